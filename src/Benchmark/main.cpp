@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "EffectBenchmark.h"
+#include "Win32Utils.h"
+#include "StrUtils.h"
+#include "CommonSharedConstants.h"
+#include <filesystem>
+
+using namespace Magpie::Core;
+
+static void PrintUsage() noexcept {
+	std::fputws(LR"(用法: Benchmark [选项] <效果>...
+      Benchmark --parse [--frames N]
+      Benchmark --validate-fp16-storage [选项] <效果>...
+
+效果为 effects 文件夹中的文件名，不含扩展名，按顺序执行。
+CPU 参考实现的测量使用 CpuBenchmark，它不需要 GPU，可以在任何平台上构建。
+
+选项:
+  --parse             测量解析 effects 文件夹中所有效果的速度，--frames 为迭代次数
+  --validate-fp16-storage
+                      比较 FP16 存储和全精度的输出，报告每个中间纹理造成的误差，
+                      并将误差足够小的中间纹理保存到 effects\fp16_storage.json
+  --input WxH         合成画面的尺寸，默认为 1920x1080
+  --frames-from F...  使用录制的帧 (DDS)，直到下一个选项为止
+  --output WxH        缩放窗口的尺寸，默认为 3840x2160
+  --frames N          测量的帧数，默认为 300
+  --warmup N          预热的帧数，默认为 30
+  --adapter N         图形适配器序号
+  --fp16              使用半精度浮点数
+  --tiled             分块执行支持的效果
+  --no-fp16-storage   忽略 FP16 存储的验证结果，中间纹理使用效果指定的格式
+  --trace PATH        保存 Chrome 格式的 trace
+)", stderr);
+}
+
+static bool ParseSize(const wchar_t* str, SIZE& size) noexcept {
+	int width = 0;
+	int height = 0;
+	if (swscanf_s(str, L"%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+		return false;
+	}
+
+	size = { width, height };
+	return true;
+}
+
+static bool ParseUInt(const wchar_t* str, uint32_t& value) noexcept {
+	wchar_t* end = nullptr;
+	const unsigned long result = std::wcstoul(str, &end, 10);
+	if (end == str || *end != L'\0') {
+		return false;
+	}
+
+	value = (uint32_t)result;
+	return true;
+}
+
+// 相对路径基于调用者的当前目录，必须在改变当前目录前转换
+static std::wstring ToAbsolutePath(const wchar_t* path) noexcept {
+	std::error_code ec;
+	std::filesystem::path result = std::filesystem::absolute(path, ec);
+	return ec ? std::wstring(path) : result.wstring();
+}
+
+static bool ParseArgs(
+	int argc,
+	wchar_t* argv[],
+	EffectBenchmarkOptions& options,
+	bool& parseOnly,
+	bool& validateFP16Storage
+) noexcept {
+	bool fp16 = false;
+	bool tiled = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::wstring_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == L"--parse") {
+			parseOnly = true;
+		} else if (arg == L"--fp16") {
+			fp16 = true;
+		} else if (arg == L"--tiled") {
+			tiled = true;
+		} else if (arg == L"--no-fp16-storage") {
+			options.useFP16Storage = false;
+		} else if (arg == L"--validate-fp16-storage") {
+			validateFP16Storage = true;
+		} else if (arg == L"--input") {
+			if (!hasValue || !ParseSize(argv[++i], options.inputSize)) {
+				return false;
+			}
+		} else if (arg == L"--output") {
+			if (!hasValue || !ParseSize(argv[++i], options.outputSize)) {
+				return false;
+			}
+		} else if (arg == L"--frames") {
+			if (!hasValue || !ParseUInt(argv[++i], options.frameCount)) {
+				return false;
+			}
+		} else if (arg == L"--warmup") {
+			if (!hasValue || !ParseUInt(argv[++i], options.warmupFrameCount)) {
+				return false;
+			}
+		} else if (arg == L"--adapter") {
+			uint32_t adapter = 0;
+			if (!hasValue || !ParseUInt(argv[++i], adapter)) {
+				return false;
+			}
+			options.graphicsCard = (int)adapter;
+		} else if (arg == L"--trace") {
+			if (!hasValue) {
+				return false;
+			}
+			options.tracePath = ToAbsolutePath(argv[++i]);
+		} else if (arg == L"--frames-from") {
+			while (i + 1 < argc && !std::wstring_view(argv[i + 1]).starts_with(L"--")) {
+				options.inputFrames.push_back(ToAbsolutePath(argv[++i]));
+			}
+			if (options.inputFrames.empty()) {
+				return false;
+			}
+		} else if (arg.starts_with(L"--")) {
+			return false;
+		} else {
+			options.effects.emplace_back().name = arg;
+		}
+	}
+
+	for (EffectOption& effect : options.effects) {
+		if (fp16) {
+			effect.flags |= EffectOptionFlags::FP16;
+		}
+		if (tiled) {
+			effect.flags |= EffectOptionFlags::Tiled;
+		}
+	}
+
+	if (validateFP16Storage && parseOnly) {
+		return false;
+	}
+
+	return parseOnly || !options.effects.empty();
+}
+
+// 将当前目录设为程序所在目录，以便找到 effects 文件夹
+static void SetWorkingDir() noexcept {
+	std::wstring path = Win32Utils::GetExePath();
+
+	FAIL_FAST_IF_FAILED(PathCchRemoveFileSpec(
+		path.data(),
+		path.size() + 1
+	));
+
+	FAIL_FAST_IF_WIN32_BOOL_FALSE(SetCurrentDirectory(path.c_str()));
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+	EffectBenchmarkOptions options;
+	bool parseOnly = false;
+	bool validateFP16Storage = false;
+	if (!ParseArgs(argc, argv, options, parseOnly, validateFP16Storage)) {
+		PrintUsage();
+		return 2;
+	}
+
+	SetWorkingDir();
+
+	Logger::Get().Initialize(
+		spdlog::level::info,
+		CommonSharedConstants::BENCHMARK_LOG_PATH,
+		100000,
+		2,
+		false
+	);
+
+	std::optional<std::string> result;
+	if (parseOnly) {
+		result = EffectBenchmark::RunParser(options.frameCount);
+	} else if (validateFP16Storage) {
+		result = EffectBenchmark::ValidateFP16Storage(options);
+	} else {
+		result = EffectBenchmark::Run(options);
+	}
+	if (!result) {
+		std::fprintf(stderr, "测量失败，详见 %s\n", CommonSharedConstants::BENCHMARK_LOG_PATH);
+		return 1;
+	}
+
+	std::fwrite(result->data(), 1, result->size(), stdout);
+	std::fputc('\n', stdout);
+	return 0;
+}
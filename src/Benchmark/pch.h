@@ -0,0 +1,6 @@
+#pragma once
+#include "CommonPch.h"
+
+// DirectX 头文件
+#include <d3d11_4.h>
+#include <dxgi1_6.h>
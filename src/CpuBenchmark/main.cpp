@@ -0,0 +1,250 @@
+#include "CpuEffectDrawer.h"
+#include "EffectParser.h"
+#include "FrameTrace.h"
+#include "SyntheticFrame.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+
+using namespace Magpie::Core;
+
+// CMake 构建时为源码中 effects 文件夹的路径
+#ifndef MP_EFFECTS_DIR
+#define MP_EFFECTS_DIR "effects/"
+#endif
+
+static void PrintUsage() noexcept {
+	std::fputs(R"(用法: CpuBenchmark [选项] <效果>...
+
+使用 CpuEffectDrawer 测量效果的性能，输入为合成的画面，只支持有内置 CPU 实现的效果。
+效果为 effects 文件夹中的文件名，不含扩展名，按顺序执行，最后一个效果等比缩放到输出尺寸。
+
+选项:
+  --input WxH         合成画面的尺寸，默认为 1920x1080
+  --output WxH        缩放窗口的尺寸，默认为 3840x2160
+  --frames N          测量的帧数，默认为 300
+  --warmup N          预热的帧数，默认为 30
+  --effects-dir DIR   effects 文件夹的路径
+  --trace PATH        保存 Chrome 格式的 trace
+)", stderr);
+}
+
+struct CpuBenchmarkOptions {
+	std::vector<std::string> effects;
+	std::string effectsDir = MP_EFFECTS_DIR;
+	CpuSize inputSize{ 1920, 1080 };
+	CpuSize outputSize{ 3840, 2160 };
+	uint32_t warmupFrameCount = 30;
+	uint32_t frameCount = 300;
+	// 非空则保存 Chrome 格式的 trace
+	std::string tracePath;
+};
+
+static bool ParseUInt(const char* str, uint32_t& value, char terminator = '\0', const char** end = nullptr) noexcept {
+	char* parseEnd = nullptr;
+	const unsigned long result = std::strtoul(str, &parseEnd, 10);
+	if (parseEnd == str || *parseEnd != terminator) {
+		return false;
+	}
+
+	value = (uint32_t)result;
+	if (end) {
+		*end = parseEnd;
+	}
+	return true;
+}
+
+static bool ParseSize(const char* str, CpuSize& size) noexcept {
+	const char* heightStr = nullptr;
+	if (!ParseUInt(str, size.width, 'x', &heightStr) || !ParseUInt(heightStr + 1, size.height)) {
+		return false;
+	}
+
+	return size.width > 0 && size.height > 0;
+}
+
+static bool ParseArgs(int argc, char* argv[], CpuBenchmarkOptions& options) noexcept {
+	for (int i = 1; i < argc; ++i) {
+		const std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--input") {
+			if (!hasValue || !ParseSize(argv[++i], options.inputSize)) {
+				return false;
+			}
+		} else if (arg == "--output") {
+			if (!hasValue || !ParseSize(argv[++i], options.outputSize)) {
+				return false;
+			}
+		} else if (arg == "--frames") {
+			if (!hasValue || !ParseUInt(argv[++i], options.frameCount)) {
+				return false;
+			}
+		} else if (arg == "--warmup") {
+			if (!hasValue || !ParseUInt(argv[++i], options.warmupFrameCount)) {
+				return false;
+			}
+		} else if (arg == "--effects-dir") {
+			if (!hasValue) {
+				return false;
+			}
+			options.effectsDir = argv[++i];
+			if (!options.effectsDir.ends_with('/') && !options.effectsDir.ends_with('\\')) {
+				options.effectsDir.push_back('/');
+			}
+		} else if (arg == "--trace") {
+			if (!hasValue) {
+				return false;
+			}
+			options.tracePath = argv[++i];
+		} else if (arg.starts_with("--")) {
+			return false;
+		} else {
+			options.effects.emplace_back(arg);
+		}
+	}
+
+	return !options.effects.empty() && options.frameCount > 0;
+}
+
+static CpuSize CalcFitSize(CpuSize inputSize, CpuSize outputSize) noexcept {
+	const float scale = std::min(
+		float(outputSize.width) / inputSize.width,
+		float(outputSize.height) / inputSize.height
+	);
+	return { (uint32_t)std::lroundf(inputSize.width * scale), (uint32_t)std::lroundf(inputSize.height * scale) };
+}
+
+static bool LoadEffectMetadata(const std::string& effectsDir, const std::string& effectName, EffectMetadata& metadata) noexcept {
+	std::ifstream file(effectsDir + effectName + ".hlsl", std::ios::binary);
+	std::string source(std::istreambuf_iterator<char>(file), {});
+	if (source.empty()) {
+		std::fprintf(stderr, "读取 %s.hlsl 失败\n", effectName.c_str());
+		return false;
+	}
+
+	if (EffectParser::ParseMetadata(source, metadata)) {
+		std::fprintf(stderr, "解析 %s.hlsl 失败\n", effectName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// 结果的格式和 Benchmark 相同，但统计的是每个效果而不是每个通道
+static std::optional<std::string> Run(const CpuBenchmarkOptions& options) noexcept {
+	std::vector<CpuEffectDrawer> effectDrawers(options.effects.size());
+	CpuSize curSize = options.inputSize;
+	for (size_t i = 0; i < options.effects.size(); ++i) {
+		const std::string& effectName = options.effects[i];
+		if (!CpuEffectDrawer::IsSupported(effectName)) {
+			std::fprintf(stderr, "%s 没有 CPU 实现\n", effectName.c_str());
+			return std::nullopt;
+		}
+
+		EffectMetadata metadata;
+		if (!LoadEffectMetadata(options.effectsDir, effectName, metadata)) {
+			return std::nullopt;
+		}
+
+		// 和 Benchmark 一致，只有最后一个效果缩放到 outputSize
+		const CpuSize drawerOutputSize = i + 1 == options.effects.size()
+			? CalcFitSize(curSize, options.outputSize) : curSize;
+		if (!effectDrawers[i].Initialize(effectName, metadata, {}, curSize, drawerOutputSize)) {
+			std::fprintf(stderr, "初始化效果#%zu (%s) 失败\n", i, effectName.c_str());
+			return std::nullopt;
+		}
+
+		curSize = effectDrawers[i].OutputSize();
+	}
+
+	// 每帧每个效果一个事件，外加每帧的总耗时
+	FrameTrace trace(uint32_t(options.effects.size() + 1) * options.frameCount);
+
+	std::vector<uint32_t> effectNameIds;
+	for (const std::string& effectName : options.effects) {
+		effectNameIds.push_back(trace.RegisterName(effectName));
+	}
+	const uint32_t totalNameId = trace.RegisterName("Total");
+
+	const uint32_t inputWidth = options.inputSize.width;
+	const std::vector<uint8_t> syntheticFrame = SyntheticFrame::Generate(inputWidth, options.inputSize.height);
+
+	const uint32_t totalFrameCount = options.warmupFrameCount + options.frameCount;
+	for (uint32_t frame = 0; frame < totalFrameCount; ++frame) {
+		const CpuTexture input = CpuTexture::FromBGRA8(SyntheticFrame::FrameData(syntheticFrame, inputWidth, frame),
+			inputWidth, options.inputSize.height, inputWidth * 4);
+
+		const bool measure = frame >= options.warmupFrameCount;
+		const uint64_t frameStart = trace.Now();
+
+		const CpuTexture* curTexture = &input;
+		for (size_t i = 0; i < effectDrawers.size(); ++i) {
+			const uint64_t start = trace.Now();
+			curTexture = &effectDrawers[i].Draw(*curTexture);
+			if (measure) {
+				trace.Record(FrameTrace::Category::CPU, effectNameIds[i], frame, start, trace.Now() - start);
+			}
+		}
+
+		if (measure) {
+			trace.Record(FrameTrace::Category::CPU, totalNameId, frame, frameStart, trace.Now() - frameStart);
+		}
+	}
+
+	if (!options.tracePath.empty()) {
+		const std::string traceJson = trace.ExportChromeTrace();
+		std::ofstream file(options.tracePath, std::ios::binary);
+		if (!file.write(traceJson.data(), traceJson.size())) {
+			std::fprintf(stderr, "保存 trace 失败\n");
+		}
+	}
+
+	// 名字只能是内置效果的名字或 Total，无需转义
+	std::string json = "{\n";
+	json += "\t\"device\": \"CPU\",\n";
+	json += "\t\"inputSize\": [" + std::to_string(options.inputSize.width) + ", " + std::to_string(options.inputSize.height) + "],\n";
+	json += "\t\"outputSize\": [" + std::to_string(curSize.width) + ", " + std::to_string(curSize.height) + "],\n";
+	json += "\t\"frameCount\": " + std::to_string(options.frameCount) + ",\n";
+	// 单位均为毫秒
+	json += "\t\"effects\": [";
+	bool isFirst = true;
+	for (const FrameTrace::Summary& summary : trace.Summarize()) {
+		json += isFirst ? "\n" : ",\n";
+		isFirst = false;
+
+		json += "\t\t{\n";
+		json += "\t\t\t\"name\": \"" + summary.name + "\",\n";
+		json += "\t\t\t\"count\": " + std::to_string(summary.count) + ",\n";
+		json += "\t\t\t\"average\": " + std::to_string(summary.average) + ",\n";
+		json += "\t\t\t\"p50\": " + std::to_string(summary.p50) + ",\n";
+		json += "\t\t\t\"p99\": " + std::to_string(summary.p99) + ",\n";
+		json += "\t\t\t\"max\": " + std::to_string(summary.max) + "\n";
+		json += "\t\t}";
+	}
+	json += "\n\t]\n}";
+
+	return json;
+}
+
+// CpuEffectDrawer 的离线测量，只依赖标准库。需要 GPU 的测量见 Benchmark
+int main(int argc, char* argv[]) {
+	CpuBenchmarkOptions options;
+	if (!ParseArgs(argc, argv, options)) {
+		PrintUsage();
+		return 2;
+	}
+
+	const std::optional<std::string> result = Run(options);
+	if (!result) {
+		return 1;
+	}
+
+	std::fwrite(result->data(), 1, result->size(), stdout);
+	std::fputc('\n', stdout);
+	return 0;
+}
@@ -93,6 +93,7 @@ Texture2D t7;
 //!NUM_THREADS 64
 //!IN INPUT
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) min16float((dot(float3(6.280e-01, 1.208e+00, 2.567e-01), O(INPUT, float2(x, y)).rgb) + -3.744e-01))
 
@@ -187,6 +188,7 @@ void Pass1(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -638,6 +640,7 @@ void Pass2(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -1089,6 +1092,7 @@ void Pass3(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -1540,6 +1544,7 @@ void Pass4(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -1991,6 +1996,7 @@ void Pass5(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -2442,6 +2448,7 @@ void Pass6(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -2893,6 +2900,7 @@ void Pass7(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -3344,6 +3352,7 @@ void Pass8(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -3795,6 +3804,7 @@ void Pass9(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -4246,6 +4256,7 @@ void Pass10(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -4697,6 +4708,7 @@ void Pass11(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -5148,6 +5160,7 @@ void Pass12(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -5599,6 +5612,7 @@ void Pass13(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -6050,6 +6064,7 @@ void Pass14(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -6501,6 +6516,7 @@ void Pass15(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t0, t1, t2, t3
 //!OUT t4, t5, t6, t7
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -6952,6 +6968,7 @@ void Pass16(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN t4, t5, t6, t7
 //!OUT t0, t1, t2, t3
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t4, float2(x, y)))
 #define l1(x, y) V4(O(t5, float2(x, y)))
@@ -7403,6 +7420,7 @@ void Pass17(uint2 blockStart, uint3 tid) {
 //!NUM_THREADS 64
 //!IN INPUT, t0, t1, t2, t3
 //!OUT OUTPUT
+//!DIRTY_RADIUS 1
 
 #define l0(x, y) V4(O(t0, float2(x, y)))
 #define l1(x, y) V4(O(t1, float2(x, y)))
@@ -53,6 +53,7 @@ SamplerState sam;
 //!OUT OUTPUT
 //!BLOCK_SIZE 8
 //!NUM_THREADS 64
+//!DIRTY_RADIUS 2
 
 #define PI 3.1415926535897932384626433832795
 
@@ -28,6 +28,7 @@ SamplerState sam;
 //!STYLE PS
 //!IN INPUT
 //!OUT OUTPUT
+//!DIRTY_RADIUS 3
 
 #define FIX(c) max(abs(c), 1e-5)
 #define PI 3.14159265359
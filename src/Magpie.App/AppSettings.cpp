@@ -14,19 +14,135 @@
 #include "ScalingMode.h"
 #include "LocalizationService.h"
 #include <ShellScalingApi.h>
+#include "Utils.h"
+#include "YasHelper.h"
 
 #pragma comment(lib, "Shcore.lib")
 
 using namespace ::Magpie::Core;
 
+namespace Magpie::Core {
+
+template<typename Archive>
+void serialize(Archive& ar, EffectOption& o) {
+	ar& o.name& o.parameters& o.scalingType& o.scale& o.flags;
+}
+
+}
+
 namespace winrt::Magpie::App {
 
+template<typename Archive>
+void serialize(Archive& ar, ScalingMode& o) {
+	ar& o.name& o.effects;
+}
+
+template<typename Archive>
+void serialize(Archive& ar, Profile& o) {
+	ar& o.name& o.pathRule& o.classNameRule& o.launcherPath& o.cursorScaling& o.customCursorScaling
+		& o.cropping& o.scalingMode& o.captureMethod& o.graphicsCard& o.multiMonitorUsage
+		& o.cursorInterpolationMode& o.maxFrameRate& o.launchParameters& o.scalingFlags
+		& o.isPackaged& o.isWildcardRule& o.isCroppingEnabled& o.isAutoScale& o.isFrameRateLimiterEnabled;
+}
+
+// 不包含 _language、_configDir、_configPath 和 _isPortableMode
+template<typename Archive>
+void serialize(Archive& ar, _AppSettingsData& o) {
+	ar& o._shortcuts& o._scalingModes& o._defaultProfile& o._profiles& o._mainWindowCenter
+		& o._mainWindowSizeInDips& o._theme& o._countdownSeconds& o._updateCheckDate
+		& o._duplicateFrameDetectionMode& o._isAlwaysRunAsAdmin& o._isDeveloperMode& o._isDebugMode
+		& o._isEffectCacheDisabled& o._isFontCacheDisabled& o._isSaveEffectSources& o._isWarningsAreErrors
+		& o._isAllowScalingMaximized& o._isSimulateExclusiveFullscreen& o._isInlineParams
+		& o._isTiledExecution& o._isShowNotifyIcon& o._isAutoRestore& o._isMainWindowMaximized
+		& o._isAutoCheckForUpdates& o._isCheckForPreviewUpdates& o._isStatisticsForDynamicDetectionEnabled
+		& o._isFrameTraceEnabled;
+}
+
 static constexpr uint32_t CONFIG_VERSION = 2;
+// SaveAsync 最后一次调用后等待的时间
+static constexpr std::chrono::milliseconds SAVE_DELAY(1000);
+
+// 配置快照保存解析后的配置以加快启动，并记录生成它的 JSON 配置的哈希。JSON 配置仍是唯一的数据来源，
+// 哈希不一致 (比如手动修改了配置文件) 时快照失效，回退到解析 JSON
+struct ConfigSnapshotHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t configHash;
+	// 解析配置的结果和系统版本有关，比如 Desktop Duplication 要求 Win10 20H1+，系统版本改变后快照失效
+	uint64_t osVersion;
+};
+
+// "MPCS"
+static constexpr uint32_t CONFIG_SNAPSHOT_MAGIC = 0x5343504D;
+// 快照结构或解析配置的逻辑有更改时更新它，使旧快照失效
+static constexpr uint32_t CONFIG_SNAPSHOT_VERSION = 4;
 
 _AppSettingsData::_AppSettingsData() {}
 
 _AppSettingsData::~_AppSettingsData() {}
 
+// 返回 LocalizationService::SupportedLanguages 索引，-1 表示使用系统设置
+static int FindLanguage(std::wstring language) noexcept {
+	if (language.empty()) {
+		return -1;
+	}
+
+	StrUtils::ToLowerCase(language);
+	std::span<const wchar_t*> languages = LocalizationService::SupportedLanguages();
+	auto it = std::find(languages.begin(), languages.end(), language);
+	if (it == languages.end()) {
+		// 未知的语言设置，重置为使用系统设置
+		return -1;
+	}
+
+	return int(it - languages.begin());
+}
+
+static uint64_t HashConfigText(std::string_view configText) noexcept {
+	return Utils::HashData({ (const BYTE*)configText.data(), configText.size() });
+}
+
+static uint64_t GetSnapshotOSVersion() noexcept {
+	const Win32Utils::OSVersion& osVersion = Win32Utils::GetOSVersion();
+	return ((uint64_t)osVersion.major << 48) | ((uint64_t)osVersion.minor << 32) | osVersion.patch;
+}
+
+// 失败不影响配置的保存，下次启动时将解析 JSON
+static void WriteConfigSnapshot(const _AppSettingsData& data, uint64_t configHash) noexcept {
+	std::vector<BYTE> buf;
+	buf.reserve(4096);
+	buf.resize(sizeof(ConfigSnapshotHeader));
+
+	try {
+		yas::vector_ostream os(buf);
+		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+
+		// 语言保存为名称，因为支持的语言改变后索引会改变
+		std::wstring language;
+		if (data._language >= 0) {
+			language = LocalizationService::SupportedLanguages()[data._language];
+		}
+
+		oa& language& data;
+	} catch (...) {
+		Logger::Get().Error("序列化配置快照失败");
+		return;
+	}
+
+	const ConfigSnapshotHeader header{
+		.magic = CONFIG_SNAPSHOT_MAGIC,
+		.version = CONFIG_SNAPSHOT_VERSION,
+		.configHash = configHash,
+		.osVersion = GetSnapshotOSVersion()
+	};
+	std::memcpy(buf.data(), &header, sizeof(header));
+
+	const std::wstring snapshotPath = data._configDir + CommonSharedConstants::CONFIG_SNAPSHOT_FILENAME;
+	if (!Win32Utils::WriteFile(snapshotPath.c_str(), buf.data(), buf.size())) {
+		Logger::Get().Error("保存配置快照失败");
+	}
+}
+
 // 将热键存储为 uint32_t
 // 不能存储为字符串，因为某些键的字符相同，如句号和小键盘的点
 static uint32_t EncodeShortcut(const Shortcut& shortcut) noexcept {
@@ -69,6 +185,8 @@ static void WriteProfile(rapidjson::PrettyWriter<rapidjson::StringBuffer>& write
 		writer.String(StrUtils::UTF16ToUTF8(profile.pathRule).c_str());
 		writer.Key("classNameRule");
 		writer.String(StrUtils::UTF16ToUTF8(profile.classNameRule).c_str());
+		writer.Key("wildcardRule");
+		writer.Bool(profile.isWildcardRule);
 		writer.Key("launcherPath");
 		writer.String(StrUtils::UTF16ToUTF8(profile.launcherPath).c_str());
 		writer.Key("autoScale");
@@ -260,6 +378,19 @@ bool AppSettings::Initialize() noexcept {
 		return true;
 	}
 
+	// 旧版本的配置文件没有快照
+	const bool isCurrentConfig = existingConfigPath == _configPath;
+	// 必须在 ParseInsitu 修改 configText 前计算
+	const uint64_t configHash = HashConfigText(configText);
+	if (isCurrentConfig && _LoadSnapshot(configHash)) {
+		logger.Info("已从快照加载配置");
+
+		if (_SetDefaultShortcuts()) {
+			SaveAsync();
+		}
+		return true;
+	}
+
 	rapidjson::Document doc;
 	doc.ParseInsitu(configText.data());
 	if (doc.HasParseError()) {
@@ -288,6 +419,10 @@ bool AppSettings::Initialize() noexcept {
 
 	_LoadSettings(root);
 
+	if (isCurrentConfig) {
+		WriteConfigSnapshot(*this, configHash);
+	}
+
 	if (_SetDefaultShortcuts()) {
 		SaveAsync();
 	}
@@ -296,17 +431,59 @@ bool AppSettings::Initialize() noexcept {
 
 bool AppSettings::Save() noexcept {
 	_UpdateWindowPlacement();
-	return _Save(*this);
+
+	// 等待中的 SaveAsync 无需再写入
+	_isSaveDirty = false;
+	return _Save(*this, ++_saveGeneration);
 }
 
 fire_and_forget AppSettings::SaveAsync() noexcept {
+	using namespace std::chrono;
+
+	// 只记录修改时间，等待结束后才拷贝配置
+	_lastSaveRequestTime = steady_clock::now();
+	_isSaveDirty = true;
+
+	if (_isSaveScheduled) {
+		co_return;
+	}
+	_isSaveScheduled = true;
+
+	CoreDispatcher dispatcher = CoreWindow::GetForCurrentThread().Dispatcher();
+
+	milliseconds delay = SAVE_DELAY;
+	while (true) {
+		co_await delay;
+
+		// 回到主线程，配置只在主线程上修改
+		co_await dispatcher;
+
+		if (!_isSaveDirty) {
+			// 已由 Save 写入
+			_isSaveScheduled = false;
+			co_return;
+		}
+
+		const milliseconds elapsed = duration_cast<milliseconds>(steady_clock::now() - _lastSaveRequestTime);
+		if (elapsed >= SAVE_DELAY) {
+			break;
+		}
+
+		// 等待期间有新的修改
+		delay = SAVE_DELAY - elapsed;
+	}
+
 	_UpdateWindowPlacement();
 
-	// 拷贝当前配置
-	_AppSettingsData data = *this;
+	const _AppSettingsData data = *this;
+	const uint64_t generation = ++_saveGeneration;
+	_isSaveDirty = false;
+	// 写入期间的修改由新的 SaveAsync 处理
+	_isSaveScheduled = false;
+
 	co_await resume_background();
 
-	_Save(data);
+	_Save(data, generation);
 }
 
 void AppSettings::IsPortableMode(bool value) noexcept {
@@ -322,6 +499,9 @@ void AppSettings::IsPortableMode(bool value) noexcept {
 				return;
 			}
 		}
+
+		// 快照失去意义，删除失败也无妨
+		DeleteFile(StrUtils::Concat(_configDir, CommonSharedConstants::CONFIG_SNAPSHOT_FILENAME).c_str());
 	}
 
 	_isPortableMode = value;
@@ -400,6 +580,7 @@ void AppSettings::IsDeveloperMode(bool value) noexcept {
 		_isWarningsAreErrors = false;
 		_duplicateFrameDetectionMode = DuplicateFrameDetectionMode::Dynamic;
 		_isStatisticsForDynamicDetectionEnabled = false;
+		_isFrameTraceEnabled = false;
 	}
 
 	SaveAsync();
@@ -457,7 +638,7 @@ void AppSettings::_UpdateWindowPlacement() noexcept {
 	_isMainWindowMaximized = wp.showCmd == SW_MAXIMIZE;
 }
 
-bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
+bool AppSettings::_Save(const _AppSettingsData& data, uint64_t generation) noexcept {
 	HRESULT hr = wil::CreateDirectoryDeepNoThrow(data._configDir.c_str());
 	if (FAILED(hr)) {
 		Logger::Get().ComError("创建配置文件夹失败", hr);
@@ -469,10 +650,10 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 	writer.StartObject();
 
 	writer.Key("language");
-	if (_language < 0) {
+	if (data._language < 0) {
 		writer.String("");
 	} else {
-		const wchar_t* language = LocalizationService::SupportedLanguages()[_language];
+		const wchar_t* language = LocalizationService::SupportedLanguages()[data._language];
 		writer.String(StrUtils::UTF16ToUTF8(language).c_str());
 	}
 
@@ -527,6 +708,8 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 	writer.Bool(data._isShowNotifyIcon);
 	writer.Key("inlineParams");
 	writer.Bool(data._isInlineParams);
+	writer.Key("tiledExecution");
+	writer.Bool(data._isTiledExecution);
 	writer.Key("autoCheckForUpdates");
 	writer.Bool(data._isAutoCheckForUpdates);
 	writer.Key("checkForPreviewUpdates");
@@ -537,8 +720,10 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 	writer.Uint((uint32_t)data._duplicateFrameDetectionMode);
 	writer.Key("enableStatisticsForDynamicDetection");
 	writer.Bool(data._isStatisticsForDynamicDetectionEnabled);
+	writer.Key("enableFrameTrace");
+	writer.Bool(data._isFrameTraceEnabled);
 
-	ScalingModesService::Get().Export(writer);
+	ScalingModesService::Get().Export(writer, data._scalingModes);
 
 	writer.Key("profiles");
 	writer.StartArray();
@@ -550,13 +735,87 @@ bool AppSettings::_Save(const _AppSettingsData& data) noexcept {
 
 	writer.EndObject();
 
+	const std::string_view configText(json.GetString(), json.GetLength());
+
 	// 防止并行写入
 	auto lock = _saveLock.lock_exclusive();
-	if (!Win32Utils::WriteTextFile(data._configPath.c_str(), { json.GetString(), json.GetLength() })) {
+	if (generation < _savedGeneration) {
+		// 已写入更新的配置
+		return true;
+	}
+
+	if (configText == _savedConfigText && data._configPath == _savedConfigPath) {
+		_savedGeneration = generation;
+		return true;
+	}
+
+	if (!Win32Utils::WriteTextFileAtomic(data._configPath.c_str(), configText)) {
 		Logger::Get().Error("保存配置失败");
 		return false;
 	}
 
+	_savedConfigText = configText;
+	_savedConfigPath = data._configPath;
+	_savedGeneration = generation;
+
+	// 快照和 JSON 配置由同一份数据生成
+	WriteConfigSnapshot(data, HashConfigText(configText));
+	return true;
+}
+
+bool AppSettings::_LoadSnapshot(uint64_t configHash) noexcept {
+	const std::wstring snapshotPath = _configDir + CommonSharedConstants::CONFIG_SNAPSHOT_FILENAME;
+	if (!Win32Utils::FileExists(snapshotPath.c_str())) {
+		return false;
+	}
+
+	std::vector<BYTE> buf;
+	if (!Win32Utils::ReadFile(snapshotPath.c_str(), buf)) {
+		Logger::Get().Error("读取配置快照失败");
+		return false;
+	}
+
+	ConfigSnapshotHeader header{};
+	if (buf.size() < sizeof(header)) {
+		Logger::Get().Error("配置快照已损坏");
+		return false;
+	}
+	std::memcpy(&header, buf.data(), sizeof(header));
+
+	if (header.magic != CONFIG_SNAPSHOT_MAGIC || header.version != CONFIG_SNAPSHOT_VERSION) {
+		Logger::Get().Info("配置快照版本不匹配");
+		return false;
+	}
+
+	if (header.configHash != configHash) {
+		Logger::Get().Info("配置文件已修改，配置快照失效");
+		return false;
+	}
+
+	if (header.osVersion != GetSnapshotOSVersion()) {
+		Logger::Get().Info("系统版本已改变，配置快照失效");
+		return false;
+	}
+
+	// 先反序列化到临时对象，失败时不影响解析 JSON
+	_AppSettingsData data;
+	std::wstring language;
+	try {
+		yas::mem_istream mi(buf.data() + sizeof(header), buf.size() - sizeof(header));
+		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+
+		ia& language& data;
+	} catch (...) {
+		Logger::Get().Error("反序列化配置快照失败");
+		return false;
+	}
+
+	data._language = FindLanguage(std::move(language));
+	data._configDir = _configDir;
+	data._configPath = _configPath;
+	data._isPortableMode = _isPortableMode;
+	static_cast<_AppSettingsData&>(*this) = data;
+
 	return true;
 }
 
@@ -565,19 +824,7 @@ void AppSettings::_LoadSettings(const rapidjson::GenericObject<true, rapidjson::
 	{
 		std::wstring language;
 		JsonHelper::ReadString(root, "language", language);
-		if (language.empty()) {
-			_language = -1;
-		} else {
-			StrUtils::ToLowerCase(language);
-			std::span<const wchar_t*> languages = LocalizationService::SupportedLanguages();
-			auto it = std::find(languages.begin(), languages.end(), language);
-			if (it == languages.end()) {
-				// 未知的语言设置，重置为使用系统设置
-				_language = -1;
-			} else {
-				_language = int(it - languages.begin());
-			}
-		}
+		_language = FindLanguage(std::move(language));
 	}
 
 	{
@@ -681,6 +928,7 @@ void AppSettings::_LoadSettings(const rapidjson::GenericObject<true, rapidjson::
 		JsonHelper::ReadBool(root, "showTrayIcon", _isShowNotifyIcon);
 	}
 	JsonHelper::ReadBool(root, "inlineParams", _isInlineParams);
+	JsonHelper::ReadBool(root, "tiledExecution", _isTiledExecution);
 	JsonHelper::ReadBool(root, "autoCheckForUpdates", _isAutoCheckForUpdates);
 	JsonHelper::ReadBool(root, "checkForPreviewUpdates", _isCheckForPreviewUpdates);
 	{
@@ -699,6 +947,7 @@ void AppSettings::_LoadSettings(const rapidjson::GenericObject<true, rapidjson::
 		_duplicateFrameDetectionMode = (::Magpie::Core::DuplicateFrameDetectionMode)duplicateFrameDetectionMode;
 	}
 	JsonHelper::ReadBool(root, "enableStatisticsForDynamicDetection", _isStatisticsForDynamicDetectionEnabled);
+	JsonHelper::ReadBool(root, "enableFrameTrace", _isFrameTraceEnabled);
 
 	[[maybe_unused]] bool result = ScalingModesService::Get().Import(root, true);
 	assert(result);
@@ -768,6 +1017,7 @@ bool AppSettings::_LoadProfile(
 			return false;
 		}
 
+		JsonHelper::ReadBool(profileObj, "wildcardRule", profile.isWildcardRule);
 		JsonHelper::ReadString(profileObj, "launcherPath", profile.launcherPath);
 		JsonHelper::ReadBool(profileObj, "autoScale", profile.isAutoScale);
 		JsonHelper::ReadString(profileObj, "launchParameters", profile.launchParameters);
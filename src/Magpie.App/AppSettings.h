@@ -62,12 +62,14 @@ struct _AppSettingsData {
 	bool _isAllowScalingMaximized = false;
 	bool _isSimulateExclusiveFullscreen = false;
 	bool _isInlineParams = false;
+	bool _isTiledExecution = false;
 	bool _isShowNotifyIcon = true;
 	bool _isAutoRestore = false;
 	bool _isMainWindowMaximized = false;
 	bool _isAutoCheckForUpdates = true;
 	bool _isCheckForPreviewUpdates = false;
 	bool _isStatisticsForDynamicDetectionEnabled = false;
+	bool _isFrameTraceEnabled = false;
 };
 
 class AppSettings : private _AppSettingsData {
@@ -81,8 +83,11 @@ public:
 
 	bool Initialize() noexcept;
 
+	// 立即保存，取消等待中的 SaveAsync
 	bool Save() noexcept;
 
+	// 合并短时间内的多次修改，最后一次调用后 SAVE_DELAY 内没有新的调用才拷贝配置并在后台保存。
+	// 只能在主线程调用
 	fire_and_forget SaveAsync() noexcept;
 
 	const std::wstring& ConfigDir() const noexcept {
@@ -234,6 +239,15 @@ public:
 		SaveAsync();
 	}
 
+	bool IsTiledExecution() const noexcept {
+		return _isTiledExecution;
+	}
+
+	void IsTiledExecution(bool value) noexcept {
+		_isTiledExecution = value;
+		SaveAsync();
+	}
+
 	std::vector<ScalingMode>& ScalingModes() noexcept {
 		return _scalingModes;
 	}
@@ -283,6 +297,15 @@ public:
 		SaveAsync();
 	}
 
+	bool IsFrameTraceEnabled() const noexcept {
+		return _isFrameTraceEnabled;
+	}
+
+	void IsFrameTraceEnabled(bool value) noexcept {
+		_isFrameTraceEnabled = value;
+		SaveAsync();
+	}
+
 	WinRTUtils::Event<delegate<Magpie::App::Theme>> ThemeChanged;
 	WinRTUtils::Event<delegate<ShortcutAction>> ShortcutChanged;
 	WinRTUtils::Event<delegate<bool>> IsAutoRestoreChanged;
@@ -297,8 +320,11 @@ private:
 	AppSettings(AppSettings&&) = delete;
 
 	void _UpdateWindowPlacement() noexcept;
-	bool _Save(const _AppSettingsData& data) noexcept;
+	// generation 小于已写入的配置的 generation 时不写入，防止旧的配置覆盖新的
+	bool _Save(const _AppSettingsData& data, uint64_t generation) noexcept;
 
+	// 配置文件的哈希和快照中记录的不一致时返回 false，此时配置不变
+	bool _LoadSnapshot(uint64_t configHash) noexcept;
 	void _LoadSettings(const rapidjson::GenericObject<true, rapidjson::Value>& root) noexcept;
 	bool _LoadProfile(
 		const rapidjson::GenericObject<true, rapidjson::Value>& profileObj,
@@ -310,8 +336,21 @@ private:
 
 	bool _UpdateConfigPath(std::wstring* existingConfigPath = nullptr) noexcept;
 
-	// 用于同步保存
+	// 以下成员只在主线程访问
+	std::chrono::steady_clock::time_point _lastSaveRequestTime;
+	// 是否有尚未写入的修改
+	bool _isSaveDirty = false;
+	// 是否有 SaveAsync 正在等待
+	bool _isSaveScheduled = false;
+	// 每次拷贝配置的序号
+	uint64_t _saveGeneration = 0;
+
+	// 用于同步保存，保护以下成员
 	wil::srwlock _saveLock;
+	// 上一次写入的内容，没有变化时跳过写入
+	std::string _savedConfigText;
+	std::wstring _savedConfigPath;
+	uint64_t _savedGeneration = 0;
 };
 
 }
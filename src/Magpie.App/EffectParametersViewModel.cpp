@@ -15,47 +15,12 @@
 #include "ScalingModesService.h"
 #include "ScalingMode.h"
 #include "EffectsService.h"
+#include "ScalingService.h"
 
 using namespace Magpie::Core;
 
 namespace winrt::Magpie::App::implementation {
 
-// 限制保存频率
-// 1 秒内没有新的调用才执行保存
-static fire_and_forget LazySaveAppSettings() {
-	using namespace std::chrono;
-
-	static steady_clock::time_point lastInvokeTime;
-	static bool sleeping = false;
-
-	lastInvokeTime = steady_clock::now();
-
-	if (sleeping) {
-		co_return;
-	}
-
-	sleeping = true;
-	CoreDispatcher dispatcher = CoreWindow::GetForCurrentThread().Dispatcher();
-	
-	co_await 1s;
-
-	while (true) {
-		int duration = (int)duration_cast<milliseconds>(steady_clock::now() - lastInvokeTime).count();
-		if (duration >= 999) {
-			break;
-		}
-
-		// 如果与 lastInvokeTime 相差不到 1s，则继续等待
-		co_await milliseconds(1000 - duration);
-	}
-
-	// 回到主线程
-	co_await dispatcher;
-
-	sleeping = false;
-	AppSettings::Get().SaveAsync();
-}
-
 EffectParametersViewModel::EffectParametersViewModel(uint32_t scalingModeIdx, uint32_t effectIdx)
 	: _scalingModeIdx(scalingModeIdx), _effectIdx(effectIdx)
 {
@@ -131,10 +96,14 @@ void EffectParametersViewModel::_ScalingModeBoolParameter_PropertyChanged(
 
 	ScalingModeBoolParameter* boolParamImpl =
 		get_self<ScalingModeBoolParameter>(sender.as<Magpie::App::ScalingModeBoolParameter>());
-	const std::string& effectName = _effectInfo->params[boolParamImpl->Index()].name;
-	_Data()[StrUtils::UTF8ToUTF16(effectName)] = (float)boolParamImpl->Value();
+	std::wstring paramName = StrUtils::UTF8ToUTF16(_effectInfo->params[boolParamImpl->Index()].name);
+	const float value = (float)boolParamImpl->Value();
+	_Data()[paramName] = value;
 
-	LazySaveAppSettings();
+	AppSettings::Get().SaveAsync();
+
+	// 立即应用到正在使用此缩放模式的缩放窗口
+	ScalingService::Get().OnEffectParameterChanged(_scalingModeIdx, _effectIdx, paramName, value);
 }
 
 void EffectParametersViewModel::_ScalingModeFloatParameter_PropertyChanged(
@@ -147,10 +116,14 @@ void EffectParametersViewModel::_ScalingModeFloatParameter_PropertyChanged(
 
 	ScalingModeFloatParameter* floatParamImpl =
 		get_self<ScalingModeFloatParameter>(sender.as<Magpie::App::ScalingModeFloatParameter>());
-	const std::string& effectName = _effectInfo->params[floatParamImpl->Index()].name;
-	_Data()[StrUtils::UTF8ToUTF16(effectName)] = (float)floatParamImpl->Value();
+	std::wstring paramName = StrUtils::UTF8ToUTF16(_effectInfo->params[floatParamImpl->Index()].name);
+	const float value = (float)floatParamImpl->Value();
+	_Data()[paramName] = value;
+
+	AppSettings::Get().SaveAsync();
 
-	LazySaveAppSettings();
+	// 立即应用到正在使用此缩放模式的缩放窗口
+	ScalingService::Get().OnEffectParameterChanged(_scalingModeIdx, _effectIdx, paramName, value);
 }
 
 phmap::flat_hash_map<std::wstring, float>& EffectParametersViewModel::_Data() {
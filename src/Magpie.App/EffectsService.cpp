@@ -6,7 +6,6 @@
 #include "CommonSharedConstants.h"
 #include "Logger.h"
 #include <d3dcompiler.h>	// ID3DBlob
-#include <Magpie.Core.h>
 
 using namespace Magpie::Core;
 
@@ -16,7 +15,13 @@ EffectInfo::EffectInfo() {}
 
 EffectInfo::~EffectInfo() {}
 
-static void ListEffects(std::vector<std::wstring>& result, std::wstring_view prefix = {}) {
+struct EffectFile {
+	std::wstring name;
+	uint64_t lastWriteTime;
+	uint64_t fileSize;
+};
+
+static void ListEffects(std::vector<EffectFile>& result, std::wstring_view prefix = {}) {
 	result.reserve(80);
 
 	WIN32_FIND_DATA findData{};
@@ -39,61 +44,124 @@ static void ListEffects(std::vector<std::wstring>& result, std::wstring_view pre
 				continue;
 			}
 
-			result.emplace_back(StrUtils::Concat(prefix, fileName.substr(0, fileName.size() - 5)));
+			// 枚举时已得到修改时间和大小，无需再打开文件
+			result.push_back({
+				.name = StrUtils::Concat(prefix, fileName.substr(0, fileName.size() - 5)),
+				.lastWriteTime = ((uint64_t)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime,
+				.fileSize = ((uint64_t)findData.nFileSizeHigh << 32) | findData.nFileSizeLow
+			});
 		} while (FindNextFile(hFind.get(), &findData));
 	} else {
 		Logger::Get().Win32Error("查找缓存文件失败");
 	}
 }
 
+// 源文件没有变化时从索引中读取，否则解析源码
+static bool GetEffectMetadata(
+	const EffectMetadataIndex& index,
+	const EffectFile& effectFile,
+	EffectMetadataIndexEntry& entry,
+	bool& fromIndex
+) noexcept {
+	entry.name = StrUtils::UTF16ToUTF8(effectFile.name);
+	entry.lastWriteTime = effectFile.lastWriteTime;
+	entry.fileSize = effectFile.fileSize;
+
+	if (const EffectMetadata* metadata = index.Find(entry.name, entry.lastWriteTime, entry.fileSize)) {
+		entry.metadata = *metadata;
+		fromIndex = true;
+		return true;
+	}
+
+	std::string source;
+	if (!Win32Utils::ReadTextFile(
+		StrUtils::Concat(CommonSharedConstants::EFFECTS_DIR, effectFile.name, L".hlsl").c_str(), source)) {
+		Logger::Get().Error(StrUtils::Concat("读取 ", entry.name, ".hlsl 失败"));
+		return false;
+	}
+
+	if (EffectParser::ParseMetadata(source, entry.metadata)) {
+		Logger::Get().Error(StrUtils::Concat("解析 ", entry.name, ".hlsl 失败"));
+		return false;
+	}
+
+	return true;
+}
+
 fire_and_forget EffectsService::StartInitialize() {
 	co_await resume_background();
 
-	std::vector<std::wstring> effectNames;
-	ListEffects(effectNames);
+	std::vector<EffectFile> effectFiles;
+	ListEffects(effectFiles);
 
-	const uint32_t nEffect = (uint32_t)effectNames.size();
-	_effectsMap.reserve(nEffect);
-	_effects.reserve(nEffect);
+	EffectMetadataIndex index;
+	index.Load();
 
-	// 用于同步 _effectsMap 和 _effects 的初始化
-	wil::srwlock srwLock;
+	const uint32_t nEffect = (uint32_t)effectFiles.size();
+	std::vector<EffectMetadataIndexEntry> entries(nEffect);
+	enum class State : uint8_t {
+		Failed,
+		FromIndex,
+		Parsed
+	};
+	std::vector<State> states(nEffect, State::Failed);
 
 	// 并行解析效果
 	Win32Utils::RunParallel([&](uint32_t id) {
-		EffectDesc effectDesc;
+		bool fromIndex = false;
+		if (GetEffectMetadata(index, effectFiles[id], entries[id], fromIndex)) {
+			states[id] = fromIndex ? State::FromIndex : State::Parsed;
+		}
+	}, nEffect);
+
+	_effectsMap.reserve(nEffect);
+	_effects.reserve(nEffect);
 
-		effectDesc.name = StrUtils::UTF16ToUTF8(effectNames[id]);
-		if (EffectCompiler::Compile(effectDesc, EffectCompilerFlags::NoCompile)) {
-			return;
+	bool indexChanged = false;
+	std::vector<EffectMetadataIndexEntry> newIndex;
+	newIndex.reserve(nEffect);
+	for (uint32_t i = 0; i < nEffect; ++i) {
+		if (states[i] == State::Failed) {
+			continue;
+		}
+		if (states[i] == State::Parsed) {
+			indexChanged = true;
 		}
 
+		const EffectMetadata& metadata = entries[i].metadata;
+
 		EffectInfo effect;
-		effect.name = std::move(effectNames[id]);
+		effect.name = std::move(effectFiles[i].name);
 
-		if (effectDesc.sortName.empty()) {
+		if (metadata.sortName.empty()) {
 			effect.sortName = effect.name;
 		} else {
 			size_t pos = effect.name.find_last_of(L'\\');
 			if (pos == std::wstring::npos) {
-				effect.sortName = StrUtils::UTF8ToUTF16(effectDesc.sortName);
+				effect.sortName = StrUtils::UTF8ToUTF16(metadata.sortName);
 			} else {
 				effect.sortName = StrUtils::Concat(
 					std::wstring_view(effect.name.c_str(), pos + 1),
-					StrUtils::UTF8ToUTF16(effectDesc.sortName)
+					StrUtils::UTF8ToUTF16(metadata.sortName)
 				);
 			}
 		}
 
-		effect.params = std::move(effectDesc.params);
-		if (effectDesc.GetOutputSizeExpr().first.empty()) {
+		effect.params = metadata.params;
+		if (metadata.outputSizeExpr.first.empty()) {
 			effect.flags |= EffectInfoFlags::CanScale;
 		}
 
-		auto lock = srwLock.lock_exclusive();
 		_effectsMap.emplace(effect.name, (uint32_t)_effects.size());
 		_effects.emplace_back(std::move(effect));
-	}, nEffect);
+
+		newIndex.emplace_back(std::move(entries[i]));
+	}
+
+	// 有效果被修改、添加或删除时更新索引。解析失败的效果不会保存，数量的变化可以反映删除
+	if (indexChanged || newIndex.size() != index.Size()) {
+		EffectMetadataIndex::Save(newIndex);
+	}
 
 	_initialized.store(true, std::memory_order_release);
 	_initialized.notify_one();
@@ -253,6 +253,21 @@ void HomeViewModel::IsInlineParams(bool value) {
 	RaisePropertyChanged(L"IsInlineParams");
 }
 
+bool HomeViewModel::IsTiledExecution() const noexcept {
+	return AppSettings::Get().IsTiledExecution();
+}
+
+void HomeViewModel::IsTiledExecution(bool value) {
+	AppSettings& settings = AppSettings::Get();
+
+	if (settings.IsTiledExecution() == value) {
+		return;
+	}
+
+	settings.IsTiledExecution(value);
+	RaisePropertyChanged(L"IsTiledExecution");
+}
+
 bool HomeViewModel::IsSimulateExclusiveFullscreen() const noexcept {
 	return AppSettings::Get().IsSimulateExclusiveFullscreen();
 }
@@ -404,6 +419,21 @@ void HomeViewModel::IsStatisticsForDynamicDetectionEnabled(bool value) {
 	RaisePropertyChanged(L"IsStatisticsForDynamicDetectionEnabled");
 }
 
+bool HomeViewModel::IsFrameTraceEnabled() const noexcept {
+	return AppSettings::Get().IsFrameTraceEnabled();
+}
+
+void HomeViewModel::IsFrameTraceEnabled(bool value) {
+	AppSettings& settings = AppSettings::Get();
+
+	if (settings.IsFrameTraceEnabled() == value) {
+		return;
+	}
+
+	settings.IsFrameTraceEnabled(value);
+	RaisePropertyChanged(L"IsFrameTraceEnabled");
+}
+
 void HomeViewModel::_ScalingService_IsTimerOnChanged(bool value) {
 	if (!value) {
 		RaisePropertyChanged(L"TimerProgressRingValue");
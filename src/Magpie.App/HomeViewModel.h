@@ -63,6 +63,9 @@ struct HomeViewModel : HomeViewModelT<HomeViewModel>, wil::notify_property_chang
 	bool IsInlineParams() const noexcept;
 	void IsInlineParams(bool value);
 
+	bool IsTiledExecution() const noexcept;
+	void IsTiledExecution(bool value);
+
 	bool IsSimulateExclusiveFullscreen() const noexcept;
 	void IsSimulateExclusiveFullscreen(bool value);
 
@@ -91,6 +94,9 @@ struct HomeViewModel : HomeViewModelT<HomeViewModel>, wil::notify_property_chang
 
 	bool IsStatisticsForDynamicDetectionEnabled() const noexcept;
 	void IsStatisticsForDynamicDetectionEnabled(bool value);
+
+	bool IsFrameTraceEnabled() const noexcept;
+	void IsFrameTraceEnabled(bool value);
 private:
 	void _ScalingService_IsTimerOnChanged(bool value);
 
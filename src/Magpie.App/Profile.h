@@ -71,6 +71,9 @@ struct Profile {
 	uint32_t scalingFlags = ::Magpie::Core::ScalingFlags::AdjustCursorSpeed | ::Magpie::Core::ScalingFlags::DrawCursor;
 
 	bool isPackaged = false;
+	// 为 true 时 pathRule 和 classNameRule 中的 * 和 ? 为通配符，否则按字面精确匹配。
+	// 只能通过编辑配置文件启用，因为类名和路径本身可以包含这些字符
+	bool isWildcardRule = false;
 	bool isCroppingEnabled = false;
 	bool isAutoScale = false;
 	bool isFrameRateLimiterEnabled = false;
@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "ProfileMatcher.h"
+#include <regex>
+#include "StrUtils.h"
+
+namespace winrt::Magpie::App {
+
+// WPF 窗口类每次启动都会改变，格式为:
+// HwndWrapper[{名称};;{GUID}]
+// GUID 格式为 xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+static bool MatchWPFClassName(std::wstring_view& className) noexcept {
+	static constexpr const wchar_t* WPF_PREFIX = L"HwndWrapper[";
+	static constexpr const wchar_t* WPF_SUFFIX = L"]";
+	if (!className.starts_with(WPF_PREFIX) || !className.ends_with(WPF_SUFFIX)) {
+		return false;
+	}
+
+	static const std::wregex regex(
+		LR"(^(.*);;[0-9,a-f]{8}-[0-9,a-f]{4}-[0-9,a-f]{4}-[0-9,a-f]{4}-[0-9,a-f]{12}$)",
+		std::wregex::optimize
+	);
+
+	std::match_results<std::wstring_view::iterator> matchResults;
+	if (!std::regex_match(
+		className.begin() + StrUtils::StrLen(WPF_PREFIX),
+		className.end() - StrUtils::StrLen(WPF_SUFFIX),
+		matchResults,
+		regex
+	)) {
+		return false;
+	}
+
+	if (matchResults.size() != 2) {
+		return false;
+	}
+
+	className = std::wstring_view(matchResults[1].first, matchResults[1].second);
+	return true;
+}
+
+// GH#508
+// RPG Maker MZ 制作的游戏每次重新加载（快捷键 F5）窗口类名都会改变，格式为:
+// Chrome_WidgetWin_{递增的数字}
+// 这个类名似乎在基于 Chromium 的程序中很常见，大多数时候是 Chrome_WidgetWin_1
+static bool MatchRPGMakerMZClassName(std::wstring_view& className) noexcept {
+	static constexpr const wchar_t* RPG_MAKER_MZ_PREFIX = L"Chrome_WidgetWin_";
+	if (!className.starts_with(RPG_MAKER_MZ_PREFIX)) {
+		return false;
+	}
+
+	// 检查数字后缀
+	for (wchar_t c : wil::make_range(className.begin() + StrUtils::StrLen(RPG_MAKER_MZ_PREFIX), className.end())) {
+		if (!StrUtils::isdigit(c)) {
+			return false;
+		}
+	}
+
+	className = L"Chrome_WidgetWin_1";
+	return true;
+}
+
+// GH#904
+// TeknoParrot 模拟 Linux 游戏时创建的窗口类名格式为：
+// XWindow_{一串数字}
+static bool MatchTeknoParrotClassName(std::wstring_view& className) noexcept {
+	static constexpr const wchar_t* TEKNO_PARROT_PREFIX = L"XWindow_";
+	if (!className.starts_with(TEKNO_PARROT_PREFIX)) {
+		return false;
+	}
+
+	// 检查数字后缀
+	for (wchar_t c : wil::make_range(className.begin() + StrUtils::StrLen(TEKNO_PARROT_PREFIX), className.end())) {
+		if (!StrUtils::isdigit(c)) {
+			return false;
+		}
+	}
+
+	className = L"XWindow_0";
+	return true;
+}
+
+std::wstring_view ProfileMatcher::ParseClassName(std::wstring_view className) noexcept {
+	for (auto func : {
+		MatchWPFClassName,
+		MatchRPGMakerMZClassName,
+		MatchTeknoParrotClassName
+	}) {
+		if (func(className)) {
+			return className;
+		}
+	}
+
+	return className;
+}
+
+// 支持 * 和 ?，区分大小写
+static bool MatchWildcard(std::wstring_view pattern, std::wstring_view str) noexcept {
+	size_t p = 0;
+	size_t s = 0;
+	// 上一个 * 的位置和它匹配到的位置，失配时回溯
+	size_t starP = std::wstring_view::npos;
+	size_t starS = 0;
+
+	while (s < str.size()) {
+		if (p < pattern.size() && (pattern[p] == L'?' || pattern[p] == str[s])) {
+			++p;
+			++s;
+		} else if (p < pattern.size() && pattern[p] == L'*') {
+			starP = p++;
+			starS = s;
+		} else if (starP != std::wstring_view::npos) {
+			p = starP + 1;
+			s = ++starS;
+		} else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == L'*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
+static std::wstring MakeAppKey(std::wstring_view className, bool isPackaged, std::wstring_view pathOrAumid) noexcept {
+	std::wstring key;
+	key.reserve(className.size() + pathOrAumid.size() + 2);
+	key += className;
+	key += L'\0';
+	key += isPackaged ? L'1' : L'0';
+	key += pathOrAumid;
+	return key;
+}
+
+void ProfileMatcher::Build(std::span<const Profile> profiles) noexcept {
+	_classRules.clear();
+	_appRules.clear();
+	_wildcardRules.clear();
+	_hasAutoScaleRules = false;
+
+	for (uint32_t i = 0; i < (uint32_t)profiles.size(); ++i) {
+		const Profile& profile = profiles[i];
+		_hasAutoScaleRules |= profile.isAutoScale;
+
+		if (IsWildcardRule(profile)) {
+			_wildcardRules.push_back({
+				.classNameRule = profile.classNameRule,
+				.pathRule = profile.pathRule,
+				.profileIdx = i,
+				.isPackaged = profile.isPackaged,
+				.isAutoScale = profile.isAutoScale
+			});
+			continue;
+		}
+
+		_classRules[profile.classNameRule].Add(i, profile.isAutoScale);
+		_appRules[MakeAppKey(profile.classNameRule, profile.isPackaged, profile.pathRule)].Add(i, profile.isAutoScale);
+	}
+}
+
+bool ProfileMatcher::_HasCandidates(
+	bool forAutoScale,
+	std::wstring_view parsedClassName,
+	SmallVector<uint32_t>& wildcardCandidates
+) const noexcept {
+	for (uint32_t i = 0; i < (uint32_t)_wildcardRules.size(); ++i) {
+		const _WildcardRule& rule = _wildcardRules[i];
+		if ((!forAutoScale || rule.isAutoScale) && MatchWildcard(rule.classNameRule, parsedClassName)) {
+			wildcardCandidates.push_back(i);
+		}
+	}
+
+	if (!wildcardCandidates.empty()) {
+		return true;
+	}
+
+	auto it = _classRules.find(parsedClassName);
+	return it != _classRules.end() && it->second.Get(forAutoScale) != NO_MATCH;
+}
+
+uint32_t ProfileMatcher::_MatchApp(
+	bool forAutoScale,
+	std::wstring_view parsedClassName,
+	bool isPackaged,
+	std::wstring_view pathOrAumid,
+	const SmallVector<uint32_t>& wildcardCandidates
+) const noexcept {
+	uint32_t result = NO_MATCH;
+
+	auto it = _appRules.find(MakeAppKey(parsedClassName, isPackaged, pathOrAumid));
+	if (it != _appRules.end()) {
+		result = it->second.Get(forAutoScale);
+	}
+
+	// 只有更靠前的通配符规则才能取代精确匹配的结果
+	for (uint32_t idx : wildcardCandidates) {
+		const _WildcardRule& rule = _wildcardRules[idx];
+		if (rule.profileIdx > result) {
+			break;
+		}
+
+		if (rule.isPackaged == isPackaged && MatchWildcard(rule.pathRule, pathOrAumid)) {
+			return rule.profileIdx;
+		}
+	}
+
+	return result;
+}
+
+}
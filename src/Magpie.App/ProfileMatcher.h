@@ -0,0 +1,105 @@
+#pragma once
+#include "Profile.h"
+#include "SmallVector.h"
+#include <parallel_hashmap/phmap.h>
+
+namespace winrt::Magpie::App {
+
+// 为窗口选择配置文件的核心逻辑，不调用 Win32 API，窗口的信息由调用者提供。
+// 配置文件改变后需重新调用 Build 建立索引。大多数配置文件的规则精确匹配，通过哈希表查找；
+// 设置了 isWildcardRule 且规则含通配符 (* 和 ?) 的按顺序逐个比较，和精确匹配的结果合并后
+// 仍返回最靠前的配置文件。
+class ProfileMatcher {
+public:
+	static constexpr uint32_t NO_MATCH = std::numeric_limits<uint32_t>::max();
+
+	// 去除类名中每次启动都会改变的部分
+	static std::wstring_view ParseClassName(std::wstring_view className) noexcept;
+
+	// 未设置 isWildcardRule 时规则中的 * 和 ? 是类名或路径的一部分
+	static bool IsWildcardRule(const Profile& profile) noexcept {
+		if (!profile.isWildcardRule) {
+			return false;
+		}
+
+		return profile.classNameRule.find_first_of(L"*?") != std::wstring::npos
+			|| profile.pathRule.find_first_of(L"*?") != std::wstring::npos;
+	}
+
+	void Build(std::span<const Profile> profiles) noexcept;
+
+	bool HasAutoScaleRules() const noexcept {
+		return _hasAutoScaleRules;
+	}
+
+	// 返回第一个匹配的配置文件的序号，没有则返回 NO_MATCH。获取窗口所属的应用代价较高，因此只在
+	// 有配置文件的类名匹配时才调用 resolveApp，签名为 bool(bool& isPackaged, std::wstring_view& pathOrAumid)，
+	// 返回 false 表示获取失败，此时视为没有匹配
+	template <typename ResolveApp>
+	uint32_t Match(bool forAutoScale, std::wstring_view parsedClassName, ResolveApp&& resolveApp) const noexcept {
+		SmallVector<uint32_t> wildcardCandidates;
+		if (!_HasCandidates(forAutoScale, parsedClassName, wildcardCandidates)) {
+			return NO_MATCH;
+		}
+
+		bool isPackaged = false;
+		std::wstring_view pathOrAumid;
+		if (!resolveApp(isPackaged, pathOrAumid)) {
+			return NO_MATCH;
+		}
+
+		return _MatchApp(forAutoScale, parsedClassName, isPackaged, pathOrAumid, wildcardCandidates);
+	}
+
+private:
+	// 类名匹配的规则中有没有可用的，同时返回类名匹配的通配符规则在 _wildcardRules 中的位置
+	bool _HasCandidates(
+		bool forAutoScale,
+		std::wstring_view parsedClassName,
+		SmallVector<uint32_t>& wildcardCandidates
+	) const noexcept;
+
+	uint32_t _MatchApp(
+		bool forAutoScale,
+		std::wstring_view parsedClassName,
+		bool isPackaged,
+		std::wstring_view pathOrAumid,
+		const SmallVector<uint32_t>& wildcardCandidates
+	) const noexcept;
+
+	// 精确匹配的规则中第一个配置文件和第一个启用自动缩放的配置文件
+	struct _Candidates {
+		uint32_t first = NO_MATCH;
+		uint32_t firstAutoScale = NO_MATCH;
+
+		uint32_t Get(bool forAutoScale) const noexcept {
+			return forAutoScale ? firstAutoScale : first;
+		}
+
+		void Add(uint32_t profileIdx, bool isAutoScale) noexcept {
+			first = std::min(first, profileIdx);
+			if (isAutoScale) {
+				firstAutoScale = std::min(firstAutoScale, profileIdx);
+			}
+		}
+	};
+
+	// 键为类名
+	phmap::flat_hash_map<std::wstring, _Candidates> _classRules;
+	// 键由类名、是否为打包应用和路径或 AUMID 组成
+	phmap::flat_hash_map<std::wstring, _Candidates> _appRules;
+
+	struct _WildcardRule {
+		std::wstring classNameRule;
+		std::wstring pathRule;
+		uint32_t profileIdx;
+		bool isPackaged;
+		bool isAutoScale;
+	};
+	// 按配置文件的顺序排列
+	std::vector<_WildcardRule> _wildcardRules;
+
+	bool _hasAutoScaleRules = false;
+};
+
+}
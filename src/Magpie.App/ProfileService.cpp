@@ -3,99 +3,10 @@
 #include "Win32Utils.h"
 #include "AppSettings.h"
 #include "AppXReader.h"
-#include <regex>
-#include "StrUtils.h"
+#include "ProfileMatcher.h"
 
 namespace winrt::Magpie::App {
 
-// WPF 窗口类每次启动都会改变，格式为:
-// HwndWrapper[{名称};;{GUID}]
-// GUID 格式为 xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
-static bool MatchWPFClassName(std::wstring_view& className) noexcept {
-	static constexpr const wchar_t* WPF_PREFIX = L"HwndWrapper[";
-	static constexpr const wchar_t* WPF_SUFFIX = L"]";
-	if (!className.starts_with(WPF_PREFIX) || !className.ends_with(WPF_SUFFIX)) {
-		return false;
-	}
-
-	static const std::wregex regex(
-		LR"(^(.*);;[0-9,a-f]{8}-[0-9,a-f]{4}-[0-9,a-f]{4}-[0-9,a-f]{4}-[0-9,a-f]{12}$)",
-		std::wregex::optimize
-	);
-
-	std::match_results<std::wstring_view::iterator> matchResults;
-	if (!std::regex_match(
-		className.begin() + StrUtils::StrLen(WPF_PREFIX),
-		className.end() - StrUtils::StrLen(WPF_SUFFIX),
-		matchResults,
-		regex
-	)) {
-		return false;
-	}
-
-	if (matchResults.size() != 2) {
-		return false;
-	}
-
-	className = std::wstring_view(matchResults[1].first, matchResults[1].second);
-	return true;
-}
-
-// GH#508
-// RPG Maker MZ 制作的游戏每次重新加载（快捷键 F5）窗口类名都会改变，格式为:
-// Chrome_WidgetWin_{递增的数字}
-// 这个类名似乎在基于 Chromium 的程序中很常见，大多数时候是 Chrome_WidgetWin_1
-static bool MatchRPGMakerMZClassName(std::wstring_view& className) noexcept {
-	static constexpr const wchar_t* RPG_MAKER_MZ_PREFIX = L"Chrome_WidgetWin_";
-	if (!className.starts_with(RPG_MAKER_MZ_PREFIX)) {
-		return false;
-	}
-
-	// 检查数字后缀
-	for (wchar_t c : wil::make_range(className.begin() + StrUtils::StrLen(RPG_MAKER_MZ_PREFIX), className.end())) {
-		if (!StrUtils::isdigit(c)) {
-			return false;
-		}
-	}
-
-	className = L"Chrome_WidgetWin_1";
-	return true;
-}
-
-// GH#904
-// TeknoParrot 模拟 Linux 游戏时创建的窗口类名格式为：
-// XWindow_{一串数字}
-static bool MatchTeknoParrotClassName(std::wstring_view& className) noexcept {
-	static constexpr const wchar_t* TEKNO_PARROT_PREFIX = L"XWindow_";
-	if (!className.starts_with(TEKNO_PARROT_PREFIX)) {
-		return false;
-	}
-
-	// 检查数字后缀
-	for (wchar_t c : wil::make_range(className.begin() + StrUtils::StrLen(TEKNO_PARROT_PREFIX), className.end())) {
-		if (!StrUtils::isdigit(c)) {
-			return false;
-		}
-	}
-
-	className = L"XWindow_0";
-	return true;
-}
-
-static std::wstring_view ParseClassName(std::wstring_view className) noexcept {
-	for (auto func : {
-		MatchWPFClassName,
-		MatchRPGMakerMZClassName,
-		MatchTeknoParrotClassName
-	}) {
-		if (func(className)) {
-			return className;
-		}
-	}
-
-	return className;
-}
-
 static bool TestNewProfileImpl(
 	bool isPackaged,
 	std::wstring_view pathOrAumid,
@@ -125,7 +36,7 @@ bool ProfileService::TestNewProfile(bool isPackaged, std::wstring_view pathOrAum
 		return false;
 	}
 
-	return TestNewProfileImpl(isPackaged, pathOrAumid, ParseClassName(className));
+	return TestNewProfileImpl(isPackaged, pathOrAumid, ProfileMatcher::ParseClassName(className));
 }
 
 bool ProfileService::AddProfile(
@@ -137,7 +48,7 @@ bool ProfileService::AddProfile(
 ) {
 	assert(!pathOrAumid.empty() && !className.empty() && !name.empty());
 
-	const std::wstring_view parsedClassName = ParseClassName(className);
+	const std::wstring_view parsedClassName = ProfileMatcher::ParseClassName(className);
 
 	if (!TestNewProfileImpl(isPackaged, pathOrAumid, parsedClassName)) {
 		return false;
@@ -153,6 +64,7 @@ bool ProfileService::AddProfile(
 	profile.pathRule = pathOrAumid;
 	profile.classNameRule = parsedClassName;
 
+	InvalidateMatcher();
 	ProfileAdded.Invoke(std::ref(profile));
 
 	AppSettings::Get().SaveAsync();
@@ -169,6 +81,7 @@ void ProfileService::RenameProfile(uint32_t profileIdx, std::wstring_view newNam
 void ProfileService::RemoveProfile(uint32_t profileIdx) {
 	std::vector<Profile>& profiles = AppSettings::Get().Profiles();
 	profiles.erase(profiles.begin() + profileIdx);
+	InvalidateMatcher();
 	ProfileRemoved.Invoke(profileIdx);
 	AppSettings::Get().SaveAsync();
 }
@@ -180,75 +93,85 @@ bool ProfileService::MoveProfile(uint32_t profileIdx, bool isMoveUp) {
 	}
 
 	std::swap(profiles[profileIdx], profiles[isMoveUp ? (size_t)profileIdx - 1 : (size_t)profileIdx + 1]);
+	InvalidateMatcher();
 	ProfileMoved.Invoke(profileIdx, isMoveUp);
 
 	AppSettings::Get().SaveAsync();
 	return true;
 }
 
-static bool AnyAutoScaleProfile(const std::vector<Profile>& profiles) noexcept {
-	for (const Profile& profile : profiles) {
-		if (profile.isAutoScale) {
-			return true;
-		}
-	}
-	return false;
-}
-
 const Profile* ProfileService::GetProfileForWindow(HWND hWnd, bool forAutoScale) noexcept {
-	const std::vector<Profile>& profiles = AppSettings::Get().Profiles();
+	if (_isMatcherOutdated) {
+		_profileMatcher.Build(AppSettings::Get().Profiles());
+		_isMatcherOutdated = false;
+		// 使所有窗口缓存的匹配结果失效
+		++_matcherVersion;
+	}
 
 	// 作为优化，先检查有没有配置文件启用了自动缩放
-	if (forAutoScale && !AnyAutoScaleProfile(profiles)) {
+	if (forAutoScale && !_profileMatcher.HasAutoScaleRules()) {
 		return nullptr;
 	}
-	
-	// 先检查窗口类名，这比获取可执行文件名快得多
-	std::wstring className = Win32Utils::GetWndClassName(hWnd);
-	std::wstring_view parsedClassName = ParseClassName(className);
-
-	std::wstring path;
-	std::optional<bool> isPackaged;
-
-	for (const Profile& profile : profiles) {
-		if (forAutoScale && !profile.isAutoScale) {
-			continue;
-		}
 
-		if (profile.classNameRule != parsedClassName) {
-			continue;
-		}
+	DWORD processId = 0;
+	const DWORD threadId = GetWindowThreadProcessId(hWnd, &processId);
+	if (threadId == 0) {
+		// 窗口已销毁
+		_wndInfoCache.erase(hWnd);
+		return forAutoScale ? nullptr : &DefaultProfile();
+	}
 
-		if (!isPackaged.has_value()) {
-			AppXReader appxReader;
-			isPackaged = appxReader.Initialize(hWnd);
-			if (*isPackaged) {
-				// 打包应用匹配 AUMID
-				path = appxReader.AUMID();
-			}
-		}
+	if (_wndInfoCache.size() >= _cacheSizeToPrune) {
+		_PruneWndInfoCache();
+	}
 
-		if (profile.isPackaged != *isPackaged) {
-			continue;
-		}
+	// 窗口的类名和所属应用在生存期内不会改变
+	auto [it, inserted] = _wndInfoCache.try_emplace(hWnd);
+	_WndInfo& wndInfo = it->second;
+	if (!inserted && (wndInfo.processId != processId || wndInfo.threadId != threadId)) {
+		// 窗口句柄被新窗口重用，缓存已过时
+		wndInfo = {};
+		inserted = true;
+	}
+	if (inserted) {
+		wndInfo.className = ProfileMatcher::ParseClassName(Win32Utils::GetWndClassName(hWnd));
+		wndInfo.processId = processId;
+		wndInfo.threadId = threadId;
+	}
 
-		if (!*isPackaged && path.empty()) {
-			// 桌面应用匹配路径
-			path = Win32Utils::GetPathOfWnd(hWnd);
-			if (path.empty()) {
+	// 没有匹配的结果也被缓存
+	_WndInfo::MatchResult& matchResult = wndInfo.matchResults[forAutoScale];
+	if (matchResult.version != _matcherVersion) {
+		matchResult.profileIdx = _profileMatcher.Match(forAutoScale, wndInfo.className,
+			[&](bool& isPackaged, std::wstring_view& pathOrAumid) {
+				if (!wndInfo.isAppResolved) {
+					AppXReader appxReader;
+					wndInfo.isPackaged = appxReader.Initialize(hWnd);
+					// 打包应用匹配 AUMID，桌面应用匹配路径
+					wndInfo.pathOrAumid = wndInfo.isPackaged ? appxReader.AUMID() : Win32Utils::GetPathOfWnd(hWnd);
+					wndInfo.isAppResolved = true;
+				}
+
+				isPackaged = wndInfo.isPackaged;
+				pathOrAumid = wndInfo.pathOrAumid;
 				// 获取路径失败
-				break;
+				return !pathOrAumid.empty();
 			}
-		}
-		
-		if (profile.pathRule == path) {
-			return &profile;
-		}
+		);
+		matchResult.version = _matcherVersion;
 	}
 
+	if (matchResult.profileIdx != ProfileMatcher::NO_MATCH) {
+		return &AppSettings::Get().Profiles()[matchResult.profileIdx];
+	}
 	return forAutoScale ? nullptr : &DefaultProfile();
 }
 
+void ProfileService::InvalidateMatcher() noexcept {
+	_isMatcherOutdated = true;
+}
+
+
 Profile& ProfileService::DefaultProfile() noexcept {
 	return AppSettings::Get().DefaultProfile();
 }
@@ -261,4 +184,19 @@ uint32_t ProfileService::GetProfileCount() noexcept {
 	return (uint32_t)AppSettings::Get().Profiles().size();
 }
 
+void ProfileService::_PruneWndInfoCache() noexcept {
+	for (auto it = _wndInfoCache.begin(); it != _wndInfoCache.end();) {
+		DWORD processId = 0;
+		const DWORD threadId = GetWindowThreadProcessId(it->first, &processId);
+		if (threadId != it->second.threadId || processId != it->second.processId) {
+			_wndInfoCache.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	// 缓存中的窗口大多仍然存在时推迟下次清理，使清理的开销均摊到每次插入
+	_cacheSizeToPrune = std::max(MIN_CACHE_SIZE_TO_PRUNE, (uint32_t)_wndInfoCache.size() * 2);
+}
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "WinRTUtils.h"
+#include "ProfileMatcher.h"
+#include <parallel_hashmap/phmap.h>
 
 namespace winrt::Magpie::App {
 
@@ -26,8 +28,13 @@ public:
 
 	bool MoveProfile(uint32_t profileIdx, bool isMoveUp);
 
+	// 窗口的信息和匹配结果被缓存，只能在主线程调用。窗口句柄可能被重用，查找时通过所属的进程和
+	// 线程检查缓存是否过时
 	const Profile* GetProfileForWindow(HWND hWnd, bool forAutoScale) noexcept;
 
+	// 配置文件的规则或是否自动缩放改变后调用，下次匹配时重新建立索引
+	void InvalidateMatcher() noexcept;
+
 	Profile& DefaultProfile() noexcept;
 
 	Profile& GetProfile(uint32_t idx) noexcept;
@@ -41,6 +48,37 @@ public:
 
 private:
 	ProfileService() = default;
+
+	struct _WndInfo {
+		// 已解析
+		std::wstring className;
+		// 打包应用为 AUMID，否则为可执行文件路径
+		std::wstring pathOrAumid;
+		// 用于检测窗口句柄被重用
+		DWORD processId = 0;
+		DWORD threadId = 0;
+		bool isAppResolved = false;
+		bool isPackaged = false;
+
+		struct MatchResult {
+			// 和 _matcherVersion 不同表示已过时
+			uint32_t version = 0;
+			uint32_t profileIdx = ProfileMatcher::NO_MATCH;
+		};
+		// 分别用于普通匹配和自动缩放
+		std::array<MatchResult, 2> matchResults;
+	};
+	// 清除已销毁窗口的缓存
+	void _PruneWndInfoCache() noexcept;
+
+	phmap::flat_hash_map<HWND, _WndInfo> _wndInfoCache;
+	static constexpr uint32_t MIN_CACHE_SIZE_TO_PRUNE = 64;
+	// 缓存达到此大小时清理
+	uint32_t _cacheSizeToPrune = MIN_CACHE_SIZE_TO_PRUNE;
+
+	ProfileMatcher _profileMatcher;
+	uint32_t _matcherVersion = 0;
+	bool _isMatcherOutdated = true;
 };
 
 }
@@ -464,6 +464,7 @@ void ProfileViewModel::IsAutoScale(bool value) {
 	}
 
 	_data->isAutoScale = value;
+	ProfileService::Get().InvalidateMatcher();
 	AppSettings::Get().SaveAsync();
 
 	RaisePropertyChanged(L"IsAutoScale");
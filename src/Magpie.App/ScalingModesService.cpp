@@ -129,11 +129,14 @@ static void WriteScalingMode(rapidjson::PrettyWriter<rapidjson::StringBuffer>& w
 	writer.EndObject();
 }
 
-void ScalingModesService::Export(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer) const noexcept {
+void ScalingModesService::Export(
+	rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer,
+	std::span<const ScalingMode> scalingModes
+) const noexcept {
 	writer.Key("scalingModes");
 	writer.StartArray();
 
-	for (const ScalingMode& scalingMode : AppSettings::Get().ScalingModes()) {
+	for (const ScalingMode& scalingMode : scalingModes) {
 		WriteScalingMode(writer, scalingMode);
 	}
 
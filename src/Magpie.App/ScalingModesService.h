@@ -35,7 +35,10 @@ public:
 
 	// 不能使用 rapidjson::Writer 类型，因为 PrettyWriter 没有重写 Writer 中的方法
 	// 不合理的 API 设计
-	void Export(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer) const noexcept;
+	void Export(
+		rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer,
+		std::span<const ScalingMode> scalingModes
+	) const noexcept;
 
 	bool Import(const rapidjson::GenericObject<true, rapidjson::Value>& root, bool loadingSettings) noexcept;
 
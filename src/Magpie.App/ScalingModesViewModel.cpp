@@ -61,7 +61,7 @@ void ScalingModesViewModel::Export() const noexcept {
 	rapidjson::StringBuffer json;
 	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
 	writer.StartObject();
-	ScalingModesService::Get().Export(writer);
+	ScalingModesService::Get().Export(writer, AppSettings::Get().ScalingModes());
 	writer.EndObject();
 
 	Win32Utils::WriteTextFile(fileName->c_str(), {json.GetString(), json.GetLength()});
@@ -13,7 +13,6 @@
 
 using namespace ::Magpie::Core;
 using namespace winrt;
-using namespace Windows::System::Threading;
 
 namespace winrt::Magpie::App {
 
@@ -23,10 +22,12 @@ void ScalingService::Initialize() {
 	_countDownTimer.Interval(25ms);
 	_countDownTimer.Tick({ this, &ScalingService::_CountDownTimer_Tick });
 
-	_checkForegroundTimer = ThreadPoolTimer::CreatePeriodicTimer(
-		{ this, &ScalingService::_CheckForegroundTimer_Tick },
-		50ms
-	);
+	// 不在进程内注入，事件通过主线程的消息循环传递
+	_hForegroundHook.reset(SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+		NULL, _WinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT));
+	if (!_hForegroundHook) {
+		Logger::Get().Win32Error("SetWinEventHook 失败");
+	}
 	
 	AppSettings::Get().IsAutoRestoreChanged({ this, &ScalingService::_Settings_IsAutoRestoreChanged });
 	_scalingRuntime = std::make_unique<ScalingRuntime>();
@@ -37,11 +38,11 @@ void ScalingService::Initialize() {
 	);
 
 	// 立即检查前台窗口
-	_CheckForegroundTimer_Tick(nullptr);
+	_CheckForeground();
 }
 
 void ScalingService::Uninitialize() {
-	_checkForegroundTimer.Cancel();
+	_hForegroundHook.reset();
 	_countDownTimer.Stop();
 	_scalingRuntime.reset();
 }
@@ -90,7 +91,21 @@ bool ScalingService::IsRunning() const noexcept {
 
 void ScalingService::CheckForeground() {
 	_hwndChecked = NULL;
-	_CheckForegroundTimer_Tick(nullptr);
+	_CheckForeground();
+}
+
+void ScalingService::OnEffectParameterChanged(
+	uint32_t scalingModeIdx,
+	uint32_t effectIdx,
+	const std::wstring& paramName,
+	float value
+) {
+	if (!_scalingRuntime || !_scalingRuntime->IsRunning() || _curScalingMode != (int)scalingModeIdx) {
+		return;
+	}
+
+	const ScalingMode& scalingMode = ScalingModesService::Get().GetScalingMode(scalingModeIdx);
+	_scalingRuntime->SetEffectParameter(effectIdx, scalingMode.effects[effectIdx].name, paramName, value);
 }
 
 void ScalingService::_WndToRestore(HWND value) {
@@ -144,28 +159,28 @@ void ScalingService::_CountDownTimer_Tick(IInspectable const&, IInspectable cons
 	TimerTick.Invoke(timeLeft);
 }
 
-fire_and_forget ScalingService::_CheckForegroundTimer_Tick(ThreadPoolTimer const& timer) {
+void ScalingService::_CheckForeground() {
 	if (!_scalingRuntime || _scalingRuntime->IsRunning()) {
-		co_return;
+		return;
 	}
 
 	HWND hwndFore = GetForegroundWindow();
-	if (!hwndFore || hwndFore == _hwndChecked) {
-		co_return;
+	if (!hwndFore) {
+		return;
 	}
-	_hwndChecked = NULL;
-
-	if (timer) {
-		// ThreadPoolTimer 在后台线程触发
-		co_await _dispatcher;
+	// 句柄可能被新窗口重用，因此还要比较所属线程
+	const DWORD foreThreadId = GetWindowThreadProcessId(hwndFore, nullptr);
+	if (hwndFore == _hwndChecked && foreThreadId == _hwndCheckedThreadId) {
+		return;
 	}
+	_hwndChecked = NULL;
 
 	if (_hwndToRestore == hwndFore) {
 		// 检查自动恢复
 		if (_CheckSrcWnd(hwndFore, false)) {
 			const Profile* profile = ProfileService::Get().GetProfileForWindow(hwndFore, false);
 			_StartScale(hwndFore, *profile);
-			co_return;
+			return;
 		}
 
 		// _hwndToRestore 无法缩放则清空
@@ -175,7 +190,7 @@ fire_and_forget ScalingService::_CheckForegroundTimer_Tick(ThreadPoolTimer const
 		const Profile* profile = ProfileService::Get().GetProfileForWindow(hwndFore, true);
 		if (profile && _CheckSrcWnd(hwndFore, true)) {
 			_StartScale(hwndFore, *profile);
-			co_return;
+			return;
 		}
 		
 		if (_hwndToRestore && !_CheckSrcWnd(_hwndToRestore, false)) {
@@ -186,6 +201,19 @@ fire_and_forget ScalingService::_CheckForegroundTimer_Tick(ThreadPoolTimer const
 
 	// 避免重复检查
 	_hwndChecked = hwndFore;
+	_hwndCheckedThreadId = foreThreadId;
+}
+
+void CALLBACK ScalingService::_WinEventProc(
+	HWINEVENTHOOK /*hWinEventHook*/,
+	DWORD /*event*/,
+	HWND /*hwnd*/,
+	LONG /*idObject*/,
+	LONG /*idChild*/,
+	DWORD /*dwEventThread*/,
+	DWORD /*dwmsEventTime*/
+) {
+	ScalingService::Get()._CheckForeground();
 }
 
 void ScalingService::_Settings_IsAutoRestoreChanged(bool value) {
@@ -207,6 +235,7 @@ fire_and_forget ScalingService::_ScalingRuntime_IsRunningChanged(bool isRunning)
 		if (GetForegroundWindow() == _hwndCurSrc) {
 			// 退出全屏后如果前台窗口不变视为通过热键退出
 			_hwndChecked = _hwndCurSrc;
+			_hwndCheckedThreadId = GetWindowThreadProcessId(_hwndCurSrc, nullptr);
 		} else if (!_isAutoScaling && AppSettings::Get().IsAutoRestore()) {
 			// 无需再次检查完整性级别
 			if (_CheckSrcWnd(_hwndCurSrc, false)) {
@@ -215,9 +244,10 @@ fire_and_forget ScalingService::_ScalingRuntime_IsRunningChanged(bool isRunning)
 		}
 
 		_hwndCurSrc = NULL;
+		_curScalingMode = -1;
 
 		// 立即检查前台窗口
-		_CheckForegroundTimer_Tick(nullptr);
+		_CheckForeground();
 	}
 
 	IsRunningChanged.Invoke(isRunning);
@@ -297,10 +327,13 @@ bool ScalingService::_StartScale(HWND hWnd, const Profile& profile) {
 	// 应用全局配置
 	AppSettings& settings = AppSettings::Get();
 
-	if (settings.IsInlineParams()) {
-		for (EffectOption& effect : options.effects) {
+	for (EffectOption& effect : options.effects) {
+		if (settings.IsInlineParams()) {
 			effect.flags |= EffectOptionFlags::InlineParams;
 		}
+		if (settings.IsTiledExecution()) {
+			effect.flags |= EffectOptionFlags::Tiled;
+		}
 	}
 
 	options.IsDebugMode(settings.IsDebugMode());
@@ -312,10 +345,12 @@ bool ScalingService::_StartScale(HWND hWnd, const Profile& profile) {
 	options.IsSimulateExclusiveFullscreen(settings.IsSimulateExclusiveFullscreen());
 	options.duplicateFrameDetectionMode = settings.DuplicateFrameDetectionMode();
 	options.IsStatisticsForDynamicDetectionEnabled(settings.IsStatisticsForDynamicDetectionEnabled());
+	options.IsFrameTraceEnabled(settings.IsFrameTraceEnabled());
 
 	_isAutoScaling = profile.isAutoScale;
 	_scalingRuntime->Start(hWnd, std::move(options));
 	_hwndCurSrc = hWnd;
+	_curScalingMode = profile.scalingMode;
 	return true;
 }
 
@@ -49,6 +49,9 @@ public:
 	// 强制重新检查前台窗口
 	void CheckForeground();
 
+	// 正在使用该缩放模式缩放时将参数的修改应用到缩放窗口
+	void OnEffectParameterChanged(uint32_t scalingModeIdx, uint32_t effectIdx, const std::wstring& paramName, float value);
+
 	WinRTUtils::Event<delegate<bool>> IsTimerOnChanged;
 	WinRTUtils::Event<delegate<double>> TimerTick;
 	WinRTUtils::Event<delegate<HWND>> WndToRestoreChanged;
@@ -63,7 +66,17 @@ private:
 
 	void _CountDownTimer_Tick(IInspectable const&, IInspectable const&);
 
-	fire_and_forget _CheckForegroundTimer_Tick(Threading::ThreadPoolTimer const& timer);
+	void _CheckForeground();
+
+	static void CALLBACK _WinEventProc(
+		HWINEVENTHOOK hWinEventHook,
+		DWORD event,
+		HWND hwnd,
+		LONG idObject,
+		LONG idChild,
+		DWORD dwEventThread,
+		DWORD dwmsEventTime
+	);
 
 	void _Settings_IsAutoRestoreChanged(bool value);
 
@@ -79,19 +92,22 @@ private:
 	CoreDispatcher _dispatcher{ nullptr };
 
 	DispatcherTimer _countDownTimer;
-	// DispatcherTimer 在不显示主窗口时可能停滞，因此使用 ThreadPoolTimer
-	Threading::ThreadPoolTimer _checkForegroundTimer{ nullptr };
+	// 前台窗口改变时检查是否应自动缩放，无需轮询。回调在主线程上执行
+	wil::unique_hwineventhook _hForegroundHook;
 
 	std::chrono::steady_clock::time_point _timerStartTimePoint;
 
 	uint32_t _curCountdownSeconds = 0;
 
 	HWND _hwndCurSrc = NULL;
+	// 当前缩放使用的缩放模式
+	int _curScalingMode = -1;
 	HWND _hwndToRestore = NULL;
 	// 1. 避免重复检查同一个窗口
 	// 2. 用户使用热键退出全屏后暂时阻止该窗口自动放大
-	// 可能在线程池中访问，因此增加原子性
-	std::atomic<HWND> _hwndChecked = NULL;
+	HWND _hwndChecked = NULL;
+	// 用于检测 _hwndChecked 被新窗口重用
+	DWORD _hwndCheckedThreadId = 0;
 	
 	bool _isAutoScaling = false;
 };
@@ -63,4 +63,9 @@ ID3D11UnorderedAccessView* BackendDescriptorStore::GetUnorderedAccessView(ID3D11
 	return _uavMap.emplace(buffer, std::move(uav)).first->second.get();
 }
 
+void BackendDescriptorStore::RemoveViews(ID3D11Texture2D* texture) noexcept {
+	_srvMap.erase(texture);
+	_uavMap.erase(texture);
+}
+
 }
@@ -23,6 +23,9 @@ public:
 		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN
 	) noexcept;
 
+	// 释放纹理的所有视图，视图持有纹理的引用
+	void RemoveViews(ID3D11Texture2D* texture) noexcept;
+
 private:
 	ID3D11Device5* _d3dDevice = nullptr;
 
@@ -0,0 +1,330 @@
+#include "pch.h"
+#include "CompileScheduler.h"
+#include "CommonSharedConstants.h"
+#include "Logger.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include "YasHelper.h"
+
+using namespace std::chrono;
+
+namespace Magpie::Core {
+
+static thread_local CompileScheduler* curScheduler = nullptr;
+static thread_local uint32_t curWorkerIdx = 0;
+// 在任务中调用 Wait 会嵌套执行其他任务，只统计最外层的任务
+static thread_local uint32_t taskDepth = 0;
+
+// 当记录的结构有更改时更新它，使旧记录失效
+static constexpr uint32_t COST_HISTORY_VERSION = 2;
+static constexpr const wchar_t* COST_HISTORY_NAME = L"compile_costs";
+// 还没有任何记录时源码每字节的编译用时（微秒），大致为 Magpie 自带效果的平均值
+static constexpr double DEFAULT_COST_PER_BYTE = 16.0;
+// 每次修改效果都会产生新的记录，超过此数量时删除最久没有更新的记录
+static constexpr size_t MAX_COST_RECORDS = 1024;
+
+struct CostRecord {
+	// 微秒
+	uint64_t duration;
+	uint64_t sourceSize;
+	// 更新时的 costHistoryClock
+	uint64_t lastUpdate;
+};
+
+// 键为通道的哈希，保存在 cache 文件夹中
+static wil::srwlock costHistoryLock;
+static phmap::flat_hash_map<std::wstring, CostRecord> costHistory;
+// 每次更新记录时递增
+static uint64_t costHistoryClock = 0;
+// 所有记录的用时和源码长度之和，用于估计每字节的编译用时
+static uint64_t costHistoryTotalDuration = 0;
+static uint64_t costHistoryTotalSize = 0;
+static bool isCostHistoryLoaded = false;
+static bool isCostHistoryDirty = false;
+
+static std::wstring GetCostHistoryPath() noexcept {
+	return StrUtils::Concat(CommonSharedConstants::CACHE_DIR, COST_HISTORY_NAME);
+}
+
+static void LoadCostHistory() noexcept {
+	const std::wstring path = GetCostHistoryPath();
+	if (!Win32Utils::FileExists(path.c_str())) {
+		return;
+	}
+
+	std::vector<uint8_t> buffer;
+	if (!Win32Utils::ReadFile(path.c_str(), buffer) || buffer.empty()) {
+		return;
+	}
+
+	try {
+		yas::mem_istream mi(buffer.data(), buffer.size());
+		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+
+		uint32_t version;
+		ia& version;
+		if (version != COST_HISTORY_VERSION) {
+			Logger::Get().Info("编译用时记录版本不匹配");
+			return;
+		}
+
+		ia& costHistory;
+	} catch (...) {
+		Logger::Get().Error("反序列化编译用时记录失败");
+		costHistory.clear();
+		return;
+	}
+
+	for (const auto& [key, record] : costHistory) {
+		costHistoryTotalDuration += record.duration;
+		costHistoryTotalSize += record.sourceSize;
+		costHistoryClock = std::max(costHistoryClock, record.lastUpdate);
+	}
+}
+
+static void SaveCostHistory() noexcept {
+	if (costHistory.size() > MAX_COST_RECORDS) {
+		// 保留最近更新的 MAX_COST_RECORDS 条记录
+		std::vector<uint64_t> lastUpdates;
+		lastUpdates.reserve(costHistory.size());
+		for (const auto& [key, record] : costHistory) {
+			lastUpdates.push_back(record.lastUpdate);
+		}
+		auto nth = lastUpdates.end() - MAX_COST_RECORDS;
+		std::nth_element(lastUpdates.begin(), nth, lastUpdates.end());
+		const uint64_t minLastUpdate = *nth;
+
+		for (auto it = costHistory.begin(); it != costHistory.end();) {
+			if (it->second.lastUpdate < minLastUpdate) {
+				costHistoryTotalDuration -= it->second.duration;
+				costHistoryTotalSize -= it->second.sourceSize;
+				costHistory.erase(it++);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	std::vector<uint8_t> buffer;
+
+	try {
+		yas::vector_ostream os(buffer);
+		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+
+		oa& COST_HISTORY_VERSION& costHistory;
+	} catch (...) {
+		Logger::Get().Error("序列化编译用时记录失败");
+		return;
+	}
+
+	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr)
+			&& GetLastError() != ERROR_ALREADY_EXISTS) {
+		Logger::Get().Win32Error("创建 cache 文件夹失败");
+		return;
+	}
+
+	if (!Win32Utils::WriteFile(GetCostHistoryPath().c_str(), buffer.data(), buffer.size())) {
+		Logger::Get().Error("保存编译用时记录失败");
+	}
+}
+
+CompileScheduler::CompileScheduler() noexcept {
+#ifdef _DEBUG
+	// 为了便于调试，DEBUG 模式下所有任务都在 Wait 中执行
+	_workerCount = 1;
+#else
+	_workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+#endif
+
+	_workers = std::make_unique<_Worker[]>(_workerCount);
+
+	{
+		// 第一次创建调度器时加载之前的编译用时
+		auto lock = costHistoryLock.lock_exclusive();
+		if (!isCostHistoryLoaded) {
+			isCostHistoryLoaded = true;
+			LoadCostHistory();
+		}
+	}
+
+	_startTime = steady_clock::now();
+	_lastChangeTime = _startTime;
+
+	assert(!curScheduler);
+	curScheduler = this;
+	curWorkerIdx = 0;
+
+	_threads.reserve(_workerCount - 1);
+	for (uint32_t i = 1; i < _workerCount; ++i) {
+		_threads.emplace_back(&CompileScheduler::_WorkerThreadProc, this, i);
+	}
+}
+
+CompileScheduler::~CompileScheduler() {
+	_stopping.store(true, std::memory_order_release);
+	_signal.fetch_add(1, std::memory_order_release);
+	_signal.notify_all();
+
+	for (std::thread& t : _threads) {
+		t.join();
+	}
+
+	curScheduler = nullptr;
+
+	// 所有任务已完成，保存这次编译的用时
+	auto lock = costHistoryLock.lock_exclusive();
+	if (isCostHistoryDirty) {
+		isCostHistoryDirty = false;
+		SaveCostHistory();
+	}
+}
+
+void CompileScheduler::Submit(TaskGroup& group, uint64_t cost, std::function<void()> func) noexcept {
+	group._pending.fetch_add(1, std::memory_order_relaxed);
+
+	// 优先放入当前线程的队列
+	const uint32_t workerIdx = curScheduler == this
+		? curWorkerIdx
+		: _nextWorker.fetch_add(1, std::memory_order_relaxed) % _workerCount;
+
+	{
+		_Worker& worker = _workers[workerIdx];
+		auto lock = worker.lock.lock_exclusive();
+		worker.tasks.push_back({ cost, &group, std::move(func) });
+		std::push_heap(worker.tasks.begin(), worker.tasks.end());
+	}
+
+	_signal.fetch_add(1, std::memory_order_release);
+	_signal.notify_all();
+}
+
+void CompileScheduler::Wait(TaskGroup& group) noexcept {
+	assert(curScheduler == this);
+
+	while (group._pending.load(std::memory_order_acquire) != 0) {
+		const uint32_t signal = _signal.load(std::memory_order_acquire);
+
+		if (!_TryRunOne(curWorkerIdx) && group._pending.load(std::memory_order_acquire) != 0) {
+			// 没有可执行的任务，等待其他线程完成任务或提交新任务
+			if (taskDepth > 0) {
+				_ChangeActiveCount(-1);
+			}
+			_signal.wait(signal, std::memory_order_acquire);
+			if (taskDepth > 0) {
+				_ChangeActiveCount(1);
+			}
+		}
+	}
+}
+
+CompileScheduler::Statistics CompileScheduler::GetStatistics() const noexcept {
+	auto lock = _statsLock.lock_shared();
+	return {
+		.wallTime = (uint64_t)duration_cast<microseconds>(steady_clock::now() - _startTime).count(),
+		.busyTime = _busyTime,
+		.parallelTime = _parallelTime
+	};
+}
+
+CompileScheduler* CompileScheduler::Current() noexcept {
+	return curScheduler;
+}
+
+uint64_t CompileScheduler::EstimateCost(std::wstring_view key, size_t sourceSize) noexcept {
+	auto lock = costHistoryLock.lock_shared();
+
+	if (auto it = costHistory.find(key); it != costHistory.end()) {
+		return it->second.duration;
+	}
+
+	// 没有记录时将源码长度换算为用时，以便和有记录的任务比较
+	const double costPerByte = costHistoryTotalSize == 0
+		? DEFAULT_COST_PER_BYTE : (double)costHistoryTotalDuration / costHistoryTotalSize;
+	return (uint64_t)std::llround(sourceSize * costPerByte);
+}
+
+void CompileScheduler::RecordCost(std::wstring_view key, size_t sourceSize, uint64_t duration) noexcept {
+	auto lock = costHistoryLock.lock_exclusive();
+
+	CostRecord& record = costHistory[std::wstring(key)];
+	costHistoryTotalDuration += duration - record.duration;
+	costHistoryTotalSize += sourceSize - record.sourceSize;
+	record = { .duration = duration, .sourceSize = sourceSize, .lastUpdate = ++costHistoryClock };
+	isCostHistoryDirty = true;
+}
+
+void CompileScheduler::_WorkerThreadProc(uint32_t workerIdx) noexcept {
+#ifdef _DEBUG
+	SetThreadDescription(GetCurrentThread(), L"Magpie 编译线程");
+#endif
+
+	curScheduler = this;
+	curWorkerIdx = workerIdx;
+
+	while (!_stopping.load(std::memory_order_acquire)) {
+		const uint32_t signal = _signal.load(std::memory_order_acquire);
+
+		if (!_TryRunOne(workerIdx) && !_stopping.load(std::memory_order_acquire)) {
+			_signal.wait(signal, std::memory_order_acquire);
+		}
+	}
+
+	curScheduler = nullptr;
+}
+
+bool CompileScheduler::_TryRunOne(uint32_t workerIdx) noexcept {
+	_Task task;
+	bool found = false;
+
+	for (uint32_t i = 0; i < _workerCount; ++i) {
+		_Worker& worker = _workers[(workerIdx + i) % _workerCount];
+
+		auto lock = worker.lock.lock_exclusive();
+		if (worker.tasks.empty()) {
+			continue;
+		}
+
+		// 无论是自己的还是窃取的，都取估计用时最长的任务
+		std::pop_heap(worker.tasks.begin(), worker.tasks.end());
+		task = std::move(worker.tasks.back());
+		worker.tasks.pop_back();
+		found = true;
+		break;
+	}
+
+	if (!found) {
+		return false;
+	}
+
+	if (taskDepth++ == 0) {
+		_ChangeActiveCount(1);
+	}
+	task.func();
+	if (--taskDepth == 0) {
+		_ChangeActiveCount(-1);
+	}
+
+	if (task.group->_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		// 唤醒等待这个任务组的线程
+		_signal.fetch_add(1, std::memory_order_release);
+		_signal.notify_all();
+	}
+
+	return true;
+}
+
+void CompileScheduler::_ChangeActiveCount(int delta) noexcept {
+	auto lock = _statsLock.lock_exclusive();
+
+	const steady_clock::time_point now = steady_clock::now();
+	const uint64_t elapsed = (uint64_t)duration_cast<microseconds>(now - _lastChangeTime).count();
+	_busyTime += elapsed * _activeCount;
+	if (_activeCount >= 2) {
+		_parallelTime += elapsed;
+	}
+
+	_lastChangeTime = now;
+	_activeCount += delta;
+}
+
+}
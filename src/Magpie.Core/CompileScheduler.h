@@ -0,0 +1,98 @@
+#pragma once
+#include <thread>
+
+namespace Magpie::Core {
+
+// 编译任务调度器，所有效果和通道的编译任务共用一组工作线程。每个线程有自己的任务队列，
+// 空闲时从其他线程的队列中窃取任务。任务按估计用时从长到短执行，避免最后只剩一个耗时很长
+// 的通道在编译。DEBUG 模式下和 Win32Utils::RunParallel 一样不使用额外的线程。
+class CompileScheduler {
+public:
+	class TaskGroup {
+	public:
+		TaskGroup() = default;
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup(TaskGroup&&) = delete;
+
+	private:
+		friend class CompileScheduler;
+		std::atomic<uint32_t> _pending = 0;
+	};
+
+	struct Statistics {
+		// 单位均为微秒
+		uint64_t wallTime = 0;
+		// 所有线程执行任务的时间之和
+		uint64_t busyTime = 0;
+		// 至少有两个线程在执行任务的时间
+		uint64_t parallelTime = 0;
+	};
+
+	// 创建调度器的线程成为 0 号工作线程，它应在 Wait 中参与执行任务
+	CompileScheduler() noexcept;
+	~CompileScheduler();
+
+	CompileScheduler(const CompileScheduler&) = delete;
+	CompileScheduler(CompileScheduler&&) = delete;
+
+	// cost 为估计用时，越大越先执行
+	void Submit(TaskGroup& group, uint64_t cost, std::function<void()> func) noexcept;
+
+	// 等待 group 中的任务全部完成，等待时执行其他任务
+	void Wait(TaskGroup& group) noexcept;
+
+	Statistics GetStatistics() const noexcept;
+
+	// 当前线程所属的调度器，如果不在调度器的线程中则为 nullptr
+	static CompileScheduler* Current() noexcept;
+
+	// 根据之前的编译用时估计任务的用时，单位为微秒。没有记录时按已记录的平均编译速度将源码长度
+	// 换算为用时。key 为 EffectCacheManager::GetPassHash 的结果，因此源码、包含的文件或编译选项
+	// 改变后不会使用过时的记录。记录保存在 cache 文件夹中，调度器析构时写入
+	static uint64_t EstimateCost(std::wstring_view key, size_t sourceSize) noexcept;
+	static void RecordCost(std::wstring_view key, size_t sourceSize, uint64_t duration) noexcept;
+
+private:
+	struct _Task {
+		uint64_t cost;
+		TaskGroup* group;
+		std::function<void()> func;
+
+		bool operator<(const _Task& other) const noexcept {
+			return cost < other.cost;
+		}
+	};
+
+	struct _Worker {
+		wil::srwlock lock;
+		// 大顶堆，堆顶为估计用时最长的任务
+		std::vector<_Task> tasks;
+	};
+
+	void _WorkerThreadProc(uint32_t workerIdx) noexcept;
+
+	// 先从自己的队列中取任务，没有则窃取其他线程的任务
+	bool _TryRunOne(uint32_t workerIdx) noexcept;
+
+	// 任务开始或结束时更新统计数据
+	void _ChangeActiveCount(int delta) noexcept;
+
+	std::unique_ptr<_Worker[]> _workers;
+	uint32_t _workerCount = 0;
+	std::vector<std::thread> _threads;
+
+	// 有新任务或任务完成时递增，用于唤醒空闲的线程
+	std::atomic<uint32_t> _signal = 0;
+	std::atomic<uint32_t> _nextWorker = 0;
+	std::atomic<bool> _stopping = false;
+
+	// 用于统计并行度
+	mutable wil::srwlock _statsLock;
+	std::chrono::steady_clock::time_point _startTime;
+	std::chrono::steady_clock::time_point _lastChangeTime;
+	uint32_t _activeCount = 0;
+	uint64_t _busyTime = 0;
+	uint64_t _parallelTime = 0;
+};
+
+}
@@ -0,0 +1,460 @@
+#include "CpuEffectDrawer.h"
+#include "EffectSizeExpr.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <initializer_list>
+#include <numeric>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MP_CPU_SSE
+#include <immintrin.h>
+#endif
+
+namespace Magpie::Core {
+
+// 一个像素的 RGBA 值。x64 上使用 SSE，否则回退到标量实现
+struct Vec4 {
+#ifdef MP_CPU_SSE
+	__m128 v;
+
+	static Vec4 Zero() noexcept { return { _mm_setzero_ps() }; }
+	static Vec4 Load(const float* p) noexcept { return { _mm_loadu_ps(p) }; }
+	void Store(float* p) const noexcept { _mm_storeu_ps(p, v); }
+
+	Vec4 operator+(Vec4 other) const noexcept { return { _mm_add_ps(v, other.v) }; }
+	Vec4 operator-(Vec4 other) const noexcept { return { _mm_sub_ps(v, other.v) }; }
+	Vec4 operator*(float s) const noexcept { return { _mm_mul_ps(v, _mm_set1_ps(s)) }; }
+
+	static Vec4 Min(Vec4 l, Vec4 r) noexcept { return { _mm_min_ps(l.v, r.v) }; }
+	static Vec4 Max(Vec4 l, Vec4 r) noexcept { return { _mm_max_ps(l.v, r.v) }; }
+#else
+	float v[4];
+
+	static Vec4 Zero() noexcept { return {}; }
+	static Vec4 Load(const float* p) noexcept { return { p[0], p[1], p[2], p[3] }; }
+	void Store(float* p) const noexcept { std::memcpy(p, v, sizeof(v)); }
+
+	Vec4 operator+(Vec4 other) const noexcept {
+		return { v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3] };
+	}
+	Vec4 operator-(Vec4 other) const noexcept {
+		return { v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3] };
+	}
+	Vec4 operator*(float s) const noexcept {
+		return { v[0] * s, v[1] * s, v[2] * s, v[3] * s };
+	}
+
+	static Vec4 Min(Vec4 l, Vec4 r) noexcept {
+		return { std::min(l.v[0], r.v[0]), std::min(l.v[1], r.v[1]), std::min(l.v[2], r.v[2]), std::min(l.v[3], r.v[3]) };
+	}
+	static Vec4 Max(Vec4 l, Vec4 r) noexcept {
+		return { std::max(l.v[0], r.v[0]), std::max(l.v[1], r.v[1]), std::max(l.v[2], r.v[2]), std::max(l.v[3], r.v[3]) };
+	}
+#endif
+
+	Vec4& operator+=(Vec4 other) noexcept {
+		return *this = *this + other;
+	}
+
+	static Vec4 Lerp(Vec4 l, Vec4 r, float t) noexcept {
+		return l + (r - l) * t;
+	}
+
+	static Vec4 Clamp(Vec4 x, Vec4 lo, Vec4 hi) noexcept {
+		return Min(Max(x, lo), hi);
+	}
+
+	// alpha 通道置为 1，和着色器中的 float4(color, 1) 相同
+	void StoreOpaque(float* p) const noexcept {
+		Store(p);
+		p[3] = 1.0f;
+	}
+};
+
+// 以下采样函数均为 CLAMP 寻址，坐标和 D3D 相同: 纹素 (x, y) 的中心为 (x + 0.5, y + 0.5)
+
+static Vec4 LoadClamped(const CpuTexture& tex, int x, int y) noexcept {
+	x = std::clamp(x, 0, (int)tex.width - 1);
+	y = std::clamp(y, 0, (int)tex.height - 1);
+	return Vec4::Load(tex.Texel(x, y));
+}
+
+static Vec4 SamplePoint(const CpuTexture& tex, float u, float v) noexcept {
+	return LoadClamped(tex, (int)std::floor(u * tex.width), (int)std::floor(v * tex.height));
+}
+
+static Vec4 SampleLinear(const CpuTexture& tex, float u, float v) noexcept {
+	const float fx = u * tex.width - 0.5f;
+	const float fy = v * tex.height - 0.5f;
+	const float x0 = std::floor(fx);
+	const float y0 = std::floor(fy);
+	const float tx = fx - x0;
+	const float ty = fy - y0;
+
+	const Vec4 top = Vec4::Lerp(LoadClamped(tex, (int)x0, (int)y0), LoadClamped(tex, (int)x0 + 1, (int)y0), tx);
+	const Vec4 bottom = Vec4::Lerp(LoadClamped(tex, (int)x0, (int)y0 + 1), LoadClamped(tex, (int)x0 + 1, (int)y0 + 1), tx);
+	return Vec4::Lerp(top, bottom, ty);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// 内置效果的 CPU 实现，应和 effects 文件夹中对应的 hlsl 保持一致
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void NearestKernel(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	const CpuTexture& input = *context.input;
+	CpuTexture& output = *context.output;
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+		const float v = (y + 0.5f) / output.height;
+		for (uint32_t x = 0; x < output.width; ++x) {
+			SamplePoint(input, (x + 0.5f) / output.width, v).Store(output.Texel(x, y));
+		}
+	}
+}
+
+static void BilinearKernel(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	const CpuTexture& input = *context.input;
+	CpuTexture& output = *context.output;
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+		const float v = (y + 0.5f) / output.height;
+		for (uint32_t x = 0; x < output.width; ++x) {
+			SampleLinear(input, (x + 0.5f) / output.width, v).Store(output.Texel(x, y));
+		}
+	}
+}
+
+static float BicubicWeight(float x, float B, float C) noexcept {
+	const float ax = std::abs(x);
+
+	if (ax < 1.0f) {
+		return (x * x * ((12.0f - 9.0f * B - 6.0f * C) * ax + (-18.0f + 12.0f * B + 6.0f * C)) + (6.0f - 2.0f * B)) / 6.0f;
+	} else if (ax < 2.0f) {
+		return (x * x * ((-B - 6.0f * C) * ax + (6.0f * B + 30.0f * C)) + (-12.0f * B - 48.0f * C) * ax + (8.0f * B + 24.0f * C)) / 6.0f;
+	} else {
+		return 0.0f;
+	}
+}
+
+static void BicubicKernel(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	const CpuTexture& input = *context.input;
+	CpuTexture& output = *context.output;
+	const float B = context.params[0].floatVal;
+	const float C = context.params[1].floatVal;
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+		const float posY = (y + 0.5f) / output.height * input.height - 0.5f;
+		const float baseY = std::floor(posY);
+		const float fy = posY - baseY;
+
+		float colTaps[4];
+		float colSum = 0;
+		for (int i = 0; i < 4; ++i) {
+			colTaps[i] = BicubicWeight(fy - (i - 1), B, C);
+			colSum += colTaps[i];
+		}
+
+		for (uint32_t x = 0; x < output.width; ++x) {
+			const float posX = (x + 0.5f) / output.width * input.width - 0.5f;
+			const float baseX = std::floor(posX);
+			const float fx = posX - baseX;
+
+			float rowTaps[4];
+			float rowSum = 0;
+			for (int i = 0; i < 4; ++i) {
+				rowTaps[i] = BicubicWeight(fx - (i - 1), B, C);
+				rowSum += rowTaps[i];
+			}
+
+			Vec4 total = Vec4::Zero();
+			for (int j = 0; j < 4; ++j) {
+				Vec4 row = Vec4::Zero();
+				for (int i = 0; i < 4; ++i) {
+					row += LoadClamped(input, (int)baseX + i - 1, (int)baseY + j - 1) * rowTaps[i];
+				}
+				total += row * colTaps[j];
+			}
+
+			(total * (1.0f / (rowSum * colSum))).StoreOpaque(output.Texel(x, y));
+		}
+	}
+}
+
+static constexpr float PI = 3.14159265359f;
+
+// 参见 Lanczos.hlsl 中的 weight3
+static void LanczosWeights(float f, float (&weights)[6]) noexcept {
+	float sum = 0;
+	for (int i = 0; i < 6; ++i) {
+		// 偶数位置对应 weight3(0.5 - f * 0.5)，奇数位置对应 weight3(1 - f * 0.5)
+		const float x = (i % 2 == 0 ? 0.5f : 1.0f) - f * 0.5f;
+		const float s = std::max(std::abs(2.0f * PI * (x - 1.5f + (i / 2))), 1e-5f);
+		weights[i] = std::sin(s) * std::sin(s / 3.0f) / (s * s);
+		sum += weights[i];
+	}
+
+	for (float& w : weights) {
+		w /= sum;
+	}
+}
+
+static void LanczosKernel(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	const CpuTexture& input = *context.input;
+	CpuTexture& output = *context.output;
+	const float arStrength = context.params[0].floatVal;
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+		const float posY = (y + 0.5f) / output.height * input.height + 0.5f;
+		const float baseY = std::floor(posY);
+
+		float colTaps[6];
+		LanczosWeights(posY - baseY, colTaps);
+
+		for (uint32_t x = 0; x < output.width; ++x) {
+			const float posX = (x + 0.5f) / output.width * input.width + 0.5f;
+			const float baseX = std::floor(posX);
+
+			float rowTaps[6];
+			LanczosWeights(posX - baseX, rowTaps);
+
+			Vec4 src[6][6];
+			for (int i = 0; i < 6; ++i) {
+				for (int j = 0; j < 6; ++j) {
+					src[i][j] = LoadClamped(input, (int)baseX - 3 + i, (int)baseY - 3 + j);
+				}
+			}
+
+			Vec4 color = Vec4::Zero();
+			for (int j = 0; j < 6; ++j) {
+				Vec4 row = Vec4::Zero();
+				for (int i = 0; i < 6; ++i) {
+					row += src[i][j] * rowTaps[i];
+				}
+				color += row * colTaps[j];
+			}
+
+			// 抗振铃
+			const Vec4 minSample = Vec4::Min(Vec4::Min(src[2][2], src[3][2]), Vec4::Min(src[2][3], src[3][3]));
+			const Vec4 maxSample = Vec4::Max(Vec4::Max(src[2][2], src[3][2]), Vec4::Max(src[2][3], src[3][3]));
+			color = Vec4::Lerp(color, Vec4::Clamp(color, minSample, maxSample), arStrength);
+
+			color.StoreOpaque(output.Texel(x, y));
+		}
+	}
+}
+
+static float JincResampler(float x, float wa, float wb) noexcept {
+	return x == 0.0f ? wa * wb : std::sin(x * wa) * std::sin(x * wb) / (x * x);
+}
+
+static void JincKernel(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	const CpuTexture& input = *context.input;
+	CpuTexture& output = *context.output;
+	const float wa = context.params[0].floatVal * PI;
+	const float wb = context.params[1].floatVal * PI;
+	const float arStrength = context.params[2].floatVal;
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y) {
+		const float pcY = (y + 0.5f) / output.height * input.height;
+		const float baseY = std::floor(pcY - 0.5f);
+
+		for (uint32_t x = 0; x < output.width; ++x) {
+			const float pcX = (x + 0.5f) / output.width * input.width;
+			const float baseX = std::floor(pcX - 0.5f);
+
+			// src[i][j] 为 (baseX + i - 1, baseY + j - 1) 处的纹素
+			Vec4 src[4][4];
+			for (int i = 0; i < 4; ++i) {
+				for (int j = 0; j < 4; ++j) {
+					src[i][j] = LoadClamped(input, (int)baseX + i - 1, (int)baseY + j - 1);
+				}
+			}
+
+			Vec4 color = Vec4::Zero();
+			float weightSum = 0;
+			for (int j = 0; j < 4; ++j) {
+				for (int i = 0; i < 4; ++i) {
+					const float dx = baseX + i - 0.5f - pcX;
+					const float dy = baseY + j - 0.5f - pcY;
+					const float weight = JincResampler(std::sqrt(dx * dx + dy * dy), wa, wb);
+					weightSum += weight;
+
+					// 和 Jinc.hlsl 保持一致，最后一行的第二个纹素使用了 src[2][3]
+					color += (j == 3 && i == 1 ? src[2][3] : src[i][j]) * weight;
+				}
+			}
+			color = color * (1.0f / weightSum);
+
+			// 抗振铃
+			const Vec4 minSample = Vec4::Min(Vec4::Min(src[1][1], src[2][1]), Vec4::Min(src[1][2], src[2][2]));
+			const Vec4 maxSample = Vec4::Max(Vec4::Max(src[1][1], src[2][1]), Vec4::Max(src[1][2], src[2][2]));
+			color = Vec4::Lerp(color, Vec4::Clamp(color, minSample, maxSample), arStrength);
+
+			color.StoreOpaque(output.Texel(x, y));
+		}
+	}
+}
+
+struct BuiltinCpuEffect {
+	std::string_view name;
+	CpuPassKernel kernel;
+	// 必须和 hlsl 中声明的参数一致，顺序为 CpuPassContext::params 的顺序
+	std::initializer_list<std::string_view> params;
+};
+
+static const BuiltinCpuEffect* FindBuiltinEffect(std::string_view name) noexcept {
+	static const BuiltinCpuEffect BUILTIN_EFFECTS[] = {
+		{ "Nearest", NearestKernel, {} },
+		{ "Bilinear", BilinearKernel, {} },
+		{ "Bicubic", BicubicKernel, { "paramB", "paramC" } },
+		{ "Lanczos", LanczosKernel, { "ARStrength" } },
+		{ "Jinc", JincKernel, { "windowSinc", "sinc", "ARStrength" } }
+	};
+
+	for (const BuiltinCpuEffect& effect : BUILTIN_EFFECTS) {
+		if (effect.name == name) {
+			return &effect;
+		}
+	}
+
+	return nullptr;
+}
+
+// 输出为 R8G8B8A8_UNORM，模拟写入纹理时的精度损失，使结果和 GPU 一致
+static void QuantizeRows(CpuTexture& tex, uint32_t rowBegin, uint32_t rowEnd) noexcept {
+	float* begin = tex.Texel(0, rowBegin);
+	float* end = begin + (size_t)(rowEnd - rowBegin) * tex.width * 4;
+	for (float* p = begin; p != end; ++p) {
+		*p = std::roundf(std::clamp(*p, 0.0f, 1.0f) * 255.0f) / 255.0f;
+	}
+}
+
+CpuTexture CpuTexture::FromBGRA8(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch) noexcept {
+	CpuTexture result(width, height);
+
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* src = pixels + (size_t)y * rowPitch;
+		float* dest = result.Texel(0, y);
+		for (uint32_t x = 0; x < width; ++x) {
+			dest[0] = src[2] / 255.0f;
+			dest[1] = src[1] / 255.0f;
+			dest[2] = src[0] / 255.0f;
+			dest[3] = src[3] / 255.0f;
+			src += 4;
+			dest += 4;
+		}
+	}
+
+	return result;
+}
+
+void CpuTexture::ToRGBA8(std::vector<uint8_t>& result) const noexcept {
+	result.resize(data.size());
+	for (size_t i = 0; i < data.size(); ++i) {
+		result[i] = (uint8_t)std::lroundf(std::clamp(data[i], 0.0f, 1.0f) * 255.0f);
+	}
+}
+
+bool CpuEffectDrawer::IsSupported(std::string_view effectName) noexcept {
+	return FindBuiltinEffect(effectName) != nullptr;
+}
+
+bool CpuEffectDrawer::Initialize(
+	std::string_view effectName,
+	const EffectMetadata& metadata,
+	const CpuEffectParams& params,
+	CpuSize inputSize,
+	CpuSize outputSize
+) noexcept {
+	const BuiltinCpuEffect* effect = FindBuiltinEffect(effectName);
+	if (!effect || metadata.params.size() != effect->params.size()) {
+		return false;
+	}
+
+	if (!metadata.outputSizeExpr.first.empty()) {
+		std::pair<EffectSizeBytecode, EffectSizeBytecode> bytecode;
+		if (!EffectSizeExpr::Compile(metadata.outputSizeExpr.first, false, bytecode.first) ||
+			!EffectSizeExpr::Compile(metadata.outputSizeExpr.second, false, bytecode.second)) {
+			return false;
+		}
+
+		const EffectSizeExprVars vars{ (double)inputSize.width, (double)inputSize.height, 0, 0 };
+		int32_t width, height;
+		if (!EffectSizeExpr::EvaluateSize(bytecode, vars, width, height)) {
+			return false;
+		}
+		outputSize = { (uint32_t)width, (uint32_t)height };
+	}
+
+	if (inputSize.width == 0 || inputSize.height == 0 || outputSize.width == 0 || outputSize.height == 0) {
+		return false;
+	}
+
+	// 不允许效果未声明的参数，避免拼写错误被忽略
+	for (const auto& [name, value] : params) {
+		if (std::none_of(metadata.params.begin(), metadata.params.end(),
+			[&](const EffectParameterDesc& paramDesc) { return paramDesc.name == name; })) {
+			return false;
+		}
+	}
+
+	_params.resize(effect->params.size());
+	for (size_t i = 0; i < _params.size(); ++i) {
+		const std::string_view paramName = effect->params.begin()[i];
+		auto descIt = std::find_if(metadata.params.begin(), metadata.params.end(),
+			[&](const EffectParameterDesc& paramDesc) { return paramDesc.name == paramName; });
+		if (descIt == metadata.params.end()) {
+			// hlsl 和 CPU 实现不一致
+			return false;
+		}
+
+		auto it = params.find(descIt->name);
+		if (descIt->constant.index() == 0) {
+			const EffectConstant<float>& constant = std::get<0>(descIt->constant);
+			const float value = it == params.end() ? constant.defaultValue : it->second;
+			if (value < constant.minValue || value > constant.maxValue) {
+				return false;
+			}
+			_params[i].floatVal = value;
+		} else {
+			const EffectConstant<int>& constant = std::get<1>(descIt->constant);
+			const int value = it == params.end() ? constant.defaultValue : (int)std::lroundf(it->second);
+			if (value < constant.minValue || value > constant.maxValue) {
+				return false;
+			}
+			_params[i].intVal = value;
+		}
+	}
+
+	_kernel = effect->kernel;
+	_output = CpuTexture(outputSize.width, outputSize.height);
+	return true;
+}
+
+const CpuTexture& CpuEffectDrawer::Draw(const CpuTexture& input) noexcept {
+	// 每个任务处理的行数
+	static constexpr uint32_t ROWS_PER_TASK = 32;
+
+	const CpuPassContext context{ &input, &_output, _params.data() };
+	const uint32_t height = _output.height;
+
+	// 使用标准库的并行算法，不依赖平台的线程池
+	_taskIds.resize((height + ROWS_PER_TASK - 1) / ROWS_PER_TASK);
+	std::iota(_taskIds.begin(), _taskIds.end(), 0u);
+
+	std::for_each(std::execution::par, _taskIds.begin(), _taskIds.end(), [&](uint32_t id) {
+		const uint32_t rowBegin = id * ROWS_PER_TASK;
+		const uint32_t rowEnd = std::min(rowBegin + ROWS_PER_TASK, height);
+
+		_kernel(context, rowBegin, rowEnd);
+		QuantizeRows(_output, rowBegin, rowEnd);
+	});
+
+	return _output;
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "EffectMetadata.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 不使用 Win32 的 SIZE，使 CPU 实现不依赖平台
+struct CpuSize {
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// CPU 上的纹理，每个像素为 RGBA 四个 float
+struct CpuTexture {
+	CpuTexture() = default;
+	CpuTexture(uint32_t width_, uint32_t height_) noexcept
+		: width(width_), height(height_), data((size_t)width_ * height_ * 4) {}
+
+	float* Texel(uint32_t x, uint32_t y) noexcept {
+		return data.data() + ((size_t)y * width + x) * 4;
+	}
+
+	const float* Texel(uint32_t x, uint32_t y) const noexcept {
+		return data.data() + ((size_t)y * width + x) * 4;
+	}
+
+	// 捕获的帧格式为 B8G8R8A8_UNORM
+	static CpuTexture FromBGRA8(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch) noexcept;
+
+	void ToRGBA8(std::vector<uint8_t>& result) const noexcept;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<float> data;
+};
+
+// 参数名到值的映射，未指定的参数使用默认值
+using CpuEffectParams = std::unordered_map<std::string, float>;
+
+union CpuConstant {
+	float floatVal;
+	int intVal;
+};
+
+struct CpuPassContext {
+	const CpuTexture* input = nullptr;
+	CpuTexture* output = nullptr;
+	// 按内置实现声明的顺序排列
+	const CpuConstant* params = nullptr;
+};
+
+// 处理输出的 [rowBegin, rowEnd) 行，不同的行可能在不同线程上并行处理
+using CpuPassKernel = void (*)(const CpuPassContext& context, uint32_t rowBegin, uint32_t rowEnd);
+
+// EffectDrawer 的 CPU 参考实现，只依赖标准库。用于离线批处理和生成回归测试的基准图像。
+// 无法在 CPU 上执行 HLSL，因此只支持有内置 CPU 实现的效果，目前为 Nearest、Bilinear、Bicubic、
+// Lanczos 和 Jinc，它们都只有一个通道。失败时不记录日志，由调用者处理。
+class CpuEffectDrawer {
+public:
+	CpuEffectDrawer() = default;
+	CpuEffectDrawer(const CpuEffectDrawer&) = delete;
+	CpuEffectDrawer(CpuEffectDrawer&&) = default;
+
+	// metadata 应由 EffectParser::ParseMetadata 从效果源码解析，用于取得参数的默认值和范围以及
+	// 输出尺寸。params 中不能有效果未声明的参数。outputSize 为效果未指定输出尺寸时使用的尺寸
+	bool Initialize(
+		std::string_view effectName,
+		const EffectMetadata& metadata,
+		const CpuEffectParams& params,
+		CpuSize inputSize,
+		CpuSize outputSize
+	) noexcept;
+
+	CpuSize OutputSize() const noexcept {
+		return { _output.width, _output.height };
+	}
+
+	// input 的尺寸必须和初始化时相同
+	const CpuTexture& Draw(const CpuTexture& input) noexcept;
+
+	static bool IsSupported(std::string_view effectName) noexcept;
+
+private:
+	// 格式为 R8G8B8A8_UNORM，和 EffectDrawer 的输出相同
+	CpuTexture _output;
+	CpuPassKernel _kernel = nullptr;
+	std::vector<CpuConstant> _params;
+	// 每个并行任务处理一段行，复用以避免每帧分配
+	std::vector<uint32_t> _taskIds;
+};
+
+}
@@ -149,10 +149,9 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 
 	_isFrameAcquired = true;
 
-	bool noUpdate = true;
-
 	// 检索 move rects 和 dirty rects
-	// 这些区域如果和窗口客户区有重叠则表明画面有变化
+	// 这些区域和窗口客户区重叠的部分即为画面变化的区域
+	RECT dirtyRect{};
 	if (info.TotalMetadataBufferSize) {
 		if (info.TotalMetadataBufferSize > _dupMetaData.size()) {
 			_dupMetaData.resize(info.TotalMetadataBufferSize);
@@ -172,37 +171,39 @@ FrameSourceBase::UpdateState DesktopDuplicationFrameSource::_Update() noexcept {
 		for (uint32_t i = 0; i < nRect; ++i) {
 			const DXGI_OUTDUPL_MOVE_RECT& rect = 
 				((DXGI_OUTDUPL_MOVE_RECT*)_dupMetaData.data())[i];
-			if (Win32Utils::CheckOverlap(_srcClientInMonitor, rect.DestinationRect)) {
-				noUpdate = false;
-				break;
+			RECT overlap;
+			if (IntersectRect(&overlap, &_srcClientInMonitor, &rect.DestinationRect)) {
+				UnionRect(&dirtyRect, &dirtyRect, &overlap);
 			}
 		}
 
-		if (noUpdate) {
-			bufSize = info.TotalMetadataBufferSize;
+		bufSize = info.TotalMetadataBufferSize;
 
-			// Dirty rects
-			hr = _outputDup->GetFrameDirtyRects(
-				bufSize, (RECT*)_dupMetaData.data(), &bufSize);
-			if (FAILED(hr)) {
-				Logger::Get().ComError("GetFrameDirtyRects 失败", hr);
-				return UpdateState::Error;
-			}
+		// Dirty rects
+		hr = _outputDup->GetFrameDirtyRects(
+			bufSize, (RECT*)_dupMetaData.data(), &bufSize);
+		if (FAILED(hr)) {
+			Logger::Get().ComError("GetFrameDirtyRects 失败", hr);
+			return UpdateState::Error;
+		}
 
-			nRect = bufSize / sizeof(RECT);
-			for (uint32_t i = 0; i < nRect; ++i) {
-				const RECT& rect = ((RECT*)_dupMetaData.data())[i];
-				if (Win32Utils::CheckOverlap(_srcClientInMonitor, rect)) {
-					noUpdate = false;
-					break;
-				}
+		nRect = bufSize / sizeof(RECT);
+		for (uint32_t i = 0; i < nRect; ++i) {
+			const RECT& rect = ((RECT*)_dupMetaData.data())[i];
+			RECT overlap;
+			if (IntersectRect(&overlap, &_srcClientInMonitor, &rect)) {
+				UnionRect(&dirtyRect, &dirtyRect, &overlap);
 			}
 		}
 	}
 
-	if (noUpdate) {
+	if (IsRectEmpty(&dirtyRect)) {
 		return UpdateState::Waiting;
 	}
+
+	// 转换为输出纹理中的坐标
+	OffsetRect(&dirtyRect, -(LONG)_frameInMonitor.left, -(LONG)_frameInMonitor.top);
+	IntersectRect(&_dirtyRect, &_dirtyRect, &dirtyRect);
 	
 	winrt::com_ptr<ID3D11Texture2D> frameTexture = dxgiRes.try_as<ID3D11Texture2D>();
 	if (!frameTexture) {
@@ -4,11 +4,10 @@
 #include "Logger.h"
 #include "StrUtils.h"
 #include "DirectXHelper.h"
-#include "ScalingWindow.h"
 
 namespace Magpie::Core {
 
-bool DeviceResources::Initialize() noexcept {
+bool DeviceResources::Initialize(int graphicsCard) noexcept {
 #ifdef _DEBUG
 	UINT flag = DXGI_CREATE_FACTORY_DEBUG;
 #else
@@ -31,7 +30,7 @@ bool DeviceResources::Initialize() noexcept {
 	_isSupportTearing = supportTearing;
 	Logger::Get().Info(fmt::format("可变刷新率支持: {}", supportTearing ? "是" : "否"));
 
-	if (!_ObtainAdapterAndDevice(ScalingWindow::Get().Options().graphicsCard)) {
+	if (!_ObtainAdapterAndDevice(graphicsCard)) {
 		Logger::Get().Error("找不到可用的图形适配器");
 		return false;
 	}
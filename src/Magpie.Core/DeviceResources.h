@@ -9,7 +9,8 @@ public:
 	DeviceResources(const DeviceResources&) = delete;
 	DeviceResources(DeviceResources&&) = default;
 
-	bool Initialize() noexcept;
+	// graphicsCard 为首选的图形适配器序号，-1 表示默认
+	bool Initialize(int graphicsCard) noexcept;
 
 	IDXGIFactory7* GetDXGIFactory() const noexcept { return _dxgiFactory.get(); }
 	ID3D11Device5* GetD3DDevice() const noexcept { return _d3dDevice.get(); }
@@ -6,6 +6,17 @@
 
 namespace Magpie::Core {
 
+static std::unique_ptr<D3D_SHADER_MACRO[]> ToShaderMacros(
+	const std::vector<std::pair<std::string, std::string>>& macros
+) noexcept {
+	std::unique_ptr<D3D_SHADER_MACRO[]> mc(new D3D_SHADER_MACRO[macros.size() + 1]);
+	for (UINT i = 0; i < macros.size(); ++i) {
+		mc[i] = { macros[i].first.c_str(), macros[i].second.c_str() };
+	}
+	mc[macros.size()] = { nullptr,nullptr };
+	return mc;
+}
+
 bool DirectXHelper::CompileComputeShader(
 	std::string_view hlsl,
 	const char* entryPoint,
@@ -28,11 +39,7 @@ bool DirectXHelper::CompileComputeShader(
 	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
 #endif // _DEBUG
 
-	std::unique_ptr<D3D_SHADER_MACRO[]> mc(new D3D_SHADER_MACRO[macros.size() + 1]);
-	for (UINT i = 0; i < macros.size(); ++i) {
-		mc[i] = { macros[i].first.c_str(), macros[i].second.c_str() };
-	}
-	mc[macros.size()] = { nullptr,nullptr };
+	std::unique_ptr<D3D_SHADER_MACRO[]> mc = ToShaderMacros(macros);
 
 	HRESULT hr = D3DCompile(hlsl.data(), hlsl.size(), sourceName, mc.get(), include,
 		entryPoint, "cs_5_0", flags, 0, blob, errorMsgs.put());
@@ -51,6 +58,27 @@ bool DirectXHelper::CompileComputeShader(
 	return true;
 }
 
+bool DirectXHelper::PreprocessShader(
+	std::string_view hlsl,
+	const char* sourceName,
+	ID3DInclude* include,
+	const std::vector<std::pair<std::string, std::string>>& macros,
+	ID3DBlob** blob
+) {
+	winrt::com_ptr<ID3DBlob> errorMsgs = nullptr;
+	std::unique_ptr<D3D_SHADER_MACRO[]> mc = ToShaderMacros(macros);
+
+	HRESULT hr = D3DPreprocess(hlsl.data(), hlsl.size(), sourceName, mc.get(), include, blob, errorMsgs.put());
+	if (FAILED(hr)) {
+		if (errorMsgs) {
+			Logger::Get().ComError(StrUtils::Concat("预处理着色器失败: ", (const char*)errorMsgs->GetBufferPointer()), hr);
+		}
+		return false;
+	}
+
+	return true;
+}
+
 bool DirectXHelper::IsDebugLayersAvailable() noexcept {
 #ifdef _DEBUG
 	static bool result = SUCCEEDED(D3D11CreateDevice(
@@ -13,6 +13,15 @@ struct DirectXHelper {
 		bool warningsAreErrors = false
 	);
 
+	// 只展开 #include 和宏，不编译
+	static bool PreprocessShader(
+		std::string_view hlsl,
+		const char* sourceName,
+		ID3DInclude* include,
+		const std::vector<std::pair<std::string, std::string>>& macros,
+		ID3DBlob** blob
+	);
+
 	static bool IsDebugLayersAvailable() noexcept;
 
 	static winrt::com_ptr<ID3D11Texture2D> CreateTexture2D(
@@ -0,0 +1,737 @@
+#include "pch.h"
+#include "EffectBenchmark.h"
+#include "EffectCompiler.h"
+#include "EffectDesc.h"
+#include "EffectDrawer.h"
+#include "EffectsProfiler.h"
+#include "EffectTextureAllocator.h"
+#include "FP16StorageAllowlist.h"
+#include "BackendDescriptorStore.h"
+#include "EffectConstantStore.h"
+#include "DeviceResources.h"
+#include "DirectXHelper.h"
+#include "TextureLoader.h"
+#include "FrameTrace.h"
+#include "SyntheticFrame.h"
+#include "EffectParser.h"
+#include "CommonSharedConstants.h"
+#include "Logger.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include <filesystem>
+#include <rapidjson/prettywriter.h>
+
+using namespace std::chrono;
+
+namespace Magpie::Core {
+
+// 允许 FP16 存储的纹理对最终输出造成的最大误差，以 8 位颜色值计
+static constexpr uint32_t FP16_STORAGE_MAX_ERROR = 1;
+
+static std::optional<EffectDesc> CompileEffect(const EffectOption& effectOption) noexcept {
+	EffectDesc result;
+	result.name = StrUtils::UTF16ToUTF8(effectOption.name);
+
+	if (effectOption.flags & EffectOptionFlags::InlineParams) {
+		result.flags |= EffectFlags::InlineParams;
+	}
+	if (effectOption.flags & EffectOptionFlags::FP16) {
+		result.flags |= EffectFlags::FP16;
+	}
+
+	if (EffectCompiler::Compile(result, 0, &effectOption.parameters)) {
+		Logger::Get().Error(StrUtils::Concat("编译 ", result.name, ".hlsl 失败"));
+		return std::nullopt;
+	}
+
+	return result;
+}
+
+static bool RunOnGpu(
+	const EffectBenchmarkOptions& options,
+	const std::vector<EffectDesc>& effectDescs,
+	FrameTrace& trace,
+	std::string& deviceName,
+	SIZE& inputSize,
+	SIZE& outputSize
+) noexcept {
+	DeviceResources deviceResources;
+	if (!deviceResources.Initialize(options.graphicsCard)) {
+		Logger::Get().Error("初始化 D3D 设备失败");
+		return false;
+	}
+
+	ID3D11Device5* d3dDevice = deviceResources.GetD3DDevice();
+	ID3D11DeviceContext4* d3dDC = deviceResources.GetD3DDC();
+
+	{
+		DXGI_ADAPTER_DESC1 desc;
+		if (SUCCEEDED(deviceResources.GetGraphicsAdapter()->GetDesc1(&desc))) {
+			deviceName = StrUtils::UTF16ToUTF8(desc.Description);
+		}
+	}
+
+	// 录制的帧每帧复制到输入纹理
+	std::vector<winrt::com_ptr<ID3D11Texture2D>> inputFrames;
+	for (const std::wstring& fileName : options.inputFrames) {
+		winrt::com_ptr<ID3D11Texture2D>& frame = inputFrames.emplace_back(TextureLoader::Load(fileName.c_str(), d3dDevice));
+		if (!frame) {
+			Logger::Get().Error(fmt::format("加载 {} 失败", StrUtils::UTF16ToUTF8(fileName)));
+			return false;
+		}
+	}
+
+	std::vector<uint8_t> syntheticFrame;
+	winrt::com_ptr<ID3D11Texture2D> inputTexture;
+	if (inputFrames.empty()) {
+		inputSize = options.inputSize;
+		syntheticFrame = SyntheticFrame::Generate((uint32_t)inputSize.cx, (uint32_t)inputSize.cy);
+		inputTexture = DirectXHelper::CreateTexture2D(
+			d3dDevice,
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			inputSize.cx,
+			inputSize.cy,
+			D3D11_BIND_SHADER_RESOURCE
+		);
+	} else {
+		D3D11_TEXTURE2D_DESC desc;
+		inputFrames[0]->GetDesc(&desc);
+		for (const winrt::com_ptr<ID3D11Texture2D>& frame : inputFrames) {
+			D3D11_TEXTURE2D_DESC frameDesc;
+			frame->GetDesc(&frameDesc);
+			if (frameDesc.Width != desc.Width || frameDesc.Height != desc.Height || frameDesc.Format != desc.Format) {
+				Logger::Get().Error("录制的帧尺寸或格式不同");
+				return false;
+			}
+		}
+
+		inputSize = { (LONG)desc.Width, (LONG)desc.Height };
+		inputTexture = DirectXHelper::CreateTexture2D(
+			d3dDevice,
+			desc.Format,
+			desc.Width,
+			desc.Height,
+			D3D11_BIND_SHADER_RESOURCE
+		);
+	}
+	if (!inputTexture) {
+		Logger::Get().Error("创建输入纹理失败");
+		return false;
+	}
+
+	BackendDescriptorStore descriptorStore;
+	descriptorStore.Initialize(d3dDevice);
+
+	EffectConstantStore constantStore;
+	constantStore.Initialize(d3dDevice, d3dDC);
+
+	EffectTextureAllocator textureAllocator;
+	textureAllocator.Initialize(d3dDevice);
+
+	std::vector<EffectDrawer> effectDrawers(effectDescs.size());
+	ID3D11Texture2D* inOutTexture = inputTexture.get();
+	for (size_t i = 0; i < effectDescs.size(); ++i) {
+		if (!effectDrawers[i].Initialize(effectDescs[i], options.effects[i], options.outputSize,
+			deviceResources, descriptorStore, constantStore, textureAllocator, &inOutTexture)) {
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, effectDescs[i].name));
+			return false;
+		}
+	}
+
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		inOutTexture->GetDesc(&desc);
+		outputSize = { (LONG)desc.Width, (LONG)desc.Height };
+	}
+
+	// 和 Renderer 相同，帧数在所有效果共用的段中
+	const bool useDynamic = std::any_of(effectDescs.begin(), effectDescs.end(),
+		[](const EffectDesc& desc) { return desc.flags & EffectFlags::UseDynamic; });
+	const uint32_t dynamicConstantRegion = useDynamic ? constantStore.AddRegion(1) : 0;
+	if (!constantStore.Upload()) {
+		return false;
+	}
+
+	SmallVector<uint32_t> passNameIds;
+	for (const EffectDesc& desc : effectDescs) {
+		for (const EffectPassDesc& passDesc : desc.passes) {
+			passNameIds.push_back(trace.RegisterName(StrUtils::Concat(desc.name, ": ", passDesc.desc)));
+		}
+	}
+	const uint32_t totalNameId = trace.RegisterName("Total");
+
+	EffectsProfiler profiler;
+	const RECT inputRect{ 0, 0, inputSize.cx, inputSize.cy };
+	const uint32_t totalFrameCount = options.warmupFrameCount + options.frameCount;
+	for (uint32_t frame = 0; frame < totalFrameCount; ++frame) {
+		if (frame == options.warmupFrameCount) {
+			// 预热结束后才开始测量
+			profiler.Start(d3dDevice, &trace, passNameIds, 1);
+		}
+
+		if (inputFrames.empty()) {
+			const uint32_t rowPitch = (uint32_t)inputSize.cx * 4;
+			d3dDC->UpdateSubresource(inputTexture.get(), 0, nullptr,
+				SyntheticFrame::FrameData(syntheticFrame, (uint32_t)inputSize.cx, frame), rowPitch, 0);
+		} else {
+			d3dDC->CopyResource(inputTexture.get(), inputFrames[frame % inputFrames.size()].get());
+		}
+
+		d3dDC->ClearState();
+
+		if (useDynamic) {
+			constantStore.Edit(dynamicConstantRegion, 0, 1)->uintVal = frame;
+		}
+		constantStore.Upload();
+		if (useDynamic) {
+			constantStore.Bind(dynamicConstantRegion, 1);
+		}
+
+		const uint64_t frameStart = trace.Now();
+		profiler.OnBeginEffects(d3dDC, frame);
+
+		RECT dirtyRect = inputRect;
+		for (EffectDrawer& effectDrawer : effectDrawers) {
+			effectDrawer.Draw(profiler, dirtyRect);
+		}
+
+		profiler.OnEndEffects(d3dDC);
+
+		// 等待这一帧完成
+		profiler.QueryTimings(d3dDC, frame);
+
+		// 时间戳不连续时没有结果
+		const SmallVector<float> timings = profiler.GetTimings();
+		if (frame >= options.warmupFrameCount && !timings.empty()) {
+			float total = 0.0f;
+			for (float timing : timings) {
+				total += timing;
+			}
+			trace.Record(FrameTrace::Category::GPU, totalNameId, frame, frameStart, (uint64_t)std::llround(total * 1000));
+		}
+	}
+
+	return true;
+}
+
+std::optional<std::string> EffectBenchmark::Run(const EffectBenchmarkOptions& originalOptions) noexcept {
+	if (originalOptions.effects.empty() || originalOptions.frameCount == 0) {
+		Logger::Get().Error("参数非法");
+		return std::nullopt;
+	}
+
+	EffectBenchmarkOptions options = originalOptions;
+	if (EffectOption& lastEffect = options.effects.back(); !lastEffect.HasScale()) {
+		lastEffect.scalingType = ScalingType::Fit;
+	}
+
+	std::vector<EffectDesc> effectDescs;
+	for (const EffectOption& effectOption : options.effects) {
+		std::optional<EffectDesc> desc = CompileEffect(effectOption);
+		if (!desc) {
+			return std::nullopt;
+		}
+		effectDescs.push_back(std::move(*desc));
+	}
+
+	// 和 Renderer 相同，按验证结果使用 FP16 存储
+	if (options.useFP16Storage) {
+		FP16StorageAllowlist fp16StorageAllowlist;
+		fp16StorageAllowlist.Load();
+		for (EffectDesc& desc : effectDescs) {
+			fp16StorageAllowlist.Apply(desc);
+		}
+	}
+
+	// 每帧每个通道一个事件，外加每帧的总耗时
+	uint32_t eventsPerFrame = 1;
+	for (const EffectDesc& desc : effectDescs) {
+		eventsPerFrame += (uint32_t)desc.passes.size();
+	}
+	FrameTrace trace(eventsPerFrame * options.frameCount);
+
+	std::string deviceName;
+	SIZE inputSize{};
+	SIZE outputSize{};
+	if (!RunOnGpu(options, effectDescs, trace, deviceName, inputSize, outputSize)) {
+		return std::nullopt;
+	}
+
+	if (!options.tracePath.empty()) {
+		const std::string traceJson = trace.ExportChromeTrace();
+		if (!Win32Utils::WriteFile(options.tracePath.c_str(), traceJson.data(), traceJson.size())) {
+			Logger::Get().Error("保存 trace 失败");
+		}
+	}
+
+	rapidjson::StringBuffer json;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+	writer.StartObject();
+	writer.Key("device");
+	writer.String(deviceName.c_str(), (rapidjson::SizeType)deviceName.size());
+	writer.Key("inputSize");
+	writer.StartArray();
+	writer.Int(inputSize.cx);
+	writer.Int(inputSize.cy);
+	writer.EndArray();
+	writer.Key("outputSize");
+	writer.StartArray();
+	writer.Int(outputSize.cx);
+	writer.Int(outputSize.cy);
+	writer.EndArray();
+	writer.Key("frameCount");
+	writer.Uint(options.frameCount);
+	// 单位均为毫秒
+	writer.Key("passes");
+	writer.StartArray();
+	for (const FrameTrace::Summary& summary : trace.Summarize()) {
+		writer.StartObject();
+		writer.Key("name");
+		writer.String(summary.name.c_str(), (rapidjson::SizeType)summary.name.size());
+		writer.Key("count");
+		writer.Uint(summary.count);
+		writer.Key("average");
+		writer.Double(summary.average);
+		writer.Key("p50");
+		writer.Double(summary.p50);
+		writer.Key("p99");
+		writer.Double(summary.p99);
+		writer.Key("max");
+		writer.Double(summary.max);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	return std::string(json.GetString(), json.GetSize());
+}
+
+// 执行一帧并读回最终输出，格式为 R8G8B8A8_UNORM
+static bool RenderOnce(
+	const EffectBenchmarkOptions& options,
+	const std::vector<EffectDesc>& effectDescs,
+	DeviceResources& deviceResources,
+	ID3D11Texture2D* inputTexture,
+	std::vector<uint8_t>& pixels,
+	SIZE& outputSize
+) noexcept {
+	ID3D11Device5* d3dDevice = deviceResources.GetD3DDevice();
+	ID3D11DeviceContext4* d3dDC = deviceResources.GetD3DDC();
+
+	BackendDescriptorStore descriptorStore;
+	descriptorStore.Initialize(d3dDevice);
+
+	EffectConstantStore constantStore;
+	constantStore.Initialize(d3dDevice, d3dDC);
+
+	EffectTextureAllocator textureAllocator;
+	textureAllocator.Initialize(d3dDevice);
+
+	std::vector<EffectDrawer> effectDrawers(effectDescs.size());
+	ID3D11Texture2D* inOutTexture = inputTexture;
+	for (size_t i = 0; i < effectDescs.size(); ++i) {
+		if (!effectDrawers[i].Initialize(effectDescs[i], options.effects[i], options.outputSize,
+			deviceResources, descriptorStore, constantStore, textureAllocator, &inOutTexture)) {
+			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, effectDescs[i].name));
+			return false;
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC outputDesc;
+	inOutTexture->GetDesc(&outputDesc);
+	outputSize = { (LONG)outputDesc.Width, (LONG)outputDesc.Height };
+
+	d3dDC->ClearState();
+
+	// 帧数始终为 0
+	const bool useDynamic = std::any_of(effectDescs.begin(), effectDescs.end(),
+		[](const EffectDesc& desc) { return desc.flags & EffectFlags::UseDynamic; });
+	const uint32_t dynamicConstantRegion = useDynamic ? constantStore.AddRegion(1) : 0;
+	if (!constantStore.Upload()) {
+		return false;
+	}
+	if (useDynamic) {
+		constantStore.Bind(dynamicConstantRegion, 1);
+	}
+
+	// 未启动的 EffectsProfiler 不做任何事
+	EffectsProfiler profiler;
+	D3D11_TEXTURE2D_DESC inputDesc;
+	inputTexture->GetDesc(&inputDesc);
+	RECT dirtyRect{ 0, 0, (LONG)inputDesc.Width, (LONG)inputDesc.Height };
+	for (EffectDrawer& effectDrawer : effectDrawers) {
+		effectDrawer.Draw(profiler, dirtyRect);
+	}
+
+	outputDesc.Usage = D3D11_USAGE_STAGING;
+	outputDesc.BindFlags = 0;
+	outputDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	outputDesc.MiscFlags = 0;
+	winrt::com_ptr<ID3D11Texture2D> stagingTexture;
+	HRESULT hr = d3dDevice->CreateTexture2D(&outputDesc, nullptr, stagingTexture.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateTexture2D 失败", hr);
+		return false;
+	}
+
+	d3dDC->CopyResource(stagingTexture.get(), inOutTexture);
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	hr = d3dDC->Map(stagingTexture.get(), 0, D3D11_MAP_READ, 0, &ms);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("Map 失败", hr);
+		return false;
+	}
+
+	const size_t rowSize = (size_t)outputDesc.Width * 4;
+	pixels.resize(rowSize * outputDesc.Height);
+	for (uint32_t y = 0; y < outputDesc.Height; ++y) {
+		std::memcpy(&pixels[y * rowSize], (const uint8_t*)ms.pData + (size_t)y * ms.RowPitch, rowSize);
+	}
+
+	d3dDC->Unmap(stagingTexture.get(), 0);
+	return true;
+}
+
+struct ImageError {
+	uint32_t maxError = 0;
+	double meanError = 0;
+	// 完全相同时为无穷大
+	double psnr = std::numeric_limits<double>::infinity();
+};
+
+// 只比较颜色通道
+static ImageError CompareImages(const std::vector<uint8_t>& reference, const std::vector<uint8_t>& pixels) noexcept {
+	assert(reference.size() == pixels.size());
+
+	ImageError result;
+	uint64_t totalError = 0;
+	uint64_t totalSquaredError = 0;
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		for (size_t j = 0; j < 3; ++j) {
+			const uint32_t error = (uint32_t)std::abs((int)reference[i + j] - (int)pixels[i + j]);
+			result.maxError = std::max(result.maxError, error);
+			totalError += error;
+			totalSquaredError += error * error;
+		}
+	}
+
+	const double sampleCount = pixels.size() / 4 * 3.0;
+	result.meanError = totalError / sampleCount;
+	if (totalSquaredError > 0) {
+		result.psnr = 10 * std::log10(255.0 * 255.0 * sampleCount / totalSquaredError);
+	}
+	return result;
+}
+
+static void WriteImageError(rapidjson::PrettyWriter<rapidjson::StringBuffer>& writer, const ImageError& error) noexcept {
+	writer.Key("maxError");
+	writer.Uint(error.maxError);
+	writer.Key("meanError");
+	writer.Double(error.meanError);
+	writer.Key("psnr");
+	if (std::isinf(error.psnr)) {
+		writer.Null();
+	} else {
+		writer.Double(error.psnr);
+	}
+}
+
+std::optional<std::string> EffectBenchmark::ValidateFP16Storage(const EffectBenchmarkOptions& originalOptions) noexcept {
+	if (originalOptions.effects.empty()) {
+		Logger::Get().Error("参数非法");
+		return std::nullopt;
+	}
+
+	EffectBenchmarkOptions options = originalOptions;
+	if (EffectOption& lastEffect = options.effects.back(); !lastEffect.HasScale()) {
+		lastEffect.scalingType = ScalingType::Fit;
+	}
+
+	// 全精度的结果作为参照，替换纹理格式无需重新编译
+	std::vector<EffectDesc> referenceDescs;
+	for (const EffectOption& effectOption : options.effects) {
+		std::optional<EffectDesc> desc = CompileEffect(effectOption);
+		if (!desc) {
+			return std::nullopt;
+		}
+		referenceDescs.push_back(std::move(*desc));
+	}
+
+	DeviceResources deviceResources;
+	if (!deviceResources.Initialize(options.graphicsCard)) {
+		Logger::Get().Error("初始化 D3D 设备失败");
+		return std::nullopt;
+	}
+
+	winrt::com_ptr<ID3D11Texture2D> inputTexture;
+	if (options.inputFrames.empty()) {
+		const std::vector<uint8_t> syntheticFrame = SyntheticFrame::Generate((uint32_t)options.inputSize.cx, (uint32_t)options.inputSize.cy);
+		const D3D11_SUBRESOURCE_DATA initData{
+			.pSysMem = syntheticFrame.data(),
+			.SysMemPitch = (UINT)options.inputSize.cx * 4
+		};
+		inputTexture = DirectXHelper::CreateTexture2D(
+			deviceResources.GetD3DDevice(),
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			options.inputSize.cx,
+			options.inputSize.cy,
+			D3D11_BIND_SHADER_RESOURCE,
+			D3D11_USAGE_DEFAULT,
+			0,
+			&initData
+		);
+	} else {
+		inputTexture = TextureLoader::Load(options.inputFrames[0].c_str(), deviceResources.GetD3DDevice());
+	}
+	if (!inputTexture) {
+		Logger::Get().Error("创建输入纹理失败");
+		return std::nullopt;
+	}
+
+	std::vector<uint8_t> referencePixels;
+	SIZE outputSize{};
+	if (!RenderOnce(options, referenceDescs, deviceResources, inputTexture.get(), referencePixels, outputSize)) {
+		return std::nullopt;
+	}
+
+	struct TextureResult {
+		size_t effectIdx;
+		size_t textureIdx;
+		ImageError error;
+		bool isAllowed;
+	};
+	std::vector<TextureResult> textureResults;
+
+	// 逐个替换纹理以找出误差来源
+	std::vector<uint8_t> pixels;
+	for (size_t i = 0; i < referenceDescs.size(); ++i) {
+		const EffectDesc& referenceDesc = referenceDescs[i];
+
+		for (size_t j = 2; j < referenceDesc.textures.size(); ++j) {
+			const EffectIntermediateTextureDesc& texDesc = referenceDesc.textures[j];
+			const EffectIntermediateTextureFormat fp16Format = GetFP16StorageFormat(texDesc.format);
+			if (!texDesc.source.empty() || fp16Format == texDesc.format) {
+				continue;
+			}
+
+			std::vector<EffectDesc> descs = referenceDescs;
+			descs[i].textures[j].format = fp16Format;
+			if (!RenderOnce(options, descs, deviceResources, inputTexture.get(), pixels, outputSize)) {
+				return std::nullopt;
+			}
+
+			const ImageError error = CompareImages(referencePixels, pixels);
+			Logger::Get().Info(fmt::format("{} 的纹理 {}: 最大误差 {}，平均误差 {}",
+				referenceDesc.name, texDesc.name, error.maxError, error.meanError));
+
+			textureResults.push_back({ i, j, error, error.maxError <= FP16_STORAGE_MAX_ERROR });
+		}
+	}
+
+	const auto renderWith = [&](bool allowedOnly, ImageError& error) {
+		std::vector<EffectDesc> descs = referenceDescs;
+		for (const TextureResult& result : textureResults) {
+			if (!allowedOnly || result.isAllowed) {
+				EffectIntermediateTextureDesc& texDesc = descs[result.effectIdx].textures[result.textureIdx];
+				texDesc.format = GetFP16StorageFormat(texDesc.format);
+			}
+		}
+
+		if (!RenderOnce(options, descs, deviceResources, inputTexture.get(), pixels, outputSize)) {
+			return false;
+		}
+
+		error = CompareImages(referencePixels, pixels);
+		return true;
+	};
+
+	// 替换所有纹理的误差，仅供参考
+	ImageError totalError;
+	if (!renderWith(false, totalError)) {
+		return std::nullopt;
+	}
+
+	// 单独替换时误差足够小的纹理同时替换时误差可能累积，逐个排除平均误差最大的直到满足要求。
+	// 没有纹理被替换时误差为 0，因此循环一定会结束
+	ImageError allowedError;
+	while (true) {
+		if (!renderWith(true, allowedError)) {
+			return std::nullopt;
+		}
+
+		if (allowedError.maxError <= FP16_STORAGE_MAX_ERROR) {
+			break;
+		}
+
+		TextureResult* worst = nullptr;
+		for (TextureResult& result : textureResults) {
+			if (result.isAllowed && (!worst || result.error.meanError > worst->error.meanError)) {
+				worst = &result;
+			}
+		}
+		worst->isAllowed = false;
+	}
+
+	// 保存验证结果，保留其他效果的结果。同一个效果出现多次时只允许每次都通过验证的纹理
+	{
+		FP16StorageAllowlist allowlist;
+		allowlist.Load();
+
+		phmap::flat_hash_map<std::string, std::vector<std::string>> effectTextures;
+		for (size_t i = 0; i < referenceDescs.size(); ++i) {
+			const EffectDesc& referenceDesc = referenceDescs[i];
+
+			std::vector<std::string> textureNames;
+			for (const TextureResult& result : textureResults) {
+				if (result.effectIdx == i && result.isAllowed) {
+					textureNames.push_back(referenceDesc.textures[result.textureIdx].name);
+				}
+			}
+
+			auto [it, inserted] = effectTextures.try_emplace(referenceDesc.name, std::move(textureNames));
+			if (!inserted) {
+				std::erase_if(it->second, [&](const std::string& name) {
+					return std::find(textureNames.begin(), textureNames.end(), name) == textureNames.end();
+				});
+			}
+		}
+
+		for (auto& [effectName, textureNames] : effectTextures) {
+			allowlist.SetTextures(effectName, std::move(textureNames));
+		}
+
+		if (!allowlist.Save()) {
+			return std::nullopt;
+		}
+	}
+
+	rapidjson::StringBuffer json;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+	writer.StartObject();
+	writer.Key("outputSize");
+	writer.StartArray();
+	writer.Int(outputSize.cx);
+	writer.Int(outputSize.cy);
+	writer.EndArray();
+	writer.Key("all");
+	writer.StartObject();
+	WriteImageError(writer, totalError);
+	writer.EndObject();
+	writer.Key("allowed");
+	writer.StartObject();
+	WriteImageError(writer, allowedError);
+	writer.EndObject();
+	writer.Key("textures");
+	writer.StartArray();
+	for (const TextureResult& result : textureResults) {
+		const EffectDesc& referenceDesc = referenceDescs[result.effectIdx];
+		const EffectIntermediateTextureDesc& texDesc = referenceDesc.textures[result.textureIdx];
+
+		writer.StartObject();
+		writer.Key("effect");
+		writer.String(referenceDesc.name.c_str(), (rapidjson::SizeType)referenceDesc.name.size());
+		writer.Key("texture");
+		writer.String(texDesc.name.c_str(), (rapidjson::SizeType)texDesc.name.size());
+		writer.Key("format");
+		writer.String(EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].name);
+		WriteImageError(writer, result.error);
+		writer.Key("allowed");
+		writer.Bool(result.isAllowed);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	return std::string(json.GetString(), json.GetSize());
+}
+
+std::optional<std::string> EffectBenchmark::RunParser(uint32_t iterationCount) noexcept {
+	if (iterationCount == 0) {
+		Logger::Get().Error("参数非法");
+		return std::nullopt;
+	}
+
+	std::vector<std::string> sources;
+	size_t totalSize = 0;
+	{
+		std::error_code ec;
+		for (auto it = std::filesystem::recursive_directory_iterator(CommonSharedConstants::EFFECTS_DIR, ec);
+			!ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (!it->is_regular_file() || it->path().extension() != L".hlsl") {
+				continue;
+			}
+
+			std::string& source = sources.emplace_back();
+			if (!Win32Utils::ReadTextFile(it->path().c_str(), source)) {
+				Logger::Get().Error(StrUtils::Concat("读取 ", StrUtils::UTF16ToUTF8(it->path().native()), " 失败"));
+				return std::nullopt;
+			}
+			totalSize += source.size();
+		}
+
+		if (ec || sources.empty()) {
+			Logger::Get().Error("枚举效果失败");
+			return std::nullopt;
+		}
+	}
+
+	// 删除注释是原地进行的，每次迭代都要复制源码，复制不计入耗时
+	std::vector<std::string> work(sources.size());
+	duration<double, std::milli> removeCommentsTime{};
+	duration<double, std::milli> splitBlocksTime{};
+
+	for (uint32_t i = 0; i < iterationCount; ++i) {
+		for (size_t j = 0; j < sources.size(); ++j) {
+			work[j] = sources[j];
+		}
+
+		auto start = steady_clock::now();
+		for (std::string& source : work) {
+			if (EffectParser::RemoveComments(source)) {
+				Logger::Get().Error("删除注释失败");
+				return std::nullopt;
+			}
+		}
+		auto mid = steady_clock::now();
+
+		for (const std::string& source : work) {
+			EffectSourceBlocks blocks;
+			EffectParser::SplitBlocks(source, blocks);
+		}
+		auto end = steady_clock::now();
+
+		removeCommentsTime += mid - start;
+		splitBlocksTime += end - mid;
+	}
+
+	rapidjson::StringBuffer json;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+	writer.StartObject();
+	writer.Key("fileCount");
+	writer.Uint((uint32_t)sources.size());
+	writer.Key("totalSize");
+	writer.Uint64(totalSize);
+	writer.Key("iterationCount");
+	writer.Uint(iterationCount);
+
+	// 单位为毫秒和 MB/s
+	auto writePhase = [&](const char* name, duration<double, std::milli> time) {
+		const double average = time.count() / iterationCount;
+		writer.Key(name);
+		writer.StartObject();
+		writer.Key("average");
+		writer.Double(average);
+		writer.Key("throughput");
+		writer.Double(totalSize / 1e3 / average);
+		writer.EndObject();
+	};
+	writePhase("removeComments", removeCommentsTime);
+	writePhase("splitBlocks", splitBlocksTime);
+
+	writer.EndObject();
+
+	return std::string(json.GetString(), json.GetSize());
+}
+
+}
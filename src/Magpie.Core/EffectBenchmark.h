@@ -0,0 +1,38 @@
+#pragma once
+#include "ScalingOptions.h"
+
+namespace Magpie::Core {
+
+struct EffectBenchmarkOptions {
+	// 最后一个效果未指定缩放方式时等比缩放到 outputSize
+	std::vector<EffectOption> effects;
+	// 录制的帧，为 DDS 文件，尺寸和格式必须相同。为空则使用合成的画面
+	std::vector<std::wstring> inputFrames;
+	// 合成画面的尺寸
+	SIZE inputSize{ 1920, 1080 };
+	// 相当于缩放窗口的尺寸
+	SIZE outputSize{ 3840, 2160 };
+	uint32_t warmupFrameCount = 30;
+	uint32_t frameCount = 300;
+	int graphicsCard = -1;
+	// 按 Benchmark --validate-fp16-storage 的结果将部分中间纹理改为 16 位浮点格式，和缩放时相同
+	bool useFP16Storage = true;
+	// 非空则保存 Chrome 格式的 trace
+	std::wstring tracePath;
+};
+
+// 离线测量效果的性能，不需要创建缩放窗口。结果为 JSON 格式，包含每个通道耗时的平均值、
+// p50 和 p99。CPU 参考实现的测量见 CpuBenchmark，它不依赖 Win32 和 D3D。
+struct EffectBenchmark {
+	static std::optional<std::string> Run(const EffectBenchmarkOptions& options) noexcept;
+
+	// 验证 FP16 存储的精度。比较全精度和 32 位浮点中间纹理改为 16 位浮点后最终输出的误差，
+	// 先逐个替换以找出误差来源，再同时替换误差足够小的纹理，将最终通过验证的纹理保存到
+	// FP16StorageAllowlist 中。只使用第一帧，误差以 8 位颜色值计
+	static std::optional<std::string> ValidateFP16Storage(const EffectBenchmarkOptions& options) noexcept;
+
+	// 测量 EffectParser 删除注释和分割块的速度，源码为 effects 文件夹中的所有效果
+	static std::optional<std::string> RunParser(uint32_t iterationCount) noexcept;
+};
+
+}
@@ -1,61 +1,17 @@
 #include "pch.h"
 #include "EffectCacheManager.h"
-#include <regex>
 #include "StrUtils.h"
 #include "Logger.h"
 #include "CommonSharedConstants.h"
-#include <d3dcompiler.h>
+#include <d3dcommon.h>
 #include "Utils.h"
 #include "YasHelper.h"
 
-namespace yas::detail {
-
-// winrt::com_ptr<ID3DBlob>
-template<std::size_t F>
-struct serializer<
-	type_prop::not_a_fundamental,
-	ser_case::use_internal_serializer,
-	F,
-	winrt::com_ptr<ID3DBlob>
-> {
-	template<typename Archive>
-	static Archive& save(Archive& ar, const winrt::com_ptr<ID3DBlob>& blob) {
-		uint32_t size = (uint32_t)blob->GetBufferSize();
-		ar& size;
-
-		ar.write(blob->GetBufferPointer(), size);
-
-		return ar;
-	}
-
-	template<typename Archive>
-	static Archive& load(Archive& ar, winrt::com_ptr<ID3DBlob>& blob) {
-		uint32_t size = 0;
-		ar& size;
-		HRESULT hr = D3DCreateBlob(size, blob.put());
-		if (FAILED(hr)) {
-			Logger::Get().ComError("D3DCreateBlob 失败", hr);
-			throw new std::exception();
-		}
-
-		ar.read(blob->GetBufferPointer(), size);
-
-		return ar;
-	}
-};
-
-}
-
 namespace Magpie::Core {
 
-template<typename Archive>
-void serialize(Archive& ar, EffectParameterDesc& o) {
-	ar& o.name& o.label& o.constant;
-}
-
 template<typename Archive>
 void serialize(Archive& ar, EffectIntermediateTextureDesc& o) {
-	ar& o.format& o.name& o.source& o.sizeExpr;
+	ar& o.format& o.name& o.source& o.sizeExpr& o.sizeBytecode;
 }
 
 template<typename Archive>
@@ -63,9 +19,10 @@ void serialize(Archive& ar, EffectSamplerDesc& o) {
 	ar& o.filterType& o.addressType& o.name;
 }
 
+// cso 不在此序列化，而是存储在缓存文件的字节码区
 template<typename Archive>
 void serialize(Archive& ar, EffectPassDesc& o) {
-	ar& o.cso& o.inputs& o.outputs& o.numThreads[0] & o.numThreads[1] & o.numThreads[2] & o.blockSize& o.desc& o.isPSStyle;
+	ar& o.inputs& o.outputs& o.numThreads[0] & o.numThreads[1] & o.numThreads[2] & o.blockSize& o.desc& o.dirtyRadius& o.isPSStyle;
 }
 
 template<typename Archive>
@@ -77,8 +34,211 @@ static constexpr uint32_t MAX_CACHE_COUNT = 127;
 
 // 缓存版本
 // 当缓存文件结构有更改时更新它，使旧缓存失效
-static constexpr uint32_t EFFECT_CACHE_VERSION = 13;
+static constexpr uint32_t EFFECT_CACHE_VERSION = 19;
+
+// 所有缓存都保存在同一个包文件中，新记录总是追加到末尾。同一效果（flags 相同）的新记录会取代
+// 旧记录，被取代的记录在之后启动时由线程池中的压缩任务清除
+static constexpr const wchar_t* CACHE_PACK_NAME = L"effects.pack";
+static constexpr const wchar_t* CACHE_PACK_TEMP_NAME = L"effects.pack.tmp";
+// 被取代的记录超过此大小且超过有效记录的总大小时压缩包文件
+static constexpr uint64_t CACHE_PACK_COMPACT_THRESHOLD = 1024 * 1024;
+
+// 包文件布局: [CachePackHeader][记录...]
+// 记录布局: [CacheRecordHeader][键（UTF-16）][数据]，记录头和数据都对齐到 CACHE_ALIGNMENT
+struct CachePackHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t reserved[2];
+};
+
+struct CacheRecordHeader {
+	uint32_t magic;
+	// 键的长度，单位为字符
+	uint32_t keyLength;
+	uint32_t dataSize;
+	uint32_t reserved;
+};
+
+// 数据布局，偏移均相对于数据开头:
+// [CacheDataHeader][CachePassEntry * passCount][EffectDesc 元数据][字节码...]
+// 加载时将包文件映射到内存，字节码无需复制即可直接用于创建着色器
+struct CacheDataHeader {
+	uint32_t metaOffset;
+	uint32_t metaSize;
+	uint32_t passCount;
+	uint32_t reserved;
+};
+
+struct CachePassEntry {
+	uint32_t offset;
+	uint32_t size;
+};
+
+// "MPPK"
+static constexpr uint32_t CACHE_PACK_MAGIC = 0x4B50504D;
+// "MPRC"
+static constexpr uint32_t CACHE_RECORD_MAGIC = 0x4352504D;
+static constexpr uint32_t CACHE_ALIGNMENT = 16;
+
+static constexpr uint64_t AlignCacheOffset(uint64_t offset) noexcept {
+	return (offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+// 引用包文件中的字节码，持有映射视图（压缩期间为复制到内存中的数据）的所有权
+class MappedBlob final : public ID3DBlob {
+public:
+	MappedBlob(std::shared_ptr<const BYTE> view, const BYTE* data, size_t size) noexcept
+		: _view(std::move(view)), _data(data), _size(size) {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) noexcept override {
+		if (!ppvObject) {
+			return E_POINTER;
+		}
+
+		if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3DBlob)) {
+			AddRef();
+			*ppvObject = static_cast<ID3DBlob*>(this);
+			return S_OK;
+		}
+
+		*ppvObject = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() noexcept override {
+		return _refCount.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() noexcept override {
+		const ULONG refCount = _refCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		if (refCount == 0) {
+			delete this;
+		}
+		return refCount;
+	}
+
+	LPVOID STDMETHODCALLTYPE GetBufferPointer() noexcept override {
+		return (LPVOID)_data;
+	}
+
+	SIZE_T STDMETHODCALLTYPE GetBufferSize() noexcept override {
+		return _size;
+	}
+
+private:
+	std::shared_ptr<const BYTE> _view;
+	const BYTE* _data;
+	size_t _size;
+	std::atomic<ULONG> _refCount = 1;
+};
+
+static bool ReadAt(HANDLE hFile, uint64_t offset, void* buffer, uint32_t size) noexcept {
+	OVERLAPPED ov{};
+	ov.Offset = (DWORD)offset;
+	ov.OffsetHigh = DWORD(offset >> 32);
+	DWORD read = 0;
+	return ::ReadFile(hFile, buffer, size, &read, &ov) && read == size;
+}
+
+static bool WriteAt(HANDLE hFile, uint64_t offset, const void* buffer, uint32_t size) noexcept {
+	OVERLAPPED ov{};
+	ov.Offset = (DWORD)offset;
+	ov.OffsetHigh = DWORD(offset >> 32);
+	DWORD written = 0;
+	return ::WriteFile(hFile, buffer, size, &written, &ov) && written == size;
+}
+
+static bool SerializeCacheData(const EffectDesc& desc, std::vector<BYTE>& buf) noexcept {
+	buf.reserve(4096);
+
+	CacheDataHeader header{ .passCount = (uint32_t)desc.passes.size() };
+	header.metaOffset = uint32_t(sizeof(CacheDataHeader) + header.passCount * sizeof(CachePassEntry));
+	buf.resize(header.metaOffset);
+
+	try {
+		yas::vector_ostream os(buf);
+		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+
+		oa& desc;
+	} catch (...) {
+		Logger::Get().Error("序列化 EffectDesc 失败");
+		return false;
+	}
+
+	header.metaSize = uint32_t(buf.size() - header.metaOffset);
+	std::memcpy(buf.data(), &header, sizeof(header));
+
+	// 写入字节码
+	for (uint32_t i = 0; i < header.passCount; ++i) {
+		const winrt::com_ptr<ID3DBlob>& cso = desc.passes[i].cso;
+		const size_t offset = (size_t)AlignCacheOffset(buf.size());
+		const size_t size = cso->GetBufferSize();
+
+		buf.resize(offset + size);
+		std::memcpy(buf.data() + offset, cso->GetBufferPointer(), size);
+
+		const CachePassEntry entry{ (uint32_t)offset, (uint32_t)size };
+		std::memcpy(buf.data() + sizeof(CacheDataHeader) + i * sizeof(CachePassEntry), &entry, sizeof(entry));
+	}
+
+	return true;
+}
+
+// data 位于 view 中且对齐到 CACHE_ALIGNMENT
+static bool DeserializeCacheData(
+	const std::shared_ptr<const BYTE>& view,
+	const BYTE* data,
+	size_t dataSize,
+	EffectDesc& desc
+) noexcept {
+	if (dataSize < sizeof(CacheDataHeader)) {
+		Logger::Get().Error("缓存已损坏");
+		return false;
+	}
+
+	CacheDataHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	const size_t entriesEnd = sizeof(CacheDataHeader) + (size_t)header.passCount * sizeof(CachePassEntry);
+	if (entriesEnd > dataSize || header.metaOffset < entriesEnd ||
+		(size_t)header.metaOffset + header.metaSize > dataSize) {
+		Logger::Get().Error("缓存已损坏");
+		return false;
+	}
+
+	try {
+		yas::mem_istream mi(data + header.metaOffset, header.metaSize);
+		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+
+		ia& desc;
+	} catch (...) {
+		Logger::Get().Error("反序列化失败");
+		desc = {};
+		return false;
+	}
+
+	if (desc.passes.size() != header.passCount) {
+		Logger::Get().Error("缓存已损坏");
+		desc = {};
+		return false;
+	}
+
+	const CachePassEntry* entries = (const CachePassEntry*)(data + sizeof(CacheDataHeader));
+	for (uint32_t i = 0; i < header.passCount; ++i) {
+		const CachePassEntry& entry = entries[i];
+		if (entry.size == 0 || entry.offset % CACHE_ALIGNMENT != 0 ||
+			(size_t)entry.offset + entry.size > dataSize) {
+			Logger::Get().Error("缓存已损坏");
+			desc = {};
+			return false;
+		}
+
+		// 字节码直接引用映射视图
+		desc.passes[i].cso.attach(new MappedBlob(view, data + entry.offset, entry.size));
+	}
 
+	return true;
+}
 
 static std::wstring GetLinearEffectName(std::wstring_view effectName) {
 	std::wstring result(effectName);
@@ -90,15 +250,23 @@ static std::wstring GetLinearEffectName(std::wstring_view effectName) {
 	return result;
 }
 
-static std::wstring GetCacheFileName(std::wstring_view linearEffectName, std::wstring_view hash, UINT flags) {
-	// 缓存文件的命名: {效果名}_{标志位（16进制）}{哈希}
-	return fmt::format(L"{}{}_{:01x}{}", CommonSharedConstants::CACHE_DIR, linearEffectName, flags & 0xf, hash);
+static std::wstring GetCacheName(std::wstring_view linearEffectName, std::wstring_view hash, UINT flags) {
+	// 缓存的命名: {效果名}_{标志位（16进制）}{哈希}
+	// 去掉哈希后的部分为包文件索引的键
+	return fmt::format(L"{}_{:01x}{}", linearEffectName, flags & 0xf, hash);
 }
 
-void EffectCacheManager::_AddToMemCache(const std::wstring& cacheFileName, const EffectDesc& desc) {
+static constexpr size_t CACHE_HASH_LENGTH = 16;
+
+// 通道缓存的键为 {PASS_CACHE_KEY_PREFIX}{哈希}，文件名中不会出现此字符，因此不会和效果缓存冲突
+static constexpr wchar_t PASS_CACHE_KEY_PREFIX = L'|';
+// 通道缓存按内容寻址，不会被取代，因此打开包文件时只保留最新的这么多条
+static constexpr size_t MAX_PASS_CACHE_COUNT = 1024;
+
+void EffectCacheManager::_AddToMemCache(const std::wstring& cacheName, const EffectDesc& desc) {
 	auto lock = _lock.lock_exclusive();
 
-	_memCache[cacheFileName] = { desc, ++_lastAccess };
+	_memCache[cacheName] = { desc, ++_lastAccess };
 
 	if (_memCache.size() > MAX_CACHE_COUNT) {
 		assert(_memCache.size() == MAX_CACHE_COUNT + 1);
@@ -124,115 +292,580 @@ void EffectCacheManager::_AddToMemCache(const std::wstring& cacheFileName, const
 	}
 }
 
-bool EffectCacheManager::_LoadFromMemCache(const std::wstring& cacheFileName, EffectDesc& desc) {
+bool EffectCacheManager::_LoadFromMemCache(const std::wstring& cacheName, EffectDesc& desc) {
 	auto lock = _lock.lock_exclusive();
 
-	auto it = _memCache.find(cacheFileName);
+	auto it = _memCache.find(cacheName);
 	if (it != _memCache.end()) {
 		desc = it->second.first;
 		it->second.second = ++_lastAccess;
-		Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+		Logger::Get().Info("已读取缓存", {
+			{ "cache", StrUtils::UTF16ToUTF8(cacheName) },
+			{ "source", "memory" }
+		});
 		return true;
 	}
 	return false;
 }
 
-bool EffectCacheManager::Load(std::wstring_view effectName, std::wstring_view hash, EffectDesc& desc) {
-	assert(!effectName.empty() && !hash.empty());
+static std::wstring GetPackPath(const wchar_t* name) {
+	return StrUtils::Concat(CommonSharedConstants::CACHE_DIR, name);
+}
+
+// "MPFX"，使用包文件前每个缓存一个文件，文件名为 {效果名}_{标志位}{哈希}
+static constexpr uint32_t LEGACY_CACHE_FILE_MAGIC = 0x5846504D;
+
+static bool IsLegacyCacheFile(std::wstring_view fileName) noexcept {
+	// 至少有 19 个字符: {Name}_{1}{16}
+	if (fileName.size() < 19 || fileName[fileName.size() - 18] != L'_') {
+		return false;
+	}
 
-	std::wstring cacheFileName = GetCacheFileName(GetLinearEffectName(effectName), hash, desc.flags);
+	for (wchar_t c : fileName.substr(fileName.size() - 17)) {
+		if (!(c >= L'0' && c <= L'9') && !(c >= L'a' && c <= L'f')) {
+			return false;
+		}
+	}
+
+	const std::wstring path = StrUtils::Concat(CommonSharedConstants::CACHE_DIR, fileName);
+	wil::unique_hfile hFile(CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr));
+	uint32_t magic = 0;
+	return hFile && ReadAt(hFile.get(), 0, &magic, sizeof(magic)) && magic == LEGACY_CACHE_FILE_MAGIC;
+}
+
+// 旧缓存的 EffectDesc 布局和字节码都已过时（缓存版本不同），无法迁移到包文件中，只能删除。
+// 在线程池中执行，只访问文件系统
+static void CALLBACK DeleteLegacyCacheFiles(PTP_CALLBACK_INSTANCE, void*) noexcept {
+	WIN32_FIND_DATA findData{};
+	wil::unique_hfind hFind(FindFirstFileEx(
+		StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"*").c_str(),
+		FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
+	if (!hFind) {
+		return;
+	}
+
+	uint32_t deletedCount = 0;
+	do {
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !IsLegacyCacheFile(findData.cFileName)) {
+			continue;
+		}
 
-	if (_LoadFromMemCache(cacheFileName, desc)) {
+		if (DeleteFile(StrUtils::Concat(CommonSharedConstants::CACHE_DIR, findData.cFileName).c_str())) {
+			++deletedCount;
+		} else {
+			Logger::Get().Win32Error(StrUtils::Concat("删除旧缓存文件 ",
+				StrUtils::UTF16ToUTF8(findData.cFileName), " 失败"));
+		}
+	} while (FindNextFile(hFind.get(), &findData));
+
+	if (deletedCount > 0) {
+		Logger::Get().Info(fmt::format("已删除 {} 个旧缓存文件", deletedCount));
+	}
+}
+
+bool EffectCacheManager::_OpenPack() noexcept {
+	if (_hPack) {
 		return true;
 	}
 
-	if (!Win32Utils::FileExists(cacheFileName.c_str())) {
+	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+		Logger::Get().Win32Error("创建 cache 文件夹失败");
 		return false;
 	}
 
-	std::vector<BYTE> buf;
-	if (!Win32Utils::ReadFile(cacheFileName.c_str(), buf) || buf.empty()) {
+	_hPack.reset(CreateFile2(GetPackPath(CACHE_PACK_NAME).c_str(), GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_ALWAYS, nullptr));
+	if (!_hPack) {
+		Logger::Get().Win32Error("打开缓存包失败");
 		return false;
 	}
 
-	try {
-		yas::mem_istream mi(buf.data(), buf.size());
-		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+	_packIndex.clear();
+	_passIndex.clear();
+	_packSize = 0;
+	_deadBytes = 0;
 
-		ia& desc;
-	} catch (...) {
-		Logger::Get().Error("反序列化失败");
-		desc = {};
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(_hPack.get(), &fileSize)) {
+		Logger::Get().Win32Error("GetFileSizeEx 失败");
+		_hPack.reset();
+		return false;
+	}
+
+	CachePackHeader packHeader{};
+	if ((uint64_t)fileSize.QuadPart < sizeof(packHeader) ||
+		!ReadAt(_hPack.get(), 0, &packHeader, sizeof(packHeader)) ||
+		packHeader.magic != CACHE_PACK_MAGIC || packHeader.version != EFFECT_CACHE_VERSION
+	) {
+		// 新建的包文件或版本不匹配，清空重建
+		packHeader = { .magic = CACHE_PACK_MAGIC, .version = EFFECT_CACHE_VERSION };
+		if (!SetEndOfFile(_hPack.get()) || !WriteAt(_hPack.get(), 0, &packHeader, sizeof(packHeader))) {
+			Logger::Get().Win32Error("初始化缓存包失败");
+			_hPack.reset();
+			return false;
+		}
+
+		_packSize = sizeof(packHeader);
+
+		// 包文件是新建的，可能是从每个缓存一个文件的版本升级而来
+		if (!TrySubmitThreadpoolCallback(DeleteLegacyCacheFiles, nullptr, nullptr)) {
+			Logger::Get().Win32Error("TrySubmitThreadpoolCallback 失败");
+		}
+		return true;
+	}
+
+	// 只读取记录头和键以建立索引
+	uint64_t offset = sizeof(packHeader);
+	std::wstring key;
+	while (offset < (uint64_t)fileSize.QuadPart) {
+		CacheRecordHeader recordHeader;
+		if (!ReadAt(_hPack.get(), offset, &recordHeader, sizeof(recordHeader)) ||
+			recordHeader.magic != CACHE_RECORD_MAGIC || recordHeader.keyLength <= CACHE_HASH_LENGTH ||
+			recordHeader.keyLength > MAX_PATH
+		) {
+			break;
+		}
+
+		const uint64_t dataOffset = AlignCacheOffset(
+			offset + sizeof(recordHeader) + recordHeader.keyLength * sizeof(wchar_t));
+		const uint64_t recordEnd = AlignCacheOffset(dataOffset + recordHeader.dataSize);
+		if (recordEnd > (uint64_t)fileSize.QuadPart) {
+			break;
+		}
+
+		key.resize(recordHeader.keyLength);
+		if (!ReadAt(_hPack.get(), offset + sizeof(recordHeader), key.data(),
+			uint32_t(recordHeader.keyLength * sizeof(wchar_t)))) {
+			break;
+		}
+
+		_PackIndexEntry entry{
+			.hash = key.substr(key.size() - CACHE_HASH_LENGTH),
+			.recordOffset = offset,
+			.recordSize = recordEnd - offset,
+			.dataOffset = dataOffset,
+			.dataSize = recordHeader.dataSize
+		};
+		key.resize(key.size() - CACHE_HASH_LENGTH);
+
+		const bool isPass = key.size() == 1 && key[0] == PASS_CACHE_KEY_PREFIX;
+		auto& index = isPass ? _passIndex : _packIndex;
+		auto [it, inserted] = index.try_emplace(isPass ? entry.hash : key);
+		if (!inserted) {
+			_deadBytes += it->second.recordSize;
+		}
+		it->second = std::move(entry);
+
+		offset = recordEnd;
+	}
+
+	_packSize = offset;
+
+	if (offset < (uint64_t)fileSize.QuadPart) {
+		// 上次写入未完成，截断不完整的记录
+		Logger::Get().Warn("缓存包末尾已损坏，将被截断");
+
+		LARGE_INTEGER pos{ .QuadPart = (LONGLONG)offset };
+		if (!SetFilePointerEx(_hPack.get(), pos, nullptr, FILE_BEGIN) || !SetEndOfFile(_hPack.get())) {
+			Logger::Get().Win32Error("截断缓存包失败");
+		}
+	}
+
+	if (_passIndex.size() > MAX_PASS_CACHE_COUNT) {
+		// 淘汰较旧的通道缓存
+		std::vector<uint64_t> offsets;
+		offsets.reserve(_passIndex.size());
+		for (const auto& pair : _passIndex) {
+			offsets.push_back(pair.second.recordOffset);
+		}
+
+		auto minIt = offsets.end() - MAX_PASS_CACHE_COUNT;
+		std::nth_element(offsets.begin(), minIt, offsets.end());
+		const uint64_t minOffset = *minIt;
+
+		for (auto it = _passIndex.begin(); it != _passIndex.end();) {
+			if (it->second.recordOffset < minOffset) {
+				_deadBytes += it->second.recordSize;
+				it = _passIndex.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	uint64_t liveBytes = 0;
+	for (const auto& pair : _packIndex) {
+		liveBytes += pair.second.recordSize;
+	}
+	for (const auto& pair : _passIndex) {
+		liveBytes += pair.second.recordSize;
+	}
+
+	// 每次运行最多压缩一次。包文件被映射后无法替换，而缓存的效果会一直持有映射，因此只在
+	// 第一次打开包文件时提交压缩任务。任务完成前读取记录时复制到内存中，不映射包文件
+	if (!_isCompactionTried && _liveViewCount.load(std::memory_order_acquire) == 0 &&
+		_deadBytes >= CACHE_PACK_COMPACT_THRESHOLD && _deadBytes > liveBytes) {
+		_isCompactionTried = true;
+
+		_compactionWork.reset(CreateThreadpoolWork(_CompactPackCallback, this, nullptr));
+		if (_compactionWork) {
+			_isCompacting = true;
+			SubmitThreadpoolWork(_compactionWork.get());
+		} else {
+			Logger::Get().Win32Error("CreateThreadpoolWork 失败");
+		}
+	}
+
+	return true;
+}
+
+bool EffectCacheManager::_MapPack(uint64_t requiredSize) noexcept {
+	if (_packViewSize >= requiredSize) {
+		return true;
+	}
+
+	// 包文件增长后重新映射整个文件，旧视图由仍在使用它的字节码保持存活
+	wil::unique_handle hMapping(CreateFileMapping(_hPack.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!hMapping) {
+		Logger::Get().Win32Error("CreateFileMapping 失败");
+		return false;
+	}
+
+	// 视图会保持映射对象存活，因此可以关闭句柄
+	const BYTE* view = (const BYTE*)MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		Logger::Get().Win32Error("MapViewOfFile 失败");
+		return false;
+	}
+
+	_liveViewCount.fetch_add(1, std::memory_order_relaxed);
+	_packView = std::shared_ptr<const BYTE>(view, [this](const BYTE* p) {
+		UnmapViewOfFile(p);
+		_liveViewCount.fetch_sub(1, std::memory_order_release);
+	});
+	_packViewSize = _packSize;
+	return requiredSize <= _packViewSize;
+}
+
+bool EffectCacheManager::_ReadRecordData(const _PackIndexEntry& entry, std::shared_ptr<const BYTE>& view) noexcept {
+	if (!_isCompacting) {
+		if (!_MapPack(entry.dataOffset + entry.dataSize)) {
+			return false;
+		}
+
+		// 共享映射视图的所有权
+		view = std::shared_ptr<const BYTE>(_packView, _packView.get() + entry.dataOffset);
+		return true;
+	}
+
+	// new 返回的内存满足 CACHE_ALIGNMENT 的对齐要求
+	std::shared_ptr<BYTE[]> buf(new (std::nothrow) BYTE[entry.dataSize]);
+	if (!buf) {
+		Logger::Get().Error("分配内存失败");
+		return false;
+	}
+
+	if (!ReadAt(_hPack.get(), entry.dataOffset, buf.get(), entry.dataSize)) {
+		Logger::Get().Win32Error("读取缓存包失败");
+		return false;
+	}
+
+	view = std::shared_ptr<const BYTE>(buf, buf.get());
+	return true;
+}
+
+void CALLBACK EffectCacheManager::_CompactPackCallback(PTP_CALLBACK_INSTANCE, void* context, PTP_WORK) noexcept {
+	((EffectCacheManager*)context)->_CompactPack();
+}
+
+// 从 offset 开始复制 size 字节，分块进行以限制内存占用
+static bool CopyPackRange(HANDLE hSrc, uint64_t srcOffset, HANDLE hDest, uint64_t destOffset, uint64_t size) noexcept {
+	static constexpr uint64_t CHUNK_SIZE = 1024 * 1024;
+
+	std::vector<BYTE> buf((size_t)std::min(size, CHUNK_SIZE));
+	for (uint64_t copied = 0; copied < size;) {
+		const uint32_t chunkSize = (uint32_t)std::min(size - copied, CHUNK_SIZE);
+		if (!ReadAt(hSrc, srcOffset + copied, buf.data(), chunkSize) ||
+			!WriteAt(hDest, destOffset + copied, buf.data(), chunkSize)) {
+			return false;
+		}
+		copied += chunkSize;
+	}
+
+	return true;
+}
+
+void EffectCacheManager::_CompactPack() noexcept {
+	const std::wstring packPath = GetPackPath(CACHE_PACK_NAME);
+	const std::wstring tempPath = GetPackPath(CACHE_PACK_TEMP_NAME);
+
+	// 记录写入后不再改变，新记录只会追加到末尾，因此复制快照中的记录时无需持有锁
+	uint64_t snapshotSize = 0;
+	phmap::flat_hash_map<std::wstring, _PackIndexEntry> newIndex;
+	phmap::flat_hash_map<std::wstring, _PackIndexEntry> newPassIndex;
+	{
+		auto lock = _packLock.lock_exclusive();
+		snapshotSize = _packSize;
+		newIndex = _packIndex;
+		newPassIndex = _passIndex;
+	}
+
+	wil::unique_hfile hTemp(CreateFile2(tempPath.c_str(), GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr));
+	// _hPack 可以被其他线程使用，因此单独打开一个句柄用于读取
+	wil::unique_hfile hSrc(CreateFile2(packPath.c_str(), GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, OPEN_EXISTING, nullptr));
+
+	const CachePackHeader packHeader{ .magic = CACHE_PACK_MAGIC, .version = EFFECT_CACHE_VERSION };
+	bool success = hTemp && hSrc && WriteAt(hTemp.get(), 0, &packHeader, sizeof(packHeader));
+	uint64_t newSize = sizeof(packHeader);
+
+	// 快照中记录的原偏移 -> 新偏移
+	phmap::flat_hash_map<uint64_t, uint64_t> offsetMap;
+	auto copyRecords = [&](const phmap::flat_hash_map<std::wstring, _PackIndexEntry>& index) {
+		for (auto& [key, entry] : index) {
+			if (!success) {
+				break;
+			}
+
+			success = CopyPackRange(hSrc.get(), entry.recordOffset, hTemp.get(), newSize, entry.recordSize);
+			offsetMap[entry.recordOffset] = newSize;
+			newSize += entry.recordSize;
+		}
+	};
+	copyRecords(newIndex);
+	copyRecords(newPassIndex);
+
+	auto lock = _packLock.lock_exclusive();
+	_isCompacting = false;
+
+	// 压缩期间读取记录不会映射包文件，这里只是以防万一
+	if (!success || !_hPack || _liveViewCount.load(std::memory_order_acquire) != 0) {
+		if (!success) {
+			Logger::Get().Win32Error("写入临时缓存包失败");
+		}
+		hTemp.reset();
+		DeleteFile(tempPath.c_str());
+		return;
+	}
+
+	// 复制期间追加的记录原样复制到末尾，其中可能有被取代的记录，下次压缩时清除
+	const uint64_t tailOffset = newSize;
+	if (_packSize > snapshotSize) {
+		if (!CopyPackRange(_hPack.get(), snapshotSize, hTemp.get(), tailOffset, _packSize - snapshotSize)) {
+			Logger::Get().Win32Error("写入临时缓存包失败");
+			hTemp.reset();
+			DeleteFile(tempPath.c_str());
+			return;
+		}
+		newSize += _packSize - snapshotSize;
+	}
+
+	hTemp.reset();
+	hSrc.reset();
+
+	// 以当前的索引为准，复制期间新增或取代其他记录的记录都在末尾
+	auto remapIndex = [&](const phmap::flat_hash_map<std::wstring, _PackIndexEntry>& index) {
+		phmap::flat_hash_map<std::wstring, _PackIndexEntry> result;
+		for (const auto& [key, entry] : index) {
+			const uint64_t newOffset = entry.recordOffset >= snapshotSize
+				? entry.recordOffset - snapshotSize + tailOffset
+				: offsetMap[entry.recordOffset];
+
+			_PackIndexEntry& newEntry = result[key];
+			newEntry = entry;
+			newEntry.recordOffset = newOffset;
+			newEntry.dataOffset = entry.dataOffset - entry.recordOffset + newOffset;
+		}
+		return result;
+	};
+	newIndex = remapIndex(_packIndex);
+	newPassIndex = remapIndex(_passIndex);
+
+	// 没有视图映射包文件，关闭句柄后即可替换
+	_hPack.reset();
+	_packView.reset();
+	_packViewSize = 0;
+
+	const bool replaced = MoveFileEx(tempPath.c_str(), packPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+	if (!replaced) {
+		// 继续使用原包文件，索引仍然有效
+		Logger::Get().Win32Error("替换缓存包失败");
+		DeleteFile(tempPath.c_str());
+	}
+
+	_hPack.reset(CreateFile2(packPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_DELETE, OPEN_EXISTING, nullptr));
+	if (!_hPack) {
+		// 下次访问时重新打开并建立索引
+		Logger::Get().Win32Error("重新打开缓存包失败");
+		return;
+	}
+
+	if (replaced) {
+		_packIndex = std::move(newIndex);
+		_passIndex = std::move(newPassIndex);
+		_packSize = newSize;
+
+		// 只有末尾可能有被取代的记录
+		uint64_t liveBytes = 0;
+		for (const auto& pair : _packIndex) {
+			liveBytes += pair.second.recordSize;
+		}
+		for (const auto& pair : _passIndex) {
+			liveBytes += pair.second.recordSize;
+		}
+		_deadBytes = _packSize - sizeof(CachePackHeader) - liveBytes;
+		Logger::Get().Info("已压缩缓存包");
+	}
+}
+
+bool EffectCacheManager::_AppendRecord(
+	_PackIndexEntry& entry,
+	std::wstring_view key,
+	std::span<const BYTE> data
+) noexcept {
+	const CacheRecordHeader recordHeader{
+		.magic = CACHE_RECORD_MAGIC,
+		.keyLength = (uint32_t)key.size(),
+		.dataSize = (uint32_t)data.size()
+	};
+	const size_t dataOffset = (size_t)AlignCacheOffset(sizeof(recordHeader) + key.size() * sizeof(wchar_t));
+	std::vector<BYTE> record((size_t)AlignCacheOffset(dataOffset + data.size()));
+	std::memcpy(record.data(), &recordHeader, sizeof(recordHeader));
+	std::memcpy(record.data() + sizeof(recordHeader), key.data(), key.size() * sizeof(wchar_t));
+	std::memcpy(record.data() + dataOffset, data.data(), data.size());
+
+	if (!WriteAt(_hPack.get(), _packSize, record.data(), (uint32_t)record.size())) {
 		return false;
 	}
 
-	_AddToMemCache(cacheFileName, desc);
+	if (entry.recordSize != 0) {
+		_deadBytes += entry.recordSize;
+	}
+	entry = {
+		.hash = std::wstring(key.substr(key.size() - CACHE_HASH_LENGTH)),
+		.recordOffset = _packSize,
+		.recordSize = record.size(),
+		.dataOffset = _packSize + dataOffset,
+		.dataSize = (uint32_t)data.size()
+	};
+	_packSize += record.size();
+
+	return true;
+}
+
+bool EffectCacheManager::Load(std::wstring_view effectName, std::wstring_view hash, EffectDesc& desc) {
+	assert(!effectName.empty() && hash.size() == CACHE_HASH_LENGTH);
+
+	std::wstring cacheName = GetCacheName(GetLinearEffectName(effectName), hash, desc.flags);
+
+	if (_LoadFromMemCache(cacheName, desc)) {
+		return true;
+	}
+
+	{
+		auto lock = _packLock.lock_exclusive();
+
+		if (!_OpenPack()) {
+			return false;
+		}
+
+		auto it = _packIndex.find(cacheName.substr(0, cacheName.size() - CACHE_HASH_LENGTH));
+		if (it == _packIndex.end() || it->second.hash != hash) {
+			return false;
+		}
 
-	Logger::Get().Info(StrUtils::Concat("已读取缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+		const _PackIndexEntry& entry = it->second;
+		std::shared_ptr<const BYTE> view;
+		if (!_ReadRecordData(entry, view)) {
+			return false;
+		}
+
+		if (!DeserializeCacheData(view, view.get(), entry.dataSize, desc)) {
+			return false;
+		}
+	}
+
+	_AddToMemCache(cacheName, desc);
+
+	Logger::Get().Info("已读取缓存", {
+		{ "cache", StrUtils::UTF16ToUTF8(cacheName) },
+		{ "source", "pack" }
+	});
 	return true;
 }
 
 void EffectCacheManager::Save(std::wstring_view effectName, std::wstring_view hash, const EffectDesc& desc) {
-	std::wstring linearEffectName = GetLinearEffectName(effectName);
+	assert(!effectName.empty() && hash.size() == CACHE_HASH_LENGTH);
 
-	std::vector<BYTE> buf;
-	buf.reserve(4096);
-	
-	try {
-		yas::vector_ostream os(buf);
-		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+	std::wstring cacheName = GetCacheName(GetLinearEffectName(effectName), hash, desc.flags);
 
-		oa& desc;
-	} catch (...) {
-		Logger::Get().Error("序列化 EffectDesc 失败");
+	std::vector<BYTE> data;
+	if (!SerializeCacheData(desc, data)) {
 		return;
 	}
 
-	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr)) {
-		if (GetLastError() != ERROR_ALREADY_EXISTS) {
-			Logger::Get().Win32Error("创建 cache 文件夹失败");
+	{
+		auto lock = _packLock.lock_exclusive();
+
+		if (!_OpenPack()) {
+			Logger::Get().Error("保存缓存失败");
 			return;
 		}
 
-		// 删除所有该效果（flags 相同）的缓存
-		std::wregex regex(fmt::format(L"^{}_{:01x}[0-9,a-f]{{16}}$", linearEffectName, desc.flags & 0xf),
-			std::wregex::optimize | std::wregex::nosubs);
-
-		WIN32_FIND_DATA findData{};
-		wil::unique_hfind hFind(FindFirstFileEx(
-			StrUtils::Concat(CommonSharedConstants::CACHE_DIR, L"*").c_str(),
-			FindExInfoBasic, &findData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
-		if (hFind) {
-			do {
-				// 缓存文件名至少有 19 个字符
-				// {Name}_{1}{16}
-				if (StrUtils::StrLen(findData.cFileName) < 19) {
-					continue;
-				}
-
-				// 正则匹配文件名
-				if (!std::regex_match(findData.cFileName, regex)) {
-					continue;
-				}
-
-				if (!DeleteFile(StrUtils::Concat(CommonSharedConstants::CACHE_DIR, findData.cFileName).c_str())) {
-					Logger::Get().Win32Error(StrUtils::Concat("删除缓存文件 ",
-						StrUtils::UTF16ToUTF8(findData.cFileName), " 失败"));
-				}
-			} while (FindNextFile(hFind.get(), &findData));
-		} else {
-			Logger::Get().Win32Error("查找缓存文件失败");
+		if (!_AppendRecord(_packIndex[cacheName.substr(0, cacheName.size() - CACHE_HASH_LENGTH)], cacheName, data)) {
+			Logger::Get().Win32Error("保存缓存失败");
+			return;
 		}
 	}
 
-	std::wstring cacheFileName = GetCacheFileName(linearEffectName, hash, desc.flags);
-	if (!Win32Utils::WriteFile(cacheFileName.c_str(), buf.data(), buf.size())) {
-		Logger::Get().Error("保存缓存失败");
+	_AddToMemCache(cacheName, desc);
+
+	Logger::Get().Info("已保存缓存", {
+		{ "cache", StrUtils::UTF16ToUTF8(cacheName) },
+		{ "size", data.size() }
+	});
+}
+
+bool EffectCacheManager::LoadPass(std::wstring_view passHash, winrt::com_ptr<ID3DBlob>& cso) {
+	assert(passHash.size() == CACHE_HASH_LENGTH);
+
+	auto lock = _packLock.lock_exclusive();
+
+	if (!_OpenPack()) {
+		return false;
 	}
 
-	_AddToMemCache(cacheFileName, desc);
+	auto it = _passIndex.find(std::wstring(passHash));
+	if (it == _passIndex.end()) {
+		return false;
+	}
 
-	Logger::Get().Info(StrUtils::Concat("已保存缓存 ", StrUtils::UTF16ToUTF8(cacheFileName)));
+	const _PackIndexEntry& entry = it->second;
+	std::shared_ptr<const BYTE> view;
+	if (entry.dataSize == 0 || !_ReadRecordData(entry, view)) {
+		return false;
+	}
+
+	cso.attach(new MappedBlob(view, view.get(), entry.dataSize));
+	return true;
+}
+
+void EffectCacheManager::SavePass(std::wstring_view passHash, ID3DBlob* cso) {
+	assert(passHash.size() == CACHE_HASH_LENGTH && cso);
+
+	std::wstring key = StrUtils::Concat(std::wstring_view(&PASS_CACHE_KEY_PREFIX, 1), passHash);
+
+	auto lock = _packLock.lock_exclusive();
+
+	if (!_OpenPack()) {
+		return;
+	}
+
+	if (!_AppendRecord(_passIndex[std::wstring(passHash)], key,
+		std::span((const BYTE*)cso->GetBufferPointer(), cso->GetBufferSize()))) {
+		Logger::Get().Win32Error("保存通道缓存失败");
+	}
 }
 
 static std::wstring HexHash(std::span<const BYTE> data) {
@@ -274,10 +907,14 @@ std::wstring EffectCacheManager::GetHash(
 	return HexHash(std::span((const BYTE*)source.data(), source.size()));
 }
 
-std::wstring EffectCacheManager::GetHash(std::string& source, const phmap::flat_hash_map<std::wstring, float>* inlineParams) {
+std::wstring EffectCacheManager::GetHash(
+	std::string& source,
+	const phmap::flat_hash_map<std::wstring, float>* inlineParams,
+	std::string_view includes
+) {
 	size_t originSize = source.size();
 
-	source.reserve(originSize + 256);
+	source.reserve(originSize + includes.size() + 256);
 
 	source.append(fmt::format("VERSION:{}\n", EFFECT_CACHE_VERSION));
 	if (inlineParams) {
@@ -285,12 +922,35 @@ std::wstring EffectCacheManager::GetHash(std::string& source, const phmap::flat_
 			source.append(fmt::format("{}:{}\n", StrUtils::UTF16ToUTF8(pair.first), std::lroundf(pair.second * 10000)));
 		}
 	}
+	source.append(includes);
 
 	std::wstring result = HexHash(std::span((const BYTE*)source.data(), source.size()));
 	source.resize(originSize);
 	return result;
 }
 
-}
+std::wstring EffectCacheManager::GetPassHash(
+	std::string& source,
+	std::string_view includes,
+	const std::vector<std::pair<std::string, std::string>>& macros,
+	uint32_t compileFlags
+) {
+	size_t originSize = source.size();
+	source.reserve(originSize + includes.size() + 256);
+
+	source.append(fmt::format("VERSION:{}\nFLAGS:{}\n", EFFECT_CACHE_VERSION, compileFlags));
+#ifdef _DEBUG
+	// 调试版本的编译选项不同
+	source.append("DEBUG\n");
+#endif
+	for (const auto& [name, value] : macros) {
+		source.append(fmt::format("{}={}\n", name, value));
+	}
+	source.append(includes);
 
+	std::wstring result = HexHash(std::span((const BYTE*)source.data(), source.size()));
+	source.resize(originSize);
+	return result;
+}
 
+}
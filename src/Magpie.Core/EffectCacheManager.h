@@ -19,28 +19,85 @@ public:
 
 	void Save(std::wstring_view effectName, std::wstring_view hash, const EffectDesc& desc);
 
+	// 通道级缓存，以生成的通道源码为键，修改效果的一个通道时其他通道无需重新编译
+	bool LoadPass(std::wstring_view passHash, winrt::com_ptr<ID3DBlob>& cso);
+
+	void SavePass(std::wstring_view passHash, ID3DBlob* cso);
+
 	// inlineParams 为内联变量，可以为空
-	// 接受 std::string& 的重载速度更快，且保证不修改 source
+	// 接受 std::string& 的重载速度更快，且保证不修改 source。includes 为 source 包含的文件的内容
 	static std::wstring GetHash(
 		std::string_view source,
 		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr
 	);
 	static std::wstring GetHash(
 		std::string& source,
-		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr
+		const phmap::flat_hash_map<std::wstring, float>* inlineParams = nullptr,
+		std::string_view includes = {}
+	);
+
+	// source 为 GeneratePassSource 生成的源码，保证不修改 source。includes 为 source 直接或间接
+	// 包含的所有文件的内容，包含的文件修改后缓存失效
+	static std::wstring GetPassHash(
+		std::string& source,
+		std::string_view includes,
+		const std::vector<std::pair<std::string, std::string>>& macros,
+		uint32_t compileFlags
 	);
 
 private:
 	EffectCacheManager() = default;
 
-	void _AddToMemCache(const std::wstring& cacheFileName, const EffectDesc& desc);
-	bool _LoadFromMemCache(const std::wstring& cacheFileName, EffectDesc& desc);
+	struct _PackIndexEntry {
+		std::wstring hash;
+		uint64_t recordOffset = 0;
+		uint64_t recordSize = 0;
+		uint64_t dataOffset = 0;
+		uint32_t dataSize = 0;
+	};
+
+	void _AddToMemCache(const std::wstring& cacheName, const EffectDesc& desc);
+	bool _LoadFromMemCache(const std::wstring& cacheName, EffectDesc& desc);
+
+	// 以下函数需持有 _packLock
+	bool _OpenPack() noexcept;
+	bool _MapPack(uint64_t requiredSize) noexcept;
+	// 取得记录的数据，view 持有数据的所有权。压缩包文件期间不能映射，改为复制到内存中
+	bool _ReadRecordData(const _PackIndexEntry& entry, std::shared_ptr<const BYTE>& view) noexcept;
+	// 将记录追加到包文件末尾并更新 entry
+	bool _AppendRecord(_PackIndexEntry& entry, std::wstring_view key, std::span<const BYTE> data) noexcept;
+
+	// 在线程池中执行，重写包文件以删除被取代的记录。复制记录时不持有 _packLock，有视图映射
+	// 包文件时放弃替换。失败时 _hPack 可能为空
+	void _CompactPack() noexcept;
+	static void CALLBACK _CompactPackCallback(PTP_CALLBACK_INSTANCE, void* context, PTP_WORK) noexcept;
 
 	// 用于同步对 _memCache 的访问
 	wil::srwlock _lock;
-	// cacheFileName -> (EffectDesc, lastAccess)
+	// cacheName -> (EffectDesc, lastAccess)
 	phmap::flat_hash_map<std::wstring, std::pair<EffectDesc, UINT>> _memCache;
 	UINT _lastAccess = 0;
+
+	// 用于同步对包文件和索引的访问
+	wil::srwlock _packLock;
+	wil::unique_hfile _hPack;
+	uint64_t _packSize = 0;
+	// 整个包文件的只读映射，追加记录后按需重新映射
+	std::shared_ptr<const BYTE> _packView;
+	uint64_t _packViewSize = 0;
+	// {效果名}_{标志位} -> 最新的记录
+	phmap::flat_hash_map<std::wstring, _PackIndexEntry> _packIndex;
+	// 通道哈希 -> 记录
+	phmap::flat_hash_map<std::wstring, _PackIndexEntry> _passIndex;
+	// 被取代的记录的总大小
+	uint64_t _deadBytes = 0;
+	// 仍然存在的视图数，包括已被重新映射取代但仍被字节码使用的视图
+	std::atomic<uint32_t> _liveViewCount = 0;
+	bool _isCompactionTried = false;
+	// 压缩任务已提交但未完成
+	bool _isCompacting = false;
+	// 最后声明，析构时先等待压缩任务完成
+	wil::unique_threadpool_work _compactionWork;
 };
 
 }
@@ -12,17 +12,19 @@
 #include "EffectHelper.h"
 #include "Win32Utils.h"
 #include "EffectDesc.h"
+#include "CompileScheduler.h"
+#include "EffectParser.h"
+#include "EffectLexer.h"
 
 namespace Magpie::Core {
 
-// 当前 MagpieFX 版本
-static constexpr uint32_t MAGPIE_FX_VERSION = 4;
-
-static const char* META_INDICATOR = "//!";
+using namespace EffectLexer;
 
 class PassInclude : public ID3DInclude {
 public:
-	PassInclude(std::wstring_view localDir) : _localDir(localDir) {}
+	// includes 不为空时记录打开的所有文件的名字和内容
+	PassInclude(std::wstring_view localDir, std::string* includes = nullptr)
+		: _localDir(localDir), _includes(includes) {}
 
 	PassInclude(const PassInclude&) = default;
 	PassInclude(PassInclude&&) = default;
@@ -41,6 +43,11 @@ public:
 			return E_FAIL;
 		}
 
+		if (_includes) {
+			_includes->append(fmt::format("INCLUDE:{}:{}\n", pFileName, file.size()));
+			_includes->append(file);
+		}
+
 		char* result = new char[file.size()];
 		std::memcpy(result, file.data(), file.size());
 
@@ -57,447 +64,51 @@ public:
 
 private:
 	std::wstring _localDir;
+	std::string* _includes = nullptr;
 };
 
-static uint32_t RemoveComments(std::string& source) {
-	// 确保以换行符结尾
-	if (source.back() != '\n') {
-		source.push_back('\n');
-	}
-
-	std::string result;
-	result.reserve(source.size());
-
-	int j = 0;
-	// 单独处理最后两个字符
-	for (size_t i = 0, end = source.size() - 2; i < end; ++i) {
-		if (source[i] == '/') {
-			if (source[i + 1] == '/' && source[i + 2] != '!') {
-				// 行注释
-				i += 2;
-
-				// 无需处理越界，因为必定以换行符结尾
-				while (source[i] != '\n') {
-					++i;
-				}
-
-				// 保留换行符
-				source[j++] = '\n';
-
-				continue;
-			} else if (source[i + 1] == '*') {
-				// 块注释
-				i += 2;
-
-				while (true) {
-					if (++i >= source.size()) {
-						// 未闭合
-						return 1;
-					}
-
-					if (source[i - 1] == '*' && source[i] == '/') {
-						break;
-					}
-				}
-
-				// 文件结尾
-				if (i >= source.size() - 2) {
-					source.resize(j);
-					return 0;
-				}
-
-				continue;
-			}
-		}
-
-		source[j++] = source[i];
-	}
-
-	// 无需复制最后的换行符
-	source[j++] = source[source.size() - 2];
-	source.resize(j);
-	return 0;
-}
-
-template<bool IncludeNewLine>
-static void RemoveLeadingBlanks(std::string_view& source) {
-	size_t i = 0;
-	for (; i < source.size(); ++i) {
-		if constexpr (IncludeNewLine) {
-			if (!StrUtils::isspace(source[i])) {
-				break;
-			}
-		} else {
-			char c = source[i];
-			if (c != ' ' && c != '\t') {
-				break;
-			}
-		}
-	}
-
-	source.remove_prefix(i);
-}
-
-template<bool AllowNewLine>
-static bool CheckNextToken(std::string_view& source, std::string_view token) {
-	RemoveLeadingBlanks<AllowNewLine>(source);
-
-	if (!source.starts_with(token)) {
-		return false;
-	}
-
-	source.remove_prefix(token.size());
-	return true;
+static std::wstring GetIncludeDir(std::string_view effectName) noexcept {
+	size_t delimPos = effectName.find_last_of('\\');
+	return delimPos == std::string::npos
+		? L"effects\\"
+		: L"effects\\" + StrUtils::UTF8ToUTF16(effectName.substr(0, delimPos + 1));
 }
 
-template<bool AllowNewLine>
-static uint32_t GetNextToken(std::string_view& source, std::string_view& value) {
-	RemoveLeadingBlanks<AllowNewLine>(source);
-
-	if (source.empty()) {
-		return 2;
-	}
-
-	char cur = source[0];
-
-	if (StrUtils::isalpha(cur) || cur == '_') {
-		size_t j = 1;
-		for (; j < source.size(); ++j) {
-			cur = source[j];
-
-			if (!StrUtils::isalnum(cur) && cur != '_') {
-				break;
-			}
-		}
-
-		value = source.substr(0, j);
-		source.remove_prefix(j);
-		return 0;
+// 预处理 source 以得到它直接或间接包含的所有文件的内容，用于缓存键。没有 #include 时无需预处理
+static bool CollectIncludes(
+	std::string_view source,
+	std::wstring_view includeDir,
+	const char* sourceName,
+	const std::vector<std::pair<std::string, std::string>>& macros,
+	std::string& includes
+) noexcept {
+	if (source.find("#include") == std::string_view::npos) {
+		return true;
 	}
 
-	if constexpr (AllowNewLine) {
-		return 1;
-	} else {
-		return cur == '\n' ? 2 : 1;
-	}
+	PassInclude recordingInclude(includeDir, &includes);
+	winrt::com_ptr<ID3DBlob> preprocessed;
+	return DirectXHelper::PreprocessShader(source, sourceName, &recordingInclude, macros, preprocessed.put());
 }
 
-static bool CheckMagic(std::string_view& source) {
-	std::string_view token;
-	if (!CheckNextToken<true>(source, META_INDICATOR)) {
-		return false;
-	}
-
-	if (!CheckNextToken<false>(source, "MAGPIE")) {
-		return false;
-	}
-	if (!CheckNextToken<false>(source, "EFFECT")) {
-		return false;
-	}
-
-	if (GetNextToken<false>(source, token) != 2) {
+static bool CompileSizeExpr(
+	const std::pair<std::string, std::string>& sizeExpr,
+	bool allowOutputSize,
+	std::pair<EffectSizeBytecode, EffectSizeBytecode>& bytecode
+) noexcept {
+	if (!EffectSizeExpr::Compile(sizeExpr.first, allowOutputSize, bytecode.first)) {
+		Logger::Get().Error(fmt::format("非法的尺寸表达式: {}", sizeExpr.first));
 		return false;
 	}
 
-	if (source.empty()) {
+	if (!EffectSizeExpr::Compile(sizeExpr.second, allowOutputSize, bytecode.second)) {
+		Logger::Get().Error(fmt::format("非法的尺寸表达式: {}", sizeExpr.second));
 		return false;
 	}
 
 	return true;
 }
 
-static uint32_t GetNextString(std::string_view& source, std::string_view& value) {
-	RemoveLeadingBlanks<false>(source);
-	size_t pos = source.find('\n');
-
-	value = source.substr(0, pos);
-	StrUtils::Trim(value);
-	if (value.empty()) {
-		return 1;
-	}
-
-	source.remove_prefix(std::min(pos + 1, source.size()));
-	return 0;
-}
-
-template<typename T>
-static uint32_t GetNextNumber(std::string_view& source, T& value) {
-	RemoveLeadingBlanks<false>(source);
-
-	if (source.empty()) {
-		return 1;
-	}
-
-	const auto& result = std::from_chars(source.data(), source.data() + source.size(), value);
-	if ((int)result.ec) {
-		return 1;
-	}
-
-	// 解析成功
-	source.remove_prefix(result.ptr - source.data());
-	return 0;
-}
-
-static uint32_t GetNextExpr(std::string_view& source, std::string& expr) {
-	RemoveLeadingBlanks<false>(source);
-	size_t size = std::min(source.find('\n') + 1, source.size());
-
-	// 移除空白字符
-	expr.resize(size);
-
-	size_t j = 0;
-	for (size_t i = 0; i < size; ++i) {
-		char c = source[i];
-		if (!isspace(c)) {
-			expr[j++] = c;
-		}
-	}
-	expr.resize(j);
-
-	if (expr.empty()) {
-		return 1;
-	}
-
-	source.remove_prefix(size);
-	return 0;
-}
-
-static uint32_t ResolveHeader(std::string_view block, EffectDesc& desc, bool noCompile) {
-	// 必需的选项: VERSION
-	// 可选的选项: USE_DYNAMIC, SORT_NAME
-
-	std::bitset<3> processed;
-
-	std::string_view token;
-
-	while (true) {
-		if (!CheckNextToken<true>(block, META_INDICATOR)) {
-			break;
-		}
-
-		if (GetNextToken<false>(block, token)) {
-			return 1;
-		}
-		std::string t = StrUtils::ToUpperCase(token);
-
-		if (t == "VERSION") {
-			if (processed[0]) {
-				return 1;
-			}
-			processed[0] = true;
-
-			uint32_t version;
-			if (GetNextNumber(block, version)) {
-				return 1;
-			}
-
-			if (version != MAGPIE_FX_VERSION) {
-				return 1;
-			}
-
-			if (GetNextToken<false>(block, token) != 2) {
-				return 1;
-			}
-		} else if (t == "USE_DYNAMIC") {
-			if (processed[1]) {
-				return 1;
-			}
-			processed[1] = true;
-
-			if (GetNextToken<false>(block, token) != 2) {
-				return 1;
-			}
-
-			desc.flags |= EffectFlags::UseDynamic;
-		} else if (t == "SORT_NAME") {
-			if (processed[2]) {
-				return 1;
-			}
-			processed[2] = true;
-
-			std::string_view sortName;
-			if (GetNextString(block, sortName)) {
-				return 1;
-			}
-
-			if (noCompile) {
-				desc.sortName = sortName;
-			}
-		} else {
-			return 1;
-		}
-	}
-
-	// HEADER 块不含代码部分
-	if (GetNextToken<true>(block, token) != 2) {
-		return 1;
-	}
-
-	if (!processed[0]) {
-		return 1;
-	}
-
-	return 0;
-}
-
-static uint32_t ResolveParameter(std::string_view block, EffectDesc& desc) {
-	// 必需的选项: DEFAULT, MIN, MAX, STEP
-	// 可选的选项: LABEL
-
-	std::bitset<5> processed;
-
-	std::string_view token;
-
-	if (!CheckNextToken<true>(block, META_INDICATOR)) {
-		return 1;
-	}
-
-	if (!CheckNextToken<false>(block, "PARAMETER")) {
-		return 1;
-	}
-	if (GetNextToken<false>(block, token) != 2) {
-		return 1;
-	}
-
-	EffectParameterDesc& paramDesc = desc.params.emplace_back();
-
-	std::string_view defaultValue;
-	std::string_view minValue;
-	std::string_view maxValue;
-	std::string_view stepValue;
-
-	while (true) {
-		if (!CheckNextToken<true>(block, META_INDICATOR)) {
-			break;
-		}
-
-		if (GetNextToken<false>(block, token)) {
-			return 1;
-		}
-
-		std::string t = StrUtils::ToUpperCase(token);
-
-		if (t == "DEFAULT") {
-			if (processed[0]) {
-				return 1;
-			}
-			processed[0] = true;
-
-			if (GetNextString(block, defaultValue)) {
-				return 1;
-			}
-		} else if (t == "LABEL") {
-			if (processed[1]) {
-				return 1;
-			}
-			processed[1] = true;
-
-			std::string_view label;
-			if (GetNextString(block, label)) {
-				return 1;
-			}
-			paramDesc.label = label;
-		} else if (t == "MIN") {
-			if (processed[2]) {
-				return 1;
-			}
-			processed[2] = true;
-
-			if (GetNextString(block, minValue)) {
-				return 1;
-			}
-		} else if (t == "MAX") {
-			if (processed[3]) {
-				return 1;
-			}
-			processed[3] = true;
-
-			if (GetNextString(block, maxValue)) {
-				return 1;
-			}
-		} else if (t == "STEP") {
-			if (processed[4]) {
-				return 1;
-			}
-			processed[4] = true;
-
-			if (GetNextString(block, stepValue)) {
-				return 1;
-			}
-		} else {
-			return 1;
-		}
-	}
-
-	// 检查必选项
-	if (!processed[0] || !processed[2] || !processed[3] || !processed[4]) {
-		return 1;
-	}
-
-	// 代码部分
-	if (GetNextToken<true>(block, token)) {
-		return 1;
-	}
-
-	if (token == "float") {
-		EffectConstant<float>& constant = paramDesc.constant.emplace<0>();
-
-		if (GetNextNumber(defaultValue, constant.defaultValue)) {
-			return 1;
-		}
-		if (GetNextNumber(minValue, constant.minValue)) {
-			return 1;
-		}
-		if (GetNextNumber(maxValue, constant.maxValue)) {
-			return 1;
-		}
-		if (GetNextNumber(stepValue, constant.step)) {
-			return 1;
-		}
-
-		if (constant.defaultValue < constant.minValue || constant.maxValue < constant.defaultValue) {
-			return 1;
-		}
-	} else if (token == "int") {
-		EffectConstant<int>& constant = paramDesc.constant.emplace<1>();
-
-		if (GetNextNumber(defaultValue, constant.defaultValue)) {
-			return 1;
-		}
-		if (GetNextNumber(minValue, constant.minValue)) {
-			return 1;
-		}
-		if (GetNextNumber(maxValue, constant.maxValue)) {
-			return 1;
-		}
-		if (GetNextNumber(stepValue, constant.step)) {
-			return 1;
-		}
-
-		if (constant.defaultValue < constant.minValue || constant.maxValue < constant.defaultValue) {
-			return 1;
-		}
-	} else {
-		return 1;
-	}
-
-	if (GetNextToken<true>(block, token)) {
-		return 1;
-	}
-	paramDesc.name = token;
-
-	if (!CheckNextToken<true>(block, ";")) {
-		return 1;
-	}
-
-	if (GetNextToken<true>(block, token) != 2) {
-		return 1;
-	}
-
-	return 0;
-}
-
-
 static uint32_t ResolveTexture(std::string_view block, EffectDesc& desc) {
 	// 如果名称为 INPUT 不能有任何选项，含 SOURCE 时不能有任何其他选项
 	// 如果名称为 OUTPUT 只能有 WIDTH 或 HEIGHT
@@ -622,11 +233,18 @@ static uint32_t ResolveTexture(std::string_view block, EffectDesc& desc) {
 			return 1;
 		}
 
-		// OUTPUT 已为第二个元素
+		// OUTPUT 已为第二个元素。OUTPUT 的尺寸不能依赖自身
+		if (processed[2] && !CompileSizeExpr(texDesc.sizeExpr, false, desc.textures[1].sizeBytecode)) {
+			return 1;
+		}
 		desc.textures[1].sizeExpr = std::move(texDesc.sizeExpr);
 		desc.textures.pop_back();
 	} else {
 		texDesc.name = token;
+
+		if (processed[2] && !CompileSizeExpr(texDesc.sizeExpr, true, texDesc.sizeBytecode)) {
+			return 1;
+		}
 	}
 
 	if (!CheckNextToken<true>(block, ";")) {
@@ -764,7 +382,7 @@ static uint32_t ResolvePasses(
 	EffectDesc& desc
 ) {
 	// 必选项: IN, OUT
-	// 可选项: BLOCK_SIZE, NUM_THREADS, STYLE
+	// 可选项: BLOCK_SIZE, NUM_THREADS, STYLE, DESC, DIRTY_RADIUS
 	// STYLE 为 PS 时不能有 BLOCK_SIZE 或 NUM_THREADS
 
 	std::string_view token;
@@ -829,7 +447,7 @@ static uint32_t ResolvePasses(
 			texNames.emplace(desc.textures[j].name, j);
 		}
 
-		std::bitset<6> processed;
+		std::bitset<7> processed;
 
 		while (true) {
 			if (!CheckNextToken<true>(block, META_INDICATOR)) {
@@ -1009,6 +627,22 @@ static uint32_t ResolvePasses(
 
 				StrUtils::Trim(val);
 				passDesc.desc = val;
+			} else if (t == "DIRTY_RADIUS") {
+				if (processed[6]) {
+					return 1;
+				}
+				processed[6] = true;
+
+				uint32_t radius;
+				if (GetNextNumber(block, radius)) {
+					return 1;
+				}
+
+				if (GetNextToken<false>(block, token) != 2) {
+					return 1;
+				}
+
+				passDesc.dirtyRadius = (int32_t)radius;
 			} else {
 				return 1;
 			}
@@ -1034,6 +668,12 @@ static uint32_t ResolvePasses(
 		}
 	}
 
+	// 使用帧数的效果每帧的输出都可能变化
+	if (!(desc.flags & EffectFlags::UseDynamic) && std::all_of(desc.passes.begin(), desc.passes.end(),
+		[](const EffectPassDesc& d) { return d.dirtyRadius >= 0; })) {
+		desc.flags |= EffectFlags::SupportsDirtyRects;
+	}
+
 	return 0;
 }
 
@@ -1217,6 +857,10 @@ float2 GetScale() { return __scale; }
 	// 着色器入口
 	// 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// 只渲染变化的区域时不从第一个线程组开始
+	const char* groupId = (desc.flags & EffectFlags::SupportsDirtyRects) ? "(gid.xy + __groupOffset)" : "gid.xy";
+
 	if (passDesc.isPSStyle) {
 		if (passDesc.outputs.size() <= 1) {
 			std::string outputSize;
@@ -1232,7 +876,7 @@ float2 GetScale() { return __scale; }
 
 			result.append(fmt::format(R"([numthreads(64, 1, 1)]
 void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
-	uint2 gxy = (gid.xy << 4u) + Rmp8x8(tid.x);
+	uint2 gxy = ({4} << 4u) + Rmp8x8(tid.x);
 	if (gxy.x >= {1}.x || gxy.y >= {1}.y) {{
 		return;
 	}}
@@ -1259,18 +903,18 @@ void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
 		{3}[gxy] = Pass{0}(pos);
 	}}
 }}
-)", passIdx, outputSize, outputPt, desc.textures[passDesc.outputs[0]].name));
+)", passIdx, outputSize, outputPt, desc.textures[passDesc.outputs[0]].name, groupId));
 		} else {
 			// 多渲染目标
 			result.append(fmt::format(R"([numthreads(64, 1, 1)]
 void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
-	uint2 gxy = (gid.xy << 4u) + Rmp8x8(tid.x);
+	uint2 gxy = ({1} << 4u) + Rmp8x8(tid.x);
 	if (gxy.x >= __pass{0}OutputSize.x || gxy.y >= __pass{0}OutputSize.y) {{
 		return;
 	}}
 	float2 pos = (gxy + 0.5f) * __pass{0}OutputPt;
 	float2 step = 8 * __pass{0}OutputPt;
-)", passIdx));
+)", passIdx, groupId));
 			for (int i = 0; i < passDesc.outputs.size(); ++i) {
 				auto& texDesc = desc.textures[passDesc.outputs[i]];
 				result.append(fmt::format("\t{} c{};\n",
@@ -1313,9 +957,9 @@ void __M(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {{
 		std::string blockStartExpr;
 		if (passDesc.blockSize.first == passDesc.blockSize.second && std::has_single_bit(passDesc.blockSize.first)) {
 			uint32_t nShift = std::lroundf(std::log2f((float)passDesc.blockSize.first));
-			blockStartExpr = fmt::format("(gid.xy << {})", nShift);
+			blockStartExpr = fmt::format("({} << {})", groupId, nShift);
 		} else {
-			blockStartExpr = fmt::format("gid.xy * uint2({}, {})", passDesc.blockSize.first, passDesc.blockSize.second);
+			blockStartExpr = fmt::format("{} * uint2({}, {})", groupId, passDesc.blockSize.first, passDesc.blockSize.second);
 		}
 
 		result.append(fmt::format(R"([numthreads({}, {}, {})]
@@ -1372,6 +1016,11 @@ static uint32_t CompilePasses(
 		cbHlsl.append("cbuffer __CB2 : register(b1) { uint __frameCount; };\n\n");
 	}
 
+	if (desc.flags & EffectFlags::SupportsDirtyRects) {
+		// 只渲染变化的区域时第一个线程组的位置
+		cbHlsl.append("cbuffer __CB3 : register(b2) { uint2 __groupOffset; };\n\n");
+	}
+
 	std::wstring sourcesPathName = StrUtils::Concat(CommonSharedConstants::SOURCES_DIR, StrUtils::UTF8ToUTF16(desc.name));
 	std::wstring sourcesPath = sourcesPathName.substr(0, sourcesPathName.find_last_of(L'\\'));
 
@@ -1382,17 +1031,23 @@ static uint32_t CompilePasses(
 		}
 	}
 
-	size_t delimPos = desc.name.find_last_of('\\');
-	PassInclude passInclude(delimPos == std::string::npos 
-		? L"effects\\"
-		: L"effects\\" + StrUtils::UTF8ToUTF16(std::string_view(desc.name.c_str(), delimPos + 1)));
+	const std::wstring includeDir = GetIncludeDir(desc.name);
+	PassInclude passInclude(includeDir);
 
-	// 并行生成代码和编译
-	Win32Utils::RunParallel([&](uint32_t id) {
+	struct PassSource {
 		std::string source;
 		std::vector<std::pair<std::string, std::string>> macros;
-		if (GeneratePassSource(desc, id + 1, cbHlsl, commonBlocks, passBlocks[id], inlineParams, source, macros)) {
+		// 既是缓存键也用于记录编译用时，获取失败时为空
+		std::wstring hash;
+	};
+	std::vector<PassSource> passSources(passBlocks.size());
+
+	// 并行生成代码并检查缓存，需要编译的通道由调度器根据通道的哈希估计用时
+	auto preparePass = [&](uint32_t id) {
+		PassSource& passSource = passSources[id];
+		if (GeneratePassSource(desc, id + 1, cbHlsl, commonBlocks, passBlocks[id], inlineParams, passSource.source, passSource.macros)) {
 			Logger::Get().Error(fmt::format("生成 Pass{} 失败", id + 1));
+			passSource.source.clear();
 			return;
 		}
 
@@ -1401,17 +1056,81 @@ static uint32_t CompilePasses(
 				? StrUtils::Concat(sourcesPathName, L".hlsl")
 				: fmt::format(L"{}_Pass{}.hlsl", sourcesPathName, id + 1);
 
-			if (!Win32Utils::WriteFile(fileName.c_str(), source.data(), source.size())) {
+			if (!Win32Utils::WriteFile(fileName.c_str(), passSource.source.data(), passSource.source.size())) {
 				Logger::Get().Error(fmt::format("保存 Pass{} 源码失败", id + 1));
 			}
 		}
 
-		if (!DirectXHelper::CompileComputeShader(source, "__M", desc.passes[id].cso.put(),
-			fmt::format("{}_Pass{}.hlsl", desc.name, id + 1).c_str(), &passInclude, macros, flags & EffectCompilerFlags::WarningsAreErrors)
-		) {
+		// 包含的文件也是哈希的一部分。获取失败时不使用缓存，编译时会报告错误
+		std::string includes;
+		if (CollectIncludes(passSource.source, includeDir, fmt::format("{}_Pass{}.hlsl", desc.name, id + 1).c_str(), passSource.macros, includes)) {
+			passSource.hash = EffectCacheManager::GetPassHash(
+				passSource.source, includes, passSource.macros, flags & EffectCompilerFlags::WarningsAreErrors);
+		}
+
+		// 通道级缓存，效果只有部分通道更改时无需全部重新编译
+		if (!(flags & EffectCompilerFlags::NoCache) && !passSource.hash.empty()) {
+			EffectCacheManager::Get().LoadPass(passSource.hash, desc.passes[id].cso);
+		}
+	};
+
+	auto compilePass = [&](uint32_t id) {
+		const PassSource& passSource = passSources[id];
+
+		bool success = true;
+		const int duration = Utils::Measure([&]() {
+			success = DirectXHelper::CompileComputeShader(passSource.source, "__M", desc.passes[id].cso.put(),
+				fmt::format("{}_Pass{}.hlsl", desc.name, id + 1).c_str(), &passInclude, passSource.macros, flags & EffectCompilerFlags::WarningsAreErrors);
+		});
+		if (!success) {
 			Logger::Get().Error(fmt::format("编译 Pass{} 失败", id + 1));
+			return;
+		}
+
+		if (passSource.hash.empty()) {
+			return;
+		}
+
+		// 供调度器估计下次编译的用时
+		CompileScheduler::RecordCost(passSource.hash, passSource.source.size(), duration);
+
+		if (!(flags & EffectCompilerFlags::NoCache)) {
+			EffectCacheManager::Get().SavePass(passSource.hash, desc.passes[id].cso.get());
 		}
-	}, (uint32_t)passBlocks.size());
+	};
+
+	// 和其他效果的通道共用工作线程
+	CompileScheduler* scheduler = CompileScheduler::Current();
+
+	if (scheduler) {
+		CompileScheduler::TaskGroup group;
+		for (uint32_t i = 0; i < (uint32_t)passBlocks.size(); ++i) {
+			scheduler->Submit(group, passBlocks[i].size(), [&preparePass, i]() { preparePass(i); });
+		}
+		scheduler->Wait(group);
+	} else {
+		Win32Utils::RunParallel(preparePass, (uint32_t)passBlocks.size());
+	}
+
+	// 生成失败或已从缓存加载的通道无需编译
+	SmallVector<uint32_t> passesToCompile;
+	for (uint32_t i = 0; i < (uint32_t)passBlocks.size(); ++i) {
+		if (!desc.passes[i].cso && !passSources[i].source.empty()) {
+			passesToCompile.push_back(i);
+		}
+	}
+
+	if (scheduler) {
+		// 先编译耗时长的通道。没有记录时以代码长度估计
+		CompileScheduler::TaskGroup group;
+		for (uint32_t id : passesToCompile) {
+			const uint64_t cost = CompileScheduler::EstimateCost(passSources[id].hash, passSources[id].source.size());
+			scheduler->Submit(group, cost, [&compilePass, id]() { compilePass(id); });
+		}
+		scheduler->Wait(group);
+	} else {
+		Win32Utils::RunParallel([&](uint32_t i) { compilePass(passesToCompile[i]); }, (uint32_t)passesToCompile.size());
+	}
 
 	// 检查编译结果
 	for (const EffectPassDesc& d : desc.passes) {
@@ -1451,14 +1170,18 @@ uint32_t EffectCompiler::Compile(
 	}
 
 	// 移除注释
-	if (RemoveComments(source)) {
+	if (EffectParser::RemoveComments(source)) {
 		Logger::Get().Error("删除注释失败");
 		return 1;
 	}
 
 	std::wstring hash;
 	if (!noCache) {
-		hash = EffectCacheManager::GetHash(source, desc.flags & EffectFlags::InlineParams ? inlineParams : nullptr);
+		// 包含的文件修改后缓存也应失效，获取失败时不使用缓存
+		std::string includes;
+		if (CollectIncludes(source, GetIncludeDir(desc.name), desc.name.c_str(), {}, includes)) {
+			hash = EffectCacheManager::GetHash(source, desc.flags & EffectFlags::InlineParams ? inlineParams : nullptr, includes);
+		}
 		if (!hash.empty()) {
 			if (EffectCacheManager::Get().Load(effectName, hash, desc)) {
 				// 已从缓存中读取
@@ -1467,100 +1190,13 @@ uint32_t EffectCompiler::Compile(
 		}
 	}
 
-	std::string_view sourceView(source);
-
-	// 检查头
-	if (!CheckMagic(sourceView)) {
-		Logger::Get().Error("检查 MagpieFX 头失败");
-		return 2;
-	}
-
-	enum class BlockType {
-		Header,
-		Parameter,
-		Texture,
-		Sampler,
-		Common,
-		Pass
-	};
-
-	std::string_view headerBlock;
-	SmallVector<std::string_view> paramBlocks;
-	SmallVector<std::string_view> textureBlocks;
-	SmallVector<std::string_view> samplerBlocks;
-	SmallVector<std::string_view> commonBlocks;
-	SmallVector<std::string_view> passBlocks;
-
-	BlockType curBlockType = BlockType::Header;
-	size_t curBlockOff = 0;
-
-	auto completeCurrentBlock = [&](size_t len, BlockType newBlockType) {
-		switch (curBlockType) {
-		case BlockType::Header:
-			headerBlock = sourceView.substr(curBlockOff, len);
-			break;
-		case BlockType::Parameter:
-			paramBlocks.push_back(sourceView.substr(curBlockOff, len));
-			break;
-		case BlockType::Texture:
-			textureBlocks.push_back(sourceView.substr(curBlockOff, len));
-			break;
-		case BlockType::Sampler:
-			samplerBlocks.push_back(sourceView.substr(curBlockOff, len));
-			break;
-		case BlockType::Common:
-			commonBlocks.push_back(sourceView.substr(curBlockOff, len));
-			break;
-		case BlockType::Pass:
-			passBlocks.push_back(sourceView.substr(curBlockOff, len));
-			break;
-		default:
-			assert(false);
-			break;
-		}
-
-		curBlockType = newBlockType;
-		curBlockOff += len;
-	};
-
-	bool newLine = true;
-	std::string_view t = sourceView;
-	while (t.size() > 5) {
-		if (newLine) {
-			// 包含换行符
-			size_t len = t.data() - sourceView.data() - curBlockOff + 1;
-
-			if (CheckNextToken<true>(t, META_INDICATOR)) {
-				std::string_view token;
-				if (GetNextToken<false>(t, token)) {
-					return 1;
-				}
-				std::string blockType = StrUtils::ToUpperCase(token);
-
-				if (blockType == "PARAMETER") {
-					completeCurrentBlock(len, BlockType::Parameter);
-				} else if (blockType == "TEXTURE") {
-					completeCurrentBlock(len, BlockType::Texture);
-				} else if (blockType == "SAMPLER") {
-					completeCurrentBlock(len, BlockType::Sampler);
-				} else if (blockType == "COMMON") {
-					completeCurrentBlock(len, BlockType::Common);
-				} else if (blockType == "PASS") {
-					completeCurrentBlock(len, BlockType::Pass);
-				}
-			}
-
-			if (t.size() <= 5) {
-				break;
-			}
-		} else {
-			t.remove_prefix(1);
-		}
-
-		newLine = t[0] == '\n';
+	EffectSourceBlocks blocks;
+	if (uint32_t result = EffectParser::SplitBlocks(source, blocks)) {
+		Logger::Get().Error(result == 2 ? "检查 MagpieFX 头失败" : "分割源码失败");
+		return result;
 	}
 
-	completeCurrentBlock(sourceView.size() - curBlockOff, BlockType::Header);
+	SmallVector<std::string_view>& passBlocks = blocks.passes;
 
 	// 必须有 PASS 块
 	if (!noCompile && passBlocks.empty()) {
@@ -1568,14 +1204,25 @@ uint32_t EffectCompiler::Compile(
 		return 1;
 	}
 
-	if (ResolveHeader(headerBlock, desc, noCompile)) {
-		Logger::Get().Error("解析 Header 块失败");
-		return 1;
+	{
+		EffectMetadata metadata;
+		if (EffectParser::ResolveHeader(blocks.header, metadata)) {
+			Logger::Get().Error("解析 Header 块失败");
+			return 1;
+		}
+
+		if (metadata.useDynamic) {
+			desc.flags |= EffectFlags::UseDynamic;
+		}
+		if (noCompile) {
+			desc.sortName = std::move(metadata.sortName);
+		}
 	}
 
 	desc.params.clear();
-	for (size_t i = 0; i < paramBlocks.size(); ++i) {
-		if (ResolveParameter(paramBlocks[i], desc)) {
+	desc.params.reserve(blocks.params.size());
+	for (size_t i = 0; i < blocks.params.size(); ++i) {
+		if (EffectParser::ResolveParameter(blocks.params[i], desc.params.emplace_back())) {
 			Logger::Get().Error(fmt::format("解析 Parameter#{} 块失败", i + 1));
 			return 1;
 		}
@@ -1589,6 +1236,7 @@ uint32_t EffectCompiler::Compile(
 		inputDesc.format = EffectIntermediateTextureFormat::R8G8B8A8_UNORM;
 		inputDesc.sizeExpr.first = "INPUT_WIDTH";
 		inputDesc.sizeExpr.second = "INPUT_HEIGHT";
+		CompileSizeExpr(inputDesc.sizeExpr, false, inputDesc.sizeBytecode);
 	}
 	// 第二个元素为 OUTPUT
 	{
@@ -1597,8 +1245,8 @@ uint32_t EffectCompiler::Compile(
 		outputDesc.format = EffectIntermediateTextureFormat::R8G8B8A8_UNORM;
 	}
 
-	for (size_t i = 0; i < textureBlocks.size(); ++i) {
-		if (ResolveTexture(textureBlocks[i], desc)) {
+	for (size_t i = 0; i < blocks.textures.size(); ++i) {
+		if (ResolveTexture(blocks.textures[i], desc)) {
 			Logger::Get().Error(fmt::format("解析 Texture#{} 块失败", i + 1));
 			return 1;
 		}
@@ -1606,8 +1254,8 @@ uint32_t EffectCompiler::Compile(
 
 	if (!noCompile) {
 		desc.samplers.clear();
-		for (size_t i = 0; i < samplerBlocks.size(); ++i) {
-			if (ResolveSampler(samplerBlocks[i], desc)) {
+		for (size_t i = 0; i < blocks.samplers.size(); ++i) {
+			if (ResolveSampler(blocks.samplers[i], desc)) {
 				Logger::Get().Error(fmt::format("解析 Sampler#{} 块失败", i + 1));
 				return 1;
 			}
@@ -1641,8 +1289,8 @@ uint32_t EffectCompiler::Compile(
 	}
 
 	if (!noCompile) {
-		for (size_t i = 0; i < commonBlocks.size(); ++i) {
-			if (ResolveCommon(commonBlocks[i])) {
+		for (size_t i = 0; i < blocks.commons.size(); ++i) {
+			if (ResolveCommon(blocks.commons[i])) {
 				Logger::Get().Error(fmt::format("解析 Common#{} 块失败", i + 1));
 				return 1;
 			}
@@ -1654,7 +1302,7 @@ uint32_t EffectCompiler::Compile(
 			return 1;
 		}
 
-		if (CompilePasses(desc, flags, commonBlocks, passBlocks, inlineParams)) {
+		if (CompilePasses(desc, flags, blocks.commons, passBlocks, inlineParams)) {
 			Logger::Get().Error("编译着色器失败");
 			return 1;
 		}
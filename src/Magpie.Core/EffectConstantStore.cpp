@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "EffectConstantStore.h"
+#include "Logger.h"
+
+namespace Magpie::Core {
+
+// 偏移和大小必须是 16 个常量 (16 字节) 的倍数，即 256 字节
+static constexpr uint32_t OFFSETTING_ALIGNMENT = 64;
+// 常量缓冲区的大小必须是 16 字节的倍数
+static constexpr uint32_t BUFFER_ALIGNMENT = 4;
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment) noexcept {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void EffectConstantStore::Initialize(ID3D11Device5* d3dDevice, ID3D11DeviceContext4* d3dDC) noexcept {
+	_d3dDevice = d3dDevice;
+	_d3dDC = d3dDC;
+
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options{};
+	HRESULT hr = d3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (SUCCEEDED(hr)) {
+		_supportsOffsetting = options.ConstantBufferOffsetting;
+		_supportsPartialUpdate = options.ConstantBufferPartialUpdate;
+	} else {
+		Logger::Get().ComWarn("CheckFeatureSupport 失败", hr);
+	}
+
+	if (!_supportsOffsetting) {
+		Logger::Get().Info("不支持常量缓冲区偏移");
+	}
+}
+
+uint32_t EffectConstantStore::AddRegion(uint32_t count) noexcept {
+	const uint32_t alignment = _supportsOffsetting ? OFFSETTING_ALIGNMENT : BUFFER_ALIGNMENT;
+	count = AlignUp(std::max(count, 1u), alignment);
+
+	const uint32_t offset = (uint32_t)_constants.size();
+	_constants.resize(offset + count);
+	_regions.push_back({ .offset = offset, .count = count, .dirtyBegin = 0, .dirtyEnd = 0 });
+	return (uint32_t)_regions.size() - 1;
+}
+
+EffectHelper::Constant32* EffectConstantStore::Edit(uint32_t region, uint32_t offset, uint32_t count) noexcept {
+	_Region& r = _regions[region];
+	assert(offset + count <= r.count);
+
+	if (r.dirtyBegin >= r.dirtyEnd) {
+		r.dirtyBegin = offset;
+		r.dirtyEnd = offset + count;
+	} else {
+		r.dirtyBegin = std::min(r.dirtyBegin, offset);
+		r.dirtyEnd = std::max(r.dirtyEnd, offset + count);
+	}
+
+	return _constants.data() + r.offset + offset;
+}
+
+bool EffectConstantStore::Upload() noexcept {
+	if (_uploadedRegionCount < _regions.size()) {
+		// 新的缓冲区已包含所有常量
+		return _CreateBuffers();
+	}
+
+	// 所有段共用一个缓冲区但不支持部分更新时，只要有段被修改就上传整个缓冲区
+	bool isAnyDirty = false;
+
+	for (uint32_t i = 0; i < _regions.size(); ++i) {
+		_Region& r = _regions[i];
+		if (r.dirtyBegin >= r.dirtyEnd) {
+			continue;
+		}
+
+		if (!_supportsOffsetting) {
+			_d3dDC->UpdateSubresource(_buffers[i].get(), 0, nullptr, _constants.data() + r.offset, 0, 0);
+		} else if (_supportsPartialUpdate) {
+			// 以 16 字节为单位更新
+			const uint32_t begin = r.offset + r.dirtyBegin / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+			const uint32_t end = r.offset + AlignUp(r.dirtyEnd, BUFFER_ALIGNMENT);
+
+			const D3D11_BOX box{
+				.left = begin * 4,
+				.top = 0,
+				.front = 0,
+				.right = end * 4,
+				.bottom = 1,
+				.back = 1
+			};
+			_d3dDC->UpdateSubresource1(_buffers[0].get(), 0, &box, _constants.data() + begin, 0, 0, 0);
+		} else {
+			isAnyDirty = true;
+		}
+
+		r.dirtyBegin = r.dirtyEnd = 0;
+	}
+
+	if (isAnyDirty) {
+		_d3dDC->UpdateSubresource(_buffers[0].get(), 0, nullptr, _constants.data(), 0, 0);
+	}
+
+	return true;
+}
+
+void EffectConstantStore::Bind(uint32_t region, uint32_t slot) const noexcept {
+	assert(region < _uploadedRegionCount);
+
+	if (_supportsOffsetting) {
+		const _Region& r = _regions[region];
+		// 以 16 字节为单位
+		const UINT firstConstant = r.offset / 4;
+		const UINT numConstants = r.count / 4;
+		ID3D11Buffer* t = _buffers[0].get();
+		_d3dDC->CSSetConstantBuffers1(slot, 1, &t, &firstConstant, &numConstants);
+	} else {
+		ID3D11Buffer* t = _buffers[region].get();
+		_d3dDC->CSSetConstantBuffers(slot, 1, &t);
+	}
+}
+
+bool EffectConstantStore::_CreateBuffers() noexcept {
+	const auto createBuffer = [&](uint32_t offset, uint32_t count, winrt::com_ptr<ID3D11Buffer>& buffer) {
+		const D3D11_BUFFER_DESC bd{
+			.ByteWidth = count * 4,
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER
+		};
+		const D3D11_SUBRESOURCE_DATA initData{ .pSysMem = _constants.data() + offset };
+
+		HRESULT hr = _d3dDevice->CreateBuffer(&bd, &initData, buffer.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+		return true;
+	};
+
+	if (_supportsOffsetting) {
+		_buffers.resize(1);
+		if (!createBuffer(0, (uint32_t)_constants.size(), _buffers[0])) {
+			return false;
+		}
+	} else {
+		// 已有的段只需上传修改过的部分
+		_buffers.resize(_regions.size());
+		for (uint32_t i = 0; i < _uploadedRegionCount; ++i) {
+			_Region& r = _regions[i];
+			if (r.dirtyBegin < r.dirtyEnd) {
+				_d3dDC->UpdateSubresource(_buffers[i].get(), 0, nullptr, _constants.data() + r.offset, 0, 0);
+			}
+		}
+		for (uint32_t i = _uploadedRegionCount; i < _regions.size(); ++i) {
+			if (!createBuffer(_regions[i].offset, _regions[i].count, _buffers[i])) {
+				return false;
+			}
+		}
+	}
+
+	for (_Region& r : _regions) {
+		r.dirtyBegin = r.dirtyEnd = 0;
+	}
+	_uploadedRegionCount = (uint32_t)_regions.size();
+	return true;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "EffectHelper.h"
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+// 管理所有效果的常量。每个效果的 __CB1 和共用的 __CB2 各占一段，所有段按 256 字节对齐后放在
+// 同一个缓冲区中，绑定时指定偏移。CPU 端保留所有常量的副本并记录修改过的范围，Upload 只上传
+// 变化的部分，因此每帧只需上传帧数。驱动不支持常量缓冲区偏移时每段使用单独的缓冲区，不支持部分
+// 更新时每次上传整个缓冲区。
+class EffectConstantStore {
+public:
+	EffectConstantStore() = default;
+	EffectConstantStore(const EffectConstantStore&) = delete;
+	EffectConstantStore(EffectConstantStore&&) = default;
+
+	void Initialize(ID3D11Device5* d3dDevice, ID3D11DeviceContext4* d3dDC) noexcept;
+
+	// 添加一段，count 为 32 位常量的数量，初始值为 0。返回段的序号
+	uint32_t AddRegion(uint32_t count) noexcept;
+
+	// 返回段中从 offset 开始的 count 个常量，它们被视为已修改
+	EffectHelper::Constant32* Edit(uint32_t region, uint32_t offset, uint32_t count) noexcept;
+
+	const EffectHelper::Constant32* Get(uint32_t region, uint32_t offset) const noexcept {
+		return _constants.data() + _regions[region].offset + offset;
+	}
+
+	// 上传修改过的常量，添加了新的段时重新创建缓冲区。必须在 Bind 之前调用
+	bool Upload() noexcept;
+
+	void Bind(uint32_t region, uint32_t slot) const noexcept;
+
+private:
+	bool _CreateBuffers() noexcept;
+
+	struct _Region {
+		// 以 32 位常量为单位，已对齐
+		uint32_t offset;
+		uint32_t count;
+		// 修改过的范围，相对于段的开头。dirtyBegin >= dirtyEnd 表示没有修改
+		uint32_t dirtyBegin;
+		uint32_t dirtyEnd;
+	};
+
+	ID3D11Device5* _d3dDevice = nullptr;
+	ID3D11DeviceContext4* _d3dDC = nullptr;
+
+	std::vector<EffectHelper::Constant32> _constants;
+	SmallVector<_Region> _regions;
+	// 支持偏移时只有一个缓冲区，否则每段一个
+	SmallVector<winrt::com_ptr<ID3D11Buffer>> _buffers;
+	// 缓冲区中已包含的段数
+	uint32_t _uploadedRegionCount = 0;
+
+	bool _supportsOffsetting = false;
+	// 支持时只上传段中修改过的范围，否则 UpdateSubresource1 不能指定范围，只能上传整个缓冲区
+	bool _supportsPartialUpdate = false;
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
-#include <variant>
 #include "SmallVector.h"
+#include "EffectMetadata.h"
+#include "EffectSizeExpr.h"
 
 struct ID3D10Blob;
 typedef ID3D10Blob ID3DBlob;
@@ -31,8 +32,24 @@ enum class EffectIntermediateTextureFormat {
 	UNKNOWN
 };
 
+// 32 位浮点格式对应的 16 位浮点格式，其他格式不变。两者在着色器中的类型相同，替换后无需修改生成的代码
+constexpr EffectIntermediateTextureFormat GetFP16StorageFormat(EffectIntermediateTextureFormat format) noexcept {
+	switch (format) {
+	case EffectIntermediateTextureFormat::R32G32B32A32_FLOAT:
+		return EffectIntermediateTextureFormat::R16G16B16A16_FLOAT;
+	case EffectIntermediateTextureFormat::R32G32_FLOAT:
+		return EffectIntermediateTextureFormat::R16G16_FLOAT;
+	case EffectIntermediateTextureFormat::R32_FLOAT:
+		return EffectIntermediateTextureFormat::R16_FLOAT;
+	default:
+		return format;
+	}
+}
+
 struct EffectIntermediateTextureDesc {
 	std::pair<std::string, std::string> sizeExpr;
+	// 由 sizeExpr 编译而来，用于计算纹理尺寸
+	std::pair<EffectSizeBytecode, EffectSizeBytecode> sizeBytecode;
 	EffectIntermediateTextureFormat format = EffectIntermediateTextureFormat::UNKNOWN;
 	std::string name;
 	std::string source;
@@ -54,20 +71,6 @@ struct EffectSamplerDesc {
 	std::string name;
 };
 
-template <typename T>
-struct EffectConstant {
-	T defaultValue;
-	T minValue;
-	T maxValue;
-	T step;
-};
-
-struct EffectParameterDesc {
-	std::string name;
-	std::string label;
-	std::variant<EffectConstant<float>, EffectConstant<int>> constant;
-};
-
 struct EffectPassDesc {
 	winrt::com_ptr<ID3DBlob> cso;
 	SmallVector<uint32_t> inputs;
@@ -75,6 +78,9 @@ struct EffectPassDesc {
 	std::array<uint32_t, 3> numThreads{};
 	std::pair<uint32_t, uint32_t> blockSize{};
 	std::string desc;
+	// 输出的像素只依赖输入中此半径内的像素，单位为输入纹理的像素，-1 表示未指定。
+	// 所有通道都指定时可以只重新渲染画面变化的区域
+	int32_t dirtyRadius = -1;
 	bool isPSStyle = false;
 };
 
@@ -85,14 +91,16 @@ struct EffectFlags {
 	// 输出
 	// 此效果需要帧数和鼠标位置
 	static constexpr uint32_t UseDynamic = 1 << 4;
+	// 所有通道都指定了 DIRTY_RADIUS
+	static constexpr uint32_t SupportsDirtyRects = 1 << 5;
 };
 
 struct EffectDesc {
 	std::string name;
 	std::string sortName;	// 仅供 UI 使用
 
-	const std::pair<std::string, std::string>& GetOutputSizeExpr() const noexcept {
-		return textures[1].sizeExpr;
+	const std::pair<EffectSizeBytecode, EffectSizeBytecode>& GetOutputSizeBytecode() const noexcept {
+		return textures[1].sizeBytecode;
 	}
 
 	std::vector<EffectParameterDesc> params;
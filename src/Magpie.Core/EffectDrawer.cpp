@@ -8,36 +8,28 @@
 #include "TextureLoader.h"
 #include "EffectHelper.h"
 #include "DirectXHelper.h"
-#include "ScalingWindow.h"
 #include "BackendDescriptorStore.h"
 #include "EffectsProfiler.h"
-
-#pragma push_macro("_UNICODE")
-// Conan 的 muparser 不含 UNICODE 支持
-#undef _UNICODE
-#pragma warning(push)
-#pragma warning(disable: 4310)	// 类型强制转换截断常量值
-#include <muParser.h>
-#pragma warning(push)
-#pragma pop_macro("_UNICODE")
+#include "EffectTextureAllocator.h"
+#include "EffectConstantStore.h"
 
 namespace Magpie::Core {
 
 static SIZE CalcOutputSize(
-	const std::pair<std::string, std::string>& outputSizeExpr,
-	const EffectOption& option,
+	const std::pair<EffectSizeBytecode, EffectSizeBytecode>& outputSizeBytecode,
+	ScalingType scalingType,
+	std::pair<float, float> scale,
 	SIZE scalingWndSize,
-	SIZE inputSize,
-	mu::Parser& exprParser
+	SIZE inputSize
 ) noexcept {
 	SIZE outputSize{};
 
-	if (outputSizeExpr.first.empty()) {
-		switch (option.scalingType) {
+	if (outputSizeBytecode.first.empty()) {
+		switch (scalingType) {
 		case ScalingType::Normal:
 		{
-			outputSize.cx = std::lroundf(inputSize.cx * option.scale.first);
-			outputSize.cy = std::lroundf(inputSize.cy * option.scale.second);
+			outputSize.cx = std::lroundf(inputSize.cx * scale.first);
+			outputSize.cy = std::lroundf(inputSize.cy * scale.second);
 			break;
 		}
 		case ScalingType::Fit:
@@ -46,14 +38,14 @@ static SIZE CalcOutputSize(
 				float(scalingWndSize.cx) / inputSize.cx,
 				float(scalingWndSize.cy) / inputSize.cy
 			);
-			outputSize.cx = std::lroundf(inputSize.cx * fillScale * option.scale.first);
-			outputSize.cy = std::lroundf(inputSize.cy * fillScale * option.scale.second);
+			outputSize.cx = std::lroundf(inputSize.cx * fillScale * scale.first);
+			outputSize.cy = std::lroundf(inputSize.cy * fillScale * scale.second);
 			break;
 		}
 		case ScalingType::Absolute:
 		{
-			outputSize.cx = std::lroundf(option.scale.first);
-			outputSize.cy = std::lroundf(option.scale.second);
+			outputSize.cx = std::lroundf(scale.first);
+			outputSize.cy = std::lroundf(scale.second);
 			break;
 		}
 		case ScalingType::Fill:
@@ -66,52 +58,130 @@ static SIZE CalcOutputSize(
 			break;
 		}
 	} else {
-		assert(!outputSizeExpr.second.empty());
-
-		try {
-			exprParser.SetExpr(outputSizeExpr.first);
-			outputSize.cx = std::lround(exprParser.Eval());
+		assert(!outputSizeBytecode.second.empty());
 
-			exprParser.SetExpr(outputSizeExpr.second);
-			outputSize.cy = std::lround(exprParser.Eval());
-		} catch (const mu::ParserError& e) {
-			Logger::Get().Error(fmt::format("计算输出尺寸 {} 失败: {}", e.GetExpr(), e.GetMsg()));
+		// OUTPUT 的尺寸不能依赖自身
+		const EffectSizeExprVars vars{ (double)inputSize.cx, (double)inputSize.cy, 0, 0 };
+		int32_t width, height;
+		if (!EffectSizeExpr::EvaluateSize(outputSizeBytecode, vars, width, height)) {
+			Logger::Get().Error("计算输出尺寸失败");
 			return {};
 		}
+
+		outputSize = { (LONG)width, (LONG)height };
 	}
 
 	return outputSize;
 }
 
+// 分块执行时块的最大尺寸（包含重叠部分），单位为输入像素。更大的画面才会分块
+static constexpr LONG MAX_TILE_SIZE = 768;
+// 块的边界在所有纹理中都必须落在像素边界上，对齐要求超过此值时不分块
+static constexpr LONG MAX_TILE_ALIGNMENT = 16;
+
+struct TileSpan {
+	// 块在输入中的起始位置
+	LONG origin;
+	// 块负责的区域
+	LONG start;
+	LONG end;
+};
+
+// 沿一个方向分块，返回块的尺寸。frameSize 和 overlap 都是 alignment 的整数倍，块的边界也是。
+// 块负责的区域距块的边缘至少 overlap，画面边缘除外，因此所有块的尺寸相同
+static LONG CalcTileSpans(LONG frameSize, LONG overlap, LONG alignment, SmallVector<TileSpan>& spans) noexcept {
+	// 先求最少的块数，再在此块数下使块尽可能小以减少重叠部分
+	const LONG maxStep = MAX_TILE_SIZE - 2 * overlap;
+	const LONG tileCount = (frameSize - 2 * overlap + maxStep - 1) / maxStep;
+	LONG tileSize = (frameSize - 2 * overlap + tileCount - 1) / tileCount + 2 * overlap;
+	tileSize = (tileSize + alignment - 1) / alignment * alignment;
+
+	LONG start = 0;
+	for (LONG origin = 0;; origin += tileSize - 2 * overlap) {
+		if (origin + tileSize >= frameSize) {
+			spans.push_back({ frameSize - tileSize, start, frameSize });
+			break;
+		}
+
+		const LONG end = origin + tileSize - overlap;
+		spans.push_back({ origin, start, end });
+		start = end;
+	}
+
+	return tileSize;
+}
+
 bool EffectDrawer::Initialize(
 	const EffectDesc& desc,
 	const EffectOption& option,
+	SIZE scalingWndSize,
 	DeviceResources& deviceResources,
 	BackendDescriptorStore& descriptorStore,
+	EffectConstantStore& constantStore,
+	EffectTextureAllocator& textureAllocator,
 	ID3D11Texture2D** inOutTexture
 ) noexcept {
 	_d3dDC = deviceResources.GetD3DDC();
+	_constantStore = &constantStore;
+	_scalingType = option.scalingType;
+	_scale = option.scale;
 
-	SIZE inputSize{};
-	{
-		D3D11_TEXTURE2D_DESC inputDesc;
-		(*inOutTexture)->GetDesc(&inputDesc);
-		inputSize = { (LONG)inputDesc.Width, (LONG)inputDesc.Height };
+	// Resize 时需要重新计算纹理尺寸，因此保留尺寸表达式
+	_textureInfos.resize(desc.textures.size());
+	for (size_t i = 0; i < desc.textures.size(); ++i) {
+		const EffectIntermediateTextureDesc& texDesc = desc.textures[i];
+		_TextureInfo& info = _textureInfos[i];
+		info.sizeBytecode = texDesc.sizeBytecode;
+		info.format = EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].dxgiFormat;
+		info.fromFile = !texDesc.source.empty();
+	}
+
+	// 计算中间纹理在本效果中的生存期，不重叠的可以共用显存
+	for (uint32_t i = 0; i < (uint32_t)desc.passes.size(); ++i) {
+		for (uint32_t idx : desc.passes[i].inputs) {
+			_TextureInfo& info = _textureInfos[idx];
+			if (info.firstPass == std::numeric_limits<uint32_t>::max()) {
+				// 写入前被读取，需要保留上一帧的内容
+				info.persistent = true;
+			}
+			info.lastPass = i;
+		}
+		for (uint32_t idx : desc.passes[i].outputs) {
+			_TextureInfo& info = _textureInfos[idx];
+			if (info.firstPass == std::numeric_limits<uint32_t>::max()) {
+				info.firstPass = i;
+			}
+			info.lastPass = i;
+		}
 	}
 
-	static mu::Parser exprParser;
-	exprParser.DefineConst("INPUT_WIDTH", inputSize.cx);
-	exprParser.DefineConst("INPUT_HEIGHT", inputSize.cy);
+	// 如果有纹理在写入前被读取，无法推断变化的区域，也无法分块
+	const bool isLocal = (desc.flags & EffectFlags::SupportsDirtyRects) && std::none_of(
+		_textureInfos.begin() + 2, _textureInfos.end(), [](const _TextureInfo& info) { return info.persistent; });
 
-	const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
-	const SIZE outputSize = CalcOutputSize(desc.GetOutputSizeExpr(), option, scalingWndSize, inputSize, exprParser);
-	if (outputSize.cx <= 0 || outputSize.cy <= 0) {
-		Logger::Get().Error("非法的输出尺寸");
-		return false;
+	if (option.flags & EffectOptionFlags::Tiled) {
+		if (isLocal) {
+			_isTilingEnabled = true;
+		} else {
+			Logger::Get().Warn(fmt::format("{} 不支持分块执行", desc.name));
+		}
 	}
 
-	exprParser.DefineConst("OUTPUT_WIDTH", outputSize.cx);
-	exprParser.DefineConst("OUTPUT_HEIGHT", outputSize.cy);
+	// 只渲染变化的区域时每个通道按需要的区域重新计算，中间纹理不必保留上一帧的内容，仍可以复用。
+	// 分块执行时每个块都要完整执行，两者不能同时使用
+	_supportsDirtyRects = isLocal && !_isTilingEnabled;
+
+	_passes.resize(desc.passes.size());
+	for (size_t i = 0; i < desc.passes.size(); ++i) {
+		const EffectPassDesc& passDesc = desc.passes[i];
+		_passes[i] = {
+			.inputs = passDesc.inputs,
+			.outputs = passDesc.outputs,
+			.blockSize = passDesc.blockSize,
+			.radius = passDesc.dirtyRadius,
+			.isPSStyle = passDesc.isPSStyle
+		};
+	}
 
 	_samplers.resize(desc.samplers.size());
 	for (UINT i = 0; i < _samplers.size(); ++i) {
@@ -127,265 +197,847 @@ bool EffectDrawer::Initialize(
 		}
 	}
 
-	// 创建中间纹理
 	// 第一个为 INPUT，第二个为 OUTPUT
 	_textures.resize(desc.textures.size());
-	_textures[0].copy_from(*inOutTexture);
-
-	// 创建输出纹理，格式始终是 DXGI_FORMAT_R8G8B8A8_UNORM
-	_textures[1] = DirectXHelper::CreateTexture2D(
-		deviceResources.GetD3DDevice(),
-		EffectHelper::FORMAT_DESCS[(uint32_t)desc.textures[1].format].dxgiFormat,
-		outputSize.cx,
-		outputSize.cy,
-		D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
-	);
-
-	*inOutTexture = _textures[1].get();
-	if (!*inOutTexture) {
-		Logger::Get().Error("创建输出纹理失败");
-		return false;
-	}
 
+	// 从文件加载的纹理和尺寸无关
 	for (size_t i = 2; i < desc.textures.size(); ++i) {
 		const EffectIntermediateTextureDesc& texDesc = desc.textures[i];
+		if (texDesc.source.empty()) {
+			continue;
+		}
 
-		if (!texDesc.source.empty()) {
-			// 从文件加载纹理
-			size_t delimPos = desc.name.find_last_of('\\');
-			std::string texPath = delimPos == std::string::npos
-				? StrUtils::Concat("effects\\", texDesc.source)
-				: StrUtils::Concat("effects\\", std::string_view(desc.name.c_str(), delimPos + 1), texDesc.source);
-			_textures[i] = TextureLoader::Load(
-				StrUtils::UTF8ToUTF16(texPath).c_str(), deviceResources.GetD3DDevice());
-			if (!_textures[i]) {
-				Logger::Get().Error(fmt::format("加载纹理 {} 失败", texDesc.source));
+		size_t delimPos = desc.name.find_last_of('\\');
+		std::string texPath = delimPos == std::string::npos
+			? StrUtils::Concat("effects\\", texDesc.source)
+			: StrUtils::Concat("effects\\", std::string_view(desc.name.c_str(), delimPos + 1), texDesc.source);
+		_textures[i] = TextureLoader::Load(
+			StrUtils::UTF8ToUTF16(texPath).c_str(), deviceResources.GetD3DDevice());
+		if (!_textures[i]) {
+			Logger::Get().Error(fmt::format("加载纹理 {} 失败", texDesc.source));
+			return false;
+		}
+
+		if (texDesc.format != EffectIntermediateTextureFormat::UNKNOWN) {
+			// 检查纹理格式是否匹配
+			D3D11_TEXTURE2D_DESC srcDesc{};
+			_textures[i]->GetDesc(&srcDesc);
+			if (srcDesc.Format != EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].dxgiFormat) {
+				Logger::Get().Error("SOURCE 纹理格式不匹配");
 				return false;
 			}
+		}
+	}
 
-			if (texDesc.format != EffectIntermediateTextureFormat::UNKNOWN) {
-				// 检查纹理格式是否匹配
-				D3D11_TEXTURE2D_DESC srcDesc{};
-				_textures[i]->GetDesc(&srcDesc);
-				if (srcDesc.Format != EffectHelper::FORMAT_DESCS[(uint32_t)texDesc.format].dxgiFormat) {
-					Logger::Get().Error("SOURCE 纹理格式不匹配");
-					return false;
-				}
-			}
+	_shaders.resize(desc.passes.size());
+	for (UINT i = 0; i < _shaders.size(); ++i) {
+		const EffectPassDesc& passDesc = desc.passes[i];
 
-		} else {
-			SIZE texSize{};
-			try {
-				exprParser.SetExpr(texDesc.sizeExpr.first);
-				texSize.cx = std::lround(exprParser.Eval());
-				exprParser.SetExpr(texDesc.sizeExpr.second);
-				texSize.cy = std::lround(exprParser.Eval());
-			} catch (const mu::ParserError& e) {
-				Logger::Get().Error(fmt::format("计算中间纹理尺寸 {} 失败: {}", e.GetExpr(), e.GetMsg()));
-				return false;
-			}
+		HRESULT hr = deviceResources.GetD3DDevice()->CreateComputeShader(
+			passDesc.cso->GetBufferPointer(), passDesc.cso->GetBufferSize(), nullptr, _shaders[i].put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("创建计算着色器失败", hr);
+			return false;
+		}
+	}
 
-			if (texSize.cx <= 0 || texSize.cy <= 0) {
-				Logger::Get().Error("非法的中间纹理尺寸");
-				return false;
+	_srvs.resize(desc.passes.size());
+	_uavs.resize(desc.passes.size());
+	if (!_CreateSizeDependentResources(scalingWndSize, deviceResources, descriptorStore, textureAllocator, inOutTexture)) {
+		return false;
+	}
+
+	if (!_InitializeConstants(desc, option)) {
+		Logger::Get().Error("_InitializeConstants 失败");
+		return false;
+	}
+
+	if (desc.flags & EffectFlags::SupportsDirtyRects) {
+		// cbuffer __CB3 : register(b2) { uint2 __groupOffset; };
+		D3D11_BUFFER_DESC bd{
+			.ByteWidth = 16,
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_CONSTANT_BUFFER
+		};
+
+		const uint32_t initData[4]{};
+		D3D11_SUBRESOURCE_DATA subData{ .pSysMem = initData };
+
+		HRESULT hr = deviceResources.GetD3DDevice()->CreateBuffer(&bd, &subData, _groupOffsetCB.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool EffectDrawer::Resize(
+	SIZE scalingWndSize,
+	DeviceResources& deviceResources,
+	BackendDescriptorStore& descriptorStore,
+	EffectTextureAllocator& textureAllocator,
+	ID3D11Texture2D** inOutTexture
+) noexcept {
+	if (!_CreateSizeDependentResources(scalingWndSize, deviceResources, descriptorStore, textureAllocator, inOutTexture)) {
+		return false;
+	}
+
+	// 常量中只有尺寸需要更新，下次上传时生效
+	_UpdateSizeConstants();
+	return true;
+}
+
+void EffectDrawer::RecycleTextures(EffectTextureAllocator& textureAllocator) noexcept {
+	for (size_t i = 2; i < _textures.size(); ++i) {
+		const _TextureInfo& info = _textureInfos[i];
+		if (_textures[i] && !info.persistent && !info.fromFile) {
+			textureAllocator.Recycle(std::move(_textures[i]));
+			_textures[i] = nullptr;
+		}
+	}
+}
+
+bool EffectDrawer::_CreateSizeDependentResources(
+	SIZE scalingWndSize,
+	DeviceResources& deviceResources,
+	BackendDescriptorStore& descriptorStore,
+	EffectTextureAllocator& textureAllocator,
+	ID3D11Texture2D** inOutTexture
+) noexcept {
+	D3D11_TEXTURE2D_DESC inputDesc;
+	(*inOutTexture)->GetDesc(&inputDesc);
+	const SIZE inputSize = { (LONG)inputDesc.Width, (LONG)inputDesc.Height };
+
+	const SIZE outputSize = CalcOutputSize(_textureInfos[1].sizeBytecode, _scalingType, _scale, scalingWndSize, inputSize);
+	if (outputSize.cx <= 0 || outputSize.cy <= 0) {
+		Logger::Get().Error("非法的输出尺寸");
+		return false;
+	}
+
+	// 尺寸表达式已在编译效果时转换为字节码，这里无需解析，也没有共享的状态
+	const EffectSizeExprVars sizeVars{
+		(double)inputSize.cx,
+		(double)inputSize.cy,
+		(double)outputSize.cx,
+		(double)outputSize.cy
+	};
+
+	SmallVector<SIZE> textureSizes(_textureInfos.size());
+	textureSizes[0] = inputSize;
+	textureSizes[1] = outputSize;
+	for (size_t i = 2; i < _textureInfos.size(); ++i) {
+		if (_textureInfos[i].fromFile) {
+			D3D11_TEXTURE2D_DESC srcDesc;
+			_textures[i]->GetDesc(&srcDesc);
+			textureSizes[i] = { (LONG)srcDesc.Width, (LONG)srcDesc.Height };
+			continue;
+		}
+
+		int32_t width, height;
+		if (!EffectSizeExpr::EvaluateSize(_textureInfos[i].sizeBytecode, sizeVars, width, height)) {
+			Logger::Get().Error(fmt::format("非法的中间纹理尺寸 #{}", i));
+			return false;
+		}
+
+		textureSizes[i] = { (LONG)width, (LONG)height };
+	}
+
+	// 分块执行时之后只使用块中纹理的尺寸
+	const bool wasTiled = _isTiled;
+	_isTiled = false;
+	if (_isTilingEnabled) {
+		SmallVector<SIZE> tileTextureSizes;
+		if (_CalcTiles(textureSizes, tileTextureSizes)) {
+			textureSizes = std::move(tileTextureSizes);
+			_isTiled = true;
+		}
+	}
+
+	// 初始化时 _textureSizes 为空
+	const auto isSizeUnchanged = [&](size_t i) {
+		return i < _textureSizes.size() && textureSizes[i] == _textureSizes[i];
+	};
+
+	_frameInput.copy_from(*inOutTexture);
+
+	// 输出被重定向时尺寸不变则继续写入目标纹理
+	const bool isOutputSizeUnchanged = outputSize == _outputSize;
+	if (!_outputTargets.empty() && !isOutputSizeUnchanged) {
+		_outputTargets.clear();
+		_outputTargetUavs.clear();
+	}
+
+	if (_outputTargets.empty() && !(_frameOutput && isOutputSizeUnchanged)) {
+		if (_frameOutput) {
+			descriptorStore.RemoveViews(_frameOutput.get());
+		}
+
+		// 创建输出纹理，格式始终是 DXGI_FORMAT_R8G8B8A8_UNORM
+		_frameOutput = DirectXHelper::CreateTexture2D(
+			deviceResources.GetD3DDevice(),
+			_textureInfos[1].format,
+			outputSize.cx,
+			outputSize.cy,
+			D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+		);
+		if (!_frameOutput) {
+			Logger::Get().Error("创建输出纹理失败");
+			return false;
+		}
+	}
+
+	_inputSize = inputSize;
+	_outputSize = outputSize;
+	*inOutTexture = _frameOutput.get();
+
+	// 不分块时 INPUT 和 OUTPUT 就是整个画面的输入和输出，否则为块的输入和输出，尺寸不变则保留
+	winrt::com_ptr<ID3D11Texture2D> oldTileTextures[2];
+	if (wasTiled) {
+		oldTileTextures[0] = std::move(_textures[0]);
+		oldTileTextures[1] = std::move(_textures[1]);
+	}
+
+	if (_isTiled) {
+		for (size_t i = 0; i < 2; ++i) {
+			if (oldTileTextures[i] && isSizeUnchanged(i)) {
+				_textures[i] = std::move(oldTileTextures[i]);
+				continue;
 			}
 
+			// 块的输入从整个输入复制，因此格式相同
 			_textures[i] = DirectXHelper::CreateTexture2D(
 				deviceResources.GetD3DDevice(),
-				EffectHelper::FORMAT_DESCS[(UINT)texDesc.format].dxgiFormat,
-				texSize.cx,
-				texSize.cy,
-				D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+				i == 0 ? inputDesc.Format : _textureInfos[1].format,
+				textureSizes[i].cx,
+				textureSizes[i].cy,
+				i == 0 ? D3D11_BIND_SHADER_RESOURCE : D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
 			);
 			if (!_textures[i]) {
 				Logger::Get().Error("创建纹理失败");
 				return false;
 			}
 		}
+	} else {
+		_textures[0] = _frameInput;
+		_textures[1] = _frameOutput;
 	}
 
-	_shaders.resize(desc.passes.size());
-	_srvs.resize(desc.passes.size());
-	_uavs.resize(desc.passes.size());
-	for (UINT i = 0; i < _shaders.size(); ++i) {
-		const EffectPassDesc& passDesc = desc.passes[i];
+	for (const winrt::com_ptr<ID3D11Texture2D>& texture : oldTileTextures) {
+		if (texture) {
+			descriptorStore.RemoveViews(texture.get());
+		}
+	}
 
-		HRESULT hr = deviceResources.GetD3DDevice()->CreateComputeShader(
-			passDesc.cso->GetBufferPointer(), passDesc.cso->GetBufferSize(), nullptr, _shaders[i].put());
-		if (FAILED(hr)) {
-			Logger::Get().ComError("创建计算着色器失败", hr);
+	for (size_t i = 2; i < _textureInfos.size(); ++i) {
+		const _TextureInfo& info = _textureInfos[i];
+		// 没有通道使用的纹理不需要创建，参与复用的纹理稍后分配
+		if (info.fromFile || !info.persistent) {
+			continue;
+		}
+
+		if (_textures[i] && isSizeUnchanged(i)) {
+			continue;
+		}
+
+		if (_textures[i]) {
+			descriptorStore.RemoveViews(_textures[i].get());
+		}
+
+		_textures[i] = DirectXHelper::CreateTexture2D(
+			deviceResources.GetD3DDevice(),
+			info.format,
+			textureSizes[i].cx,
+			textureSizes[i].cy,
+			D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+		);
+		if (!_textures[i]) {
+			Logger::Get().Error("创建纹理失败");
 			return false;
 		}
+	}
+
+	_textureSizes = std::move(textureSizes);
+
+	// 按通道顺序分配其余中间纹理，同一通道使用的纹理不能共用
+	for (uint32_t i = 0; i < (uint32_t)_passes.size(); ++i) {
+		for (uint32_t idx : _passes[i].outputs) {
+			if (_textures[idx] || _textureInfos[idx].firstPass != i) {
+				continue;
+			}
+
+			_textures[idx] = textureAllocator.Acquire(_textureInfos[idx].format, _textureSizes[idx]);
+			if (!_textures[idx]) {
+				Logger::Get().Error("创建纹理失败");
+				return false;
+			}
+		}
+
+		for (size_t idx = 2; idx < _textureInfos.size(); ++idx) {
+			const _TextureInfo& info = _textureInfos[idx];
+			if (info.lastPass == i && !info.persistent && !info.fromFile
+				&& info.firstPass != std::numeric_limits<uint32_t>::max()) {
+				// 之后的通道和效果可以复用
+				textureAllocator.Release(_textures[idx]);
+			}
+		}
+	}
+
+	_outputUavSlots.clear();
+	_dispatches.clear();
+	for (UINT i = 0; i < _passes.size(); ++i) {
+		const _PassInfo& passInfo = _passes[i];
 
-		_srvs[i].resize(passDesc.inputs.size());
-		for (UINT j = 0; j < passDesc.inputs.size(); ++j) {
-			auto srv = _srvs[i][j] = descriptorStore.GetShaderResourceView(_textures[passDesc.inputs[j]].get());
+		_srvs[i].resize(passInfo.inputs.size());
+		for (UINT j = 0; j < passInfo.inputs.size(); ++j) {
+			auto srv = _srvs[i][j] = descriptorStore.GetShaderResourceView(_textures[passInfo.inputs[j]].get());
 			if (!srv) {
 				Logger::Get().Error("GetShaderResourceView 失败");
 				return false;
 			}
 		}
 
-		_uavs[i].resize(passDesc.outputs.size() * 2);
-		for (UINT j = 0; j < passDesc.outputs.size(); ++j) {
-			auto uav = _uavs[i][j] = descriptorStore.GetUnorderedAccessView(_textures[passDesc.outputs[j]].get());
+		_uavs[i].resize(passInfo.outputs.size() * 2);
+		for (UINT j = 0; j < passInfo.outputs.size(); ++j) {
+			const uint32_t idx = passInfo.outputs[j];
+			if (idx == 1 && !_isTiled) {
+				_outputUavSlots.emplace_back(i, j);
+
+				if (!_outputTargetUavs.empty()) {
+					// 由 SetOutputTarget 设置
+					_uavs[i][j] = _outputTargetUavs[0];
+					continue;
+				}
+			}
+
+			auto uav = _uavs[i][j] = descriptorStore.GetUnorderedAccessView(_textures[idx].get());
 			if (!uav) {
 				Logger::Get().Error("GetUnorderedAccessView 失败");
 				return false;
 			}
 		}
 
-		D3D11_TEXTURE2D_DESC outputDesc;
-		_textures[passDesc.outputs[0]]->GetDesc(&outputDesc);
+		const SIZE passOutputSize = _textureSizes[passInfo.outputs[0]];
 		_dispatches.emplace_back(
-			(outputDesc.Width + passDesc.blockSize.first - 1) / passDesc.blockSize.first,
-			(outputDesc.Height + passDesc.blockSize.second - 1) / passDesc.blockSize.second
+			((uint32_t)passOutputSize.cx + passInfo.blockSize.first - 1) / passInfo.blockSize.first,
+			((uint32_t)passOutputSize.cy + passInfo.blockSize.second - 1) / passInfo.blockSize.second
 		);
 	}
 
-	if (!_InitializeConstants(desc, option, deviceResources, inputSize, outputSize)) {
-		Logger::Get().Error("_InitializeConstants 失败");
+	// 中间纹理的内容已失效
+	_isFirstDraw = true;
+	return true;
+}
+
+bool EffectDrawer::_CalcTiles(const SmallVector<SIZE>& textureSizes, SmallVector<SIZE>& tileTextureSizes) noexcept {
+	const SIZE inputSize = textureSizes[0];
+	if (inputSize.cx <= MAX_TILE_SIZE && inputSize.cy <= MAX_TILE_SIZE) {
 		return false;
 	}
 
+	// 两个方向分别计算，dim 为 0 表示水平方向
+	const auto getDim = [](const SIZE& size, int dim) { return dim == 0 ? size.cx : size.cy; };
+
+	SmallVector<TileSpan> spans[2];
+	LONG tileInputSize[2]{};
+	for (int dim = 0; dim < 2; ++dim) {
+		const LONG frameSize = getDim(inputSize, dim);
+		if (frameSize <= MAX_TILE_SIZE) {
+			spans[dim].push_back({ 0, 0, frameSize });
+			tileInputSize[dim] = frameSize;
+			continue;
+		}
+
+		// 块的边界在每个纹理中都要落在像素边界上，否则块中的采样位置和不分块时不同
+		LONG alignment = 1;
+		for (; alignment <= MAX_TILE_ALIGNMENT; ++alignment) {
+			bool isAligned = frameSize % alignment == 0;
+			for (size_t i = 1; isAligned && i < textureSizes.size(); ++i) {
+				if (!_textureInfos[i].fromFile) {
+					isAligned = (alignment * getDim(textureSizes[i], dim)) % frameSize == 0;
+				}
+			}
+
+			if (isAligned) {
+				break;
+			}
+		}
+		if (alignment > MAX_TILE_ALIGNMENT) {
+			Logger::Get().Info("纹理尺寸的比例无法分块");
+			return false;
+		}
+
+		// 块之间的重叠部分为所有通道的 DIRTY_RADIUS 之和，单位换算为输入像素
+		LONG overlap = 0;
+		for (const _PassInfo& passInfo : _passes) {
+			const LONG passOutputSize = getDim(textureSizes[passInfo.outputs[0]], dim);
+
+			LONG passOverlap = 0;
+			for (uint32_t idx : passInfo.inputs) {
+				if (_textureInfos[idx].fromFile) {
+					continue;
+				}
+
+				// 输入和输出尺寸不同时多扩展一个像素以防舍入误差
+				const LONG texSize = getDim(textureSizes[idx], dim);
+				const LONG radius = passInfo.radius + (texSize != passOutputSize ? 1 : 0);
+				passOverlap = std::max(passOverlap, (radius * frameSize + texSize - 1) / texSize);
+			}
+
+			overlap += passOverlap;
+		}
+		overlap = (overlap + alignment - 1) / alignment * alignment;
+
+		// 重叠部分太大时分块得不偿失
+		if (overlap * 4 > MAX_TILE_SIZE) {
+			Logger::Get().Info("块之间的重叠部分过大，无法分块");
+			return false;
+		}
+
+		tileInputSize[dim] = CalcTileSpans(frameSize, overlap, alignment, spans[dim]);
+	}
+
+	// 块中纹理的尺寸和块成比例，尺寸表达式不是线性的则无法分块
+	tileTextureSizes.resize(textureSizes.size());
+	tileTextureSizes[0] = { tileInputSize[0], tileInputSize[1] };
+	const EffectSizeExprVars tileVars{
+		(double)tileInputSize[0],
+		(double)tileInputSize[1],
+		double((int64_t)tileInputSize[0] * textureSizes[1].cx / inputSize.cx),
+		double((int64_t)tileInputSize[1] * textureSizes[1].cy / inputSize.cy)
+	};
+	for (size_t i = 1; i < textureSizes.size(); ++i) {
+		if (_textureInfos[i].fromFile) {
+			tileTextureSizes[i] = textureSizes[i];
+			continue;
+		}
+
+		tileTextureSizes[i] = {
+			LONG((int64_t)tileInputSize[0] * textureSizes[i].cx / inputSize.cx),
+			LONG((int64_t)tileInputSize[1] * textureSizes[i].cy / inputSize.cy)
+		};
+
+		// 未指定尺寸的 OUTPUT 由缩放倍数决定，必定成比例
+		if (_textureInfos[i].sizeBytecode.first.empty()) {
+			continue;
+		}
+
+		int32_t width, height;
+		if (!EffectSizeExpr::EvaluateSize(_textureInfos[i].sizeBytecode, tileVars, width, height) ||
+			width != tileTextureSizes[i].cx || height != tileTextureSizes[i].cy) {
+			Logger::Get().Info(fmt::format("纹理 #{} 的尺寸和输入不成比例，无法分块", i));
+			return false;
+		}
+	}
+
+	const auto toOutput = [&](LONG pos, int dim) {
+		return LONG((int64_t)pos * getDim(textureSizes[1], dim) / getDim(inputSize, dim));
+	};
+
+	_tiles.clear();
+	for (const TileSpan& spanY : spans[1]) {
+		for (const TileSpan& spanX : spans[0]) {
+			const RECT outputRect{
+				toOutput(spanX.start, 0),
+				toOutput(spanY.start, 1),
+				toOutput(spanX.end, 0),
+				toOutput(spanY.end, 1)
+			};
+			_tiles.push_back({
+				.inputOrigin = { spanX.origin, spanY.origin },
+				.outputRect = outputRect,
+				.tileOutputPos = {
+					outputRect.left - toOutput(spanX.origin, 0),
+					outputRect.top - toOutput(spanY.origin, 1)
+				}
+			});
+		}
+	}
+
+	Logger::Get().Info(fmt::format("分块执行: {} 个块，块尺寸 {}x{}",
+		_tiles.size(), tileInputSize[0], tileInputSize[1]));
 	return true;
 }
 
-void EffectDrawer::Draw(EffectsProfiler& profiler) const noexcept {
-	{
-		ID3D11Buffer* t = _constantBuffer.get();
-		_d3dDC->CSSetConstantBuffers(0, 1, &t);
+void EffectDrawer::Draw(EffectsProfiler& profiler, RECT& dirtyRect) noexcept {
+	_constantStore->Bind(_constantRegion, 0);
+	if (ID3D11Buffer* t = _groupOffsetCB.get()) {
+		_d3dDC->CSSetConstantBuffers(2, 1, &t);
 	}
 	_d3dDC->CSSetSamplers(0, (UINT)_samplers.size(), _samplers.data());
 
+	const RECT inputRect{ 0, 0, _inputSize.cx, _inputSize.cy };
+	const RECT outputRect{ 0, 0, _outputSize.cx, _outputSize.cy };
+
+	if (_isTiled) {
+		_DrawTiles(profiler);
+		dirtyRect = outputRect;
+		return;
+	}
+
+	if (!_supportsDirtyRects || _isFirstDraw || EqualRect(&dirtyRect, &inputRect)) {
+		// 中间纹理还没有内容或整个输入都有变化
+		_isFirstDraw = false;
+
+		for (uint32_t i = 0; i < _dispatches.size(); ++i) {
+			_DrawPass(i, {}, _dispatches[i]);
+			profiler.OnEndPass(_d3dDC);
+		}
+
+		dirtyRect = outputRect;
+		return;
+	}
+
+	// 每个纹理在这一帧中变化的区域
+	SmallVector<RECT> texDirtyRects(_textureSizes.size());
+	texDirtyRects[0] = dirtyRect;
+
 	for (uint32_t i = 0; i < _dispatches.size(); ++i) {
-		_DrawPass(i);
+		const _PassInfo& info = _passes[i];
+		const SIZE passOutputSize = _textureSizes[info.outputs[0]];
+
+		// 将输入变化的区域映射到输出纹理并按感受野扩展，多扩展一个像素以防舍入误差
+		RECT passRect{};
+		for (uint32_t idx : info.inputs) {
+			const RECT& inputDirtyRect = texDirtyRects[idx];
+			if (IsRectEmpty(&inputDirtyRect)) {
+				continue;
+			}
+
+			const SIZE passInputSize = _textureSizes[idx];
+			const float scaleX = (float)passOutputSize.cx / passInputSize.cx;
+			const float scaleY = (float)passOutputSize.cy / passInputSize.cy;
+			const RECT mapped{
+				(LONG)std::floorf((inputDirtyRect.left - info.radius) * scaleX) - 1,
+				(LONG)std::floorf((inputDirtyRect.top - info.radius) * scaleY) - 1,
+				(LONG)std::ceilf((inputDirtyRect.right + info.radius) * scaleX) + 1,
+				(LONG)std::ceilf((inputDirtyRect.bottom + info.radius) * scaleY) + 1
+			};
+			UnionRect(&passRect, &passRect, &mapped);
+		}
+
+		const RECT passOutputRect{ 0, 0, passOutputSize.cx, passOutputSize.cy };
+		IntersectRect(&passRect, &passRect, &passOutputRect);
+
+		for (uint32_t idx : info.outputs) {
+			UnionRect(&texDirtyRects[idx], &texDirtyRects[idx], &passRect);
+		}
+	}
+
+	// 中间纹理不保留上一帧的内容，因此从输出反向推算每个通道需要渲染的区域，
+	// 通道读取的区域必须在这一帧中写入。这和分块执行时每个块带有重叠区域是一样的
+	SmallVector<RECT> texRequiredRects(_textureSizes.size());
+	texRequiredRects[1] = texDirtyRects[1];
+	if (!_outputTargetUavs.empty()) {
+		// 输出被重定向时目标纹理中过时的区域也要渲染，但这部分内容并没有变化
+		UnionRect(&texRequiredRects[1], &texRequiredRects[1], &_outputStaleRect);
+	}
+
+	SmallVector<RECT> passRenderRects(_dispatches.size());
+	for (uint32_t i = (uint32_t)_dispatches.size(); i-- > 0;) {
+		const _PassInfo& info = _passes[i];
+		const SIZE passOutputSize = _textureSizes[info.outputs[0]];
+
+		RECT renderRect{};
+		for (uint32_t idx : info.outputs) {
+			UnionRect(&renderRect, &renderRect, &texRequiredRects[idx]);
+		}
+
+		const RECT passOutputRect{ 0, 0, passOutputSize.cx, passOutputSize.cy };
+		IntersectRect(&renderRect, &renderRect, &passOutputRect);
+		if (IsRectEmpty(&renderRect)) {
+			continue;
+		}
+
+		// 对齐到块，实际写入的区域可能更大
+		const auto [blockWidth, blockHeight] = info.blockSize;
+		RECT& writtenRect = passRenderRects[i];
+		writtenRect = {
+			LONG(renderRect.left / blockWidth * blockWidth),
+			LONG(renderRect.top / blockHeight * blockHeight),
+			LONG((renderRect.right + blockWidth - 1) / blockWidth * blockWidth),
+			LONG((renderRect.bottom + blockHeight - 1) / blockHeight * blockHeight)
+		};
+		IntersectRect(&writtenRect, &writtenRect, &passOutputRect);
+
+		// 将写入的区域映射回输入纹理并按感受野扩展，多扩展一个像素以防舍入误差
+		for (uint32_t idx : info.inputs) {
+			const SIZE passInputSize = _textureSizes[idx];
+			const float scaleX = (float)passInputSize.cx / passOutputSize.cx;
+			const float scaleY = (float)passInputSize.cy / passOutputSize.cy;
+			RECT mapped{
+				(LONG)std::floorf(writtenRect.left * scaleX) - info.radius - 1,
+				(LONG)std::floorf(writtenRect.top * scaleY) - info.radius - 1,
+				(LONG)std::ceilf(writtenRect.right * scaleX) + info.radius + 1,
+				(LONG)std::ceilf(writtenRect.bottom * scaleY) + info.radius + 1
+			};
+			const RECT passInputRect{ 0, 0, passInputSize.cx, passInputSize.cy };
+			IntersectRect(&mapped, &mapped, &passInputRect);
+			UnionRect(&texRequiredRects[idx], &texRequiredRects[idx], &mapped);
+		}
+	}
+
+	for (uint32_t i = 0; i < _dispatches.size(); ++i) {
+		const RECT& renderRect = passRenderRects[i];
+		if (IsRectEmpty(&renderRect)) {
+			// 输出没有变化，也没有被之后的通道读取
+			profiler.OnEndPass(_d3dDC);
+			continue;
+		}
+
+		const auto [blockWidth, blockHeight] = _passes[i].blockSize;
+		const std::pair<uint32_t, uint32_t> groupOffset(
+			renderRect.left / blockWidth, renderRect.top / blockHeight);
+		const std::pair<uint32_t, uint32_t> groupCount(
+			(renderRect.right + blockWidth - 1) / blockWidth - groupOffset.first,
+			(renderRect.bottom + blockHeight - 1) / blockHeight - groupOffset.second);
+
+		_DrawPass(i, groupOffset, groupCount);
 		profiler.OnEndPass(_d3dDC);
 	}
+
+	dirtyRect = texDirtyRects[1];
+}
+
+void EffectDrawer::_DrawTiles(EffectsProfiler& profiler) noexcept {
+	ID3D11Texture2D* frameOutput = _frameOutput ? _frameOutput.get() : _outputTargets[_outputTargetIdx];
+
+	for (uint32_t tileIdx = 0; tileIdx < (uint32_t)_tiles.size(); ++tileIdx) {
+		const _Tile& tile = _tiles[tileIdx];
+		profiler.OnBeginTile(tileIdx);
+
+		const D3D11_BOX inputBox{
+			.left = (UINT)tile.inputOrigin.x,
+			.top = (UINT)tile.inputOrigin.y,
+			.front = 0,
+			.right = UINT(tile.inputOrigin.x + _textureSizes[0].cx),
+			.bottom = UINT(tile.inputOrigin.y + _textureSizes[0].cy),
+			.back = 1
+		};
+		_d3dDC->CopySubresourceRegion(_textures[0].get(), 0, 0, 0, 0, _frameInput.get(), 0, &inputBox);
+
+		for (uint32_t i = 0; i < _dispatches.size(); ++i) {
+			_DrawPass(i, {}, _dispatches[i]);
+			profiler.OnEndPass(_d3dDC);
+		}
+
+		// 只复制块负责的区域，边缘受重叠部分之外的像素影响
+		const D3D11_BOX outputBox{
+			.left = (UINT)tile.tileOutputPos.x,
+			.top = (UINT)tile.tileOutputPos.y,
+			.front = 0,
+			.right = UINT(tile.tileOutputPos.x + tile.outputRect.right - tile.outputRect.left),
+			.bottom = UINT(tile.tileOutputPos.y + tile.outputRect.bottom - tile.outputRect.top),
+			.back = 1
+		};
+		_d3dDC->CopySubresourceRegion(frameOutput, 0,
+			tile.outputRect.left, tile.outputRect.top, 0, _textures[1].get(), 0, &outputBox);
+	}
 }
 
-void EffectDrawer::_DrawPass(uint32_t i) const noexcept {
+bool EffectDrawer::RedirectOutput(
+	std::span<ID3D11Texture2D* const> targets,
+	BackendDescriptorStore& descriptorStore
+) noexcept {
+	// 分块执行时直接复制到目标纹理，但 Resize 后可能不再分块，因此总是创建 UAV
+	_outputTargetUavs.resize(targets.size());
+	for (size_t i = 0; i < targets.size(); ++i) {
+		_outputTargetUavs[i] = descriptorStore.GetUnorderedAccessView(targets[i]);
+		if (!_outputTargetUavs[i]) {
+			Logger::Get().Error("GetUnorderedAccessView 失败");
+			_outputTargetUavs.clear();
+			return false;
+		}
+	}
+	_outputTargets.assign(targets.begin(), targets.end());
+
+	// OUTPUT 不会作为通道的输入，因此不再需要原输出纹理
+	descriptorStore.RemoveViews(_frameOutput.get());
+	_frameOutput = nullptr;
+	if (!_isTiled) {
+		_textures[1] = nullptr;
+	}
+
+	SetOutputTarget(0, { 0, 0, _outputSize.cx, _outputSize.cy });
+	return true;
+}
+
+void EffectDrawer::SetOutputTarget(uint32_t idx, const RECT& staleRect) noexcept {
+	assert(idx < _outputTargetUavs.size());
+
+	_outputTargetIdx = idx;
+	for (const auto& [passIdx, uavIdx] : _outputUavSlots) {
+		_uavs[passIdx][uavIdx] = _outputTargetUavs[idx];
+	}
+	_outputStaleRect = staleRect;
+}
+
+void EffectDrawer::_DrawPass(
+	uint32_t i,
+	std::pair<uint32_t, uint32_t> groupOffset,
+	std::pair<uint32_t, uint32_t> groupCount
+) noexcept {
+	if (_groupOffsetCB && groupOffset != _curGroupOffset) {
+		const uint32_t data[4]{ groupOffset.first, groupOffset.second };
+		_d3dDC->UpdateSubresource(_groupOffsetCB.get(), 0, nullptr, data, 0, 0);
+		_curGroupOffset = groupOffset;
+	}
+
 	_d3dDC->CSSetShader(_shaders[i].get(), nullptr, 0);
 
 	_d3dDC->CSSetShaderResources(0, (UINT)_srvs[i].size(), _srvs[i].data());
 	UINT uavCount = (UINT)_uavs[i].size() / 2;
 	_d3dDC->CSSetUnorderedAccessViews(0, uavCount, _uavs[i].data(), nullptr);
 
-	_d3dDC->Dispatch(_dispatches[i].first, _dispatches[i].second, 1);
+	_d3dDC->Dispatch(groupCount.first, groupCount.second, 1);
 
 	_d3dDC->CSSetUnorderedAccessViews(0, uavCount, _uavs[i].data() + uavCount, nullptr);
 }
 
-bool EffectDrawer::_InitializeConstants(
-	const EffectDesc& desc,
-	const EffectOption& option,
-	DeviceResources& deviceResources,
-	SIZE inputSize,
-	SIZE outputSize
-) noexcept {
-	const bool isInlineParams = desc.flags & EffectFlags::InlineParams;
+// cbuffer __CB1 : register(b0) {
+//     uint2 __inputSize;
+//     uint2 __outputSize;
+//     float2 __inputPt;
+//     float2 __outputPt;
+//     float2 __scale;
+//     [PS 样式通道的输出尺寸...]
+//     [PARAMETERS...]
+// );
+static constexpr uint32_t BUILTIN_CONSTANT_COUNT = 10;
 
-	// 大小必须为 4 的倍数
-	const size_t builtinConstantCount = 10;
-	size_t psStylePassParams = 0;
-	for (UINT i = 0, end = (UINT)desc.passes.size() - 1; i < end; ++i) {
-		if (desc.passes[i].isPSStyle) {
-			psStylePassParams += 4;
+// 检查参数的值并转换为常量
+static bool ConvertParameterValue(
+	const std::variant<EffectConstant<float>, EffectConstant<int>>& constant,
+	float value,
+	EffectHelper::Constant32& result
+) noexcept {
+	if (constant.index() == 0) {
+		const EffectConstant<float>& floatConstant = std::get<0>(constant);
+		if (value < floatConstant.minValue || value > floatConstant.maxValue) {
+			return false;
 		}
-	}
-	_constants.resize((builtinConstantCount + psStylePassParams + (isInlineParams ? 0 : desc.params.size()) + 3) / 4 * 4);
-	// cbuffer __CB1 : register(b0) {
-	//     uint2 __inputSize;
-	//     uint2 __outputSize;
-	//     float2 __inputPt;
-	//     float2 __outputPt;
-	//     float2 __scale;
-	//     [PARAMETERS...]
-	// );
-	_constants[0].uintVal = inputSize.cx;
-	_constants[1].uintVal = inputSize.cy;
-	_constants[2].uintVal = outputSize.cx;
-	_constants[3].uintVal = outputSize.cy;
-	_constants[4].floatVal = 1.0f / inputSize.cx;
-	_constants[5].floatVal = 1.0f / inputSize.cy;
-	_constants[6].floatVal = 1.0f / outputSize.cx;
-	_constants[7].floatVal = 1.0f / outputSize.cy;
-	_constants[8].floatVal = outputSize.cx / (FLOAT)inputSize.cx;
-	_constants[9].floatVal = outputSize.cy / (FLOAT)inputSize.cy;
 
-	// PS 样式的通道需要的参数
-	EffectHelper::Constant32* pCurParam = _constants.data() + builtinConstantCount;
-	if (psStylePassParams > 0) {
-		for (UINT i = 0, end = (UINT)desc.passes.size() - 1; i < end; ++i) {
-			if (desc.passes[i].isPSStyle) {
-				D3D11_TEXTURE2D_DESC outputDesc;
-				_textures[desc.passes[i].outputs[0]]->GetDesc(&outputDesc);
-				pCurParam->uintVal = outputDesc.Width;
-				++pCurParam;
-				pCurParam->uintVal = outputDesc.Height;
-				++pCurParam;
-				pCurParam->floatVal = 1.0f / outputDesc.Width;
-				++pCurParam;
-				pCurParam->floatVal = 1.0f / outputDesc.Height;
-				++pCurParam;
-			}
+		result.floatVal = value;
+	} else {
+		const EffectConstant<int>& intConstant = std::get<1>(constant);
+		const int intValue = (int)std::lroundf(value);
+		if (intValue < intConstant.minValue || intValue > intConstant.maxValue) {
+			return false;
 		}
+
+		result.intVal = intValue;
 	}
 
-	if (!isInlineParams) {
-		for (UINT i = 0; i < desc.params.size(); ++i) {
-			const auto& paramDesc = desc.params[i];
-			auto it = option.parameters.find(StrUtils::UTF8ToUTF16(paramDesc.name));
+	return true;
+}
 
-			if (paramDesc.constant.index() == 0) {
-				const EffectConstant<float>& constant = std::get<0>(paramDesc.constant);
-				float value = constant.defaultValue;
+bool EffectDrawer::_InitializeConstants(const EffectDesc& desc, const EffectOption& option) noexcept {
+	const bool isInlineParams = desc.flags & EffectFlags::InlineParams;
 
-				if (it != option.parameters.end()) {
-					value = it->second;
+	uint32_t psStylePassParams = 0;
+	for (UINT i = 0, end = (UINT)_passes.size() - 1; i < end; ++i) {
+		if (_passes[i].isPSStyle) {
+			psStylePassParams += 4;
+		}
+	}
+	_paramsOffset = BUILTIN_CONSTANT_COUNT + psStylePassParams;
 
-					if (value < constant.minValue || value > constant.maxValue) {
-						Logger::Get().Error(fmt::format("参数 {} 的值非法", paramDesc.name));
-						return false;
-					}
-				}
+	const uint32_t paramCount = isInlineParams ? 0 : (uint32_t)desc.params.size();
+	_constantRegion = _constantStore->AddRegion(_paramsOffset + paramCount);
 
-				pCurParam->floatVal = value;
-			} else {
-				const EffectConstant<int>& constant = std::get<1>(paramDesc.constant);
-				int value = constant.defaultValue;
+	_UpdateSizeConstants();
 
-				if (it != option.parameters.end()) {
-					value = (int)std::lroundf(it->second);
+	if (paramCount == 0) {
+		return true;
+	}
 
-					if ((value < constant.minValue) || (value > constant.maxValue)) {
-						Logger::Get().Error(StrUtils::Concat("参数 ", paramDesc.name, " 的值非法"));
-						return false;
-					}
-				}
+	_paramConstants.reserve(paramCount);
+	_paramNames.reserve(paramCount);
+	EffectHelper::Constant32* pCurParam = _constantStore->Edit(_constantRegion, _paramsOffset, paramCount);
+	for (const EffectParameterDesc& paramDesc : desc.params) {
+		std::wstring paramName = StrUtils::UTF8ToUTF16(paramDesc.name);
+		auto it = option.parameters.find(paramName);
 
-				pCurParam->intVal = value;
-			}
+		float value;
+		if (it != option.parameters.end()) {
+			value = it->second;
+		} else if (paramDesc.constant.index() == 0) {
+			value = std::get<0>(paramDesc.constant).defaultValue;
+		} else {
+			value = (float)std::get<1>(paramDesc.constant).defaultValue;
+		}
 
-			++pCurParam;
+		if (!ConvertParameterValue(paramDesc.constant, value, *pCurParam)) {
+			Logger::Get().Error(fmt::format("参数 {} 的值非法", paramDesc.name));
+			return false;
 		}
+
+		_paramConstants.push_back(paramDesc.constant);
+		_paramNames.push_back(std::move(paramName));
+		++pCurParam;
 	}
 
-	D3D11_BUFFER_DESC bd{
-		.ByteWidth = 4 * (UINT)_constants.size(),
-		.Usage = D3D11_USAGE_DEFAULT,
-		.BindFlags = D3D11_BIND_CONSTANT_BUFFER
-	};
+	return true;
+}
+
+bool EffectDrawer::SetParameter(std::wstring_view name, float value) noexcept {
+	auto it = std::find(_paramNames.begin(), _paramNames.end(), name);
+	if (it == _paramNames.end()) {
+		// 参数被内联或不存在
+		return false;
+	}
+	const uint32_t idx = uint32_t(it - _paramNames.begin());
 
-	D3D11_SUBRESOURCE_DATA initData{ .pSysMem = _constants.data() };
+	EffectHelper::Constant32 constant;
+	if (!ConvertParameterValue(_paramConstants[idx], value, constant)) {
+		Logger::Get().Error(fmt::format("参数 {} 的值非法", StrUtils::UTF16ToUTF8(name)));
+		return false;
+	}
 
-	HRESULT hr = deviceResources.GetD3DDevice()->CreateBuffer(&bd, &initData, _constantBuffer.put());
-	if (FAILED(hr)) {
-		Logger::Get().ComError("CreateBuffer 失败", hr);
+	// 读取不会将常量标记为已修改
+	const EffectHelper::Constant32* pCurValue = _constantStore->Get(_constantRegion, _paramsOffset + idx);
+	if (pCurValue->uintVal == constant.uintVal) {
 		return false;
 	}
 
+	*_constantStore->Edit(_constantRegion, _paramsOffset + idx, 1) = constant;
+	// 参数影响整个输出，不能只渲染脏矩形
+	_isFirstDraw = true;
 	return true;
 }
 
+void EffectDrawer::_UpdateSizeConstants() noexcept {
+	const SIZE inputSize = _textureSizes[0];
+	const SIZE outputSize = _textureSizes[1];
+
+	EffectHelper::Constant32* constants = _constantStore->Edit(_constantRegion, 0, _paramsOffset);
+	constants[0].uintVal = inputSize.cx;
+	constants[1].uintVal = inputSize.cy;
+	constants[2].uintVal = outputSize.cx;
+	constants[3].uintVal = outputSize.cy;
+	constants[4].floatVal = 1.0f / inputSize.cx;
+	constants[5].floatVal = 1.0f / inputSize.cy;
+	constants[6].floatVal = 1.0f / outputSize.cx;
+	constants[7].floatVal = 1.0f / outputSize.cy;
+	constants[8].floatVal = outputSize.cx / (FLOAT)inputSize.cx;
+	constants[9].floatVal = outputSize.cy / (FLOAT)inputSize.cy;
+
+	// PS 样式的通道需要的参数
+	EffectHelper::Constant32* pCurParam = constants + BUILTIN_CONSTANT_COUNT;
+	for (UINT i = 0, end = (UINT)_passes.size() - 1; i < end; ++i) {
+		if (_passes[i].isPSStyle) {
+			const SIZE passOutputSize = _textureSizes[_passes[i].outputs[0]];
+			pCurParam->uintVal = passOutputSize.cx;
+			++pCurParam;
+			pCurParam->uintVal = passOutputSize.cy;
+			++pCurParam;
+			pCurParam->floatVal = 1.0f / passOutputSize.cx;
+			++pCurParam;
+			pCurParam->floatVal = 1.0f / passOutputSize.cy;
+			++pCurParam;
+		}
+	}
+}
+
 }
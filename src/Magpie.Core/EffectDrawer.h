@@ -6,9 +6,12 @@
 namespace Magpie::Core {
 
 struct EffectOption;
+enum class ScalingType;
 class DeviceResources;
 class BackendDescriptorStore;
+class EffectConstantStore;
 class EffectsProfiler;
+class EffectTextureAllocator;
 
 class EffectDrawer {
 public:
@@ -19,23 +22,66 @@ public:
 	bool Initialize(
 		const EffectDesc& desc,
 		const EffectOption& option,
+		SIZE scalingWndSize,
 		DeviceResources& deviceResources,
 		BackendDescriptorStore& descriptorStore,
+		EffectConstantStore& constantStore,
+		EffectTextureAllocator& textureAllocator,
 		ID3D11Texture2D** inOutTexture
 	) noexcept;
 
-	void Draw(EffectsProfiler& profiler) const noexcept;
+	// 输入或缩放窗口尺寸改变后重新计算纹理尺寸，只重新分配尺寸改变的纹理，着色器和采样器保持不变。
+	// 输出仍被重定向且尺寸不变时 inOutTexture 返回 nullptr
+	bool Resize(
+		SIZE scalingWndSize,
+		DeviceResources& deviceResources,
+		BackendDescriptorStore& descriptorStore,
+		EffectTextureAllocator& textureAllocator,
+		ID3D11Texture2D** inOutTexture
+	) noexcept;
+
+	// 将参与复用的中间纹理交给分配器，Resize 时可以取回。不同效果可能共用同一纹理，
+	// 因此必须先对所有效果调用此函数再调用 Resize
+	void RecycleTextures(EffectTextureAllocator& textureAllocator) noexcept;
+
+	// dirtyRect 传入输入纹理中变化的区域，返回输出纹理中变化的区域。效果支持时只渲染受影响的区域
+	void Draw(EffectsProfiler& profiler, RECT& dirtyRect) noexcept;
+
+	// 输出改为写入 targets 中的纹理，释放自己的输出纹理。targets 必须和输出纹理格式和尺寸相同，
+	// 且支持 UAV
+	bool RedirectOutput(std::span<ID3D11Texture2D* const> targets, BackendDescriptorStore& descriptorStore) noexcept;
+
+	// 选择之后 Draw 写入的纹理。staleRect 为该纹理中过时的区域，即使没有变化也会重新渲染
+	void SetOutputTarget(uint32_t idx, const RECT& staleRect) noexcept;
+
+	// 修改名为 name 的参数，下次 Draw 时生效并重新渲染整个输出。值没有变化时返回 false，
+	// 参数被内联时无法修改
+	bool SetParameter(std::wstring_view name, float value) noexcept;
 
 private:
-	bool _InitializeConstants(
-		const EffectDesc& desc,
-		const EffectOption& option,
+	// 计算纹理尺寸并创建纹理和视图，尺寸不变的纹理被保留
+	bool _CreateSizeDependentResources(
+		SIZE scalingWndSize,
 		DeviceResources& deviceResources,
-		SIZE inputSize,
-		SIZE outputSize
+		BackendDescriptorStore& descriptorStore,
+		EffectTextureAllocator& textureAllocator,
+		ID3D11Texture2D** inOutTexture
 	) noexcept;
 
-	void _DrawPass(uint32_t i) const noexcept;
+	bool _InitializeConstants(const EffectDesc& desc, const EffectOption& option) noexcept;
+
+	void _UpdateSizeConstants() noexcept;
+
+	// 计算分块方式并返回块中每个纹理的尺寸，无需分块或无法分块时返回 false
+	bool _CalcTiles(const SmallVector<SIZE>& textureSizes, SmallVector<SIZE>& tileTextureSizes) noexcept;
+
+	void _DrawTiles(EffectsProfiler& profiler) noexcept;
+
+	void _DrawPass(
+		uint32_t i,
+		std::pair<uint32_t, uint32_t> groupOffset,
+		std::pair<uint32_t, uint32_t> groupCount
+	) noexcept;
 
 	ID3D11DeviceContext* _d3dDC = nullptr;
 
@@ -45,12 +91,81 @@ private:
 	// 后半部分为空，用于解绑
 	std::vector<SmallVector<ID3D11UnorderedAccessView*>> _uavs;
 
-	SmallVector<EffectHelper::Constant32, 32> _constants;
-	winrt::com_ptr<ID3D11Buffer> _constantBuffer;
+	// __CB1 在 EffectConstantStore 中占一段
+	EffectConstantStore* _constantStore = nullptr;
+	uint32_t _constantRegion = 0;
+	// 参数在 __CB1 中的位置，参数被内联时 _paramConstants 为空
+	uint32_t _paramsOffset = 0;
+	SmallVector<std::variant<EffectConstant<float>, EffectConstant<int>>> _paramConstants;
+	// 和 _paramConstants 一一对应
+	std::vector<std::wstring> _paramNames;
 
 	SmallVector<winrt::com_ptr<ID3D11ComputeShader>> _shaders;
 
 	SmallVector<std::pair<uint32_t, uint32_t>> _dispatches;
+
+	// 分块执行时 INPUT 和 OUTPUT 为块的输入和输出，尺寸也是块的尺寸
+	SmallVector<SIZE> _textureSizes;
+
+	struct _TextureInfo {
+		std::pair<EffectSizeBytecode, EffectSizeBytecode> sizeBytecode;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		// 在本效果中的生存期，不重叠的可以共用显存
+		uint32_t firstPass = std::numeric_limits<uint32_t>::max();
+		uint32_t lastPass = 0;
+		// 需要保留上一帧的内容，不参与复用
+		bool persistent = false;
+		// 从文件加载，尺寸不会改变
+		bool fromFile = false;
+	};
+	SmallVector<_TextureInfo> _textureInfos;
+
+	struct _PassInfo {
+		SmallVector<uint32_t> inputs;
+		SmallVector<uint32_t> outputs;
+		std::pair<uint32_t, uint32_t> blockSize;
+		int32_t radius;
+		bool isPSStyle;
+	};
+	SmallVector<_PassInfo> _passes;
+	// 是否支持只渲染变化的区域
+	bool _supportsDirtyRects = false;
+
+	// 整个画面的输入和输出。不分块时和 _textures 的前两个相同，输出被重定向时 _frameOutput 为空
+	winrt::com_ptr<ID3D11Texture2D> _frameInput;
+	winrt::com_ptr<ID3D11Texture2D> _frameOutput;
+	SIZE _inputSize{};
+	SIZE _outputSize{};
+
+	struct _Tile {
+		// 块在整个输入中的位置
+		POINT inputOrigin;
+		// 块负责的区域，在整个输出中
+		RECT outputRect;
+		// outputRect 在块的输出中的位置
+		POINT tileOutputPos;
+	};
+	// 分块执行时每个块依次执行所有通道，中间纹理只需容纳一个块。
+	// 需要所有通道都指定 DIRTY_RADIUS 以计算块之间的重叠
+	SmallVector<_Tile> _tiles;
+	bool _isTilingEnabled = false;
+	bool _isTiled = false;
+
+	// 用于计算输出尺寸
+	ScalingType _scalingType{};
+	std::pair<float, float> _scale{};
+
+	winrt::com_ptr<ID3D11Buffer> _groupOffsetCB;
+	std::pair<uint32_t, uint32_t> _curGroupOffset{};
+	bool _isFirstDraw = true;
+
+	// 写入 OUTPUT 的 UAV 在 _uavs 中的位置
+	SmallVector<std::pair<uint32_t, uint32_t>> _outputUavSlots;
+	// 为空表示输出到 _frameOutput
+	SmallVector<ID3D11Texture2D*> _outputTargets;
+	SmallVector<ID3D11UnorderedAccessView*> _outputTargetUavs;
+	uint32_t _outputTargetIdx = 0;
+	RECT _outputStaleRect{};
 };
 
 }
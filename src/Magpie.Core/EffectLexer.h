@@ -0,0 +1,169 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cctype>
+
+// MagpieFX 的词法分析，由 EffectParser 和 EffectCompiler 共用。只依赖标准库
+namespace Magpie::Core::EffectLexer {
+
+inline constexpr std::string_view META_INDICATOR = "//!";
+
+inline bool IsSpace(char c) noexcept {
+	return std::isspace((unsigned char)c);
+}
+
+inline bool IsIdentifierStart(char c) noexcept {
+	return std::isalpha((unsigned char)c) || c == '_';
+}
+
+inline bool IsIdentifierChar(char c) noexcept {
+	return std::isalnum((unsigned char)c) || c == '_';
+}
+
+inline void Trim(std::string_view& str) noexcept {
+	while (!str.empty() && IsSpace(str.front())) {
+		str.remove_prefix(1);
+	}
+	while (!str.empty() && IsSpace(str.back())) {
+		str.remove_suffix(1);
+	}
+}
+
+// 比较时忽略大小写，expected 必须为大写
+inline bool EqualsUpper(std::string_view str, std::string_view expected) noexcept {
+	if (str.size() != expected.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < str.size(); ++i) {
+		if ((char)std::toupper((unsigned char)str[i]) != expected[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<bool IncludeNewLine>
+inline void RemoveLeadingBlanks(std::string_view& source) noexcept {
+	size_t i = 0;
+	for (; i < source.size(); ++i) {
+		if constexpr (IncludeNewLine) {
+			if (!IsSpace(source[i])) {
+				break;
+			}
+		} else {
+			char c = source[i];
+			if (c != ' ' && c != '\t') {
+				break;
+			}
+		}
+	}
+
+	source.remove_prefix(i);
+}
+
+template<bool AllowNewLine>
+inline bool CheckNextToken(std::string_view& source, std::string_view token) noexcept {
+	RemoveLeadingBlanks<AllowNewLine>(source);
+
+	if (!source.starts_with(token)) {
+		return false;
+	}
+
+	source.remove_prefix(token.size());
+	return true;
+}
+
+// 返回 0 表示成功，1 表示下一个字符不是标识符，2 表示已到达行尾（AllowNewLine 时为结尾）
+template<bool AllowNewLine>
+inline uint32_t GetNextToken(std::string_view& source, std::string_view& value) noexcept {
+	RemoveLeadingBlanks<AllowNewLine>(source);
+
+	if (source.empty()) {
+		return 2;
+	}
+
+	char cur = source[0];
+
+	if (IsIdentifierStart(cur)) {
+		size_t j = 1;
+		for (; j < source.size(); ++j) {
+			if (!IsIdentifierChar(source[j])) {
+				break;
+			}
+		}
+
+		value = source.substr(0, j);
+		source.remove_prefix(j);
+		return 0;
+	}
+
+	if constexpr (AllowNewLine) {
+		return 1;
+	} else {
+		return cur == '\n' ? 2 : 1;
+	}
+}
+
+// 读取到行尾，去除首尾的空白字符
+inline uint32_t GetNextString(std::string_view& source, std::string_view& value) noexcept {
+	RemoveLeadingBlanks<false>(source);
+	size_t pos = source.find('\n');
+
+	value = source.substr(0, pos);
+	Trim(value);
+	if (value.empty()) {
+		return 1;
+	}
+
+	source.remove_prefix(std::min(pos + 1, source.size()));
+	return 0;
+}
+
+template<typename T>
+inline uint32_t GetNextNumber(std::string_view& source, T& value) noexcept {
+	RemoveLeadingBlanks<false>(source);
+
+	if (source.empty()) {
+		return 1;
+	}
+
+	const auto& result = std::from_chars(source.data(), source.data() + source.size(), value);
+	if ((int)result.ec) {
+		return 1;
+	}
+
+	// 解析成功
+	source.remove_prefix(result.ptr - source.data());
+	return 0;
+}
+
+// 读取到行尾，删除所有空白字符
+inline uint32_t GetNextExpr(std::string_view& source, std::string& expr) {
+	RemoveLeadingBlanks<false>(source);
+	size_t size = std::min(source.find('\n') + 1, source.size());
+
+	// 移除空白字符
+	expr.resize(size);
+
+	size_t j = 0;
+	for (size_t i = 0; i < size; ++i) {
+		char c = source[i];
+		if (!IsSpace(c)) {
+			expr[j++] = c;
+		}
+	}
+	expr.resize(j);
+
+	if (expr.empty()) {
+		return 1;
+	}
+
+	source.remove_prefix(size);
+	return 0;
+}
+
+}
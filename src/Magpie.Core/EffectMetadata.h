@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <variant>
+
+// 效果的元数据，供用户界面使用。只依赖标准库
+namespace Magpie::Core {
+
+template <typename T>
+struct EffectConstant {
+	T defaultValue;
+	T minValue;
+	T maxValue;
+	T step;
+};
+
+struct EffectParameterDesc {
+	std::string name;
+	std::string label;
+	std::variant<EffectConstant<float>, EffectConstant<int>> constant;
+};
+
+// 供 YAS 序列化
+template<typename Archive>
+void serialize(Archive& ar, EffectParameterDesc& o) {
+	ar& o.name& o.label& o.constant;
+}
+
+struct EffectMetadata {
+	std::string sortName;
+	std::vector<EffectParameterDesc> params;
+	// OUTPUT 的尺寸表达式，为空表示效果可以缩放到任意尺寸
+	std::pair<std::string, std::string> outputSizeExpr;
+	bool useDynamic = false;
+};
+
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "EffectMetadataIndex.h"
+#include "CommonSharedConstants.h"
+#include "Logger.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include "YasHelper.h"
+
+namespace Magpie::Core {
+
+template<typename Archive>
+void serialize(Archive& ar, EffectMetadata& o) {
+	ar& o.sortName& o.params& o.outputSizeExpr& o.useDynamic;
+}
+
+template<typename Archive>
+void serialize(Archive& ar, EffectMetadataIndexEntry& o) {
+	ar& o.name& o.lastWriteTime& o.fileSize& o.metadata;
+}
+
+// 索引版本
+// 当索引结构或 EffectParser 的行为有更改时更新它，使旧索引失效
+static constexpr uint32_t EFFECT_METADATA_INDEX_VERSION = 1;
+
+static constexpr const wchar_t* INDEX_FILE_NAME = L"effects.idx";
+
+void EffectMetadataIndex::Load() noexcept {
+	_entries.clear();
+
+	const std::wstring fileName = StrUtils::Concat(CommonSharedConstants::CACHE_DIR, INDEX_FILE_NAME);
+	if (!Win32Utils::FileExists(fileName.c_str())) {
+		return;
+	}
+
+	std::vector<uint8_t> buffer;
+	if (!Win32Utils::ReadFile(fileName.c_str(), buffer) || buffer.empty()) {
+		return;
+	}
+
+	std::vector<EffectMetadataIndexEntry> entries;
+	try {
+		yas::mem_istream mi(buffer.data(), buffer.size());
+		yas::binary_iarchive<yas::mem_istream, yas::binary> ia(mi);
+
+		uint32_t version;
+		ia& version;
+		if (version != EFFECT_METADATA_INDEX_VERSION) {
+			Logger::Get().Info("效果索引版本不匹配");
+			return;
+		}
+
+		ia& entries;
+	} catch (...) {
+		Logger::Get().Error("反序列化效果索引失败");
+		return;
+	}
+
+	_entries.reserve(entries.size());
+	for (EffectMetadataIndexEntry& entry : entries) {
+		std::string name = entry.name;
+		_entries.emplace(std::move(name), std::move(entry));
+	}
+}
+
+const EffectMetadata* EffectMetadataIndex::Find(
+	std::string_view name,
+	uint64_t lastWriteTime,
+	uint64_t fileSize
+) const noexcept {
+	auto it = _entries.find(name);
+	if (it == _entries.end()) {
+		return nullptr;
+	}
+
+	const EffectMetadataIndexEntry& entry = it->second;
+	if (entry.lastWriteTime != lastWriteTime || entry.fileSize != fileSize) {
+		return nullptr;
+	}
+
+	return &entry.metadata;
+}
+
+void EffectMetadataIndex::Save(const std::vector<EffectMetadataIndexEntry>& entries) noexcept {
+	std::vector<uint8_t> buffer;
+	buffer.reserve(65536);
+
+	try {
+		yas::vector_ostream os(buffer);
+		yas::binary_oarchive<yas::vector_ostream<BYTE>, yas::binary> oa(os);
+
+		oa& EFFECT_METADATA_INDEX_VERSION& entries;
+	} catch (...) {
+		Logger::Get().Error("序列化效果索引失败");
+		return;
+	}
+
+	if (!CreateDirectory(CommonSharedConstants::CACHE_DIR, nullptr)
+			&& GetLastError() != ERROR_ALREADY_EXISTS) {
+		Logger::Get().Win32Error("创建 cache 文件夹失败");
+		return;
+	}
+
+	const std::wstring fileName = StrUtils::Concat(CommonSharedConstants::CACHE_DIR, INDEX_FILE_NAME);
+	if (!Win32Utils::WriteFile(fileName.c_str(), buffer.data(), buffer.size())) {
+		Logger::Get().Error("保存效果索引失败");
+	}
+}
+
+}
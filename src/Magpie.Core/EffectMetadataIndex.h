@@ -0,0 +1,36 @@
+#pragma once
+#include "EffectMetadata.h"
+#include <parallel_hashmap/phmap.h>
+
+namespace Magpie::Core {
+
+struct EffectMetadataIndexEntry {
+	// UTF-8 编码，不含扩展名
+	std::string name;
+	// 源文件的修改时间和大小，任一变化则需重新解析
+	uint64_t lastWriteTime = 0;
+	uint64_t fileSize = 0;
+	EffectMetadata metadata;
+};
+
+// 持久化的元数据索引，使启动时无需解析所有效果的源码
+class EffectMetadataIndex {
+public:
+	// 文件不存在、已损坏或版本不匹配时索引为空
+	void Load() noexcept;
+
+	// 源文件没有变化时返回缓存的元数据。Load 后可以并行调用
+	const EffectMetadata* Find(std::string_view name, uint64_t lastWriteTime, uint64_t fileSize) const noexcept;
+
+	size_t Size() const noexcept {
+		return _entries.size();
+	}
+
+	// 以 entries 替换整个索引，因此已删除的效果不会保留
+	static void Save(const std::vector<EffectMetadataIndexEntry>& entries) noexcept;
+
+private:
+	phmap::flat_hash_map<std::string, EffectMetadataIndexEntry> _entries;
+};
+
+}
@@ -0,0 +1,766 @@
+#include "EffectParser.h"
+#include "EffectLexer.h"
+#include <bitset>
+#include <bit>	// std::countr_zero
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace Magpie::Core::EffectLexer;
+
+namespace Magpie::Core {
+
+// 当前 MagpieFX 版本
+static constexpr uint32_t MAGPIE_FX_VERSION = 4;
+
+// 查找 c 第一次出现的位置，找不到时返回 size
+static size_t FindChar(const char* data, size_t size, size_t pos, char c) noexcept {
+#if defined(_M_X64) || defined(__SSE2__)
+	// 每次比较 16 个字节
+	const __m128i target = _mm_set1_epi8(c);
+	for (; pos + 16 <= size; pos += 16) {
+		const __m128i chunk = _mm_loadu_si128((const __m128i*)(data + pos));
+		if (const uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, target))) {
+			return pos + std::countr_zero(mask);
+		}
+	}
+#endif
+
+	if (pos >= size) {
+		return size;
+	}
+
+	const void* found = std::memchr(data + pos, c, size - pos);
+	return found ? size_t((const char*)found - data) : size;
+}
+
+// 查找 //! 第一次出现的位置，找不到时返回 size
+static size_t FindMetaIndicator(const char* data, size_t size, size_t pos) noexcept {
+#if defined(_M_X64) || defined(__SSE2__)
+	// 三个错开一个字节的加载分别和 //! 的每个字符比较
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i bang = _mm_set1_epi8('!');
+	for (; pos + 18 <= size; pos += 16) {
+		const __m128i c0 = _mm_loadu_si128((const __m128i*)(data + pos));
+		const __m128i c1 = _mm_loadu_si128((const __m128i*)(data + pos + 1));
+		const __m128i c2 = _mm_loadu_si128((const __m128i*)(data + pos + 2));
+		const __m128i match = _mm_and_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(c0, slash), _mm_cmpeq_epi8(c1, slash)),
+			_mm_cmpeq_epi8(c2, bang)
+		);
+		if (const uint32_t mask = (uint32_t)_mm_movemask_epi8(match)) {
+			return pos + std::countr_zero(mask);
+		}
+	}
+#endif
+
+	const size_t result = std::string_view(data, size).find(META_INDICATOR, pos);
+	return result == std::string_view::npos ? size : result;
+}
+
+uint32_t EffectParser::RemoveComments(std::string& source) noexcept {
+	// 确保以换行符结尾
+	if (source.empty() || source.back() != '\n') {
+		source.push_back('\n');
+	}
+
+	char* data = source.data();
+	const size_t size = source.size();
+
+	// 原地压缩，整段复制注释之间的代码
+	size_t j = 0;
+	size_t i = 0;
+	while (true) {
+		const size_t slash = FindChar(data, size, i, '/');
+		if (slash != i) {
+			std::memmove(data + j, data + i, slash - i);
+			j += slash - i;
+		}
+
+		// 必定以换行符结尾，因此 slash + 1 不会越界
+		if (slash == size) {
+			break;
+		}
+
+		if (data[slash + 1] == '/' && (slash + 2 == size || data[slash + 2] != '!')) {
+			// 行注释，保留换行符
+			i = FindChar(data, size, slash + 2, '\n');
+		} else if (data[slash + 1] == '*') {
+			// 块注释
+			size_t star = slash + 2;
+			while (true) {
+				star = FindChar(data, size, star, '*');
+				if (star + 1 >= size) {
+					// 未闭合
+					return 1;
+				}
+
+				if (data[star + 1] == '/') {
+					break;
+				}
+
+				++star;
+			}
+
+			i = star + 2;
+		} else {
+			data[j++] = '/';
+			i = slash + 1;
+		}
+	}
+
+	source.resize(j);
+
+	// 删除最后的换行符
+	if (!source.empty() && source.back() == '\n') {
+		source.pop_back();
+	}
+
+	return 0;
+}
+
+static bool CheckMagic(std::string_view& source) noexcept {
+	std::string_view token;
+	if (!CheckNextToken<true>(source, META_INDICATOR)) {
+		return false;
+	}
+
+	if (!CheckNextToken<false>(source, "MAGPIE")) {
+		return false;
+	}
+	if (!CheckNextToken<false>(source, "EFFECT")) {
+		return false;
+	}
+
+	if (GetNextToken<false>(source, token) != 2) {
+		return false;
+	}
+
+	if (source.empty()) {
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t EffectParser::SplitBlocks(std::string_view source, EffectSourceBlocks& blocks) noexcept {
+	// 检查头
+	if (!CheckMagic(source)) {
+		return 2;
+	}
+
+	enum class BlockType {
+		Header,
+		Parameter,
+		Texture,
+		Sampler,
+		Common,
+		Pass
+	};
+
+	BlockType curBlockType = BlockType::Header;
+	size_t curBlockOff = 0;
+
+	auto completeCurrentBlock = [&](size_t len, BlockType newBlockType) {
+		const std::string_view block = source.substr(curBlockOff, len);
+
+		switch (curBlockType) {
+		case BlockType::Header:
+			blocks.header = block;
+			break;
+		case BlockType::Parameter:
+			blocks.params.push_back(block);
+			break;
+		case BlockType::Texture:
+			blocks.textures.push_back(block);
+			break;
+		case BlockType::Sampler:
+			blocks.samplers.push_back(block);
+			break;
+		case BlockType::Common:
+			blocks.commons.push_back(block);
+			break;
+		case BlockType::Pass:
+			blocks.passes.push_back(block);
+			break;
+		default:
+			assert(false);
+			break;
+		}
+
+		curBlockType = newBlockType;
+		curBlockOff += len;
+	};
+
+	const char* data = source.data();
+	const size_t size = source.size();
+
+	// 直接查找 //!，无需逐个字符检查行首
+	size_t pos = 0;
+	while (true) {
+		const size_t marker = FindMetaIndicator(data, size, pos);
+		if (marker == size) {
+			break;
+		}
+		pos = marker + META_INDICATOR.size();
+
+		// 只有行首的 //! 才是元数据，即它之前的空白字符中有换行符。source 以 MAGPIE EFFECT 行的
+		// 换行符开头，因此第一行也能被识别
+		size_t runStart = marker;
+		while (runStart > 0 && IsSpace(data[runStart - 1])) {
+			--runStart;
+		}
+
+		// 块的边界位于这些空白字符中的第一个换行符之后
+		const size_t lineBreak = FindChar(data, marker, runStart, '\n');
+		if (lineBreak == marker) {
+			continue;
+		}
+
+		const size_t len = lineBreak + 1 - curBlockOff;
+
+		std::string_view t = source.substr(pos);
+		std::string_view token;
+		if (GetNextToken<false>(t, token)) {
+			return 1;
+		}
+		pos = t.data() - data;
+
+		if (EqualsUpper(token, "PARAMETER")) {
+			completeCurrentBlock(len, BlockType::Parameter);
+		} else if (EqualsUpper(token, "TEXTURE")) {
+			completeCurrentBlock(len, BlockType::Texture);
+		} else if (EqualsUpper(token, "SAMPLER")) {
+			completeCurrentBlock(len, BlockType::Sampler);
+		} else if (EqualsUpper(token, "COMMON")) {
+			completeCurrentBlock(len, BlockType::Common);
+		} else if (EqualsUpper(token, "PASS")) {
+			completeCurrentBlock(len, BlockType::Pass);
+		}
+	}
+
+	completeCurrentBlock(source.size() - curBlockOff, BlockType::Header);
+	return 0;
+}
+
+uint32_t EffectParser::ResolveHeader(std::string_view block, EffectMetadata& metadata) noexcept {
+	// 必需的选项: VERSION
+	// 可选的选项: USE_DYNAMIC, SORT_NAME
+
+	std::bitset<3> processed;
+
+	std::string_view token;
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+
+		if (EqualsUpper(token, "VERSION")) {
+			if (processed[0]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			uint32_t version;
+			if (GetNextNumber(block, version)) {
+				return 1;
+			}
+
+			if (version != MAGPIE_FX_VERSION) {
+				return 1;
+			}
+
+			if (GetNextToken<false>(block, token) != 2) {
+				return 1;
+			}
+		} else if (EqualsUpper(token, "USE_DYNAMIC")) {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			if (GetNextToken<false>(block, token) != 2) {
+				return 1;
+			}
+
+			metadata.useDynamic = true;
+		} else if (EqualsUpper(token, "SORT_NAME")) {
+			if (processed[2]) {
+				return 1;
+			}
+			processed[2] = true;
+
+			std::string_view sortName;
+			if (GetNextString(block, sortName)) {
+				return 1;
+			}
+
+			metadata.sortName = sortName;
+		} else {
+			return 1;
+		}
+	}
+
+	// HEADER 块不含代码部分
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	if (!processed[0]) {
+		return 1;
+	}
+
+	return 0;
+}
+
+template<typename T>
+static uint32_t ResolveConstant(
+	std::string_view defaultValue,
+	std::string_view minValue,
+	std::string_view maxValue,
+	std::string_view stepValue,
+	EffectConstant<T>& constant
+) noexcept {
+	if (GetNextNumber(defaultValue, constant.defaultValue)) {
+		return 1;
+	}
+	if (GetNextNumber(minValue, constant.minValue)) {
+		return 1;
+	}
+	if (GetNextNumber(maxValue, constant.maxValue)) {
+		return 1;
+	}
+	if (GetNextNumber(stepValue, constant.step)) {
+		return 1;
+	}
+
+	if (constant.defaultValue < constant.minValue || constant.maxValue < constant.defaultValue) {
+		return 1;
+	}
+
+	return 0;
+}
+
+uint32_t EffectParser::ResolveParameter(std::string_view block, EffectParameterDesc& paramDesc) noexcept {
+	// 必需的选项: DEFAULT, MIN, MAX, STEP
+	// 可选的选项: LABEL
+
+	std::bitset<5> processed;
+
+	std::string_view token;
+
+	if (!CheckNextToken<true>(block, META_INDICATOR)) {
+		return 1;
+	}
+
+	if (!CheckNextToken<false>(block, "PARAMETER")) {
+		return 1;
+	}
+	if (GetNextToken<false>(block, token) != 2) {
+		return 1;
+	}
+
+	std::string_view defaultValue;
+	std::string_view minValue;
+	std::string_view maxValue;
+	std::string_view stepValue;
+
+	while (true) {
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			break;
+		}
+
+		if (GetNextToken<false>(block, token)) {
+			return 1;
+		}
+
+		if (EqualsUpper(token, "DEFAULT")) {
+			if (processed[0]) {
+				return 1;
+			}
+			processed[0] = true;
+
+			if (GetNextString(block, defaultValue)) {
+				return 1;
+			}
+		} else if (EqualsUpper(token, "LABEL")) {
+			if (processed[1]) {
+				return 1;
+			}
+			processed[1] = true;
+
+			std::string_view label;
+			if (GetNextString(block, label)) {
+				return 1;
+			}
+			paramDesc.label = label;
+		} else if (EqualsUpper(token, "MIN")) {
+			if (processed[2]) {
+				return 1;
+			}
+			processed[2] = true;
+
+			if (GetNextString(block, minValue)) {
+				return 1;
+			}
+		} else if (EqualsUpper(token, "MAX")) {
+			if (processed[3]) {
+				return 1;
+			}
+			processed[3] = true;
+
+			if (GetNextString(block, maxValue)) {
+				return 1;
+			}
+		} else if (EqualsUpper(token, "STEP")) {
+			if (processed[4]) {
+				return 1;
+			}
+			processed[4] = true;
+
+			if (GetNextString(block, stepValue)) {
+				return 1;
+			}
+		} else {
+			return 1;
+		}
+	}
+
+	// 检查必选项
+	if (!processed[0] || !processed[2] || !processed[3] || !processed[4]) {
+		return 1;
+	}
+
+	// 代码部分
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+
+	if (token == "float") {
+		if (ResolveConstant(defaultValue, minValue, maxValue, stepValue, paramDesc.constant.emplace<0>())) {
+			return 1;
+		}
+	} else if (token == "int") {
+		if (ResolveConstant(defaultValue, minValue, maxValue, stepValue, paramDesc.constant.emplace<1>())) {
+			return 1;
+		}
+	} else {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token)) {
+		return 1;
+	}
+	paramDesc.name = token;
+
+	if (!CheckNextToken<true>(block, ";")) {
+		return 1;
+	}
+
+	if (GetNextToken<true>(block, token) != 2) {
+		return 1;
+	}
+
+	return 0;
+}
+
+uint32_t EffectParser::ResolveOutputSize(
+	const SmallVector<std::string_view>& textureBlocks,
+	std::pair<std::string, std::string>& outputSizeExpr
+) noexcept {
+	for (std::string_view block : textureBlocks) {
+		std::string_view token;
+
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			return 1;
+		}
+		if (!CheckNextToken<false>(block, "TEXTURE")) {
+			return 1;
+		}
+		if (GetNextToken<false>(block, token) != 2) {
+			return 1;
+		}
+
+		std::pair<std::string, std::string> sizeExpr;
+		bool hasOtherOptions = false;
+
+		while (true) {
+			if (!CheckNextToken<true>(block, META_INDICATOR)) {
+				break;
+			}
+
+			if (GetNextToken<false>(block, token)) {
+				return 1;
+			}
+
+			if (EqualsUpper(token, "WIDTH")) {
+				if (!sizeExpr.first.empty() || GetNextExpr(block, sizeExpr.first)) {
+					return 1;
+				}
+			} else if (EqualsUpper(token, "HEIGHT")) {
+				if (!sizeExpr.second.empty() || GetNextExpr(block, sizeExpr.second)) {
+					return 1;
+				}
+			} else {
+				// 其他选项由 EffectCompiler 检查
+				hasOtherOptions = true;
+				if (GetNextString(block, token)) {
+					return 1;
+				}
+			}
+		}
+
+		if (!CheckNextToken<true>(block, "Texture2D")) {
+			return 1;
+		}
+		if (GetNextToken<true>(block, token)) {
+			return 1;
+		}
+
+		if (token != "OUTPUT") {
+			continue;
+		}
+
+		// OUTPUT 只能有 WIDTH 和 HEIGHT，且必须成对出现
+		if (hasOtherOptions || sizeExpr.first.empty() != sizeExpr.second.empty()) {
+			return 1;
+		}
+
+		outputSizeExpr = std::move(sizeExpr);
+	}
+
+	return 0;
+}
+
+// 返回 token 在 options 中的位置，找不到时返回 options.size()
+static size_t FindOption(std::string_view token, std::initializer_list<std::string_view> options) noexcept {
+	size_t i = 0;
+	for (std::string_view option : options) {
+		if (EqualsUpper(token, option)) {
+			break;
+		}
+		++i;
+	}
+	return i;
+}
+
+// 检查 TEXTURE 块的结构并收集纹理名，选项的值由 EffectCompiler 检查
+static uint32_t CheckTextures(
+	const SmallVector<std::string_view>& textureBlocks,
+	std::vector<std::string_view>& texNames
+) noexcept {
+	texNames = { "INPUT", "OUTPUT" };
+
+	for (std::string_view block : textureBlocks) {
+		std::string_view token;
+
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			return 1;
+		}
+		if (!CheckNextToken<false>(block, "TEXTURE")) {
+			return 1;
+		}
+		if (GetNextToken<false>(block, token) != 2) {
+			return 1;
+		}
+
+		std::bitset<4> processed;
+		while (CheckNextToken<true>(block, META_INDICATOR)) {
+			if (GetNextToken<false>(block, token)) {
+				return 1;
+			}
+
+			const size_t idx = FindOption(token, { "SOURCE", "FORMAT", "WIDTH", "HEIGHT" });
+			if (idx == processed.size() || processed[idx]) {
+				return 1;
+			}
+			processed[idx] = true;
+
+			if (GetNextString(block, token)) {
+				return 1;
+			}
+		}
+
+		if (!CheckNextToken<true>(block, "Texture2D")) {
+			return 1;
+		}
+		if (GetNextToken<true>(block, token)) {
+			return 1;
+		}
+
+		// INPUT 和 OUTPUT 可以不声明
+		if (token == "INPUT" || token == "OUTPUT") {
+			continue;
+		}
+
+		if (std::find(texNames.begin(), texNames.end(), token) != texNames.end()) {
+			return 1;
+		}
+		texNames.push_back(token);
+	}
+
+	return 0;
+}
+
+// IN 和 OUT 中的纹理必须已声明。OUTPUT 不能作为输入，最后一个通道只能输出到 OUTPUT
+static uint32_t CheckPassTextures(
+	std::string_view value,
+	const std::vector<std::string_view>& texNames,
+	bool isOutput,
+	bool isLastPass
+) noexcept {
+	if (isOutput && isLastPass) {
+		return value == "OUTPUT" ? 0 : 1;
+	}
+
+	while (true) {
+		const size_t delimPos = value.find(',');
+		std::string_view name = value.substr(0, delimPos);
+		Trim(name);
+
+		if ((isOutput ? name == "INPUT" : name == "OUTPUT")
+			|| std::find(texNames.begin(), texNames.end(), name) == texNames.end()) {
+			return 1;
+		}
+
+		if (delimPos == std::string_view::npos) {
+			return 0;
+		}
+		value.remove_prefix(delimPos + 1);
+	}
+}
+
+// 检查 PASS 块的结构，选项的值和着色器代码由 EffectCompiler 检查
+static uint32_t CheckPasses(
+	const SmallVector<std::string_view>& passBlocks,
+	const std::vector<std::string_view>& texNames
+) noexcept {
+	// 必须有 PASS 块
+	if (passBlocks.empty()) {
+		return 1;
+	}
+
+	// 通道序号必须从 1 开始且连续
+	std::vector<bool> indexUsed(passBlocks.size());
+
+	for (std::string_view block : passBlocks) {
+		std::string_view token;
+
+		if (!CheckNextToken<true>(block, META_INDICATOR)) {
+			return 1;
+		}
+		if (!CheckNextToken<false>(block, "PASS")) {
+			return 1;
+		}
+
+		uint32_t index;
+		if (GetNextNumber(block, index)) {
+			return 1;
+		}
+		if (GetNextToken<false>(block, token) != 2) {
+			return 1;
+		}
+
+		if (index == 0 || index > passBlocks.size() || indexUsed[index - 1]) {
+			return 1;
+		}
+		indexUsed[index - 1] = true;
+
+		const bool isLastPass = index == passBlocks.size();
+		bool isPSStyle = false;
+
+		std::bitset<7> processed;
+		while (CheckNextToken<true>(block, META_INDICATOR)) {
+			if (GetNextToken<false>(block, token)) {
+				return 1;
+			}
+
+			const size_t idx = FindOption(token,
+				{ "IN", "OUT", "BLOCK_SIZE", "NUM_THREADS", "STYLE", "DESC", "DIRTY_RADIUS" });
+			if (idx == processed.size() || processed[idx]) {
+				return 1;
+			}
+			processed[idx] = true;
+
+			std::string_view value;
+			if (GetNextString(block, value)) {
+				return 1;
+			}
+
+			if (idx <= 1) {
+				if (CheckPassTextures(value, texNames, idx == 1, isLastPass)) {
+					return 1;
+				}
+			} else if (idx == 4) {
+				if (value == "PS") {
+					isPSStyle = true;
+				} else if (value != "CS") {
+					return 1;
+				}
+			}
+		}
+
+		// 必须指定 IN 和 OUT。PS 样式不能指定 BLOCK_SIZE 和 NUM_THREADS，CS 样式必须指定
+		if (!processed[0] || !processed[1]) {
+			return 1;
+		}
+		if (isPSStyle ? (processed[2] || processed[3]) : (!processed[2] || !processed[3])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+uint32_t EffectParser::ParseMetadata(std::string& source, EffectMetadata& metadata) noexcept {
+	if (RemoveComments(source)) {
+		return 1;
+	}
+
+	EffectSourceBlocks blocks;
+	if (uint32_t result = SplitBlocks(source, blocks)) {
+		return result;
+	}
+
+	if (ResolveHeader(blocks.header, metadata)) {
+		return 1;
+	}
+
+	metadata.params.clear();
+	metadata.params.reserve(blocks.params.size());
+	for (std::string_view block : blocks.params) {
+		EffectParameterDesc& paramDesc = metadata.params.emplace_back();
+		if (ResolveParameter(block, paramDesc)) {
+			return 1;
+		}
+
+		// 确保没有重复的名字
+		for (size_t i = 0; i + 1 < metadata.params.size(); ++i) {
+			if (metadata.params[i].name == paramDesc.name) {
+				return 1;
+			}
+		}
+	}
+
+	if (ResolveOutputSize(blocks.textures, metadata.outputSizeExpr)) {
+		return 1;
+	}
+
+	// 结构错误的效果无法编译，不应出现在效果列表中
+	std::vector<std::string_view> texNames;
+	if (CheckTextures(blocks.textures, texNames)) {
+		return 1;
+	}
+
+	return CheckPasses(blocks.passes, texNames);
+}
+
+}
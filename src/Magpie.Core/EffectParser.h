@@ -0,0 +1,40 @@
+#pragma once
+#include "EffectMetadata.h"
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+// 源码中各个块的位置，不含 //!MAGPIE EFFECT 行
+struct EffectSourceBlocks {
+	std::string_view header;
+	SmallVector<std::string_view> params;
+	SmallVector<std::string_view> textures;
+	SmallVector<std::string_view> samplers;
+	SmallVector<std::string_view> commons;
+	SmallVector<std::string_view> passes;
+};
+
+// MagpieFX 的前端，解析 //! 元数据。只依赖标准库，和 D3D 及 Win32 无关，EffectCompiler 在此
+// 基础上解析其余的块并编译着色器。返回值均为 0 表示成功
+struct EffectParser {
+	// 删除注释，保留以 //! 开头的行
+	static uint32_t RemoveComments(std::string& source) noexcept;
+
+	// source 必须已删除注释，blocks 引用 source
+	static uint32_t SplitBlocks(std::string_view source, EffectSourceBlocks& blocks) noexcept;
+
+	static uint32_t ResolveHeader(std::string_view block, EffectMetadata& metadata) noexcept;
+
+	static uint32_t ResolveParameter(std::string_view block, EffectParameterDesc& paramDesc) noexcept;
+
+	// 在 TEXTURE 块中查找 OUTPUT 的尺寸，不检查其他纹理
+	static uint32_t ResolveOutputSize(
+		const SmallVector<std::string_view>& textureBlocks,
+		std::pair<std::string, std::string>& outputSizeExpr
+	) noexcept;
+
+	// 解析用户界面需要的元数据，并检查 TEXTURE 和 PASS 块的结构。不检查 SAMPLER、COMMON 块和着色器代码
+	static uint32_t ParseMetadata(std::string& source, EffectMetadata& metadata) noexcept;
+};
+
+}
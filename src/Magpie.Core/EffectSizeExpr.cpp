@@ -0,0 +1,484 @@
+#include "EffectSizeExpr.h"
+#include "EffectLexer.h"
+#include <cmath>
+#include <numbers>
+
+namespace Magpie::Core {
+
+// 字节码求值时栈的容量，超过此深度的表达式在编译时被拒绝
+static constexpr uint32_t MAX_STACK_DEPTH = 32;
+
+static double ApplyOp(EffectSizeExprOp op, const double* args, uint32_t argCount) noexcept {
+	switch (op) {
+	case EffectSizeExprOp::Neg:
+		return -args[0];
+	case EffectSizeExprOp::Not:
+		return args[0] == 0 ? 1.0 : 0.0;
+	case EffectSizeExprOp::Abs:
+		return std::abs(args[0]);
+	case EffectSizeExprOp::Sign:
+		return args[0] > 0 ? 1.0 : (args[0] < 0 ? -1.0 : 0.0);
+	case EffectSizeExprOp::Rint:
+		return std::rint(args[0]);
+	case EffectSizeExprOp::Sqrt:
+		return std::sqrt(args[0]);
+	case EffectSizeExprOp::Exp:
+		return std::exp(args[0]);
+	case EffectSizeExprOp::Ln:
+		return std::log(args[0]);
+	case EffectSizeExprOp::Log2:
+		return std::log2(args[0]);
+	case EffectSizeExprOp::Log10:
+		return std::log10(args[0]);
+	case EffectSizeExprOp::Add:
+		return args[0] + args[1];
+	case EffectSizeExprOp::Sub:
+		return args[0] - args[1];
+	case EffectSizeExprOp::Mul:
+		return args[0] * args[1];
+	case EffectSizeExprOp::Div:
+		return args[0] / args[1];
+	case EffectSizeExprOp::Pow:
+		return std::pow(args[0], args[1]);
+	case EffectSizeExprOp::Less:
+		return args[0] < args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::LessEqual:
+		return args[0] <= args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::Greater:
+		return args[0] > args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::GreaterEqual:
+		return args[0] >= args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::Equal:
+		return args[0] == args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::NotEqual:
+		return args[0] != args[1] ? 1.0 : 0.0;
+	case EffectSizeExprOp::And:
+		return args[0] != 0 && args[1] != 0 ? 1.0 : 0.0;
+	case EffectSizeExprOp::Or:
+		return args[0] != 0 || args[1] != 0 ? 1.0 : 0.0;
+	case EffectSizeExprOp::Select:
+		return args[0] != 0 ? args[1] : args[2];
+	case EffectSizeExprOp::Min:
+	{
+		double result = args[0];
+		for (uint32_t i = 1; i < argCount; ++i) {
+			result = std::min(result, args[i]);
+		}
+		return result;
+	}
+	case EffectSizeExprOp::Max:
+	{
+		double result = args[0];
+		for (uint32_t i = 1; i < argCount; ++i) {
+			result = std::max(result, args[i]);
+		}
+		return result;
+	}
+	case EffectSizeExprOp::Sum:
+	case EffectSizeExprOp::Avg:
+	{
+		double result = 0;
+		for (uint32_t i = 0; i < argCount; ++i) {
+			result += args[i];
+		}
+		return op == EffectSizeExprOp::Avg ? result / argCount : result;
+	}
+	default:
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+}
+
+static uint32_t GetArgCount(const EffectSizeExprInst& inst) noexcept {
+	switch (inst.op) {
+	case EffectSizeExprOp::Const:
+	case EffectSizeExprOp::InputWidth:
+	case EffectSizeExprOp::InputHeight:
+	case EffectSizeExprOp::OutputWidth:
+	case EffectSizeExprOp::OutputHeight:
+		return 0;
+	case EffectSizeExprOp::Select:
+		return 3;
+	case EffectSizeExprOp::Min:
+	case EffectSizeExprOp::Max:
+	case EffectSizeExprOp::Sum:
+	case EffectSizeExprOp::Avg:
+		return inst.argCount;
+	default:
+		return inst.op < EffectSizeExprOp::Add ? 1 : 2;
+	}
+}
+
+namespace {
+
+// 递归下降解析，直接生成后缀形式的字节码。优先级和 muParser 相同，从低到高依次为
+// ?:、||、&&、比较、+ -、* /、一元 + - !、^。注意 -2^2 为 -4
+class SizeExprCompiler {
+public:
+	SizeExprCompiler(std::string_view expr, bool allowOutputSize, EffectSizeBytecode& bytecode) noexcept
+		: _expr(expr), _allowOutputSize(allowOutputSize), _bytecode(bytecode) {}
+
+	bool Compile() noexcept {
+		_bytecode.clear();
+		return _ParseTernary() && (_SkipBlanks(), _expr.empty()) && _depth == 1;
+	}
+
+private:
+	void _SkipBlanks() noexcept {
+		EffectLexer::RemoveLeadingBlanks<true>(_expr);
+	}
+
+	bool _Accept(std::string_view token) noexcept {
+		return EffectLexer::CheckNextToken<true>(_expr, token);
+	}
+
+	// 运算数均为常量时直接折叠
+	bool _Emit(EffectSizeExprOp op, uint32_t argCount = 0) noexcept {
+		EffectSizeExprInst inst;
+		inst.op = op;
+		inst.argCount = (uint8_t)argCount;
+
+		const uint32_t popCount = GetArgCount(inst);
+		if (_depth < popCount) {
+			return false;
+		}
+
+		if (popCount > 0 && _bytecode.size() >= popCount) {
+			const size_t first = _bytecode.size() - popCount;
+			double args[MAX_STACK_DEPTH];
+			bool allConst = true;
+			for (uint32_t i = 0; i < popCount; ++i) {
+				const EffectSizeExprInst& arg = _bytecode[first + i];
+				if (arg.op != EffectSizeExprOp::Const) {
+					allConst = false;
+					break;
+				}
+				args[i] = arg.value;
+			}
+
+			if (allConst) {
+				const double value = ApplyOp(op, args, popCount);
+				_bytecode.resize(first + 1);
+				_bytecode.back() = EffectSizeExprInst{ .value = value };
+				_depth = _depth - popCount + 1;
+				return true;
+			}
+		}
+
+		_bytecode.push_back(inst);
+		_depth = _depth - popCount + 1;
+		if (_depth > _maxDepth) {
+			_maxDepth = _depth;
+		}
+		return _maxDepth <= MAX_STACK_DEPTH;
+	}
+
+	bool _EmitConst(double value) noexcept {
+		_bytecode.push_back(EffectSizeExprInst{ .value = value });
+		if (++_depth > _maxDepth) {
+			_maxDepth = _depth;
+		}
+		return _maxDepth <= MAX_STACK_DEPTH;
+	}
+
+	bool _ParseTernary() noexcept {
+		if (!_ParseBinary(0)) {
+			return false;
+		}
+
+		if (!_Accept("?")) {
+			return true;
+		}
+
+		// 右结合
+		return _ParseTernary() && _Accept(":") && _ParseTernary() && _Emit(EffectSizeExprOp::Select);
+	}
+
+	// level 越大优先级越高
+	bool _ParseBinary(uint32_t level) noexcept {
+		if (level == 5) {
+			return _ParseUnary();
+		}
+
+		if (!_ParseBinary(level + 1)) {
+			return false;
+		}
+
+		while (true) {
+			EffectSizeExprOp op;
+			if (!_MatchBinaryOp(level, op)) {
+				return true;
+			}
+
+			if (!_ParseBinary(level + 1) || !_Emit(op)) {
+				return false;
+			}
+		}
+	}
+
+	bool _MatchBinaryOp(uint32_t level, EffectSizeExprOp& op) noexcept {
+		switch (level) {
+		case 0:
+			if (_Accept("||")) {
+				op = EffectSizeExprOp::Or;
+				return true;
+			}
+			return false;
+		case 1:
+			if (_Accept("&&")) {
+				op = EffectSizeExprOp::And;
+				return true;
+			}
+			return false;
+		case 2:
+			// 先匹配较长的运算符
+			if (_Accept("<=")) {
+				op = EffectSizeExprOp::LessEqual;
+			} else if (_Accept(">=")) {
+				op = EffectSizeExprOp::GreaterEqual;
+			} else if (_Accept("==")) {
+				op = EffectSizeExprOp::Equal;
+			} else if (_Accept("!=")) {
+				op = EffectSizeExprOp::NotEqual;
+			} else if (_Accept("<")) {
+				op = EffectSizeExprOp::Less;
+			} else if (_Accept(">")) {
+				op = EffectSizeExprOp::Greater;
+			} else {
+				return false;
+			}
+			return true;
+		case 3:
+			if (_Accept("+")) {
+				op = EffectSizeExprOp::Add;
+			} else if (_Accept("-")) {
+				op = EffectSizeExprOp::Sub;
+			} else {
+				return false;
+			}
+			return true;
+		default:
+			if (_Accept("*")) {
+				op = EffectSizeExprOp::Mul;
+			} else if (_Accept("/")) {
+				op = EffectSizeExprOp::Div;
+			} else {
+				return false;
+			}
+			return true;
+		}
+	}
+
+	bool _ParseUnary() noexcept {
+		if (_Accept("-")) {
+			return _ParseUnary() && _Emit(EffectSizeExprOp::Neg);
+		}
+		if (_Accept("+")) {
+			return _ParseUnary();
+		}
+		// 避免和 != 混淆
+		_SkipBlanks();
+		if (_expr.starts_with('!') && !_expr.starts_with("!=")) {
+			_expr.remove_prefix(1);
+			return _ParseUnary() && _Emit(EffectSizeExprOp::Not);
+		}
+
+		return _ParsePower();
+	}
+
+	bool _ParsePower() noexcept {
+		if (!_ParsePrimary()) {
+			return false;
+		}
+
+		if (!_Accept("^")) {
+			return true;
+		}
+
+		// 右结合，指数可以带负号，如 2^-1
+		return _ParseUnary() && _Emit(EffectSizeExprOp::Pow);
+	}
+
+	bool _ParsePrimary() noexcept {
+		_SkipBlanks();
+		if (_expr.empty()) {
+			return false;
+		}
+
+		if (_Accept("(")) {
+			return _ParseTernary() && _Accept(")");
+		}
+
+		const char c = _expr.front();
+		if ((c >= '0' && c <= '9') || c == '.') {
+			double value = 0;
+			const auto& result = std::from_chars(_expr.data(), _expr.data() + _expr.size(), value);
+			if ((int)result.ec) {
+				return false;
+			}
+			_expr.remove_prefix(result.ptr - _expr.data());
+			return _EmitConst(value);
+		}
+
+		std::string_view name;
+		if (EffectLexer::GetNextToken<true>(_expr, name) != 0) {
+			return false;
+		}
+
+		if (name == "INPUT_WIDTH") {
+			return _Emit(EffectSizeExprOp::InputWidth);
+		} else if (name == "INPUT_HEIGHT") {
+			return _Emit(EffectSizeExprOp::InputHeight);
+		} else if (name == "OUTPUT_WIDTH") {
+			return _allowOutputSize && _Emit(EffectSizeExprOp::OutputWidth);
+		} else if (name == "OUTPUT_HEIGHT") {
+			return _allowOutputSize && _Emit(EffectSizeExprOp::OutputHeight);
+		} else if (name == "_pi") {
+			return _EmitConst(std::numbers::pi);
+		} else if (name == "_e") {
+			return _EmitConst(std::numbers::e);
+		}
+
+		return _ParseFunction(name);
+	}
+
+	bool _ParseFunction(std::string_view name) noexcept {
+		static constexpr std::pair<std::string_view, EffectSizeExprOp> UNARY_FUNCS[] = {
+			{ "abs", EffectSizeExprOp::Abs },
+			{ "sign", EffectSizeExprOp::Sign },
+			{ "rint", EffectSizeExprOp::Rint },
+			{ "sqrt", EffectSizeExprOp::Sqrt },
+			{ "exp", EffectSizeExprOp::Exp },
+			{ "ln", EffectSizeExprOp::Ln },
+			// 和 muParser 相同，log 为以 10 为底的对数
+			{ "log", EffectSizeExprOp::Log10 },
+			{ "log2", EffectSizeExprOp::Log2 },
+			{ "log10", EffectSizeExprOp::Log10 }
+		};
+		static constexpr std::pair<std::string_view, EffectSizeExprOp> VARIADIC_FUNCS[] = {
+			{ "min", EffectSizeExprOp::Min },
+			{ "max", EffectSizeExprOp::Max },
+			{ "sum", EffectSizeExprOp::Sum },
+			{ "avg", EffectSizeExprOp::Avg }
+		};
+
+		bool variadic = false;
+		EffectSizeExprOp op{};
+		if (auto it = std::find_if(std::begin(UNARY_FUNCS), std::end(UNARY_FUNCS),
+			[&](const auto& func) { return func.first == name; }); it != std::end(UNARY_FUNCS)) {
+			op = it->second;
+		} else if (auto it1 = std::find_if(std::begin(VARIADIC_FUNCS), std::end(VARIADIC_FUNCS),
+			[&](const auto& func) { return func.first == name; }); it1 != std::end(VARIADIC_FUNCS)) {
+			op = it1->second;
+			variadic = true;
+		} else {
+			return false;
+		}
+
+		if (!_Accept("(")) {
+			return false;
+		}
+
+		uint32_t argCount = 0;
+		do {
+			if (!_ParseTernary() || ++argCount > UINT8_MAX) {
+				return false;
+			}
+		} while (_Accept(","));
+
+		if (!_Accept(")") || (!variadic && argCount != 1)) {
+			return false;
+		}
+
+		return _Emit(op, argCount);
+	}
+
+	std::string_view _expr;
+	bool _allowOutputSize;
+	EffectSizeBytecode& _bytecode;
+	// 求值时栈的当前深度和最大深度
+	uint32_t _depth = 0;
+	uint32_t _maxDepth = 0;
+};
+
+}
+
+bool EffectSizeExpr::Compile(std::string_view expr, bool allowOutputSize, EffectSizeBytecode& bytecode) noexcept {
+	if (!SizeExprCompiler(expr, allowOutputSize, bytecode).Compile()) {
+		bytecode.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool EffectSizeExpr::Evaluate(const EffectSizeBytecode& bytecode, const EffectSizeExprVars& vars, double& result) noexcept {
+	double stack[MAX_STACK_DEPTH];
+	uint32_t depth = 0;
+
+	for (const EffectSizeExprInst& inst : bytecode) {
+		double value;
+		switch (inst.op) {
+		case EffectSizeExprOp::Const:
+			value = inst.value;
+			break;
+		case EffectSizeExprOp::InputWidth:
+			value = vars.inputWidth;
+			break;
+		case EffectSizeExprOp::InputHeight:
+			value = vars.inputHeight;
+			break;
+		case EffectSizeExprOp::OutputWidth:
+			value = vars.outputWidth;
+			break;
+		case EffectSizeExprOp::OutputHeight:
+			value = vars.outputHeight;
+			break;
+		default:
+		{
+			// 字节码可能来自缓存，不能信任
+			const uint32_t argCount = GetArgCount(inst);
+			if (argCount == 0 || depth < argCount) {
+				return false;
+			}
+			depth -= argCount;
+			value = ApplyOp(inst.op, stack + depth, argCount);
+			break;
+		}
+		}
+
+		if (depth == MAX_STACK_DEPTH) {
+			return false;
+		}
+		stack[depth++] = value;
+	}
+
+	if (depth != 1 || !std::isfinite(stack[0])) {
+		return false;
+	}
+
+	result = stack[0];
+	return true;
+}
+
+bool EffectSizeExpr::EvaluateSize(
+	const std::pair<EffectSizeBytecode, EffectSizeBytecode>& bytecode,
+	const EffectSizeExprVars& vars,
+	int32_t& width,
+	int32_t& height
+) noexcept {
+	double w, h;
+	if (!Evaluate(bytecode.first, vars, w) || !Evaluate(bytecode.second, vars, h)) {
+		return false;
+	}
+
+	// 防止溢出
+	if (w < 0.5 || h < 0.5 || w >= (double)INT32_MAX || h >= (double)INT32_MAX) {
+		return false;
+	}
+
+	width = (int32_t)std::lround(w);
+	height = (int32_t)std::lround(h);
+	return true;
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <string_view>
+#include <utility>
+#include "SmallVector.h"
+
+// 纹理尺寸表达式。编译时转换为基于栈的字节码，初始化时直接求值，无需再解析。只依赖标准库
+namespace Magpie::Core {
+
+enum class EffectSizeExprOp : uint8_t {
+	Const,
+	InputWidth,
+	InputHeight,
+	OutputWidth,
+	OutputHeight,
+	// 一元运算
+	Neg,
+	Not,
+	Abs,
+	Sign,
+	Rint,
+	Sqrt,
+	Exp,
+	Ln,
+	Log2,
+	Log10,
+	// 二元运算
+	Add,
+	Sub,
+	Mul,
+	Div,
+	Pow,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+	Equal,
+	NotEqual,
+	And,
+	Or,
+	// 三元运算 ?:
+	Select,
+	// 参数数量由 argCount 指定
+	Min,
+	Max,
+	Sum,
+	Avg
+};
+
+struct EffectSizeExprInst {
+	// 仅用于 Const
+	double value = 0;
+	EffectSizeExprOp op = EffectSizeExprOp::Const;
+	// 仅用于 Min、Max、Sum 和 Avg
+	uint8_t argCount = 0;
+};
+
+using EffectSizeBytecode = SmallVector<EffectSizeExprInst, 4>;
+
+struct EffectSizeExprVars {
+	double inputWidth;
+	double inputHeight;
+	double outputWidth;
+	double outputHeight;
+};
+
+struct EffectSizeExpr {
+	// 语法和 muParser 兼容: 数字、INPUT_WIDTH 等常量、_pi、_e、+ - * / ^、比较和逻辑运算、?:，
+	// 以及函数 abs、sign、rint、sqrt、exp、ln、log、log2、log10、min、max、sum、avg。
+	// 只含常量的部分会被折叠。allowOutputSize 为 false 时不能使用 OUTPUT_WIDTH 和 OUTPUT_HEIGHT
+	static bool Compile(std::string_view expr, bool allowOutputSize, EffectSizeBytecode& bytecode) noexcept;
+
+	// 结果不是有限值时返回 false
+	static bool Evaluate(const EffectSizeBytecode& bytecode, const EffectSizeExprVars& vars, double& result) noexcept;
+
+	// 计算宽和高并四舍五入，任一不是正数时返回 false
+	static bool EvaluateSize(
+		const std::pair<EffectSizeBytecode, EffectSizeBytecode>& bytecode,
+		const EffectSizeExprVars& vars,
+		int32_t& width,
+		int32_t& height
+	) noexcept;
+};
+
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "EffectTextureAllocator.h"
+#include "DirectXHelper.h"
+#include "Logger.h"
+#include "BackendDescriptorStore.h"
+
+namespace Magpie::Core {
+
+// 只需支持 EffectHelper::FORMAT_DESCS 中的格式
+static uint32_t GetBitsPerPixel(DXGI_FORMAT format) noexcept {
+	switch (format) {
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 64;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R32_FLOAT:
+		return 32;
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_SNORM:
+		return 16;
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_SNORM:
+		return 8;
+	default:
+		return 32;
+	}
+}
+
+winrt::com_ptr<ID3D11Texture2D> EffectTextureAllocator::Acquire(DXGI_FORMAT format, SIZE size) noexcept {
+	const uint64_t bytes = (uint64_t)size.cx * size.cy * GetBitsPerPixel(format) / 8;
+	_requestedBytes += bytes;
+
+	const auto isMatch = [&](const _FreeTexture& t) {
+		return t.format == format && t.size.cx == size.cx && t.size.cy == size.cy;
+	};
+
+	auto it = std::find_if(_freeTextures.begin(), _freeTextures.end(), isMatch);
+	if (it != _freeTextures.end()) {
+		winrt::com_ptr<ID3D11Texture2D> result = std::move(it->texture);
+		_freeTextures.erase(it);
+		return result;
+	}
+
+	// 其次取用上一次分配的纹理，无需创建纹理和视图
+	it = std::find_if(_recycledTextures.begin(), _recycledTextures.end(), isMatch);
+	if (it != _recycledTextures.end()) {
+		winrt::com_ptr<ID3D11Texture2D> result = std::move(it->texture);
+		_recycledTextures.erase(it);
+		_allocatedBytes += bytes;
+		return result;
+	}
+
+	winrt::com_ptr<ID3D11Texture2D> result = DirectXHelper::CreateTexture2D(
+		_d3dDevice,
+		format,
+		size.cx,
+		size.cy,
+		D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+	);
+	if (result) {
+		_allocatedBytes += bytes;
+	}
+	return result;
+}
+
+void EffectTextureAllocator::Release(const winrt::com_ptr<ID3D11Texture2D>& texture) noexcept {
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	_freeTextures.push_back({ desc.Format, { (LONG)desc.Width, (LONG)desc.Height }, texture });
+}
+
+void EffectTextureAllocator::Recycle(winrt::com_ptr<ID3D11Texture2D> texture) noexcept {
+	// 多个效果可能共用同一纹理，不能重复加入，否则会被同时取用
+	if (std::any_of(_recycledTextures.begin(), _recycledTextures.end(),
+		[&](const _FreeTexture& t) { return t.texture == texture; })) {
+		return;
+	}
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	_recycledTextures.push_back({ desc.Format, { (LONG)desc.Width, (LONG)desc.Height }, std::move(texture) });
+}
+
+void EffectTextureAllocator::Trim(BackendDescriptorStore& descriptorStore) noexcept {
+	for (const _FreeTexture& t : _recycledTextures) {
+		descriptorStore.RemoveViews(t.texture.get());
+	}
+	_recycledTextures.clear();
+}
+
+void EffectTextureAllocator::LogStatistics() const noexcept {
+	Logger::Get().Info(fmt::format("中间纹理占用显存 {:.1f} MiB，复用节省了 {:.1f} MiB",
+		_allocatedBytes / 1048576.0, (_requestedBytes - _allocatedBytes) / 1048576.0));
+}
+
+}
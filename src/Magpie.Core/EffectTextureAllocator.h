@@ -0,0 +1,54 @@
+#pragma once
+#include "SmallVector.h"
+
+namespace Magpie::Core {
+
+class BackendDescriptorStore;
+
+// 为所有效果的中间纹理分配显存。EffectDrawer 按通道的执行顺序申请和归还纹理，生存期不重叠
+// 且格式和尺寸相同的纹理会共用同一个 ID3D11Texture2D。D3D11 无法让不同描述的资源共用显存，
+// 因此只复用描述完全相同的纹理。
+class EffectTextureAllocator {
+public:
+	EffectTextureAllocator() = default;
+	EffectTextureAllocator(const EffectTextureAllocator&) = delete;
+	EffectTextureAllocator(EffectTextureAllocator&&) = default;
+
+	void Initialize(ID3D11Device* d3dDevice) noexcept {
+		_d3dDevice = d3dDevice;
+	}
+
+	// 优先复用已归还的纹理
+	winrt::com_ptr<ID3D11Texture2D> Acquire(DXGI_FORMAT format, SIZE size) noexcept;
+
+	// 归还后纹理的内容可能被其他通道覆盖
+	void Release(const winrt::com_ptr<ID3D11Texture2D>& texture) noexcept;
+
+	// 调整尺寸时交回上一次分配的纹理，格式和尺寸相同时 Acquire 直接取用。同一纹理可以交回多次
+	void Recycle(winrt::com_ptr<ID3D11Texture2D> texture) noexcept;
+
+	// 释放交回后没有被取用的纹理及其视图
+	void Trim(BackendDescriptorStore& descriptorStore) noexcept;
+
+	void LogStatistics() const noexcept;
+
+private:
+	struct _FreeTexture {
+		DXGI_FORMAT format;
+		SIZE size;
+		winrt::com_ptr<ID3D11Texture2D> texture;
+	};
+
+	ID3D11Device* _d3dDevice = nullptr;
+
+	SmallVector<_FreeTexture> _freeTextures;
+	// 上一次分配的纹理，已有视图
+	SmallVector<_FreeTexture> _recycledTextures;
+
+	// 如果不复用需要的显存
+	uint64_t _requestedBytes = 0;
+	// 实际分配的显存
+	uint64_t _allocatedBytes = 0;
+};
+
+}
@@ -1,55 +1,100 @@
 #include "pch.h"
 #include "EffectsProfiler.h"
 #include "DeviceResources.h"
+#include "FrameTrace.h"
 #include <mutex>
 
 namespace Magpie::Core {
 
-void EffectsProfiler::Start(ID3D11Device* d3dDevice, uint32_t passCount) {
-	assert(_passQueries.empty());
-	_passQueries.resize(passCount);
-
-	D3D11_QUERY_DESC desc{ .Query = D3D11_QUERY_TIMESTAMP_DISJOINT };
-	d3dDevice->CreateQuery(&desc, _disjointQuery.put());
-
-	desc.Query = D3D11_QUERY_TIMESTAMP;
-	d3dDevice->CreateQuery(&desc, _startQuery.put());
-	for (winrt::com_ptr<ID3D11Query>& query : _passQueries) {
-		d3dDevice->CreateQuery(&desc, query.put());
+void EffectsProfiler::Start(
+	ID3D11Device* d3dDevice,
+	FrameTrace* trace,
+	SmallVector<uint32_t> passNameIds,
+	uint32_t slotCount
+) {
+	assert(_passNameIds.empty() && slotCount > 0);
+
+	_d3dDevice.copy_from(d3dDevice);
+	_trace = trace;
+	_passNameIds = std::move(passNameIds);
+
+	_slots.resize(slotCount);
+	for (_QuerySlot& slot : _slots) {
+		D3D11_QUERY_DESC desc{ .Query = D3D11_QUERY_TIMESTAMP_DISJOINT };
+		d3dDevice->CreateQuery(&desc, slot.disjointQuery.put());
+
+		desc.Query = D3D11_QUERY_TIMESTAMP;
+		d3dDevice->CreateQuery(&desc, slot.startQuery.put());
+
+		// 不分块时每个通道一个时间戳
+		slot.passQueries.resize(_passNameIds.size());
+		slot.queryPasses.resize(_passNameIds.size());
+		for (winrt::com_ptr<ID3D11Query>& query : slot.passQueries) {
+			d3dDevice->CreateQuery(&desc, query.put());
+		}
 	}
 }
 
-void EffectsProfiler::Stop() {
-	_disjointQuery = nullptr;
-	_startQuery = nullptr;
-	_passQueries.clear();
+void EffectsProfiler::Stop() noexcept {
+	_d3dDevice = nullptr;
+	_slots.clear();
+	_curSlot = nullptr;
+	_trace = nullptr;
+	_passNameIds.clear();
+
+	auto lock = _timingsLock.lock_exclusive();
+	_timings.clear();
 }
 
-void EffectsProfiler::OnBeginEffects(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+void EffectsProfiler::OnBeginEffects(ID3D11DeviceContext* d3dDC, uint64_t frame) {
+	if (_passNameIds.empty()) {
 		return;
 	}
 
-	d3dDC->Begin(_disjointQuery.get());
-	d3dDC->End(_startQuery.get());
+	_curSlot = &_slots[frame % _slots.size()];
+	// 同时执行的帧数不超过 _slots 的大小，因此之前使用这组查询的帧已被读取
+	assert(!_curSlot->isPending);
 
+	d3dDC->Begin(_curSlot->disjointQuery.get());
+	d3dDC->End(_curSlot->startQuery.get());
+
+	_curSlot->queryCount = 0;
+	_curSlot->beginTime = _trace ? _trace->Now() : 0;
+	_curSlot->frame = frame;
+	_curSlot->isPending = true;
 	_curPass = 0;
 }
 
 void EffectsProfiler::OnEndPass(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+	if (_passNameIds.empty()) {
 		return;
 	}
 
-	d3dDC->End(_passQueries[_curPass++].get());
+	_QuerySlot& slot = *_curSlot;
+	if (slot.queryCount == slot.passQueries.size()) {
+		D3D11_QUERY_DESC desc{ .Query = D3D11_QUERY_TIMESTAMP };
+		_d3dDevice->CreateQuery(&desc, slot.passQueries.emplace_back().put());
+		slot.queryPasses.push_back(0);
+	}
+
+	slot.queryPasses[slot.queryCount] = _curPass++;
+	d3dDC->End(slot.passQueries[slot.queryCount++].get());
+}
+
+void EffectsProfiler::OnBeginTile(uint32_t tileIdx) noexcept {
+	if (tileIdx == 0) {
+		_tileFirstPass = _curPass;
+	} else {
+		_curPass = _tileFirstPass;
+	}
 }
 
 void EffectsProfiler::OnEndEffects(ID3D11DeviceContext* d3dDC) {
-	if (_passQueries.empty()) {
+	if (_passNameIds.empty()) {
 		return;
 	}
 
-	d3dDC->End(_disjointQuery.get());
+	d3dDC->End(_curSlot->disjointQuery.get());
 }
 
 template<typename T>
@@ -61,30 +106,80 @@ static T GetQueryData(ID3D11DeviceContext* d3dDC, ID3D11Query* query) noexcept {
 	return data;
 }
 
-void EffectsProfiler::QueryTimings(ID3D11DeviceContext* d3dDC) noexcept {
-	if (_passQueries.empty()) {
+void EffectsProfiler::QueryTimings(ID3D11DeviceContext* d3dDC, uint64_t completedFrame) noexcept {
+	if (_passNameIds.empty()) {
 		return;
 	}
 
+	// 按帧的顺序读取，_timings 保留最新一帧的结果
+	while (true) {
+		_QuerySlot* oldestSlot = nullptr;
+		for (_QuerySlot& slot : _slots) {
+			if (slot.isPending && slot.frame <= completedFrame &&
+				(!oldestSlot || slot.frame < oldestSlot->frame)) {
+				oldestSlot = &slot;
+			}
+		}
+
+		if (!oldestSlot) {
+			break;
+		}
+
+		_ReadSlot(d3dDC, *oldestSlot);
+		oldestSlot->isPending = false;
+	}
+}
+
+void EffectsProfiler::_ReadSlot(ID3D11DeviceContext* d3dDC, _QuerySlot& slot) noexcept {
+	// 帧已完成，查询结果都已可用
 	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData =
-		GetQueryData<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>(d3dDC, _disjointQuery.get());
+		GetQueryData<D3D11_QUERY_DATA_TIMESTAMP_DISJOINT>(d3dDC, slot.disjointQuery.get());
 
 	if (disjointData.Disjoint) {
 		return;
 	}
 
 	const float toMS = 1000.0f / disjointData.Frequency;
+	const double toUS = 1e6 / disjointData.Frequency;
 
-	uint64_t prevTimestamp = GetQueryData<uint64_t>(d3dDC, _startQuery.get());
+	const uint64_t startTimestamp = GetQueryData<uint64_t>(d3dDC, slot.startQuery.get());
+	uint64_t prevTimestamp = startTimestamp;
 
-	auto lock = _timingsLock.lock_exclusive();
-	_timings.resize(_passQueries.size());
-	for (size_t i = 0; i < _passQueries.size(); ++i) {
-		uint64_t timestamp = GetQueryData<uint64_t>(d3dDC, _passQueries[i].get());
-		_timings[i] = (timestamp - prevTimestamp) * toMS;
+	// 分块执行时复制输入和输出的耗时计入相邻的通道
+	const uint32_t passCount = (uint32_t)_passNameIds.size();
+	SmallVector<uint64_t> passStarts(passCount, std::numeric_limits<uint64_t>::max());
+	SmallVector<uint64_t> passDurations(passCount, 0);
+	for (uint32_t i = 0; i < slot.queryCount; ++i) {
+		const uint64_t timestamp = GetQueryData<uint64_t>(d3dDC, slot.passQueries[i].get());
+
+		const uint32_t pass = slot.queryPasses[i];
+		if (passStarts[pass] == std::numeric_limits<uint64_t>::max()) {
+			passStarts[pass] = prevTimestamp;
+		}
+		passDurations[pass] += timestamp - prevTimestamp;
 
 		prevTimestamp = timestamp;
 	}
+
+	auto lock = _timingsLock.lock_exclusive();
+	_timings.resize(passCount);
+	for (uint32_t i = 0; i < passCount; ++i) {
+		_timings[i] = passDurations[i] * toMS;
+
+		if (!_trace || passStarts[i] == std::numeric_limits<uint64_t>::max()) {
+			continue;
+		}
+
+		// GPU 和 CPU 的时钟无法精确对应，假设 GPU 在提交时立即开始执行。
+		// 分块执行时通道的多次执行合并为一个事件，从第一次执行开始
+		_trace->Record(
+			FrameTrace::Category::GPU,
+			_passNameIds[i],
+			slot.frame,
+			slot.beginTime + (uint64_t)std::llround((passStarts[i] - startTimestamp) * toUS),
+			(uint64_t)std::llround(passDurations[i] * toUS)
+		);
+	}
 }
 
 SmallVector<float> EffectsProfiler::GetTimings() noexcept {
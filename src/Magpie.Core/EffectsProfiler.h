@@ -5,6 +5,7 @@
 namespace Magpie::Core {
 
 class DeviceResources;
+class FrameTrace;
 
 class EffectsProfiler {
 public:
@@ -13,17 +14,25 @@ public:
 	EffectsProfiler(const EffectsProfiler&) = delete;
 	EffectsProfiler(EffectsProfiler&&) = delete;
 
-	void Start(ID3D11Device* d3dDevice, uint32_t passCount);
+	// trace 不为空时每个通道的耗时都记录到 trace 中，passNameIds 为通道在 trace 中的名字。
+	// 每个同时执行的帧使用一组查询，slotCount 应等于最多同时执行的帧数
+	void Start(ID3D11Device* d3dDevice, FrameTrace* trace, SmallVector<uint32_t> passNameIds, uint32_t slotCount);
 
-	void Stop();
+	// 尚未读取的查询结果被丢弃
+	void Stop() noexcept;
 
-	void OnBeginEffects(ID3D11DeviceContext* d3dDC);
+	void OnBeginEffects(ID3D11DeviceContext* d3dDC, uint64_t frame);
 
 	void OnEndPass(ID3D11DeviceContext* d3dDC);
 
+	// 分块执行时每个块都执行一遍效果的所有通道，耗时累加到各个通道中。
+	// 在执行每个块之前调用，tileIdx 为 0 时记录效果的第一个通道
+	void OnBeginTile(uint32_t tileIdx) noexcept;
+
 	void OnEndEffects(ID3D11DeviceContext* d3dDC);
 
-	void QueryTimings(ID3D11DeviceContext* d3dDC) noexcept;
+	// 读取 completedFrame 及之前的帧的查询结果。这些帧应已完成，否则会等待它们完成
+	void QueryTimings(ID3D11DeviceContext* d3dDC, uint64_t completedFrame) noexcept;
 
 	// 从前端线程调用
 	SmallVector<float> GetTimings() noexcept;
@@ -32,11 +41,33 @@ private:
 	SmallVector<float> _timings;
 	wil::srwlock _timingsLock;
 
-	winrt::com_ptr<ID3D11Query> _disjointQuery;
-	winrt::com_ptr<ID3D11Query> _startQuery;
-	std::vector<winrt::com_ptr<ID3D11Query>> _passQueries;
+	struct _QuerySlot {
+		winrt::com_ptr<ID3D11Query> disjointQuery;
+		winrt::com_ptr<ID3D11Query> startQuery;
+		// 每个通道执行后的时间戳，分块执行时一个通道有多个时间戳，因此按需创建
+		std::vector<winrt::com_ptr<ID3D11Query>> passQueries;
+		// 每个时间戳所属的通道
+		SmallVector<uint32_t> queryPasses;
+		uint32_t queryCount = 0;
+		// 开始执行效果的 CPU 时间，GPU 时间戳以它为基准对齐到 trace 中
+		uint64_t beginTime = 0;
+		uint64_t frame = 0;
+		// 是否有等待读取的结果
+		bool isPending = false;
+	};
+
+	void _ReadSlot(ID3D11DeviceContext* d3dDC, _QuerySlot& slot) noexcept;
+
+	winrt::com_ptr<ID3D11Device> _d3dDevice;
+	// 第 n 帧使用 _slots[n % _slots.size()]
+	SmallVector<_QuerySlot, 2> _slots;
+	_QuerySlot* _curSlot = nullptr;
 
 	uint32_t _curPass = 0;
+	uint32_t _tileFirstPass = 0;
+
+	FrameTrace* _trace = nullptr;
+	SmallVector<uint32_t> _passNameIds;
 };
 
 }
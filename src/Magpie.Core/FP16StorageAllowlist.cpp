@@ -0,0 +1,117 @@
+#include "pch.h"
+#include "FP16StorageAllowlist.h"
+#include "EffectDesc.h"
+#include "CommonSharedConstants.h"
+#include "Logger.h"
+#include "StrUtils.h"
+#include "Win32Utils.h"
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+
+namespace Magpie::Core {
+
+bool FP16StorageAllowlist::Load() noexcept {
+	_effects.clear();
+
+	const wchar_t* path = CommonSharedConstants::FP16_STORAGE_ALLOWLIST_PATH;
+	if (!Win32Utils::FileExists(path)) {
+		return true;
+	}
+
+	std::string json;
+	if (!Win32Utils::ReadTextFile(path, json)) {
+		Logger::Get().Error("读取 FP16 存储的验证结果失败");
+		return false;
+	}
+
+	rapidjson::Document doc;
+	doc.ParseInsitu(json.data());
+	if (doc.HasParseError() || !doc.IsObject()) {
+		Logger::Get().Error(fmt::format("解析 FP16 存储的验证结果失败\n\t错误码: {}", (int)doc.GetParseError()));
+		return false;
+	}
+
+	for (const auto& effect : ((const rapidjson::Document&)doc).GetObj()) {
+		if (!effect.value.IsArray()) {
+			continue;
+		}
+
+		std::vector<std::string>& textureNames = _effects[std::string(
+			effect.name.GetString(), effect.name.GetStringLength())];
+		for (const auto& texture : effect.value.GetArray()) {
+			if (texture.IsString()) {
+				textureNames.emplace_back(texture.GetString(), texture.GetStringLength());
+			}
+		}
+	}
+
+	return true;
+}
+
+bool FP16StorageAllowlist::Save() const noexcept {
+	// 按名字排序使文件内容稳定
+	std::vector<const std::pair<const std::string, std::vector<std::string>>*> effects;
+	effects.reserve(_effects.size());
+	for (const auto& pair : _effects) {
+		effects.push_back(&pair);
+	}
+	std::sort(effects.begin(), effects.end(), [](const auto* l, const auto* r) { return l->first < r->first; });
+
+	rapidjson::StringBuffer json;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(json);
+	writer.StartObject();
+	for (const auto* effect : effects) {
+		writer.Key(effect->first.c_str(), (rapidjson::SizeType)effect->first.size());
+		writer.StartArray();
+		for (const std::string& textureName : effect->second) {
+			writer.String(textureName.c_str(), (rapidjson::SizeType)textureName.size());
+		}
+		writer.EndArray();
+	}
+	writer.EndObject();
+
+	if (!Win32Utils::WriteTextFileAtomic(CommonSharedConstants::FP16_STORAGE_ALLOWLIST_PATH,
+		std::string_view(json.GetString(), json.GetSize()))) {
+		Logger::Get().Error("保存 FP16 存储的验证结果失败");
+		return false;
+	}
+
+	return true;
+}
+
+void FP16StorageAllowlist::Apply(EffectDesc& desc) const noexcept {
+	auto it = _effects.find(desc.name);
+	if (it == _effects.end()) {
+		return;
+	}
+
+	uint32_t count = 0;
+	// 从文件加载的纹理格式由文件决定
+	for (size_t i = 2; i < desc.textures.size(); ++i) {
+		EffectIntermediateTextureDesc& texDesc = desc.textures[i];
+		if (!texDesc.source.empty() ||
+			std::find(it->second.begin(), it->second.end(), texDesc.name) == it->second.end()) {
+			continue;
+		}
+
+		const EffectIntermediateTextureFormat fp16Format = GetFP16StorageFormat(texDesc.format);
+		if (fp16Format != texDesc.format) {
+			texDesc.format = fp16Format;
+			++count;
+		}
+	}
+
+	if (count > 0) {
+		Logger::Get().Info(fmt::format("{} 的 {} 个中间纹理使用 FP16 存储", desc.name, count));
+	}
+}
+
+void FP16StorageAllowlist::SetTextures(const std::string& effectName, std::vector<std::string> textureNames) noexcept {
+	if (textureNames.empty()) {
+		_effects.erase(effectName);
+	} else {
+		_effects[effectName] = std::move(textureNames);
+	}
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace Magpie::Core {
+
+struct EffectDesc;
+
+// 可以改为 16 位浮点格式存储的中间纹理，由 Benchmark --validate-fp16-storage 根据实际误差生成，
+// 保存在 effects 文件夹中。只记录效果和纹理的名字，验证时使用的参数和输入不同时误差也可能不同
+class FP16StorageAllowlist {
+public:
+	// 文件不存在时为空
+	bool Load() noexcept;
+
+	bool Save() const noexcept;
+
+	// 将效果中允许的 32 位浮点中间纹理改为对应的 16 位浮点格式。两者在着色器中的类型相同，无需重新编译
+	void Apply(EffectDesc& desc) const noexcept;
+
+	// textureNames 为空则删除该效果
+	void SetTextures(const std::string& effectName, std::vector<std::string> textureNames) noexcept;
+
+private:
+	phmap::flat_hash_map<std::string, std::vector<std::string>> _effects;
+};
+
+}
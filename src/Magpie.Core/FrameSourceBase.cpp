@@ -5,11 +5,11 @@
 #include "Win32Utils.h"
 #include "Utils.h"
 #include "SmallVector.h"
-#include "DirectXHelper.h"
 #include "DeviceResources.h"
 #include "shaders/DuplicateFrameCS.h"
 #include "ScalingWindow.h"
 #include "BackendDescriptorStore.h"
+#include <bit>	// std::countr_zero
 
 namespace Magpie::Core {
 
@@ -18,7 +18,7 @@ static constexpr uint16_t INITIAL_SKIP_COUNT = 1;
 static constexpr uint16_t MAX_SKIP_COUNT = 16;
 
 FrameSourceBase::FrameSourceBase() noexcept :
-	_nextSkipCount(INITIAL_SKIP_COUNT), _framesLeft(INITIAL_CHECK_COUNT) {}
+	_nextSkipCount(INITIAL_SKIP_COUNT), _maxSkipCount(MAX_SKIP_COUNT), _framesLeft(INITIAL_CHECK_COUNT) {}
 
 FrameSourceBase::~FrameSourceBase() noexcept {
 	const HWND hwndSrc = ScalingWindow::Get().HwndSrc();
@@ -107,10 +107,17 @@ bool FrameSourceBase::Initialize(DeviceResources& deviceResources, BackendDescri
 		return false;
 	}
 
+	D3D11_TEXTURE2D_DESC outputDesc;
+	_output->GetDesc(&outputDesc);
+	_outputRect = { 0, 0, (LONG)outputDesc.Width, (LONG)outputDesc.Height };
+
 	return true;
 }
 
 FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
+	// 默认整个画面都有变化
+	_dirtyRect = _outputRect;
+
 	const UpdateState state = _Update();
 
 	const ScalingOptions& options = ScalingWindow::Get().Options();
@@ -120,15 +127,13 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 		return state;
 	}
 
-	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
-
-	if (!_prevFrame) {
+	if (!_tileHashBuffer) {
 		if (_InitCheckingForDuplicateFrame()) {
-			d3dDC->CopyResource(_prevFrame.get(), _output.get());
+			// 记录第一帧的哈希
+			_HashTiles();
 		} else {
 			Logger::Get().Error("_InitCheckingForDuplicateFrame 失败");
-			_prevFrame = nullptr;
-			_prevFrameSrv = nullptr;
+			_tileHashBuffer = nullptr;
 		}
 
 		return UpdateState::NewFrame;
@@ -136,71 +141,52 @@ FrameSourceBase::UpdateState FrameSourceBase::Update() noexcept {
 
 	if (duplicateFrameDetectionMode == DuplicateFrameDetectionMode::Always) {
 		// 总是检查重复帧
-		if (_IsDuplicateFrame()) {
-			return UpdateState::Waiting;
-		} else {
-			d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			return UpdateState::NewFrame;
-		}
+		_HashTiles();
+		return _ReadChangedTiles() ? UpdateState::NewFrame : UpdateState::Waiting;
 	}
 
 	///////////////////////////////////////////////
 	//
 	// 动态检查重复帧，见 #787
+	// 
+	// 跳过检查的帧也计算哈希，但稍后再取回结果，因此不会等待 GPU。
+	// 发现预测错误后立即恢复检查，并减少之后连续跳过检查的帧数
 	//
 	///////////////////////////////////////////////
 
-	const bool isStatisticsEnabled = options.IsStatisticsForDynamicDetectionEnabled();
+	_PollReadbacks(false);
 
 	if (_isCheckingForDuplicateFrame) {
 		if (--_framesLeft == 0) {
 			_isCheckingForDuplicateFrame = false;
 			_framesLeft = _nextSkipCount;
-			if (_nextSkipCount < MAX_SKIP_COUNT) {
+			if (_nextSkipCount < _maxSkipCount) {
 				// 增加下一次连续跳过检查的帧数
 				++_nextSkipCount;
 			}
+			if (_maxSkipCount < MAX_SKIP_COUNT) {
+				++_maxSkipCount;
+			}
 		}
 
-		if (_IsDuplicateFrame()) {
+		_HashTiles();
+		if (_ReadChangedTiles()) {
+			return UpdateState::NewFrame;
+		} else {
 			_isCheckingForDuplicateFrame = true;
 			_framesLeft = INITIAL_CHECK_COUNT;
 			_nextSkipCount = INITIAL_SKIP_COUNT;
 			return UpdateState::Waiting;
-		} else {
-			if (_isCheckingForDuplicateFrame || isStatisticsEnabled) {
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			}
-			return UpdateState::NewFrame;
 		}
 	} else {
 		if (--_framesLeft == 0) {
 			_isCheckingForDuplicateFrame = true;
 			// 第 2 次连续检查 10 帧，之后逐渐减少，从第 16 次开始只连续检查 2 帧
 			_framesLeft = uint32_t((-4 * (int)_nextSkipCount + 78) / 7);
-			
-			if (!isStatisticsEnabled) {
-				// 下一帧将检查重复帧，需要复制此帧
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			}
-		}
-
-		if (isStatisticsEnabled) {
-			const bool isDuplicate = _IsDuplicateFrame();
-			if (!isDuplicate) {
-				d3dDC->CopyResource(_prevFrame.get(), _output.get());
-			}
-
-			std::pair<uint32_t, uint32_t> statistics = _statistics.load(std::memory_order_relaxed);
-			if (isDuplicate) {
-				// 预测错误
-				++statistics.first;
-			}
-			// 总帧数
-			++statistics.second;
-			_statistics.store(statistics, std::memory_order_relaxed);
 		}
 
+		_HashTiles();
+		_QueueReadback();
 		return UpdateState::NewFrame;
 	}
 }
@@ -504,40 +490,51 @@ bool FrameSourceBase::_CenterWindowIfNecessary(HWND hWnd, const RECT& rcWork) no
 	return true;
 }
 
-bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
+bool FrameSourceBase::_InitCheckingForDuplicateFrame() noexcept {
 	ID3D11Device5* d3dDevice = _deviceResources->GetD3DDevice();
 
 	D3D11_TEXTURE2D_DESC td;
 	_output->GetDesc(&td);
 
-	_prevFrame = DirectXHelper::CreateTexture2D(
-		d3dDevice, td.Format, td.Width, td.Height, D3D11_BIND_SHADER_RESOURCE);
-	if (!_prevFrame) {
+	_tileCount.cx = LONG((td.Width + 15) / 16);
+	_tileCount.cy = LONG((td.Height + 15) / 16);
+	const uint32_t tileCount = uint32_t(_tileCount.cx * _tileCount.cy);
+	_changeBitmapSize = (tileCount + 31) / 32;
+
+	D3D11_BUFFER_DESC bd{
+		.ByteWidth = tileCount * 8,
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = 8
+	};
+	HRESULT hr = d3dDevice->CreateBuffer(&bd, nullptr, _tileHashBuffer.put());
+	if (FAILED(hr)) {
+		Logger::Get().ComError("CreateBuffer 失败", hr);
 		return false;
 	}
 
-	HRESULT hr = d3dDevice->CreateShaderResourceView(_prevFrame.get(), nullptr, _prevFrameSrv.put());
-	if (FAILED(hr)) {
-		Logger::Get().ComError("CreateShaderResourceView 失败", hr);
+	_tileHashBufferUav = _descriptorStore->GetUnorderedAccessView(_tileHashBuffer.get(), tileCount);
+	if (!_tileHashBufferUav) {
+		Logger::Get().Error("GetUnorderedAccessView 失败");
 		return false;
 	}
 
-	D3D11_BUFFER_DESC bd{
-		.ByteWidth = 4,
+	bd = {
+		.ByteWidth = _changeBitmapSize * 4,
 		.Usage = D3D11_USAGE_DEFAULT,
-		.BindFlags = D3D11_BIND_UNORDERED_ACCESS,
-		.StructureByteStride = 4
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS
 	};
-	hr = d3dDevice->CreateBuffer(&bd, nullptr, _resultBuffer.put());
+	hr = d3dDevice->CreateBuffer(&bd, nullptr, _changeBitmapBuffer.put());
 	if (FAILED(hr)) {
 		Logger::Get().ComError("CreateBuffer 失败", hr);
 		return false;
 	}
 
-	_resultBufferUav = _descriptorStore->GetUnorderedAccessView(
-		_resultBuffer.get(), 1, DXGI_FORMAT_R32_UINT);
-	if (!_resultBufferUav) {
-		Logger::Get().ComError("GetUnorderedAccessView 失败", hr);
+	_changeBitmapBufferUav = _descriptorStore->GetUnorderedAccessView(
+		_changeBitmapBuffer.get(), _changeBitmapSize, DXGI_FORMAT_R32_UINT);
+	if (!_changeBitmapBufferUav) {
+		Logger::Get().Error("GetUnorderedAccessView 失败");
 		return false;
 	}
 
@@ -550,51 +547,151 @@ bool FrameSourceBase::_InitCheckingForDuplicateFrame() {
 		return false;
 	}
 
+	for (winrt::com_ptr<ID3D11Buffer>& buffer : _asyncReadBackBuffers) {
+		hr = d3dDevice->CreateBuffer(&bd, nullptr, buffer.put());
+		if (FAILED(hr)) {
+			Logger::Get().ComError("CreateBuffer 失败", hr);
+			return false;
+		}
+	}
+
 	hr = d3dDevice->CreateComputeShader(
 		DuplicateFrameCS, sizeof(DuplicateFrameCS), nullptr, _dupFrameCS.put());
 	if (FAILED(hr)) {
 		Logger::Get().ComError("CreateComputeShader 失败", hr);
 		return false;
 	}
-
-	static constexpr std::pair<uint32_t, uint32_t> BLOCK_SIZE{ 16, 16 };
-	_dispatchCount.first = (td.Width + BLOCK_SIZE.first - 1) / BLOCK_SIZE.first;
-	_dispatchCount.second = (td.Height + BLOCK_SIZE.second - 1) / BLOCK_SIZE.second;
 	
 	return true;
 }
 
-bool FrameSourceBase::_IsDuplicateFrame() {
-	// 检查是否和前一帧相同
+void FrameSourceBase::_HashTiles() noexcept {
 	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
 
-	ID3D11ShaderResourceView* srvs[]{ _outputSrv, _prevFrameSrv.get() };
-	d3dDC->CSSetShaderResources(0, 2, srvs);
+	d3dDC->CSSetShaderResources(0, 1, &_outputSrv);
 
 	ID3D11SamplerState* sam = _deviceResources->GetSampler(
 		D3D11_FILTER_MIN_MAG_MIP_POINT, D3D11_TEXTURE_ADDRESS_CLAMP);
 	d3dDC->CSSetSamplers(0, 1, &sam);
 
-	// 将缓冲区置零
+	// 将位图置零
 	static constexpr UINT ZERO[4]{};
-	d3dDC->ClearUnorderedAccessViewUint(_resultBufferUav, ZERO);
-	d3dDC->CSSetUnorderedAccessViews(0, 1, &_resultBufferUav, nullptr);
+	d3dDC->ClearUnorderedAccessViewUint(_changeBitmapBufferUav, ZERO);
+
+	ID3D11UnorderedAccessView* uavs[]{ _tileHashBufferUav, _changeBitmapBufferUav };
+	d3dDC->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
 
 	d3dDC->CSSetShader(_dupFrameCS.get(), nullptr, 0);
 
-	d3dDC->Dispatch(_dispatchCount.first, _dispatchCount.second, 1);
+	d3dDC->Dispatch((UINT)_tileCount.cx, (UINT)_tileCount.cy, 1);
+}
+
+bool FrameSourceBase::_ReadChangedTiles() noexcept {
+	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
 
 	// 取回结果
-	d3dDC->CopyResource(_readBackBuffer.get(), _resultBuffer.get());
+	d3dDC->CopyResource(_readBackBuffer.get(), _changeBitmapBuffer.get());
 
-	uint32_t result = 1;
 	D3D11_MAPPED_SUBRESOURCE ms;
 	HRESULT hr = d3dDC->Map(_readBackBuffer.get(), 0, D3D11_MAP_READ, 0, &ms);
-	if (SUCCEEDED(hr)) {
-		result = *(uint32_t*)ms.pData;
-		d3dDC->Unmap(_readBackBuffer.get(), 0);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("Map 失败", hr);
+		// 视为有变化
+		return true;
+	}
+
+	RECT changedRect;
+	const bool isChanged = _GetChangedRect((const uint32_t*)ms.pData, changedRect);
+	d3dDC->Unmap(_readBackBuffer.get(), 0);
+
+	if (isChanged) {
+		IntersectRect(&_dirtyRect, &_dirtyRect, &changedRect);
 	}
-	return result == 0;
+	return isChanged;
+}
+
+void FrameSourceBase::_QueueReadback() noexcept {
+	if (_asyncReadBackCount == _asyncReadBackBuffers.size()) {
+		_PollReadbacks(true);
+	}
+
+	const uint32_t idx = uint32_t((_asyncReadBackHead + _asyncReadBackCount) % _asyncReadBackBuffers.size());
+	_deviceResources->GetD3DDC()->CopyResource(_asyncReadBackBuffers[idx].get(), _changeBitmapBuffer.get());
+	++_asyncReadBackCount;
+}
+
+void FrameSourceBase::_PollReadbacks(bool wait) noexcept {
+	ID3D11DeviceContext4* d3dDC = _deviceResources->GetD3DDC();
+
+	while (_asyncReadBackCount > 0) {
+		ID3D11Buffer* buffer = _asyncReadBackBuffers[_asyncReadBackHead].get();
+
+		D3D11_MAPPED_SUBRESOURCE ms;
+		HRESULT hr = d3dDC->Map(buffer, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &ms);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+			return;
+		}
+
+		_asyncReadBackHead = uint32_t((_asyncReadBackHead + 1) % _asyncReadBackBuffers.size());
+		--_asyncReadBackCount;
+		wait = false;
+
+		if (FAILED(hr)) {
+			Logger::Get().ComError("Map 失败", hr);
+			continue;
+		}
+
+		RECT changedRect;
+		const bool isDuplicate = !_GetChangedRect((const uint32_t*)ms.pData, changedRect);
+		d3dDC->Unmap(buffer, 0);
+
+		std::pair<uint32_t, uint32_t> statistics = _statistics.load(std::memory_order_relaxed);
+		if (isDuplicate) {
+			// 预测错误
+			++statistics.first;
+		}
+		// 总帧数
+		++statistics.second;
+		_statistics.store(statistics, std::memory_order_relaxed);
+
+		if (isDuplicate) {
+			// 画面可能正以低于捕获帧率的速度更新，如播放视频。立即恢复检查
+			_isCheckingForDuplicateFrame = true;
+			_framesLeft = INITIAL_CHECK_COUNT;
+			_nextSkipCount = INITIAL_SKIP_COUNT;
+			_maxSkipCount = std::max(uint16_t(_maxSkipCount / 2), INITIAL_SKIP_COUNT);
+		}
+	}
+}
+
+bool FrameSourceBase::_GetChangedRect(const uint32_t* changeBitmap, RECT& changedRect) const noexcept {
+	LONG minX = std::numeric_limits<LONG>::max();
+	LONG minY = std::numeric_limits<LONG>::max();
+	LONG maxX = -1;
+	LONG maxY = -1;
+
+	for (uint32_t i = 0; i < _changeBitmapSize; ++i) {
+		uint32_t bits = changeBitmap[i];
+		while (bits) {
+			const uint32_t tileIdx = i * 32 + std::countr_zero(bits);
+			bits &= bits - 1;
+
+			const LONG x = LONG(tileIdx % (uint32_t)_tileCount.cx);
+			const LONG y = LONG(tileIdx / (uint32_t)_tileCount.cx);
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+		}
+	}
+
+	if (maxX < 0) {
+		return false;
+	}
+
+	changedRect = { minX * 16, minY * 16, (maxX + 1) * 16, (maxY + 1) * 16 };
+	IntersectRect(&changedRect, &changedRect, &_outputRect);
+	return true;
 }
 
 }
@@ -33,6 +33,10 @@ public:
 	// 因为源窗口可能存在 DPI 缩放，而某些捕获方法无视 DPI 缩放
 	const RECT& SrcRect() const noexcept { return _srcRect; }
 
+	// 最新一帧中和上一帧相比有变化的区域，为 GetOutput 获取到的纹理中的坐标。
+	// 无法获知时为整个纹理
+	const RECT& DirtyRect() const noexcept { return _dirtyRect; }
+
 	std::pair<uint32_t, uint32_t> GetStatisticsForDynamicDetection() const noexcept;
 
 	virtual const char* Name() const noexcept = 0;
@@ -72,30 +76,57 @@ protected:
 	static bool _CenterWindowIfNecessary(HWND hWnd, const RECT& rcWork) noexcept;
 
 	RECT _srcRect{};
+	// _Update 返回 NewFrame 前可以缩小此区域
+	RECT _dirtyRect{};
 
 	DeviceResources* _deviceResources = nullptr;
 	BackendDescriptorStore* _descriptorStore = nullptr;
 	winrt::com_ptr<ID3D11Texture2D> _output;
 	ID3D11ShaderResourceView* _outputSrv;
 
-	winrt::com_ptr<ID3D11Buffer> _resultBuffer;
-	ID3D11UnorderedAccessView* _resultBufferUav = nullptr;
-	winrt::com_ptr<ID3D11Buffer> _readBackBuffer;
-	winrt::com_ptr<ID3D11ComputeShader> _dupFrameCS;
-	std::pair<uint32_t, uint32_t> _dispatchCount;
-
 	bool _roundCornerDisabled = false;
 	bool _windowResizingDisabled = false;
 
 private:
-	bool _InitCheckingForDuplicateFrame();
+	bool _InitCheckingForDuplicateFrame() noexcept;
+
+	// 计算每个块的哈希并和上一帧比较，结果保存在 _changeBitmapBuffer 中
+	void _HashTiles() noexcept;
+
+	// 等待并取回 _HashTiles 的结果。返回画面是否有变化，有变化时缩小 _dirtyRect
+	bool _ReadChangedTiles() noexcept;
 
-	bool _IsDuplicateFrame();
+	// 跳过检查的帧的结果稍后再取回，只用于发现预测错误
+	void _QueueReadback() noexcept;
+
+	// wait 为 true 时至少取回一个结果
+	void _PollReadbacks(bool wait) noexcept;
+
+	// 返回是否有块发生变化，changedRect 为所有变化的块的外接矩形
+	bool _GetChangedRect(const uint32_t* changeBitmap, RECT& changedRect) const noexcept;
 
 	// 用于检查重复帧
-	winrt::com_ptr<ID3D11Texture2D> _prevFrame;
-	winrt::com_ptr<ID3D11ShaderResourceView> _prevFrameSrv;
+	RECT _outputRect{};
+
+	// 每个块 16x16 像素
+	SIZE _tileCount{};
+	uint32_t _changeBitmapSize = 0;
+
+	// 保存上一帧每个块的哈希
+	winrt::com_ptr<ID3D11Buffer> _tileHashBuffer;
+	ID3D11UnorderedAccessView* _tileHashBufferUav = nullptr;
+	// 每个块一位
+	winrt::com_ptr<ID3D11Buffer> _changeBitmapBuffer;
+	ID3D11UnorderedAccessView* _changeBitmapBufferUav = nullptr;
+	winrt::com_ptr<ID3D11Buffer> _readBackBuffer;
+	std::array<winrt::com_ptr<ID3D11Buffer>, 4> _asyncReadBackBuffers;
+	uint32_t _asyncReadBackHead = 0;
+	uint32_t _asyncReadBackCount = 0;
+	winrt::com_ptr<ID3D11ComputeShader> _dupFrameCS;
+
 	uint16_t _nextSkipCount;
+	// 预测错误时减半，检查后未发现重复帧则增加
+	uint16_t _maxSkipCount;
 	uint16_t _framesLeft;
 	// (预测错误帧数, 总计跳过帧数)
 	std::atomic<std::pair<uint32_t, uint32_t>> _statistics;
@@ -0,0 +1,178 @@
+#include "FrameTrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+using namespace std::chrono;
+
+namespace Magpie::Core {
+
+FrameTrace::FrameTrace(uint32_t capacity) noexcept : _startTime(steady_clock::now()) {
+	_events.resize(std::max(capacity, 1u));
+}
+
+uint32_t FrameTrace::RegisterName(std::string_view name) noexcept {
+	std::scoped_lock lock(_lock);
+
+	auto it = std::find(_names.begin(), _names.end(), name);
+	if (it != _names.end()) {
+		return uint32_t(it - _names.begin());
+	}
+
+	_names.emplace_back(name);
+	return uint32_t(_names.size() - 1);
+}
+
+uint64_t FrameTrace::Now() const noexcept {
+	return (uint64_t)duration_cast<microseconds>(steady_clock::now() - _startTime).count();
+}
+
+void FrameTrace::Record(Category category, uint32_t nameId, uint64_t frame, uint64_t start, uint64_t duration) noexcept {
+	std::scoped_lock lock(_lock);
+
+	_events[_recordedCount % _events.size()] = {
+		.start = start,
+		.frame = frame,
+		.duration = (uint32_t)std::min<uint64_t>(duration, std::numeric_limits<uint32_t>::max()),
+		.nameId = nameId,
+		.category = category
+	};
+	++_recordedCount;
+}
+
+std::vector<FrameTrace::Event> FrameTrace::_Snapshot(std::vector<std::string>& names) const noexcept {
+	std::scoped_lock lock(_lock);
+
+	names = _names;
+
+	const size_t capacity = _events.size();
+	if (_recordedCount <= capacity) {
+		return std::vector<Event>(_events.begin(), _events.begin() + (size_t)_recordedCount);
+	}
+
+	// 缓冲区已满，最旧的事件位于下一个写入的位置
+	std::vector<Event> result;
+	result.reserve(capacity);
+	const size_t oldest = size_t(_recordedCount % capacity);
+	result.insert(result.end(), _events.begin() + oldest, _events.end());
+	result.insert(result.end(), _events.begin(), _events.begin() + oldest);
+	return result;
+}
+
+std::vector<FrameTrace::Summary> FrameTrace::Summarize() const noexcept {
+	std::vector<std::string> names;
+	const std::vector<Event> events = _Snapshot(names);
+
+	// 键为类别和名字
+	std::map<std::pair<Category, uint32_t>, std::vector<uint32_t>> durations;
+	for (const Event& event : events) {
+		durations[{ event.category, event.nameId }].push_back(event.duration);
+	}
+
+	std::vector<Summary> result;
+	result.reserve(durations.size());
+	for (auto& [key, values] : durations) {
+		std::sort(values.begin(), values.end());
+
+		uint64_t total = 0;
+		for (uint32_t value : values) {
+			total += value;
+		}
+
+		// 最近秩法
+		auto percentile = [&](uint32_t p) {
+			const size_t rank = (values.size() * p + 99) / 100;
+			return values[std::max<size_t>(rank, 1) - 1] / 1000.0f;
+		};
+
+		result.push_back({
+			.name = names[key.second],
+			.category = key.first,
+			.count = (uint32_t)values.size(),
+			.average = total / 1000.0f / values.size(),
+			.p50 = percentile(50),
+			.p99 = percentile(99),
+			.max = values.back() / 1000.0f
+		});
+	}
+
+	return result;
+}
+
+static void AppendJsonString(std::string& result, std::string_view str) noexcept {
+	result.push_back('"');
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			result.push_back('\\');
+			result.push_back(c);
+		} else if ((unsigned char)c < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			result.append(escaped);
+		} else {
+			result.push_back(c);
+		}
+	}
+	result.push_back('"');
+}
+
+std::string FrameTrace::ExportChromeTrace() const noexcept {
+	std::vector<std::string> names;
+	const std::vector<Event> events = _Snapshot(names);
+
+	std::string result;
+	// 每个事件大约需要 120 个字节
+	result.reserve(events.size() * 120 + 1024);
+
+	result.append(R"({"displayTimeUnit":"ms","traceEvents":[)");
+
+	// 为每个轨道命名
+	for (uint32_t i = 0; i < (uint32_t)Category::COUNT; ++i) {
+		result.append(R"({"name":"thread_name","ph":"M","pid":1,"tid":)")
+			.append(std::to_string(i + 1))
+			.append(R"(,"args":{"name":")")
+			.append(CategoryName((Category)i))
+			.append(R"("}},)");
+	}
+
+	for (const Event& event : events) {
+		result.append("\n{\"name\":");
+		AppendJsonString(result, names[event.nameId]);
+		result.append(R"(,"cat":")")
+			.append(CategoryName(event.category))
+			.append(R"(","ph":"X","ts":)")
+			.append(std::to_string(event.start))
+			.append(R"(,"dur":)")
+			.append(std::to_string(event.duration))
+			.append(R"(,"pid":1,"tid":)")
+			.append(std::to_string((uint32_t)event.category + 1))
+			.append(R"(,"args":{"frame":)")
+			.append(std::to_string(event.frame))
+			.append("}},");
+	}
+
+	// 删除最后的逗号
+	result.pop_back();
+	result.append("\n]}\n");
+
+	return result;
+}
+
+const char* FrameTrace::CategoryName(Category category) noexcept {
+	switch (category) {
+	case Category::Capture:
+		return "Capture";
+	case Category::Wait:
+		return "Wait";
+	case Category::GPU:
+		return "GPU";
+	case Category::Present:
+		return "Present";
+	case Category::CPU:
+		return "CPU";
+	default:
+		return "Unknown";
+	}
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 在环形缓冲区中保存最近的事件，用于诊断卡顿。缩放结束后导出为 Chrome 的 trace 格式，
+// 可以在 chrome://tracing 或 Perfetto 中查看。只依赖标准库，和 D3D 及 Win32 无关。
+class FrameTrace {
+public:
+	// 每个类别在 trace 中显示为一个单独的轨道
+	enum class Category : uint8_t {
+		Capture,
+		Wait,
+		GPU,
+		Present,
+		// 只用于离线测量
+		CPU,
+		COUNT
+	};
+
+	struct Event {
+		// 单位均为微秒，start 从创建 FrameTrace 时开始计算
+		uint64_t start;
+		uint64_t frame;
+		uint32_t duration;
+		uint32_t nameId;
+		Category category;
+	};
+
+	struct Summary {
+		std::string name;
+		Category category;
+		uint32_t count;
+		// 单位均为毫秒
+		float average;
+		float p50;
+		float p99;
+		float max;
+	};
+
+	explicit FrameTrace(uint32_t capacity = DEFAULT_CAPACITY) noexcept;
+
+	FrameTrace(const FrameTrace&) = delete;
+	FrameTrace(FrameTrace&&) = delete;
+
+	// 同名的事件共用一个 id
+	uint32_t RegisterName(std::string_view name) noexcept;
+
+	uint64_t Now() const noexcept;
+
+	// 可以从任意线程调用，缓冲区满时覆盖最旧的事件
+	void Record(Category category, uint32_t nameId, uint64_t frame, uint64_t start, uint64_t duration) noexcept;
+
+	// 按名字统计缓冲区中的事件，按类别和注册顺序排列
+	std::vector<Summary> Summarize() const noexcept;
+
+	std::string ExportChromeTrace() const noexcept;
+
+	static const char* CategoryName(Category category) noexcept;
+
+private:
+	// 每帧大约有十几个事件，足够保存一分钟以上的数据
+	static constexpr uint32_t DEFAULT_CAPACITY = 1 << 16;
+
+	// 按时间顺序复制缓冲区中的事件
+	std::vector<Event> _Snapshot(std::vector<std::string>& names) const noexcept;
+
+	const std::chrono::steady_clock::time_point _startTime;
+
+	mutable std::mutex _lock;
+	std::vector<Event> _events;
+	// 记录过的事件总数
+	uint64_t _recordedCount = 0;
+	std::vector<std::string> _names;
+};
+
+}
@@ -1115,11 +1115,70 @@ bool OverlayDrawer::_DrawUI(const SmallVector<float>& effectTimings, uint32_t fp
 			}
 		}
 	}
+
+	_DrawEffectParameters();
 	
 	ImGui::End();
 	return needRedraw;
 }
 
+void OverlayDrawer::_DrawEffectParameters() noexcept {
+	Renderer& renderer = ScalingWindow::Get().Renderer();
+	const std::vector<Renderer::EffectInfo>& effectInfos = renderer.EffectInfos();
+	if (std::all_of(effectInfos.begin(), effectInfos.end(),
+		[](const Renderer::EffectInfo& info) { return info.params.empty(); })) {
+		return;
+	}
+
+	ImGui::Spacing();
+	if (!ImGui::CollapsingHeader(_GetResourceString(L"Overlay_Profiler_Parameters").c_str())) {
+		return;
+	}
+
+	ImGui::PushItemWidth(200 * _dpiScale);
+
+	for (uint32_t i = 0; i < (uint32_t)effectInfos.size(); ++i) {
+		const Renderer::EffectInfo& info = effectInfos[i];
+		if (info.params.empty()) {
+			continue;
+		}
+
+		// 不同效果的参数可能同名
+		ImGui::PushID((int)i);
+		ImGui::TextUnformatted(std::string(GetEffectDisplayName(&info)).c_str());
+
+		for (size_t j = 0; j < info.params.size(); ++j) {
+			const EffectParameterDesc& param = info.params[j];
+			const std::string label = StrUtils::Concat(
+				param.label.empty() ? param.name : param.label, "##", param.name);
+
+			float value = info.paramValues[j];
+			bool isChanged;
+			if (param.constant.index() == 0) {
+				const EffectConstant<float>& constant = std::get<0>(param.constant);
+				isChanged = ImGui::SliderFloat(label.c_str(), &value,
+					constant.minValue, constant.maxValue, "%.3f", ImGuiSliderFlags_AlwaysClamp);
+			} else {
+				const EffectConstant<int>& constant = std::get<1>(param.constant);
+				int intValue = (int)std::lroundf(value);
+				isChanged = ImGui::SliderInt(label.c_str(), &intValue,
+					constant.minValue, constant.maxValue, "%d", ImGuiSliderFlags_AlwaysClamp);
+				value = (float)intValue;
+			}
+
+			// 只影响本次缩放，不会保存到配置文件
+			if (isChanged) {
+				renderer.SetEffectParameter(i, StrUtils::UTF8ToUTF16(info.name),
+					StrUtils::UTF8ToUTF16(param.name), value);
+			}
+		}
+
+		ImGui::PopID();
+	}
+
+	ImGui::PopItemWidth();
+}
+
 const std::string& OverlayDrawer::_GetResourceString(const std::wstring_view& key) noexcept {
 	static phmap::flat_hash_map<std::wstring_view, std::string> cache;
 
@@ -62,6 +62,8 @@ private:
 
 	bool _DrawUI(const SmallVector<float>& effectTimings, uint32_t fps) noexcept;
 
+	void _DrawEffectParameters() noexcept;
+
 	const std::string& _GetResourceString(const std::wstring_view& key) noexcept;
 
 	float _dpiScale = 1.0f;
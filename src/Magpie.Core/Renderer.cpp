@@ -8,6 +8,9 @@
 #include "StrUtils.h"
 #include "Utils.h"
 #include "EffectCompiler.h"
+#include "CompileScheduler.h"
+#include "EffectTextureAllocator.h"
+#include "FP16StorageAllowlist.h"
 #include "GraphicsCaptureFrameSource.h"
 #include "DesktopDuplicationFrameSource.h"
 #include "GDIFrameSource.h"
@@ -18,15 +21,23 @@
 #include "OverlayDrawer.h"
 #include "CursorManager.h"
 #include "EffectsProfiler.h"
+#include "CommonSharedConstants.h"
 
 namespace Magpie::Core {
 
-Renderer::Renderer() noexcept {}
+Renderer::Renderer() noexcept {
+	_captureTraceId = _frameTrace.RegisterName("Capture");
+	_waitTraceId = _frameTrace.RegisterName("Wait");
+	_presentTraceId = _frameTrace.RegisterName("Present");
+}
 
 Renderer::~Renderer() noexcept {
 	_hKeyboardHook.reset();
 
 	if (_backendThread.joinable()) {
+		// 后端可能正在等待前端持有的共享纹理
+		_ReleasePresentedFrame();
+
 		DWORD backendThreadId = GetThreadId(_backendThread.native_handle());
 		// 持续尝试直到 _backendThread 创建了消息队列
 		while (!PostThreadMessage(backendThreadId, WM_QUIT, 0, 0)) {
@@ -34,6 +45,48 @@ Renderer::~Renderer() noexcept {
 		}
 		_backendThread.join();
 	}
+
+	if (_isTraceEnabled) {
+		_SaveTrace();
+	}
+}
+
+void Renderer::_StartProfiler() noexcept {
+	SmallVector<uint32_t> passNameIds;
+	for (const EffectInfo& info : _effectInfos) {
+		for (const std::string& passName : info.passNames) {
+			passNameIds.push_back(_frameTrace.RegisterName(StrUtils::Concat(info.name, ": ", passName)));
+		}
+	}
+
+	_effectsProfiler.Start(_backendResources.GetD3DDevice(), _isTraceEnabled ? &_frameTrace : nullptr,
+		std::move(passNameIds), MAX_FRAMES_IN_FLIGHT);
+}
+
+// 保存本次缩放的 trace，以便诊断用户报告的卡顿
+void Renderer::_SaveTrace() const noexcept {
+	const std::vector<FrameTrace::Summary> summaries = _frameTrace.Summarize();
+	if (summaries.empty()) {
+		return;
+	}
+
+	// 每个阶段一条日志，单位均为毫秒
+	for (const FrameTrace::Summary& summary : summaries) {
+		Logger::Get().Info("阶段耗时", {
+			{ "category", FrameTrace::CategoryName(summary.category) },
+			{ "name", summary.name },
+			{ "count", summary.count },
+			{ "average", summary.average },
+			{ "p50", summary.p50 },
+			{ "p99", summary.p99 },
+			{ "max", summary.max }
+		});
+	}
+
+	const std::string trace = _frameTrace.ExportChromeTrace();
+	if (!Win32Utils::WriteFile(CommonSharedConstants::TRACE_PATH, trace.data(), trace.size())) {
+		Logger::Get().Error("保存 trace 失败");
+	}
 }
 
 // 监听 PrintScreen 实现截屏时隐藏光标
@@ -78,9 +131,10 @@ static void LogAdapter(IDXGIAdapter4* adapter) noexcept {
 }
 
 bool Renderer::Initialize() noexcept {
+	_isTraceEnabled = ScalingWindow::Get().Options().IsFrameTraceEnabled();
 	_backendThread = std::thread(std::bind(&Renderer::_BackendThreadProc, this));
 
-	if (!_frontendResources.Initialize()) {
+	if (!_frontendResources.Initialize(ScalingWindow::Get().Options().graphicsCard)) {
 		Logger::Get().Error("初始化前端资源失败");
 		return false;
 	}
@@ -93,34 +147,19 @@ bool Renderer::Initialize() noexcept {
 	}
 
 	// 等待后端初始化完成
-	_sharedTextureHandle.wait(NULL, std::memory_order_relaxed);
-	const HANDLE sharedTextureHandle = _sharedTextureHandle.load(std::memory_order_acquire);
-	if (sharedTextureHandle == INVALID_HANDLE_VALUE) {
+	_backendState.wait(_BackendState::Initializing, std::memory_order_relaxed);
+	if (_backendState.load(std::memory_order_acquire) == _BackendState::Failed) {
 		Logger::Get().Error("后端初始化失败");
 		return false;
 	}
 
-	// 获取共享纹理
-	HRESULT hr = _frontendResources.GetD3DDevice()->OpenSharedResource(
-		sharedTextureHandle, IID_PPV_ARGS(_frontendSharedTexture.put()));
-	if (FAILED(hr)) {
-		Logger::Get().ComError("OpenSharedResource 失败", hr);
+	if (!_OpenSharedTextures()) {
+		Logger::Get().Error("_OpenSharedTextures 失败");
 		return false;
 	}
 
-	_frontendSharedTextureMutex = _frontendSharedTexture.try_as<IDXGIKeyedMutex>();
-
-	D3D11_TEXTURE2D_DESC desc;
-	_frontendSharedTexture->GetDesc(&desc);
-
-	const RECT& scalingWndRect = ScalingWindow::Get().WndRect();
-	_destRect.left = (scalingWndRect.left + scalingWndRect.right - (LONG)desc.Width) / 2;
-	_destRect.top = (scalingWndRect.top + scalingWndRect.bottom - (LONG)desc.Height) / 2;
-	_destRect.right = _destRect.left + (LONG)desc.Width;
-	_destRect.bottom = _destRect.top + (LONG)desc.Height;
-
 	if (!_cursorDrawer.Initialize(_frontendResources, _backBuffer.get())) {
-		Logger::Get().ComError("初始化 CursorDrawer 失败", hr);
+		Logger::Get().Error("初始化 CursorDrawer 失败");
 		return false;
 	}
 
@@ -140,6 +179,66 @@ bool Renderer::Initialize() noexcept {
 	return true;
 }
 
+bool Renderer::ResizeSrc() noexcept {
+	// 后端可能正在等待前端持有的共享纹理。它等待的纹理比已发布的最新一帧更旧，切换到最新一帧
+	// 即可释放，这样共享纹理被保留时可以继续显示
+	if (!_AcquireLatestFrame()) {
+		return false;
+	}
+
+	_backendState.store(_BackendState::Resizing, std::memory_order_relaxed);
+	const bool enqueued = _backendThreadDispatcher.TryEnqueue([this]() {
+		const bool success = _ResizeBackend();
+		_backendState.store(success ? _BackendState::Running : _BackendState::Failed, std::memory_order_release);
+		_backendState.notify_one();
+	});
+	if (!enqueued) {
+		_backendState.store(_BackendState::Running, std::memory_order_relaxed);
+		return false;
+	}
+
+	// 等待后端完成，期间前端不会访问共享纹理
+	_backendState.wait(_BackendState::Resizing, std::memory_order_relaxed);
+	if (_backendState.load(std::memory_order_acquire) == _BackendState::Failed) {
+		Logger::Get().Error("后端调整尺寸失败");
+		return false;
+	}
+
+	// 效果的输出尺寸不变时共享纹理被保留，可以继续显示上一帧
+	if (_isSharedTexturesRecreated && !_OpenSharedTextures()) {
+		Logger::Get().Error("_OpenSharedTextures 失败");
+		return false;
+	}
+
+	return true;
+}
+
+bool Renderer::_OpenSharedTextures() noexcept {
+	for (uint32_t i = 0; i < SHARED_TEXTURE_COUNT; ++i) {
+		HRESULT hr = _frontendResources.GetD3DDevice()->OpenSharedResource(
+			_sharedTextureHandles[i], IID_PPV_ARGS(_frontendSharedTextures[i].put()));
+		if (FAILED(hr)) {
+			Logger::Get().ComError("OpenSharedResource 失败", hr);
+			return false;
+		}
+
+		_frontendSharedTextureMutexes[i] = _frontendSharedTextures[i].try_as<IDXGIKeyedMutex>();
+	}
+
+	_firstPresentableFrame = _sharedTexturesFirstFrame;
+
+	D3D11_TEXTURE2D_DESC desc;
+	_frontendSharedTextures[0]->GetDesc(&desc);
+
+	const RECT& scalingWndRect = ScalingWindow::Get().WndRect();
+	_destRect.left = (scalingWndRect.left + scalingWndRect.right - (LONG)desc.Width) / 2;
+	_destRect.top = (scalingWndRect.top + scalingWndRect.bottom - (LONG)desc.Height) / 2;
+	_destRect.right = _destRect.left + (LONG)desc.Width;
+	_destRect.bottom = _destRect.top + (LONG)desc.Height;
+
+	return true;
+}
+
 static bool CheckMultiplaneOverlaySupport(IDXGISwapChain4* swapChain) noexcept {
 	winrt::com_ptr<IDXGIOutput> output;
 	HRESULT hr = swapChain->GetContainingOutput(output.put());
@@ -165,6 +264,39 @@ void Renderer::OnCursorVisibilityChanged(bool isVisible, bool onDestory) {
 	});
 }
 
+void Renderer::SetEffectParameter(
+	uint32_t effectIdx,
+	std::wstring_view effectName,
+	std::wstring_view paramName,
+	float value
+) {
+	std::string effectNameUtf8 = StrUtils::UTF16ToUTF8(effectName);
+
+	// 后端初始化完成后 _effectInfos 不再改变，前端可以直接访问。记录参数的当前值以便叠加层显示
+	if (effectIdx < _effectInfos.size() && _effectInfos[effectIdx].name == effectNameUtf8) {
+		EffectInfo& info = _effectInfos[effectIdx];
+		const std::string paramNameUtf8 = StrUtils::UTF16ToUTF8(paramName);
+		for (size_t i = 0; i < info.params.size(); ++i) {
+			if (info.params[i].name == paramNameUtf8) {
+				info.paramValues[i] = value;
+				break;
+			}
+		}
+	}
+
+	_backendThreadDispatcher.TryEnqueue(
+		[this, effectIdx, effectName(std::move(effectNameUtf8)), paramName(std::wstring(paramName)), value]() {
+		// 缩放期间缩放模式可能被编辑，效果不一致时忽略
+		if (effectIdx >= _effectInfos.size() || _effectInfos[effectIdx].name != effectName) {
+			return;
+		}
+
+		if (_effectDrawers[effectIdx].SetParameter(paramName, value)) {
+			_isEffectParamsChanged = true;
+		}
+	});
+}
+
 void Renderer::MessageHandler(UINT msg, WPARAM wParam, LPARAM lParam) noexcept {
 	if (_overlayDrawer) {
 		_overlayDrawer->MessageHandler(msg, wParam, lParam);
@@ -266,40 +398,41 @@ void Renderer::_FrontendRender() noexcept {
 	// 所有渲染都使用三角形带拓扑
 	d3dDC->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
+	// 后端保证这一帧已经完成，前端持有它的共享纹理期间不会被覆盖
+	if (!_AcquireLatestFrame()) {
+		return;
+	}
+	// 共享纹理被重新创建后还没有写入任何帧
+	const bool hasFrame = _lastPresentedFrame >= _firstPresentableFrame;
+
 	// 输出画面是否充满缩放窗口
 	const RECT& scalingWndRect = ScalingWindow::Get().WndRect();
 	const bool isFill = _destRect == scalingWndRect;
 
-	if (!isFill) {
+	if (!isFill || !hasFrame) {
 		// 以黑色填充背景，因为我们指定了 DXGI_SWAP_EFFECT_FLIP_DISCARD，同时也是为了和 RTSS 兼容
 		static constexpr FLOAT BLACK[4] = { 0.0f,0.0f,0.0f,1.0f };
 		d3dDC->ClearRenderTargetView(_backBufferRtv.get(), BLACK);
 	}
 
-	_lastAccessMutexKey = ++_sharedTextureMutexKey;
-	HRESULT hr = _frontendSharedTextureMutex->AcquireSync(_lastAccessMutexKey - 1, INFINITE);
-	if (FAILED(hr)) {
-		Logger::Get().ComError("AcquireSync 失败", hr);
-		return;
-	}
-
-	if (isFill) {
-		d3dDC->CopyResource(_backBuffer.get(), _frontendSharedTexture.get());
-	} else {
-		d3dDC->CopySubresourceRegion(
-			_backBuffer.get(),
-			0,
-			_destRect.left - scalingWndRect.left,
-			_destRect.top - scalingWndRect.top,
-			0,
-			_frontendSharedTexture.get(),
-			0,
-			nullptr
-		);
+	if (hasFrame) {
+		ID3D11Texture2D* sharedTexture = _frontendSharedTextures[_lastPresentedFrame % SHARED_TEXTURE_COUNT].get();
+		if (isFill) {
+			d3dDC->CopyResource(_backBuffer.get(), sharedTexture);
+		} else {
+			d3dDC->CopySubresourceRegion(
+				_backBuffer.get(),
+				0,
+				_destRect.left - scalingWndRect.left,
+				_destRect.top - scalingWndRect.top,
+				0,
+				sharedTexture,
+				0,
+				nullptr
+			);
+		}
 	}
 
-	_frontendSharedTextureMutex->ReleaseSync(_lastAccessMutexKey);
-
 	// 叠加层和光标都绘制到 back buffer
 	{
 		ID3D11RenderTargetView* t = _backBufferRtv.get();
@@ -320,25 +453,67 @@ void Renderer::_FrontendRender() noexcept {
 	_cursorDrawer.Draw();
 
 	// 两个垂直同步之间允许渲染数帧，SyncInterval = 0 只呈现最新的一帧，旧帧被丢弃
+	const uint64_t presentStart = _frameTrace.Now();
 	_swapChain->Present(0, 0);
+	if (_isTraceEnabled) {
+		_frameTrace.Record(FrameTrace::Category::Present, _presentTraceId,
+			_lastPresentedFrame, presentStart, _frameTrace.Now() - presentStart);
+	}
 
 	// 丢弃渲染目标的内容
 	d3dDC->DiscardView(_backBufferRtv.get());
 }
 
+bool Renderer::_AcquireLatestFrame() noexcept {
+	uint64_t publishedFrame = _publishedFrame.load(std::memory_order_acquire);
+	while (_lastPresentedFrame < publishedFrame) {
+		for (uint64_t frame = std::max(_lastPresentedFrame + 1, _firstPresentableFrame); frame <= publishedFrame; ++frame) {
+			// 已发布的帧一定已由后端以 1 释放，因此不会长时间等待
+			HRESULT hr = _frontendSharedTextureMutexes[frame % SHARED_TEXTURE_COUNT]->AcquireSync(1, INFINITE);
+			if (FAILED(hr)) {
+				Logger::Get().ComError("AcquireSync 失败", hr);
+				return false;
+			}
+
+			if (_lastPresentedFrame >= _firstPresentableFrame) {
+				_frontendSharedTextureMutexes[_lastPresentedFrame % SHARED_TEXTURE_COUNT]->ReleaseSync(0);
+			}
+			_lastPresentedFrame = frame;
+		}
+
+		// 共享纹理被重新创建后还没有写入任何帧时循环不会执行
+		_lastPresentedFrame = publishedFrame;
+
+		// 获取期间后端可能发布了更新的帧
+		publishedFrame = _publishedFrame.load(std::memory_order_acquire);
+	}
+
+	return true;
+}
+
+void Renderer::_ReleasePresentedFrame() noexcept {
+	if (_lastPresentedFrame < _firstPresentableFrame) {
+		return;
+	}
+
+	_frontendSharedTextureMutexes[_lastPresentedFrame % SHARED_TEXTURE_COUNT]->ReleaseSync(0);
+	_firstPresentableFrame = _lastPresentedFrame + 1;
+}
+
 bool Renderer::Render() noexcept {
 	const CursorManager& cursorManager = ScalingWindow::Get().CursorManager();
 	const HCURSOR hCursor = cursorManager.Cursor();
 	const POINT cursorPos = cursorManager.CursorPos();
 	const uint32_t fps = _stepTimer.FPS();
 
-	// 有新帧或光标改变则渲染新的帧
-	if (_lastAccessMutexKey == _sharedTextureMutexKey.load(std::memory_order_relaxed)) {
-		if (_lastAccessMutexKey == 0) {
-			// 第一帧尚未完成
-			return false;
-		}
+	const uint64_t publishedFrame = _publishedFrame.load(std::memory_order_relaxed);
+	if (publishedFrame < _firstPresentableFrame) {
+		// 第一帧或共享纹理被重新创建后的第一帧尚未完成
+		return false;
+	}
 
+	// 有新帧或光标改变则渲染新的帧
+	if (_lastPresentedFrame == publishedFrame) {
 		// 检查光标是否移动
 		if (hCursor == _lastCursorHandle && cursorPos == _lastCursorPos) {
 			if (IsOverlayVisible() || ScalingWindow::Get().Options().IsShowFPS()) {
@@ -380,13 +555,11 @@ void Renderer::SetOverlayVisibility(bool value, bool noSetForeground) noexcept {
 		}
 		_overlayDrawer->SetUIVisibility(true);
 
-		_backendThreadDispatcher.TryEnqueue([this]() {
-			uint32_t passCount = 0;
-			for (const EffectInfo& info : _effectInfos) {
-				passCount += (uint32_t)info.passNames.size();
-			}
-			_effectsProfiler.Start(_backendResources.GetD3DDevice(), passCount);
-		});
+		if (!_isTraceEnabled) {
+			_backendThreadDispatcher.TryEnqueue([this]() {
+				_StartProfiler();
+			});
+		}
 	} else {
 		if (_overlayDrawer) {
 			if (!_overlayDrawer->IsUIVisible()) {
@@ -395,9 +568,11 @@ void Renderer::SetOverlayVisibility(bool value, bool noSetForeground) noexcept {
 			_overlayDrawer->SetUIVisibility(false, noSetForeground);
 		}
 
-		_backendThreadDispatcher.TryEnqueue([this]() {
-			_effectsProfiler.Stop();
-		});
+		if (!_isTraceEnabled) {
+			_backendThreadDispatcher.TryEnqueue([this]() {
+				_effectsProfiler.Stop();
+			});
+		}
 	}
 
 	// 立即渲染一帧
@@ -472,8 +647,10 @@ static std::optional<EffectDesc> CompileEffect(const EffectOption& effectOption)
 	});
 
 	if (success) {
-		Logger::Get().Info(fmt::format("编译 {}.hlsl 用时 {} 毫秒",
-			StrUtils::UTF16ToUTF8(effectOption.name), duration / 1000.0f));
+		Logger::Get().Info("已编译效果", {
+			{ "effect", StrUtils::UTF16ToUTF8(effectOption.name) },
+			{ "durationMs", duration / 1000.0f }
+		});
 		return result;
 	} else {
 		Logger::Get().Error(StrUtils::Concat("编译 ",
@@ -488,38 +665,70 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 
 	const uint32_t effectCount = (uint32_t)effects.size();
 
-	// 并行编译所有效果
+	// 并行编译所有效果，所有效果的通道由同一个调度器调度
 	std::vector<EffectDesc> effectDescs(effects.size());
 	std::atomic<bool> anyFailure;
 
-	int duration = Utils::Measure([&]() {
-		Win32Utils::RunParallel([&](uint32_t id) {
-			std::optional<EffectDesc> desc = CompileEffect(effects[id]);
-			if (desc) {
-				effectDescs[id] = std::move(*desc);
-			} else {
-				anyFailure.store(true, std::memory_order_relaxed);
-			}
-		}, effectCount);
-	});
+	CompileScheduler::Statistics stats;
+	{
+		CompileScheduler scheduler;
+		CompileScheduler::TaskGroup group;
+		for (uint32_t i = 0; i < effectCount; ++i) {
+			// 效果需要先解析才能提交通道，因此最先执行
+			scheduler.Submit(group, std::numeric_limits<uint64_t>::max(), [&, i]() {
+				std::optional<EffectDesc> desc = CompileEffect(effects[i]);
+				if (desc) {
+					effectDescs[i] = std::move(*desc);
+				} else {
+					anyFailure.store(true, std::memory_order_relaxed);
+				}
+			});
+		}
+		scheduler.Wait(group);
+
+		stats = scheduler.GetStatistics();
+	}
 
 	if (anyFailure.load(std::memory_order_relaxed)) {
 		return nullptr;
 	}
 
+	// 按验证结果将部分中间纹理改为 FP16 存储，加载失败时使用效果指定的格式
+	{
+		FP16StorageAllowlist fp16StorageAllowlist;
+		fp16StorageAllowlist.Load();
+		for (EffectDesc& desc : effectDescs) {
+			fp16StorageAllowlist.Apply(desc);
+		}
+	}
+
 	if (effectCount > 1) {
-		Logger::Get().Info(fmt::format("编译着色器总计用时 {} 毫秒", duration / 1000.0f));
+		// parallelPercent 为并行执行的时间占比，parallelism 为平均并行度
+		Logger::Get().Info("已编译所有效果", {
+			{ "effectCount", effectCount },
+			{ "durationMs", stats.wallTime / 1000.0f },
+			{ "parallelPercent", stats.wallTime == 0 ? 0.0f : stats.parallelTime * 100.0f / stats.wallTime },
+			{ "parallelism", stats.wallTime == 0 ? 0.0f : (float)stats.busyTime / stats.wallTime }
+		});
 	}
 
 	_effectDrawers.resize(effects.size());
 
+	// 所有效果的中间纹理由同一个分配器分配，以便跨效果复用
+	EffectTextureAllocator textureAllocator;
+	textureAllocator.Initialize(_backendResources.GetD3DDevice());
+
+	const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
 	ID3D11Texture2D* inOutTexture = _frameSource->GetOutput();
 	for (uint32_t i = 0; i < effectCount; ++i) {
 		if (!_effectDrawers[i].Initialize(
 			effectDescs[i],
 			effects[i],
+			scalingWndSize,
 			_backendResources,
 			_backendDescriptorStore,
+			_effectConstantStore,
+			textureAllocator,
 			&inOutTexture
 		)) {
 			Logger::Get().Error(fmt::format("初始化效果#{} ({}) 失败", i, StrUtils::UTF16ToUTF8(effects[i].name)));
@@ -538,13 +747,28 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 		for (EffectPassDesc& passDesc : desc.passes) {
 			info.passNames.emplace_back(std::move(passDesc.desc));
 		}
+
+		if (!(desc.flags & EffectFlags::InlineParams)) {
+			// EffectDrawer 已检查过参数的值
+			info.paramValues.reserve(desc.params.size());
+			for (const EffectParameterDesc& paramDesc : desc.params) {
+				auto it = effects[i].parameters.find(StrUtils::UTF8ToUTF16(paramDesc.name));
+				if (it != effects[i].parameters.end()) {
+					info.paramValues.push_back(it->second);
+				} else if (paramDesc.constant.index() == 0) {
+					info.paramValues.push_back(std::get<0>(paramDesc.constant).defaultValue);
+				} else {
+					info.paramValues.push_back((float)std::get<1>(paramDesc.constant).defaultValue);
+				}
+			}
+			info.params = std::move(desc.params);
+		}
 	}
 
 	// 输出尺寸大于缩放窗口尺寸则需要降采样
 	{
 		D3D11_TEXTURE2D_DESC desc;
 		inOutTexture->GetDesc(&desc);
-		const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
 		if ((LONG)desc.Width > scalingWndSize.cx || (LONG)desc.Height > scalingWndSize.cy) {
 			EffectOption bicubicOption{
 				.name = L"Bicubic",
@@ -567,8 +791,11 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 			if (!bicubicDrawer.Initialize(
 				*bicubicDesc,
 				bicubicOption,
+				scalingWndSize,
 				_backendResources,
 				_backendDescriptorStore,
+				_effectConstantStore,
+				textureAllocator,
 				&inOutTexture
 			)) {
 				Logger::Get().Error("初始化降采样效果失败");
@@ -585,63 +812,91 @@ ID3D11Texture2D* Renderer::_BuildEffects() noexcept {
 		}
 	}
 
-	// 初始化所有效果共用的动态常量缓冲区
-	for (uint32_t i = 0; i < effectDescs.size(); ++i) {
-		if (effectDescs[i].flags & EffectFlags::UseDynamic) {
-			_firstDynamicEffectIdx = i;
-			break;
-		}
+	textureAllocator.LogStatistics();
+
+	// 所有效果共用的动态常量
+	if (std::any_of(effectDescs.begin(), effectDescs.end(),
+		[](const EffectDesc& desc) { return desc.flags & EffectFlags::UseDynamic; })) {
+		// cbuffer __CB2 : register(b1) { uint __frameCount; };
+		_dynamicConstantRegion = _effectConstantStore.AddRegion(1);
 	}
-	
-	if (_firstDynamicEffectIdx != std::numeric_limits<uint32_t>::max()) {
-		D3D11_BUFFER_DESC bd = {
-			.ByteWidth = 16,	// 只用 4 个字节
-			.Usage = D3D11_USAGE_DYNAMIC,
-			.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
-			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE
-		};
-		HRESULT hr = _backendResources.GetD3DDevice()->CreateBuffer(&bd, nullptr, _dynamicCB.put());
-		if (FAILED(hr)) {
-			Logger::Get().ComError("CreateBuffer 失败", hr);
-			return nullptr;
-		}
+
+	// 创建常量缓冲区
+	if (!_effectConstantStore.Upload()) {
+		Logger::Get().Error("上传常量失败");
+		return nullptr;
 	}
 
 	return inOutTexture;
 }
 
-HANDLE Renderer::_CreateSharedTexture(ID3D11Texture2D* effectsOutput) noexcept {
+bool Renderer::_CreateSharedTextures() noexcept {
 	D3D11_TEXTURE2D_DESC desc;
-	effectsOutput->GetDesc(&desc);
+	_effectsOutput->GetDesc(&desc);
 	SIZE textureSize = { (LONG)desc.Width, (LONG)desc.Height };
 
-	// 创建共享纹理
-	_backendSharedTexture = DirectXHelper::CreateTexture2D(
-		_backendResources.GetD3DDevice(),
-		DXGI_FORMAT_R8G8B8A8_UNORM,
-		textureSize.cx,
-		textureSize.cy,
-		D3D11_BIND_SHADER_RESOURCE,
-		D3D11_USAGE_DEFAULT,
-		D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX
-	);
-	if (!_backendSharedTexture) {
-		Logger::Get().Error("创建 Texture2D 失败");
-		return NULL;
-	}
+	// 优先让最后一个效果直接写入共享纹理以省去一次复制，需要共享纹理支持 UAV
+	for (const bool directOutput : { true, false }) {
+		bool success = true;
+
+		for (uint32_t i = 0; i < SHARED_TEXTURE_COUNT; ++i) {
+			_BackendSharedTexture& sharedTexture = _backendSharedTextures[i];
+
+			// 创建共享纹理
+			sharedTexture.texture = DirectXHelper::CreateTexture2D(
+				_backendResources.GetD3DDevice(),
+				DXGI_FORMAT_R8G8B8A8_UNORM,
+				textureSize.cx,
+				textureSize.cy,
+				directOutput ? D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS : D3D11_BIND_SHADER_RESOURCE,
+				D3D11_USAGE_DEFAULT,
+				D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX
+			);
+			if (!sharedTexture.texture) {
+				Logger::Get().Error("创建 Texture2D 失败");
+				success = false;
+				break;
+			}
 
-	_backendSharedTextureMutex = _backendSharedTexture.try_as<IDXGIKeyedMutex>();
+			sharedTexture.mutex = sharedTexture.texture.try_as<IDXGIKeyedMutex>();
+			// 首次使用时需要写入整个输出
+			sharedTexture.staleRect = { 0, 0, textureSize.cx, textureSize.cy };
 
-	winrt::com_ptr<IDXGIResource> sharedDxgiRes = _backendSharedTexture.try_as<IDXGIResource>();
+			winrt::com_ptr<IDXGIResource> sharedDxgiRes = sharedTexture.texture.try_as<IDXGIResource>();
 
-	HANDLE sharedHandle = NULL;
-	HRESULT hr = sharedDxgiRes->GetSharedHandle(&sharedHandle);
-	if (FAILED(hr)) {
-		Logger::Get().ComError("GetSharedHandle 失败", hr);
-		return NULL;
+			HRESULT hr = sharedDxgiRes->GetSharedHandle(&_sharedTextureHandles[i]);
+			if (FAILED(hr)) {
+				Logger::Get().ComError("GetSharedHandle 失败", hr);
+				success = false;
+				break;
+			}
+		}
+
+		if (!success) {
+			continue;
+		}
+
+		if (directOutput) {
+			std::array<ID3D11Texture2D*, SHARED_TEXTURE_COUNT> targets;
+			for (uint32_t i = 0; i < SHARED_TEXTURE_COUNT; ++i) {
+				targets[i] = _backendSharedTextures[i].texture.get();
+			}
+
+			if (!_effectDrawers.back().RedirectOutput(targets, _backendDescriptorStore)) {
+				Logger::Get().Error("RedirectOutput 失败");
+				continue;
+			}
+
+			// 原输出纹理已被释放
+			_effectsOutput = nullptr;
+		}
+
+		Logger::Get().Info(directOutput ? "效果直接输出到共享纹理" : "效果输出将被复制到共享纹理");
+		_sharedTexturesFirstFrame = _fenceValue + 1;
+		return true;
 	}
 
-	return sharedHandle;
+	return false;
 }
 
 void Renderer::_BackendThreadProc() noexcept {
@@ -651,12 +906,11 @@ void Renderer::_BackendThreadProc() noexcept {
 
 	winrt::init_apartment(winrt::apartment_type::single_threaded);
 
-	ID3D11Texture2D* outputTexture = _InitBackend();
-	if (!outputTexture) {
+	if (!_InitBackend()) {
 		_frameSource.reset();
 		// 通知前端初始化失败
-		_sharedTextureHandle.store(INVALID_HANDLE_VALUE, std::memory_order_release);
-		_sharedTextureHandle.notify_one();
+		_backendState.store(_BackendState::Failed, std::memory_order_release);
+		_backendState.notify_one();
 
 		// 即使失败也要创建消息循环，否则前端线程将一直等待
 		MSG msg;
@@ -667,6 +921,9 @@ void Renderer::_BackendThreadProc() noexcept {
 	}
 
 	bool waitingForStepTimer = true;
+	// 用于 trace，等待从上一帧渲染完开始计算
+	uint64_t waitStart = _frameTrace.Now();
+	uint64_t waitEnd = waitStart;
 
 	MSG msg;
 	while (true) {
@@ -680,29 +937,65 @@ void Renderer::_BackendThreadProc() noexcept {
 			DispatchMessage(&msg);
 		}
 
+		if (_backendState.load(std::memory_order_relaxed) == _BackendState::Failed) {
+			// 调整尺寸失败，等待前端销毁
+			WaitMessage();
+			continue;
+		}
+
+		_PublishCompletedFrames();
+
 		if (waitingForStepTimer) {
-			if (!_stepTimer.WaitForNextFrame()) {
+			// 有帧完成时立即唤醒以便尽快交给前端
+			if (!_stepTimer.WaitForNextFrame(_fenceEvent.get())) {
 				_stepTimer.UpdateFPS(false);
 				continue;
 			}
 			waitingForStepTimer = false;
+			waitEnd = _frameTrace.Now();
 		}
 
+		const uint64_t captureStart = _frameTrace.Now();
 		const FrameSourceBase::UpdateState state = _frameSource->Update();
 		_stepTimer.UpdateFPS(state == FrameSourceBase::UpdateState::NewFrame);
 
 		switch (state) {
 		case FrameSourceBase::UpdateState::NewFrame:
 		{
-			_BackendRender(outputTexture);
+			// 只记录得到新帧时的等待和捕获，否则事件太多
+			if (_isTraceEnabled) {
+				const uint64_t frame = _fenceValue + 1;
+				_frameTrace.Record(FrameTrace::Category::Wait, _waitTraceId, frame, waitStart, waitEnd - waitStart);
+				_frameTrace.Record(FrameTrace::Category::Capture, _captureTraceId,
+					frame, captureStart, _frameTrace.Now() - captureStart);
+			}
+
+			_isEffectParamsChanged = false;
+			_BackendRender();
 			waitingForStepTimer = true;
+			waitStart = _frameTrace.Now();
 			break;
 		}
 		case FrameSourceBase::UpdateState::Waiting:
 		{
+			if (_isEffectParamsChanged) {
+				// 源窗口没有变化时也要以新参数重新渲染
+				_isEffectParamsChanged = false;
+				_BackendRender();
+				waitingForStepTimer = true;
+				waitStart = _frameTrace.Now();
+				break;
+			}
+
 			if (_frameSource->WaitType() == FrameSourceBase::WaitForMessage) {
-				// 等待新消息
-				WaitMessage();
+				if (_publishedFrame.load(std::memory_order_relaxed) == _fenceValue) {
+					// 等待新消息
+					WaitMessage();
+				} else {
+					// 等待新消息或有帧完成
+					const HANDLE hFenceEvent = _fenceEvent.get();
+					MsgWaitForMultipleObjectsEx(1, &hFenceEvent, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+				}
 			}
 			break;
 		}
@@ -715,7 +1008,7 @@ void Renderer::_BackendThreadProc() noexcept {
 	}
 }
 
-ID3D11Texture2D* Renderer::_InitBackend() noexcept {
+bool Renderer::_InitBackend() noexcept {
 	// 创建 DispatcherQueue
 	{
 		winrt::Windows::System::DispatcherQueueController dqc{ nullptr };
@@ -728,21 +1021,22 @@ ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 		);
 		if (FAILED(hr)) {
 			Logger::Get().ComError("CreateDispatcherQueueController 失败", hr);
-			return nullptr;
+			return false;
 		}
 
 		_backendThreadDispatcher = dqc.DispatcherQueue();
 	}
 
-	if (!_backendResources.Initialize()) {
-		return nullptr;
+	if (!_backendResources.Initialize(ScalingWindow::Get().Options().graphicsCard)) {
+		return false;
 	}
 	
 	ID3D11Device5* d3dDevice = _backendResources.GetD3DDevice();
 	_backendDescriptorStore.Initialize(d3dDevice);
+	_effectConstantStore.Initialize(d3dDevice, _backendResources.GetD3DDC());
 
 	if (!_InitFrameSource()) {
-		return nullptr;
+		return false;
 	}
 
 	{
@@ -774,109 +1068,268 @@ ID3D11Texture2D* Renderer::_InitBackend() noexcept {
 		_stepTimer.Initialize(frameRateLimit);
 	}
 
-	ID3D11Texture2D* outputTexture = _BuildEffects();
-	if (!outputTexture) {
-		return nullptr;
+	_effectsOutput = _BuildEffects();
+	if (!_effectsOutput) {
+		return false;
 	}
 
 	HRESULT hr = d3dDevice->CreateFence(
 		_fenceValue, D3D11_FENCE_FLAG_NONE, IID_PPV_ARGS(&_d3dFence));
 	if (FAILED(hr)) {
 		Logger::Get().ComError("CreateFence 失败", hr);
-		return nullptr;
+		return false;
 	}
 
 	if (!_fenceEvent.try_create(wil::EventOptions::None, nullptr)) {
 		Logger::Get().Win32Error("CreateEvent 失败");
-		return nullptr;
+		return false;
 	}
 
-	HANDLE sharedHandle = _CreateSharedTexture(outputTexture);
-	if (!sharedHandle) {
-		Logger::Get().Win32Error("_CreateSharedTexture 失败");
-		return nullptr;
+	if (!_CreateSharedTextures()) {
+		Logger::Get().Error("_CreateSharedTextures 失败");
+		return false;
 	}
 	
+	if (_isTraceEnabled) {
+		// 记录 trace 时始终统计每个通道的耗时，否则只在显示叠加层时统计
+		_StartProfiler();
+	}
+
+	_srcRect = _frameSource->SrcRect();
+	_backendState.store(_BackendState::Running, std::memory_order_release);
+	_backendState.notify_one();
+
+	return true;
+}
+
+bool Renderer::_ResizeBackend() noexcept {
+	// 等待 GPU 完成所有帧，之后可以安全地替换纹理
+	if (!_WaitForFramesInFlight(0)) {
+		return false;
+	}
+
+	// 捕获区域改变，重新创建 FrameSource
+	_backendDescriptorStore.RemoveViews(_frameSource->GetOutput());
+	_frameSource.reset();
+	if (!_InitFrameSource()) {
+		return false;
+	}
+
+	bool success = true;
+	const int duration = Utils::Measure([&]() {
+		success = _ResizeEffects();
+	});
+	if (!success) {
+		return false;
+	}
+	Logger::Get().Info("已调整效果尺寸", { { "durationMs", duration / 1000.0f } });
+
+	// 效果的输出尺寸不变时保留共享纹理
+	_isSharedTexturesRecreated = false;
+	if (_effectsOutput) {
+		D3D11_TEXTURE2D_DESC outputDesc;
+		_effectsOutput->GetDesc(&outputDesc);
+		D3D11_TEXTURE2D_DESC sharedDesc;
+		_backendSharedTextures[0].texture->GetDesc(&sharedDesc);
+
+		if (outputDesc.Width != sharedDesc.Width || outputDesc.Height != sharedDesc.Height) {
+			for (_BackendSharedTexture& sharedTexture : _backendSharedTextures) {
+				_backendDescriptorStore.RemoveViews(sharedTexture.texture.get());
+			}
+
+			if (!_CreateSharedTextures()) {
+				Logger::Get().Error("_CreateSharedTextures 失败");
+				return false;
+			}
+
+			_isSharedTexturesRecreated = true;
+		}
+	}
+
 	_srcRect = _frameSource->SrcRect();
-	_sharedTextureHandle.store(sharedHandle, std::memory_order_release);
-	_sharedTextureHandle.notify_one();
+	return true;
+}
+
+bool Renderer::_ResizeEffects() noexcept {
+	// 旧的中间纹理交给分配器，格式和尺寸不变的被直接复用。不同效果可能共用同一纹理，
+	// 因此必须先回收所有效果的纹理
+	EffectTextureAllocator textureAllocator;
+	textureAllocator.Initialize(_backendResources.GetD3DDevice());
+	for (EffectDrawer& effectDrawer : _effectDrawers) {
+		effectDrawer.RecycleTextures(textureAllocator);
+	}
+
+	const uint32_t effectCount = (uint32_t)ScalingWindow::Get().Options().effects.size();
+	const SIZE scalingWndSize = Win32Utils::GetSizeOfRect(ScalingWindow::Get().WndRect());
+	ID3D11Texture2D* inOutTexture = _frameSource->GetOutput();
+	for (uint32_t i = 0; i < effectCount; ++i) {
+		if (!_effectDrawers[i].Resize(
+			scalingWndSize,
+			_backendResources,
+			_backendDescriptorStore,
+			textureAllocator,
+			&inOutTexture
+		)) {
+			Logger::Get().Error(fmt::format("调整效果#{} 的尺寸失败", i));
+			return false;
+		}
+	}
+
+	// 降采样效果是否存在由初始化时的输出尺寸决定，无法在这里添加或删除。
+	// inOutTexture 为空表示输出尺寸不变且仍直接写入共享纹理
+	bool needDownscaling = false;
+	if (inOutTexture) {
+		D3D11_TEXTURE2D_DESC desc;
+		inOutTexture->GetDesc(&desc);
+		needDownscaling = (LONG)desc.Width > scalingWndSize.cx || (LONG)desc.Height > scalingWndSize.cy;
+	}
+
+	if (needDownscaling != (_effectDrawers.size() > effectCount)) {
+		Logger::Get().Info("是否需要降采样已改变");
+		return false;
+	}
 
-	return outputTexture;
+	if (needDownscaling && !_effectDrawers.back().Resize(
+		scalingWndSize,
+		_backendResources,
+		_backendDescriptorStore,
+		textureAllocator,
+		&inOutTexture
+	)) {
+		Logger::Get().Error("调整降采样效果的尺寸失败");
+		return false;
+	}
+
+	// 释放没有被复用的旧纹理
+	textureAllocator.Trim(_backendDescriptorStore);
+	textureAllocator.LogStatistics();
+
+	_effectsOutput = inOutTexture;
+	return true;
 }
 
-void Renderer::_BackendRender(ID3D11Texture2D* effectsOutput) noexcept {
+void Renderer::_BackendRender() noexcept {
+	// 第 n 帧使用的共享纹理上次由第 n - SHARED_TEXTURE_COUNT 帧写入，它之后的帧完成后
+	// 前端便不会再使用它
+	if (!_WaitForFramesInFlight(MAX_FRAMES_IN_FLIGHT - 1)) {
+		return;
+	}
+
+	const uint64_t frame = _fenceValue + 1;
+	const uint32_t sharedTextureIdx = uint32_t(frame % SHARED_TEXTURE_COUNT);
+	_BackendSharedTexture& sharedTexture = _backendSharedTextures[sharedTextureIdx];
+
+	// 前端在有更新的帧后才会释放这个共享纹理，而之后的帧已经发布，因此一般不会在这里长时间
+	// 等待。直接输出时效果会写入共享纹理，因此在渲染前获取
+	HRESULT hr = sharedTexture.mutex->AcquireSync(0, INFINITE);
+	if (FAILED(hr)) {
+		Logger::Get().ComError("AcquireSync 失败", hr);
+		return;
+	}
+
 	ID3D11DeviceContext4* d3dDC = _backendResources.GetD3DDC();
 	d3dDC->ClearState();
 
-	if (ID3D11Buffer* t = _dynamicCB.get()) {
-		_UpdateDynamicConstants();
-		d3dDC->CSSetConstantBuffers(1, 1, &t);
+	// 只上传变化的常量，通常只有帧数
+	const bool useDynamic = _dynamicConstantRegion != std::numeric_limits<uint32_t>::max();
+	if (useDynamic) {
+		_effectConstantStore.Edit(_dynamicConstantRegion, 0, 1)->uintVal = _stepTimer.FrameCount();
+	}
+	_effectConstantStore.Upload();
+	if (useDynamic) {
+		_effectConstantStore.Bind(_dynamicConstantRegion, 1);
+	}
+
+	if (!_effectsOutput) {
+		// 共享纹理中过时的区域由最后一个效果重新渲染
+		_effectDrawers.back().SetOutputTarget(sharedTextureIdx, sharedTexture.staleRect);
 	}
 
-	_effectsProfiler.OnBeginEffects(d3dDC);
+	_effectsProfiler.OnBeginEffects(d3dDC, frame);
 
-	for (const EffectDrawer& effectDrawer : _effectDrawers) {
-		effectDrawer.Draw(_effectsProfiler);
+	// 依次转换为每个效果的输出中变化的区域
+	RECT dirtyRect = _frameSource->DirtyRect();
+	for (EffectDrawer& effectDrawer : _effectDrawers) {
+		effectDrawer.Draw(_effectsProfiler, dirtyRect);
 	}
 
 	_effectsProfiler.OnEndEffects(d3dDC);
 
-	HRESULT hr = d3dDC->Signal(_d3dFence.get(), ++_fenceValue);
+	// 共享纹理保留了之前某一帧的内容，只需更新此后变化的区域
+	for (_BackendSharedTexture& t : _backendSharedTextures) {
+		UnionRect(&t.staleRect, &t.staleRect, &dirtyRect);
+	}
+
+	if (_effectsOutput) {
+		const RECT& copyRect = sharedTexture.staleRect;
+		if (!IsRectEmpty(&copyRect)) {
+			const D3D11_BOX box{
+				.left = (UINT)copyRect.left,
+				.top = (UINT)copyRect.top,
+				.front = 0,
+				.right = (UINT)copyRect.right,
+				.bottom = (UINT)copyRect.bottom,
+				.back = 1
+			};
+			d3dDC->CopySubresourceRegion(sharedTexture.texture.get(), 0,
+				copyRect.left, copyRect.top, 0, _effectsOutput, 0, &box);
+		}
+	}
+	sharedTexture.staleRect = {};
+
+	// 交给前端
+	sharedTexture.mutex->ReleaseSync(1);
+
+	hr = d3dDC->Signal(_d3dFence.get(), frame);
 	if (FAILED(hr)) {
 		Logger::Get().ComError("Signal 失败", hr);
 		return;
 	}
+	_fenceValue = frame;
 
-	hr = _d3dFence->SetEventOnCompletion(_fenceValue, _fenceEvent.get());
+	hr = _d3dFence->SetEventOnCompletion(frame, _fenceEvent.get());
 	if (FAILED(hr)) {
 		Logger::Get().ComError("SetEventOnCompletion 失败", hr);
 		return;
 	}
 
+	// 根据 https://learn.microsoft.com/en-us/windows/win32/api/d3d11/nf-d3d11-id3d11device-opensharedresource，
+	// 更新共享纹理后必须调用 Flush。不等待渲染完成，在 GPU 执行效果的同时捕获下一帧
 	d3dDC->Flush();
+}
 
-	// 等待渲染完成
-	_fenceEvent.wait();
-
-	// 查询效果的渲染时间
-	_effectsProfiler.QueryTimings(d3dDC);
-
-	// 渲染完成后再更新 _sharedTextureMutexKey，否则前端必须等待，降低光标流畅度
-	const uint64_t key = ++_sharedTextureMutexKey;
-	hr = _backendSharedTextureMutex->AcquireSync(key - 1, INFINITE);
-	if (FAILED(hr)) {
-		Logger::Get().ComError("AcquireSync 失败", hr);
+void Renderer::_PublishCompletedFrames() noexcept {
+	const uint64_t publishedFrame = _publishedFrame.load(std::memory_order_relaxed);
+	if (publishedFrame == _fenceValue) {
 		return;
 	}
 
-	d3dDC->CopyResource(_backendSharedTexture.get(), effectsOutput);
+	const uint64_t completedFrame = std::min(_d3dFence->GetCompletedValue(), _fenceValue);
+	if (completedFrame == publishedFrame) {
+		return;
+	}
 
-	_backendSharedTextureMutex->ReleaseSync(key);
+	// 每个同时执行的帧有自己的查询，读取所有已完成的帧，不会阻塞
+	_effectsProfiler.QueryTimings(_backendResources.GetD3DDC(), completedFrame);
 
-	// 根据 https://learn.microsoft.com/en-us/windows/win32/api/d3d11/nf-d3d11-id3d11device-opensharedresource，
-	// 更新共享纹理后必须调用 Flush
-	d3dDC->Flush();
+	// 渲染完成后再交给前端，否则前端必须等待，降低光标流畅度
+	_publishedFrame.store(completedFrame, std::memory_order_release);
 
 	// 唤醒前台线程
 	PostMessage(ScalingWindow::Get().Handle(), WM_NULL, 0, 0);
 }
 
-bool Renderer::_UpdateDynamicConstants() const noexcept {
-	// cbuffer __CB2 : register(b1) { uint __frameCount; };
-
-	ID3D11DeviceContext4* d3dDC = _backendResources.GetD3DDC();
+bool Renderer::_WaitForFramesInFlight(uint32_t maxFramesInFlight) noexcept {
+	while (_fenceValue - _publishedFrame.load(std::memory_order_relaxed) > maxFramesInFlight) {
+		if (_d3dFence->GetCompletedValue() + maxFramesInFlight < _fenceValue) {
+			// 每帧完成时都会触发 _fenceEvent
+			if (!_fenceEvent.wait(1000)) {
+				Logger::Get().Error("等待渲染完成超时");
+				return false;
+			}
+		}
 
-	D3D11_MAPPED_SUBRESOURCE ms;
-	HRESULT hr = d3dDC->Map(_dynamicCB.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &ms);
-	if (SUCCEEDED(hr)) {
-		// 避免使用 *(uint32_t*)ms.pData，见
-		// https://learn.microsoft.com/en-us/windows/win32/api/d3d11/nf-d3d11-id3d11devicecontext-map
-		const uint32_t frameCount = _stepTimer.FrameCount();
-		std::memcpy(ms.pData, &frameCount, 4);
-		d3dDC->Unmap(_dynamicCB.get(), 0);
-	} else {
-		Logger::Get().ComError("Map 失败", hr);
-		return false;
+		_PublishCompletedFrames();
 	}
 
 	return true;
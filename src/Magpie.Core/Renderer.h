@@ -1,11 +1,13 @@
 #pragma once
 #include "DeviceResources.h"
 #include "BackendDescriptorStore.h"
+#include "EffectConstantStore.h"
 #include "EffectDrawer.h"
 #include "Win32Utils.h"
 #include "CursorDrawer.h"
 #include "StepTimer.h"
 #include "EffectsProfiler.h"
+#include "FrameTrace.h"
 
 namespace Magpie::Core {
 
@@ -23,6 +25,9 @@ public:
 
 	bool Render() noexcept;
 
+	// 源窗口位置或尺寸改变后重建和尺寸有关的资源，已编译的效果保持不变。失败后不能继续渲染
+	bool ResizeSrc() noexcept;
+
 	bool IsOverlayVisible() noexcept;
 
 	void SetOverlayVisibility(bool value, bool noSetForeground = false) noexcept;
@@ -42,34 +47,70 @@ public:
 
 	void OnCursorVisibilityChanged(bool isVisible, bool onDestory);
 
+	// 修改第 effectIdx 个效果的参数，effectName 用于确认效果没有改变。源窗口没有新帧时也会重新渲染。
+	// 设置页面和叠加层都通过它修改参数，只能在前端线程调用
+	void SetEffectParameter(uint32_t effectIdx, std::wstring_view effectName, std::wstring_view paramName, float value);
+
 	void MessageHandler(UINT msg, WPARAM wParam, LPARAM lParam) noexcept;
 
 	struct EffectInfo {
 		std::string name;
 		std::vector<std::string> passNames;
+		// 缩放时可以修改的参数，参数被内联时为空
+		std::vector<EffectParameterDesc> params;
+		// 参数的当前值，和 params 一一对应。只在前端线程修改
+		std::vector<float> paramValues;
 	};
 	const std::vector<EffectInfo>& EffectInfos() const noexcept {
 		return _effectInfos;
 	}
 
 private:
+	// 后端最多同时提交两帧，捕获下一帧时 GPU 可以继续执行上一帧的效果。
+	// 另外还需要一个共享纹理保存前端正在使用的帧。
+	// 共享纹理的键控互斥体在前后端之间交替：后端以 0 获取，写入后以 1 释放；前端以 1 获取，
+	// 有更新的帧后以 0 释放。因此后端不会覆盖前端正在使用的帧，前端也不会读取未写入的纹理
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+	static constexpr uint32_t SHARED_TEXTURE_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
+
 	bool _CreateSwapChain() noexcept;
 
+	bool _OpenSharedTextures() noexcept;
+
 	void _FrontendRender() noexcept;
 
+	// 获取已发布的最新一帧的共享纹理并释放之前持有的。跳过的帧也要获取再释放，否则后端无法再写入
+	bool _AcquireLatestFrame() noexcept;
+
+	// 前端需要等待后端时调用，避免后端正在等待前端持有的共享纹理。之后不能再显示这一帧
+	void _ReleasePresentedFrame() noexcept;
+
 	void _BackendThreadProc() noexcept;
 
-	ID3D11Texture2D* _InitBackend() noexcept;
+	bool _InitBackend() noexcept;
 
 	bool _InitFrameSource() noexcept;
 
 	ID3D11Texture2D* _BuildEffects() noexcept;
 
-	HANDLE _CreateSharedTexture(ID3D11Texture2D* effectsOutput) noexcept;
+	bool _CreateSharedTextures() noexcept;
+
+	bool _ResizeBackend() noexcept;
 
-	void _BackendRender(ID3D11Texture2D* effectsOutput) noexcept;
+	bool _ResizeEffects() noexcept;
 
-	bool _UpdateDynamicConstants() const noexcept;
+	void _BackendRender() noexcept;
+
+	// 将 GPU 已完成的最新一帧交给前端，不会阻塞
+	void _PublishCompletedFrames() noexcept;
+
+	// 等待直到最多有 maxFramesInFlight 帧尚未完成
+	bool _WaitForFramesInFlight(uint32_t maxFramesInFlight) noexcept;
+
+	// 记录 trace 或显示叠加层时才需要每个通道的耗时
+	void _StartProfiler() noexcept;
+
+	void _SaveTrace() const noexcept;
 
 	static LRESULT CALLBACK _LowLevelKeyboardHook(int nCode, WPARAM wParam, LPARAM lParam);
 
@@ -79,7 +120,10 @@ private:
 	wil::unique_event_nothrow _frameLatencyWaitableObject;
 	winrt::com_ptr<ID3D11Texture2D> _backBuffer;
 	winrt::com_ptr<ID3D11RenderTargetView> _backBufferRtv;
-	uint64_t _lastAccessMutexKey = 0;
+	// 前端最后一次使用的帧，不小于 _firstPresentableFrame 时前端持有它的共享纹理
+	uint64_t _lastPresentedFrame = 0;
+	// 在此之前的帧写入的是旧的共享纹理
+	uint64_t _firstPresentableFrame = 1;
 
 	CursorDrawer _cursorDrawer;
 	std::unique_ptr<class OverlayDrawer> _overlayDrawer;
@@ -88,8 +132,8 @@ private:
 	POINT _lastCursorPos{ std::numeric_limits<LONG>::max(), std::numeric_limits<LONG>::max() };
 	uint32_t _lastFPS = std::numeric_limits<uint32_t>::max();
 
-	winrt::com_ptr<ID3D11Texture2D> _frontendSharedTexture;
-	winrt::com_ptr<IDXGIKeyedMutex> _frontendSharedTextureMutex;
+	std::array<winrt::com_ptr<ID3D11Texture2D>, SHARED_TEXTURE_COUNT> _frontendSharedTextures;
+	std::array<winrt::com_ptr<IDXGIKeyedMutex>, SHARED_TEXTURE_COUNT> _frontendSharedTextureMutexes;
 	RECT _destRect{};
 	
 	std::thread _backendThread;
@@ -99,30 +143,63 @@ private:
 	// 只能由后台线程访问
 	DeviceResources _backendResources;
 	Magpie::Core::BackendDescriptorStore _backendDescriptorStore;
+	// 所有效果的常量
+	EffectConstantStore _effectConstantStore;
 	std::unique_ptr<FrameSourceBase> _frameSource;
 	std::vector<EffectDrawer> _effectDrawers;
+	// 最后一个效果直接输出到共享纹理时为空
+	ID3D11Texture2D* _effectsOutput = nullptr;
 
 	StepTimer _stepTimer;
 	EffectsProfiler _effectsProfiler;
 
+	// 第 n 帧完成后围栏的值变为 n
 	winrt::com_ptr<ID3D11Fence> _d3dFence;
 	uint64_t _fenceValue = 0;
+	// 每帧完成时触发
 	wil::unique_event_nothrow _fenceEvent;
 
-	winrt::com_ptr<ID3D11Texture2D> _backendSharedTexture;
-	winrt::com_ptr<IDXGIKeyedMutex> _backendSharedTextureMutex;
+	// 第 n 帧写入 _backendSharedTextures[n % SHARED_TEXTURE_COUNT]
+	struct _BackendSharedTexture {
+		winrt::com_ptr<ID3D11Texture2D> texture;
+		winrt::com_ptr<IDXGIKeyedMutex> mutex;
+		// 和最新一帧相比内容过时的区域
+		RECT staleRect{};
+	};
+	std::array<_BackendSharedTexture, SHARED_TEXTURE_COUNT> _backendSharedTextures;
 
-	winrt::com_ptr<ID3D11Buffer> _dynamicCB;
-	uint32_t _firstDynamicEffectIdx = std::numeric_limits<uint32_t>::max();
+	// 所有效果共用的动态常量在 _effectConstantStore 中的段，没有效果需要时为 max
+	uint32_t _dynamicConstantRegion = std::numeric_limits<uint32_t>::max();
 
 	// 可由所有线程访问
 	winrt::Windows::System::DispatcherQueue _backendThreadDispatcher{ nullptr };
 
-	std::atomic<uint64_t> _sharedTextureMutexKey = 0;
-
-	// INVALID_HANDLE_VALUE 表示后端初始化失败
-	std::atomic<HANDLE> _sharedTextureHandle{ NULL };
-	// 初始化时由 _sharedTextureHandle 同步
+	FrameTrace _frameTrace;
+	// 是否记录 trace，初始化之后不能更改
+	bool _isTraceEnabled = false;
+	uint32_t _captureTraceId = 0;
+	uint32_t _waitTraceId = 0;
+	uint32_t _presentTraceId = 0;
+
+	// GPU 已完成的最新一帧，0 表示第一帧尚未完成。只由后端线程更新
+	std::atomic<uint64_t> _publishedFrame = 0;
+
+	enum class _BackendState : uint8_t {
+		Initializing,
+		Running,
+		// 源窗口尺寸改变，后端正在重建资源
+		Resizing,
+		// 后端初始化或调整尺寸失败
+		Failed
+	};
+	std::atomic<_BackendState> _backendState = _BackendState::Initializing;
+	// 初始化和调整尺寸时由 _backendState 同步
+	std::array<HANDLE, SHARED_TEXTURE_COUNT> _sharedTextureHandles{};
+	// 写入新的共享纹理的第一帧
+	uint64_t _sharedTexturesFirstFrame = 1;
+	bool _isSharedTexturesRecreated = false;
+	// 效果参数已修改但还未渲染
+	bool _isEffectParamsChanged = false;
 	RECT _srcRect{};
 
 	// 供游戏内叠加层使用
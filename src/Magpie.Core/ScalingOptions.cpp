@@ -54,6 +54,7 @@ void ScalingOptions::Log() const noexcept {
 	IsDirectFlipDisabled: {}
 	IsStatisticsForDynamicDetectionEnabled: {}
 	IsTouchSupportEnabled: {}
+	IsFrameTraceEnabled: {}
 	cropping: {},{},{},{}
 	graphicsCard: {}
 	maxFrameRate: {}
@@ -79,6 +80,7 @@ void ScalingOptions::Log() const noexcept {
 		IsDirectFlipDisabled(),
 		IsStatisticsForDynamicDetectionEnabled(),
 		IsTouchSupportEnabled(),
+		IsFrameTraceEnabled(),
 		cropping.Left, cropping.Top, cropping.Right, cropping.Bottom,
 		graphicsCard,
 		maxFrameRate.has_value() ? *maxFrameRate : 0.0f,
@@ -47,6 +47,8 @@ struct ScalingFlags {
 	// Magpie.Core 不负责启动 TouchHelper.exe，指定此标志会使 Magpie.Core 创建辅助窗口以拦截
 	// 黑边上的触控输入
 	static constexpr uint32_t IsTouchSupportEnabled = 1 << 17;
+	// 记录每帧各阶段的耗时，缩放结束后保存到 logs\trace.json
+	static constexpr uint32_t EnableFrameTrace = 1 << 18;
 };
 
 enum class ScalingType {
@@ -59,6 +61,8 @@ enum class ScalingType {
 struct EffectOptionFlags {
 	static constexpr uint32_t InlineParams = 1;
 	static constexpr uint32_t FP16 = 1 << 1;
+	// 分块执行以减少显存占用，效果不支持时忽略
+	static constexpr uint32_t Tiled = 1 << 2;
 };
 
 struct EffectOption {
@@ -97,6 +101,7 @@ struct ScalingOptions {
 	DEFINE_FLAG_ACCESSOR(IsDirectFlipDisabled, ScalingFlags::DisableDirectFlip, flags)
 	DEFINE_FLAG_ACCESSOR(IsStatisticsForDynamicDetectionEnabled, ScalingFlags::EnableStatisticsForDynamicDetection, flags)
 	DEFINE_FLAG_ACCESSOR(IsTouchSupportEnabled, ScalingFlags::IsTouchSupportEnabled, flags)
+	DEFINE_FLAG_ACCESSOR(IsFrameTraceEnabled, ScalingFlags::EnableFrameTrace, flags)
 
 	Cropping cropping{};
 	uint32_t flags = ScalingFlags::AdjustCursorSpeed | ScalingFlags::DrawCursor;	// ScalingFlags
@@ -77,6 +77,18 @@ void ScalingRuntime::ToggleOverlay() {
 	});
 }
 
+void ScalingRuntime::SetEffectParameter(uint32_t effectIdx, std::wstring effectName, std::wstring paramName, float value) {
+	if (!IsRunning()) {
+		return;
+	}
+
+	_Dispatcher().TryEnqueue([effectIdx, effectName(std::move(effectName)), paramName(std::move(paramName)), value]() {
+		if (ScalingWindow& scalingWindow = ScalingWindow::Get()) {
+			scalingWindow.Renderer().SetEffectParameter(effectIdx, effectName, paramName, value);
+		}
+	});
+}
+
 void ScalingRuntime::Stop() {
 	if (!IsRunning()) {
 		return;
@@ -15,6 +15,9 @@ public:
 
 	void ToggleOverlay();
 
+	// 参数在下一帧生效，被内联的参数需要重新缩放
+	void SetEffectParameter(uint32_t effectIdx, std::wstring effectName, std::wstring paramName, float value);
+
 	void Stop();
 
 	bool IsRunning() const noexcept {
@@ -314,6 +314,10 @@ bool ScalingWindow::Create(
 
 void ScalingWindow::Render() noexcept {
 	int srcState = _CheckSrcState();
+	if (srcState == 2 && _ResizeSrc()) {
+		srcState = 0;
+	}
+
 	if (srcState != 0) {
 		Logger::Get().Info("源窗口状态改变，退出全屏");
 		// 切换前台窗口导致停止缩放时不应激活源窗口
@@ -504,6 +508,46 @@ int ScalingWindow::_CheckSrcState() const noexcept {
 	return 0;
 }
 
+// 源窗口位置或大小改变后尝试只重建和尺寸有关的资源，避免重新缩放导致的黑屏。
+// 缩放窗口需要移动时返回 false，此时应回退到重新缩放
+bool ScalingWindow::_ResizeSrc() noexcept {
+	// 触控支持需要重新设置输入变换
+	if (_options.IsTouchSupportEnabled()) {
+		return false;
+	}
+
+	RECT wndRect;
+	if (CalcWndRect(_hwndSrc, _options.multiMonitorUsage, wndRect) == 0 || wndRect != _wndRect) {
+		return false;
+	}
+
+	RECT srcWndRect;
+	if (!GetWindowRect(_hwndSrc, &srcWndRect)) {
+		Logger::Get().Win32Error("GetWindowRect 失败");
+		return false;
+	}
+
+	if (!_options.IsAllowScalingMaximized()) {
+		// 和初始化时相同，源窗口和缩放窗口重合则不缩放
+		RECT srcRect;
+		if (!Win32Utils::GetWindowFrameRect(_hwndSrc, srcRect) || srcRect == _wndRect) {
+			return false;
+		}
+	}
+
+	if (!_renderer->ResizeSrc()) {
+		Logger::Get().Error("调整尺寸失败");
+		return false;
+	}
+
+	_srcWndRect = srcWndRect;
+	_SetWindowProps();
+
+	Logger::Get().Info(fmt::format("已调整尺寸，源窗口边界: {},{},{},{}",
+		srcWndRect.left, srcWndRect.top, srcWndRect.right, srcWndRect.bottom));
+	return true;
+}
+
 bool ScalingWindow::_CheckForeground(HWND hwndForeground) const noexcept {
 	// 检查所有者链是否存在 Magpie.ToolWindow 属性
 	{
@@ -67,6 +67,8 @@ private:
 
 	int _CheckSrcState() const noexcept;
 
+	bool _ResizeSrc() noexcept;
+
 	bool _CheckForeground(HWND hwndForeground) const noexcept;
 
 	bool _DisableDirectFlip() noexcept;
@@ -13,7 +13,7 @@ void StepTimer::Initialize(std::optional<float> maxFrameRate) noexcept {
 	}
 }
 
-bool StepTimer::WaitForNextFrame() noexcept {
+bool StepTimer::WaitForNextFrame(HANDLE hWakeEvent) noexcept {
 	if (!_minInterval) {
 		return true;
 	}
@@ -32,7 +32,12 @@ bool StepTimer::WaitForNextFrame() noexcept {
 			.QuadPart = (rest - 1ms).count() / -100
 		};
 		SetWaitableTimerEx(_hTimer.get(), &liDueTime, 0, NULL, NULL, 0, 0);
-		_hTimer.wait();
+		if (hWakeEvent) {
+			const HANDLE handles[] = { _hTimer.get(), hWakeEvent };
+			WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+		} else {
+			_hTimer.wait();
+		}
 	} else {
 		// 剩余时间在 1ms 以内则“忙等待”
 		Sleep(0);
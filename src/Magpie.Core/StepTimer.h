@@ -12,7 +12,8 @@ public:
 
 	void Initialize(std::optional<float> maxFrameRate) noexcept;
 
-	bool WaitForNextFrame() noexcept;
+	// hWakeEvent 触发时提前返回 false
+	bool WaitForNextFrame(HANDLE hWakeEvent = NULL) noexcept;
 
 	void UpdateFPS(bool newFrame) noexcept;
 
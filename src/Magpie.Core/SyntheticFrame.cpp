@@ -0,0 +1,30 @@
+#include "SyntheticFrame.h"
+#include <random>
+
+namespace Magpie::Core {
+
+std::vector<uint8_t> SyntheticFrame::Generate(uint32_t width, uint32_t height) noexcept {
+	height += EXTRA_ROWS;
+
+	std::minstd_rand rng(42);
+	std::vector<uint32_t> blockColors(((width + 31) / 32) * ((height + 31) / 32));
+	for (uint32_t& color : blockColors) {
+		color = (uint32_t)rng();
+	}
+
+	std::vector<uint8_t> result((size_t)width * height * 4);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			const uint32_t blockColor = blockColors[(y / 32) * ((width + 31) / 32) + x / 32];
+			uint8_t* pixel = &result[((size_t)y * width + x) * 4];
+			pixel[0] = uint8_t((x * 255 / width + (blockColor & 0xFF)) / 2);
+			pixel[1] = uint8_t((y * 255 / height + ((blockColor >> 8) & 0xFF)) / 2);
+			pixel[2] = uint8_t((blockColor >> 16) & 0xFF);
+			pixel[3] = 255;
+		}
+	}
+
+	return result;
+}
+
+}
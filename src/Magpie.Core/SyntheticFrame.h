@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Magpie::Core {
+
+// 离线测量使用的合成画面，GPU 和 CPU 路径共用以便结果可以比较。只依赖标准库
+struct SyntheticFrame {
+	// 高度多出的行数，每帧从不同的行开始读取，使每帧的内容都不同
+	static constexpr uint32_t EXTRA_ROWS = 64;
+
+	// 渐变上叠加随机颜色的色块，既有平滑的区域也有边缘。使用固定的种子以便结果可以复现。
+	// 格式为 R8G8B8A8_UNORM，共有 height + EXTRA_ROWS 行
+	static std::vector<uint8_t> Generate(uint32_t width, uint32_t height) noexcept;
+
+	// 第 frame 帧的起始位置
+	static const uint8_t* FrameData(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t frame) noexcept {
+		return &pixels[size_t(frame % EXTRA_ROWS) * width * 4];
+	}
+};
+
+}
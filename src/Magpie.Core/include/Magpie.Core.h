@@ -4,4 +4,6 @@
 #include "../LoggerHelper.h"
 #include "../EffectCompiler.h"
 #include "../EffectDesc.h"
+#include "../EffectParser.h"
+#include "../EffectMetadataIndex.h"
 #include "../WindowHelper.h"
@@ -1,35 +1,69 @@
-// 无需同步
-RWBuffer<uint> result : register(u0);
+// 计算每个 16x16 的块的哈希，和上一帧的哈希不同则更新并在 changeBitmap 中设置对应的位。
+// 只保存哈希而不是整个上一帧，省去了每帧复制画面的开销
+RWStructuredBuffer<uint2> tileHashes : register(u0);
+RWBuffer<uint> changeBitmap : register(u1);
 
-Texture2D tex1 : register(t0);
-Texture2D tex2 : register(t1);
+Texture2D tex : register(t0);
 
 SamplerState sam : register(s0);
 
+groupshared uint hash1;
+groupshared uint hash2;
+
+// MurmurHash3 的一轮
+uint Mix(uint h, uint v) {
+	v *= 0xcc9e2d51u;
+	v = (v << 15) | (v >> 17);
+	v *= 0x1b873593u;
+	h ^= v;
+	h = (h << 13) | (h >> 19);
+	return h * 5 + 0xe6546b64u;
+}
+
+// 使用两种不同的哈希降低碰撞的概率
+uint2 Hash(uint2 h, uint4 values) {
+	[unroll]
+	for (uint i = 0; i < 4; ++i) {
+		h.x = Mix(h.x, values[i]);
+		// FNV-1a
+		h.y = (h.y ^ values[i]) * 16777619u;
+	}
+	return h;
+}
+
 [numthreads(8, 8, 1)]
-void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {
-	if (result[0]) {
-		return;
+void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID, uint gi : SV_GroupIndex) {
+	if (gi == 0) {
+		hash1 = 0;
+		hash2 = 0;
 	}
-	
+	GroupMemoryBarrierWithGroupSync();
+
 	const int2 gxy = (gid.xy << 4) + (tid.xy << 1);
-	
+
 	// 不知为何这比通过 cbuffer 传入更快
 	uint width, height;
-	tex1.GetDimensions(width, height);
+	tex.GetDimensions(width, height);
 	const float2 pos = (gxy + 1) / float2(width, height);
-	
-	if (any(tex1.GatherRed(sam, pos) != tex2.GatherRed(sam, pos))) {
-		result[0] = 1u;
-		return;
-	}
-	
-	if (any(tex1.GatherGreen(sam, pos) != tex2.GatherGreen(sam, pos))) {
-		result[0] = 1u;
+
+	// 种子包含线程序号，因此块内像素交换位置也能被检测到
+	uint2 h = uint2(gi, 2166136261u ^ gi);
+	h = Hash(h, asuint(tex.GatherRed(sam, pos)));
+	h = Hash(h, asuint(tex.GatherGreen(sam, pos)));
+	h = Hash(h, asuint(tex.GatherBlue(sam, pos)));
+
+	InterlockedXor(hash1, h.x);
+	InterlockedAdd(hash2, h.y);
+	GroupMemoryBarrierWithGroupSync();
+
+	if (gi != 0) {
 		return;
 	}
-	
-	if (any(tex1.GatherBlue(sam, pos) != tex2.GatherBlue(sam, pos))) {
-		result[0] = 1u;
+
+	const uint tileIdx = gid.y * ((width + 15) >> 4) + gid.x;
+	const uint2 tileHash = uint2(hash1, hash2);
+	if (any(tileHashes[tileIdx] != tileHash)) {
+		tileHashes[tileIdx] = tileHash;
+		InterlockedOr(changeBitmap[tileIdx >> 5], 1u << (tileIdx & 31));
 	}
 }
@@ -37,7 +37,8 @@ static void InitializeLogger(const char* logFilePath) noexcept {
 		spdlog::level::info,
 		logFilePath,
 		100000,
-		2
+		2,
+		true
 	);
 }
 
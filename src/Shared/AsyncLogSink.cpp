@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "AsyncLogSink.h"
+
+// 后台线程没有被唤醒时写入的间隔。info 等级的日志本就只在 flush 时落盘，稍晚写入没有影响
+static constexpr DWORD WRITE_INTERVAL_MS = 100;
+
+AsyncLogSink::AsyncLogSink(std::shared_ptr<spdlog::sinks::sink> sink)
+	: _slots(std::make_unique<_Slot[]>(CAPACITY)), _sink(std::move(sink)) {
+	for (uint32_t i = 0; i < CAPACITY; ++i) {
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// 失败则始终同步写入
+	if (SUCCEEDED(_wakeEvent.create())) {
+		_thread = std::thread(&AsyncLogSink::_ThreadProc, this);
+	}
+}
+
+AsyncLogSink::~AsyncLogSink() {
+	if (_thread.joinable()) {
+		_exiting.store(true, std::memory_order_release);
+		_wakeEvent.SetEvent();
+		_thread.join();
+	}
+}
+
+void AsyncLogSink::log(const spdlog::details::log_msg& msg) {
+	if (!_thread.joinable() || !_TryEnqueue(msg)) {
+		// 缓冲区已满时同步写入以免丢失日志，此时和缓冲区中的日志的顺序可能交错
+		_sink->log(msg);
+	}
+}
+
+void AsyncLogSink::flush() {
+	const uint64_t target = _enqueuePos.load(std::memory_order_acquire);
+	uint64_t pos = _dequeuePos.load(std::memory_order_acquire);
+	if (pos < target) {
+		// 唤醒后台线程并等待它写入此前的所有日志
+		_wakeEvent.SetEvent();
+		do {
+			_dequeuePos.wait(pos, std::memory_order_acquire);
+			pos = _dequeuePos.load(std::memory_order_acquire);
+		} while (pos < target);
+	}
+
+	_sink->flush();
+}
+
+void AsyncLogSink::set_pattern(const std::string& pattern) {
+	_sink->set_pattern(pattern);
+}
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter) {
+	_sink->set_formatter(std::move(sinkFormatter));
+}
+
+// 见 https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+bool AsyncLogSink::_TryEnqueue(const spdlog::details::log_msg& msg) noexcept {
+	uint64_t pos = _enqueuePos.load(std::memory_order_relaxed);
+	while (true) {
+		_Slot& slot = _slots[pos & (CAPACITY - 1)];
+		const int64_t diff = (int64_t)slot.sequence.load(std::memory_order_acquire) - (int64_t)pos;
+		if (diff == 0) {
+			if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				slot.msg = spdlog::details::log_msg_buffer(msg);
+				slot.sequence.store(pos + 1, std::memory_order_release);
+				break;
+			}
+		} else if (diff < 0) {
+			// 已满
+			return false;
+		} else {
+			// 已被其他线程占用
+			pos = _enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	// 超过一半时提前唤醒后台线程，避免缓冲区被填满
+	if (pos + 1 - _dequeuePos.load(std::memory_order_relaxed) >= CAPACITY / 2) {
+		_wakeEvent.SetEvent();
+	}
+
+	return true;
+}
+
+void AsyncLogSink::_Drain() noexcept {
+	const uint64_t startPos = _dequeuePos.load(std::memory_order_relaxed);
+	uint64_t pos = startPos;
+
+	while (true) {
+		_Slot& slot = _slots[pos & (CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+			break;
+		}
+
+		if (_sink->should_log(slot.msg.level)) {
+			_sink->log(slot.msg);
+		}
+
+		slot.sequence.store(pos + CAPACITY, std::memory_order_release);
+		++pos;
+	}
+
+	if (pos != startPos) {
+		_dequeuePos.store(pos, std::memory_order_release);
+		_dequeuePos.notify_all();
+	}
+}
+
+void AsyncLogSink::_ThreadProc() noexcept {
+#ifdef _DEBUG
+	SetThreadDescription(GetCurrentThread(), L"Magpie 日志线程");
+#endif
+
+	while (true) {
+		const bool exiting = _exiting.load(std::memory_order_acquire);
+
+		_Drain();
+
+		if (exiting) {
+			break;
+		}
+
+		// 有线程已申请位置但尚未写入时很快重试
+		const bool hasPending = _enqueuePos.load(std::memory_order_relaxed) !=
+			_dequeuePos.load(std::memory_order_relaxed);
+		_wakeEvent.wait(hasPending ? 1 : WRITE_INTERVAL_MS);
+	}
+}
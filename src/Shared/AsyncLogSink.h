@@ -0,0 +1,52 @@
+#pragma once
+#include <spdlog/sinks/sink.h>
+#include <spdlog/details/log_msg_buffer.h>
+#include <thread>
+
+// 将日志放入无锁的环形缓冲区，由后台线程写入被包装的 sink，记录日志的线程无需等待文件 IO。
+// 任意线程都可以写入，只有后台线程读取。缓冲区已满时回落到同步写入。flush 会等待后台线程写入
+// 此前的所有日志，因此 flush_on 和 flush_every 的行为不变。
+class AsyncLogSink : public spdlog::sinks::sink {
+public:
+	// 缓冲区的容量，必须是 2 的幂
+	static constexpr uint32_t CAPACITY = 1024;
+
+	explicit AsyncLogSink(std::shared_ptr<spdlog::sinks::sink> sink);
+	AsyncLogSink(const AsyncLogSink&) = delete;
+	AsyncLogSink(AsyncLogSink&&) = delete;
+
+	~AsyncLogSink() override;
+
+	void log(const spdlog::details::log_msg& msg) override;
+
+	void flush() override;
+
+	void set_pattern(const std::string& pattern) override;
+
+	void set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter) override;
+
+private:
+	bool _TryEnqueue(const spdlog::details::log_msg& msg) noexcept;
+
+	void _Drain() noexcept;
+
+	void _ThreadProc() noexcept;
+
+	struct _Slot {
+		// 等于位置时可写入，等于位置 + 1 时可读取
+		std::atomic<uint64_t> sequence;
+		spdlog::details::log_msg_buffer msg;
+	};
+	std::unique_ptr<_Slot[]> _slots;
+
+	std::shared_ptr<spdlog::sinks::sink> _sink;
+
+	// 下一个可申请的位置
+	std::atomic<uint64_t> _enqueuePos = 0;
+	// 后台线程下一个要读取的位置，只由后台线程修改
+	std::atomic<uint64_t> _dequeuePos = 0;
+
+	wil::unique_event_nothrow _wakeEvent;
+	std::atomic<bool> _exiting = false;
+	std::thread _thread;
+};
@@ -24,10 +24,15 @@ struct CommonSharedConstants {
 
 	static constexpr const char* LOG_PATH = "logs\\magpie.log";
 	static constexpr const char* REGISTER_TOUCH_HELPER_LOG_PATH = "logs\\register_touch_helper.log";
+	static constexpr const char* BENCHMARK_LOG_PATH = "logs\\benchmark.log";
+	static constexpr const char* TESTS_LOG_PATH = "logs\\tests.log";
+	static constexpr const wchar_t* TRACE_PATH = L"logs\\trace.json";
 	static constexpr const wchar_t* CONFIG_DIR = L"config\\";
 	static constexpr const wchar_t* CONFIG_FILENAME = L"config.json";
+	static constexpr const wchar_t* CONFIG_SNAPSHOT_FILENAME = L"config.bin";
 	static constexpr const wchar_t* SOURCES_DIR = L"sources\\";
 	static constexpr const wchar_t* EFFECTS_DIR = L"effects\\";
+	static constexpr const wchar_t* FP16_STORAGE_ALLOWLIST_PATH = L"effects\\fp16_storage.json";
 	static constexpr const wchar_t* ASSETS_DIR = L"assets\\";
 	static constexpr const wchar_t* CACHE_DIR = L"cache\\";
 	static constexpr const wchar_t* UPDATE_DIR = L"update\\";
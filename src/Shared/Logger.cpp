@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Logger.h"
 #include "StrUtils.h"
+#include "AsyncLogSink.h"
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <fmt/printf.h>
 
@@ -8,10 +9,19 @@ bool Logger::Initialize(
 	spdlog::level::level_enum logLevel,
 	const char* logFileName,
 	int logArchiveAboveSize,
-	int logMaxArchiveFiles
+	int logMaxArchiveFiles,
+	bool isAsync
 ) noexcept {
 	try {
-		_logger = spdlog::rotating_logger_mt(".", logFileName, logArchiveAboveSize, logMaxArchiveFiles);
+		std::shared_ptr<spdlog::sinks::sink> sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+			logFileName, (size_t)logArchiveAboveSize, (size_t)logMaxArchiveFiles);
+		if (isAsync) {
+			sink = std::make_shared<AsyncLogSink>(std::move(sink));
+		}
+
+		_logger = std::make_shared<spdlog::logger>(".", std::move(sink));
+		// 注册后 flush_every 才对它生效
+		spdlog::register_logger(_logger);
 		_logger->set_level(logLevel);
 		_logger->set_pattern("%Y-%m-%d %H:%M:%S.%e|%l|%s:%#|%!|%v");
 		_logger->flush_on(spdlog::level::warn);
@@ -74,3 +84,69 @@ void Logger::_Log(spdlog::level::level_enum logLevel, std::string_view msg, cons
 		msg
 	);
 }
+
+static void AppendQuoted(std::string& result, std::string_view str) noexcept {
+	result.push_back('"');
+	for (char c : str) {
+		switch (c) {
+		case '"':
+			result.append("\\\"");
+			break;
+		case '\\':
+			result.append("\\\\");
+			break;
+		case '\n':
+			result.append("\\n");
+			break;
+		case '\r':
+			result.append("\\r");
+			break;
+		case '\t':
+			result.append("\\t");
+			break;
+		default:
+			result.push_back(c);
+			break;
+		}
+	}
+	result.push_back('"');
+}
+
+void Logger::_Log(
+	spdlog::level::level_enum logLevel,
+	std::string_view msg,
+	std::initializer_list<LogField> fields,
+	const SourceLocation& location
+) noexcept {
+	// 不记录时无需拼接
+	if (!_logger->should_log(logLevel)) {
+		return;
+	}
+
+	// 格式为 msg|key1=value1 key2="value2"
+	std::string result(msg);
+	result.push_back('|');
+
+	bool isFirst = true;
+	for (const LogField& field : fields) {
+		if (isFirst) {
+			isFirst = false;
+		} else {
+			result.push_back(' ');
+		}
+
+		result.append(field.key);
+		result.push_back('=');
+
+		std::visit([&](const auto& value) {
+			using T = std::decay_t<decltype(value)>;
+			if constexpr (std::is_same_v<T, std::string_view>) {
+				AppendQuoted(result, value);
+			} else {
+				fmt::format_to(std::back_inserter(result), "{}", value);
+			}
+		}, field.value);
+	}
+
+	_Log(logLevel, result, location);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <spdlog/spdlog.h>
+#include <variant>
 
 // std::source_location 中的函数名包含整个签名过于冗长，我们只需记录函数名，
 // 因此创建自己的 SourceLocation
@@ -39,6 +40,28 @@ private:
 	const char* _function = nullptr;
 };
 
+// 结构化字段，以 key=value 的形式附加在消息之后，便于工具解析。字符串值总是带引号
+struct LogField {
+	LogField(std::string_view key_, std::string_view value_) noexcept : key(key_), value(value_) {}
+
+	template <typename T>
+		requires std::is_arithmetic_v<T>
+	LogField(std::string_view key_, T value_) noexcept : key(key_) {
+		if constexpr (std::is_same_v<T, bool>) {
+			value = value_;
+		} else if constexpr (std::is_floating_point_v<T>) {
+			value = (double)value_;
+		} else if constexpr (std::is_signed_v<T>) {
+			value = (int64_t)value_;
+		} else {
+			value = (uint64_t)value_;
+		}
+	}
+
+	std::string_view key;
+	std::variant<std::string_view, bool, int64_t, uint64_t, double> value;
+};
+
 class Logger {
 public:
 	static Logger& Get() noexcept {
@@ -46,8 +69,15 @@ public:
 		return instance;
 	}
 
-	// 在 exe 中调用
-	bool Initialize(spdlog::level::level_enum logLevel, const char* logFileName, int logArchiveAboveSize, int logMaxArchiveFiles) noexcept;
+	// 在 exe 中调用。isAsync 为 true 时由后台线程写入文件，记录日志的线程不会阻塞，
+	// 但 warn 及以上等级的日志仍会等待写入完成
+	bool Initialize(
+		spdlog::level::level_enum logLevel,
+		const char* logFileName,
+		int logArchiveAboveSize,
+		int logMaxArchiveFiles,
+		bool isAsync
+	) noexcept;
 	// 在 dll 中调用
 	bool Initialize(Logger& logger) noexcept;
 
@@ -61,6 +91,14 @@ public:
 		_Log(spdlog::level::info, msg, location);
 	}
 
+	void Info(
+		std::string_view msg,
+		std::initializer_list<LogField> fields,
+		const SourceLocation& location = SourceLocation::current()
+	) noexcept {
+		_Log(spdlog::level::info, msg, fields, location);
+	}
+
 	void Win32Info(std::string_view msg, const SourceLocation& location = SourceLocation::current()) noexcept {
 		_Log(spdlog::level::info, _MakeWin32ErrorMsg(msg), location);
 	}
@@ -77,6 +115,14 @@ public:
 		_Log(spdlog::level::warn, msg, location);
 	}
 
+	void Warn(
+		std::string_view msg,
+		std::initializer_list<LogField> fields,
+		const SourceLocation& location = SourceLocation::current()
+	) noexcept {
+		_Log(spdlog::level::warn, msg, fields, location);
+	}
+
 	void Win32Warn(std::string_view msg, const SourceLocation& location = SourceLocation::current()) noexcept {
 		_Log(spdlog::level::warn, _MakeWin32ErrorMsg(msg), location);
 	}
@@ -93,6 +139,14 @@ public:
 		_Log(spdlog::level::err, msg, location);
 	}
 
+	void Error(
+		std::string_view msg,
+		std::initializer_list<LogField> fields,
+		const SourceLocation& location = SourceLocation::current()
+	) noexcept {
+		_Log(spdlog::level::err, msg, fields, location);
+	}
+
 	void Win32Error(std::string_view msg, const SourceLocation& location = SourceLocation::current()) noexcept {
 		_Log(spdlog::level::err, _MakeWin32ErrorMsg(msg), location);
 	}
@@ -130,5 +184,12 @@ private:
 
 	void _Log(spdlog::level::level_enum logLevel, std::string_view msg, const SourceLocation& location) noexcept;
 
+	void _Log(
+		spdlog::level::level_enum logLevel,
+		std::string_view msg,
+		std::initializer_list<LogField> fields,
+		const SourceLocation& location
+	) noexcept;
+
 	std::shared_ptr<spdlog::logger> _logger;
 };
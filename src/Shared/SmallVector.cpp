@@ -9,7 +9,6 @@
  // This file implements the SmallVector class.
  //
  //===----------------------------------------------------------------------===//
-#include "pch.h"
 #include "SmallVector.h"
 
 
@@ -226,6 +226,35 @@ bool Win32Utils::WriteTextFile(const wchar_t* fileName, std::string_view text) n
 	return true;
 }
 
+bool Win32Utils::WriteTextFileAtomic(const wchar_t* fileName, std::string_view text) noexcept {
+	const std::wstring tempFileName = StrUtils::Concat(fileName, L".tmp");
+
+	{
+		wil::unique_file hFile;
+		if (_wfopen_s(hFile.put(), tempFileName.c_str(), L"wt") || !hFile) {
+			Logger::Get().Error(StrUtils::Concat("打开文件 ", StrUtils::UTF16ToUTF8(tempFileName), " 失败"));
+			return false;
+		}
+
+		// 文本模式下 fwrite 返回的是写入的字符数而不是字节数
+		if (fwrite(text.data(), 1, text.size(), hFile.get()) != text.size()
+			|| fflush(hFile.get()) != 0 || _commit(_fileno(hFile.get())) != 0) {
+			Logger::Get().Error(StrUtils::Concat("写入文件 ", StrUtils::UTF16ToUTF8(tempFileName), " 失败"));
+			hFile.reset();
+			DeleteFile(tempFileName.c_str());
+			return false;
+		}
+	}
+
+	if (!MoveFileEx(tempFileName.c_str(), fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		Logger::Get().Win32Error("MoveFileEx 失败");
+		DeleteFile(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
 const Win32Utils::OSVersion& Win32Utils::GetOSVersion() noexcept {
 	static OSVersion version = []() -> OSVersion {
 		HMODULE hNtDll = GetModuleHandle(L"ntdll.dll");
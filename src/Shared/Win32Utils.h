@@ -30,6 +30,9 @@ struct Win32Utils {
 
 	static bool WriteTextFile(const wchar_t* fileName, std::string_view text) noexcept;
 
+	// 先写入临时文件并刷新到磁盘再替换原文件，写入过程中崩溃或断电不会损坏原文件
+	static bool WriteTextFileAtomic(const wchar_t* fileName, std::string_view text) noexcept;
+
 	static bool FileExists(const wchar_t* fileName) noexcept {
 		DWORD attrs = GetFileAttributes(fileName);
 		// 排除文件夹
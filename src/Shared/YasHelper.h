@@ -16,9 +16,11 @@
 #include <yas/types/std/string_view.hpp>
 #include <yas/types/std/vector.hpp>
 #include <yas/types/std/variant.hpp>
+#include <yas/types/concepts/keyval.hpp>
 #pragma warning(pop)
 
 #include "SmallVector.h"
+#include <parallel_hashmap/phmap.h>
 
 namespace yas::detail {
 
@@ -63,6 +65,25 @@ struct serializer<
 	}
 };
 
+// phmap::flat_hash_map
+template<size_t F, typename K, typename V, typename Hash, typename Eq, typename Alloc>
+struct serializer<
+	type_prop::not_a_fundamental,
+	ser_case::use_internal_serializer,
+	F,
+	phmap::flat_hash_map<K, V, Hash, Eq, Alloc>
+> {
+	template<typename Archive>
+	static Archive& save(Archive& ar, const phmap::flat_hash_map<K, V, Hash, Eq, Alloc>& map) noexcept {
+		return concepts::keyval::save<F>(ar, map);
+	}
+
+	template<typename Archive>
+	static Archive& load(Archive& ar, phmap::flat_hash_map<K, V, Hash, Eq, Alloc>& map) noexcept {
+		return concepts::keyval::load<F>(ar, map);
+	}
+};
+
 }
 
 #ifdef _M_ARM64
@@ -0,0 +1,265 @@
+#include "pch.h"
+#include "AsyncLogSink.h"
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace std::chrono;
+
+static void BusyWait(microseconds duration) noexcept {
+	const steady_clock::time_point end = steady_clock::now() + duration;
+	while (steady_clock::now() < end) {}
+}
+
+// 记录写入的日志。可以阻塞后台线程，也可以模拟缓慢的 IO
+class RecordingSink : public spdlog::sinks::sink {
+public:
+	struct Record {
+		std::string payload;
+		std::thread::id threadId;
+	};
+
+	void log(const spdlog::details::log_msg& msg) override {
+		// 只阻塞其他线程，否则同步写入的日志会让测试线程卡住
+		if (std::this_thread::get_id() != _ownerThreadId) {
+			std::unique_lock lk(_gateLock);
+			_gateCV.wait(lk, [&] { return !_isGateClosed; });
+		}
+
+		if (writeDelay.count() > 0) {
+			BusyWait(writeDelay);
+		}
+
+		std::scoped_lock lk(_recordsLock);
+		_records.push_back({ std::string(msg.payload.data(), msg.payload.size()), std::this_thread::get_id() });
+	}
+
+	void flush() override {
+		++_flushCount;
+	}
+
+	void set_pattern(const std::string&) override {}
+
+	void set_formatter(std::unique_ptr<spdlog::formatter>) override {}
+
+	void CloseGate() noexcept {
+		std::scoped_lock lk(_gateLock);
+		_isGateClosed = true;
+	}
+
+	void OpenGate() noexcept {
+		{
+			std::scoped_lock lk(_gateLock);
+			_isGateClosed = false;
+		}
+		_gateCV.notify_all();
+	}
+
+	std::vector<Record> Records() noexcept {
+		std::scoped_lock lk(_recordsLock);
+		return _records;
+	}
+
+	uint32_t FlushCount() const noexcept {
+		return _flushCount.load();
+	}
+
+	microseconds writeDelay{};
+
+private:
+	const std::thread::id _ownerThreadId = std::this_thread::get_id();
+
+	std::mutex _gateLock;
+	std::condition_variable _gateCV;
+	bool _isGateClosed = false;
+
+	std::mutex _recordsLock;
+	std::vector<Record> _records;
+
+	std::atomic<uint32_t> _flushCount = 0;
+};
+
+static void Log(spdlog::sinks::sink& sink, const std::string& payload) {
+	sink.log(spdlog::details::log_msg("test", spdlog::level::info, payload));
+}
+
+TEST_CASE(AsyncLogSink_EnqueueDoesNotBlock) {
+	// 后台线程最多取走一条但不会释放它的位置，因此这些日志总能放入缓冲区
+	static constexpr uint32_t MESSAGE_COUNT = AsyncLogSink::CAPACITY;
+
+	auto innerSink = std::make_shared<RecordingSink>();
+	// 模拟卡住的 IO，后台线程写入第一条日志时会被阻塞
+	innerSink->CloseGate();
+
+	AsyncLogSink asyncSink(innerSink);
+
+	// 在另一个线程中入队。如果入队需要等待后台线程或回落到同步写入，这个线程会被阻塞
+	std::promise<void> enqueued;
+	std::future<void> enqueuedFuture = enqueued.get_future();
+	std::thread producer([&] {
+		for (uint32_t i = 0; i < MESSAGE_COUNT; ++i) {
+			Log(asyncSink, fmt::format("message {}", i));
+		}
+		enqueued.set_value();
+	});
+	const std::thread::id producerId = producer.get_id();
+
+	// 超时只用于在入队被阻塞时结束测试，不衡量入队的速度
+	CHECK(enqueuedFuture.wait_for(seconds(10)) == std::future_status::ready);
+	// 后台线程仍被阻塞，没有写入任何日志
+	CHECK(innerSink->Records().empty());
+
+	innerSink->OpenGate();
+	producer.join();
+	asyncSink.flush();
+
+	// 所有日志由后台线程按入队的顺序写入，内容不变
+	const std::vector<RecordingSink::Record> records = innerSink->Records();
+	if (CHECK(records.size() == MESSAGE_COUNT)) {
+		for (uint32_t i = 0; i < MESSAGE_COUNT; ++i) {
+			CHECK(records[i].payload == fmt::format("message {}", i));
+			CHECK(records[i].threadId == records[0].threadId);
+		}
+		CHECK(records[0].threadId != producerId);
+		CHECK(records[0].threadId != std::this_thread::get_id());
+	}
+	CHECK(innerSink->FlushCount() == 1);
+}
+
+TEST_CASE(AsyncLogSink_FullRingFallback) {
+	static constexpr uint32_t OVERFLOW_COUNT = 10;
+
+	auto innerSink = std::make_shared<RecordingSink>();
+	// 后台线程写入第一条日志时会被阻塞，此后不再释放缓冲区中的位置
+	innerSink->CloseGate();
+
+	{
+		AsyncLogSink asyncSink(innerSink);
+
+		// 后台线程最多取走一条但不会释放它的位置，因此前 CAPACITY 条日志总能放入缓冲区
+		for (uint32_t i = 0; i < AsyncLogSink::CAPACITY + OVERFLOW_COUNT; ++i) {
+			Log(asyncSink, std::to_string(i));
+		}
+
+		// 缓冲区已满，多出的日志在当前线程同步写入，不会丢失
+		std::vector<RecordingSink::Record> records = innerSink->Records();
+		if (CHECK(records.size() == OVERFLOW_COUNT)) {
+			for (uint32_t i = 0; i < OVERFLOW_COUNT; ++i) {
+				CHECK(records[i].payload == std::to_string(AsyncLogSink::CAPACITY + i));
+				CHECK(records[i].threadId == std::this_thread::get_id());
+			}
+		}
+
+		innerSink->OpenGate();
+		asyncSink.flush();
+
+		// 缓冲区中的日志由后台线程按顺序写入
+		records = innerSink->Records();
+		if (CHECK(records.size() == AsyncLogSink::CAPACITY + OVERFLOW_COUNT)) {
+			uint32_t next = 0;
+			for (const RecordingSink::Record& record : records) {
+				if (record.threadId == std::this_thread::get_id()) {
+					continue;
+				}
+
+				CHECK(record.payload == std::to_string(next));
+				++next;
+			}
+			CHECK(next == AsyncLogSink::CAPACITY);
+		}
+
+		// 之后缓冲区恢复可用
+		Log(asyncSink, "after");
+		asyncSink.flush();
+
+		records = innerSink->Records();
+		if (CHECK(records.size() == AsyncLogSink::CAPACITY + OVERFLOW_COUNT + 1)) {
+			CHECK(records.back().payload == "after");
+			CHECK(records.back().threadId != std::this_thread::get_id());
+		}
+	}
+}
+
+TEST_CASE(AsyncLogSink_FlushWaitsForEarlierRecords) {
+	static constexpr uint32_t MESSAGE_COUNT = 50;
+
+	auto innerSink = std::make_shared<RecordingSink>();
+	// 后台线程写完所有日志至少需要 100ms，远大于入队的耗时
+	innerSink->writeDelay = microseconds(2000);
+
+	AsyncLogSink asyncSink(innerSink);
+	for (uint32_t i = 0; i < MESSAGE_COUNT; ++i) {
+		Log(asyncSink, std::to_string(i));
+	}
+
+	// 此时后台线程不可能已写完
+	CHECK(innerSink->Records().size() < MESSAGE_COUNT);
+
+	asyncSink.flush();
+
+	// flush 返回时此前的日志均已写入，且被包装的 sink 已 flush
+	const std::vector<RecordingSink::Record> records = innerSink->Records();
+	if (CHECK(records.size() == MESSAGE_COUNT)) {
+		for (uint32_t i = 0; i < MESSAGE_COUNT; ++i) {
+			CHECK(records[i].payload == std::to_string(i));
+			CHECK(records[i].threadId != std::this_thread::get_id());
+		}
+	}
+	CHECK(innerSink->FlushCount() == 1);
+
+	// 没有未写入的日志时直接 flush
+	asyncSink.flush();
+	CHECK(innerSink->FlushCount() == 2);
+}
+
+TEST_CASE(AsyncLogSink_MultipleProducers) {
+	static constexpr uint32_t THREAD_COUNT = 4;
+	// 总数不超过缓冲区容量，否则回落到同步写入的日志会打乱顺序
+	static constexpr uint32_t MESSAGE_COUNT = 200;
+
+	auto innerSink = std::make_shared<RecordingSink>();
+
+	{
+		AsyncLogSink asyncSink(innerSink);
+
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < THREAD_COUNT; ++t) {
+			threads.emplace_back([&, t] {
+				for (uint32_t i = 0; i < MESSAGE_COUNT; ++i) {
+					Log(asyncSink, fmt::format("{} {}", t, i));
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		// 析构时写入剩余的日志
+	}
+
+	// 每个线程的日志都写入且只写入一次，同一线程的日志保持顺序
+	const std::vector<RecordingSink::Record> records = innerSink->Records();
+	CHECK(records.size() == THREAD_COUNT * MESSAGE_COUNT);
+
+	uint32_t nextIds[THREAD_COUNT]{};
+	for (const RecordingSink::Record& record : records) {
+		const size_t space = record.payload.find(' ');
+		if (!CHECK(space != std::string::npos)) {
+			break;
+		}
+
+		const uint32_t t = (uint32_t)std::stoul(record.payload.substr(0, space));
+		const uint32_t i = (uint32_t)std::stoul(record.payload.substr(space + 1));
+		if (!CHECK(t < THREAD_COUNT)) {
+			break;
+		}
+
+		CHECK(i == nextIds[t]);
+		nextIds[t] = i + 1;
+	}
+
+	for (uint32_t t = 0; t < THREAD_COUNT; ++t) {
+		CHECK(nextIds[t] == MESSAGE_COUNT);
+	}
+}
@@ -0,0 +1,262 @@
+#include "TestFramework.h"
+#include "CpuEffectDrawer.h"
+#include "EffectParser.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <string>
+
+using namespace Magpie::Core;
+
+// CMake 构建时为源码中 effects 文件夹的路径，否则为程序所在目录下的 effects 文件夹
+#ifndef MP_EFFECTS_DIR
+#define MP_EFFECTS_DIR "effects/"
+#endif
+
+// 基准图像由独立的参考实现按 effects 文件夹中对应 hlsl 的公式生成，每行为 RGB 的十六进制表示，
+// alpha 均为 255。输入见 CreateInput。修改 CPU 实现后如果结果不再一致，应先确认和 GPU 的输出相同。
+
+static const char* NEAREST_GOLDEN[] = {
+	"0000002400002400004800ff6c00ff6c00ff900000b40000b40000d800fffc00fffc00ff",
+	"0024002424002424004824ff6c24ff6c24ff902400b42400b42400d824fffc24fffc24ff",
+	"0024002424002424004824ff6c24ff6c24ff902400b42400b42400d824fffc24fffc24ff",
+	"0048ff2448ff2448ff4848006c48006c48009048ffb448ffb448ffd84800fc4800fc4800",
+	"006cff246cff246cff486c006c6c006c6c00906cffb46cffb46cffd86c00fc6c00fc6c00",
+	"006cff246cff246cff486c006c6c006c6c00906cffb46cffb46cffd86c00fc6c00fc6c00",
+	"0090002490002490004890ff6c90ff6c90ff909000b49000b49000d890fffc90fffc90ff",
+	"00b40024b40024b40048b4ff6cb4ff6cb4ff90b400b4b400b4b400d8b4fffcb4fffcb4ff",
+	"00b40024b40024b40048b4ff6cb4ff6cb4ff90b400b4b400b4b400d8b4fffcb4fffcb4ff",
+	"00d8ff24d8ff24d8ff48d8006cd8006cd80090d8ffb4d8ffb4d8ffd8d800fcd800fcd800",
+	"00fcff24fcff24fcff48fc006cfc006cfc0090fcffb4fcffb4fcffd8fc00fcfc00fcfc00",
+	"00fcff24fcff24fcff48fc006cfc006cfc0090fcffb4fcffb4fcffd8fc00fcfc00fcfc00"
+};
+
+static const char* BILINEAR_GOLDEN[] = {
+	"0000000900001b00002d00403f00bf5100ff6300ff7500bf870040990000ab0000bd0040cf00bfe100fff300fffc00ff",
+	"0009000909001b09002d09403f09bf5109ff6309ff7509bf870940990900ab0900bd0940cf09bfe109fff309fffc09ff",
+	"001b00091b001b1b002d1b403f1bbf511bff631bff751bbf871b40991b00ab1b00bd1b40cf1bbfe11bfff31bfffc1bff",
+	"002d40092d401b2d402d2d603f2d9f512dbf632dbf752d9f872d60992d40ab2d40bd2d60cf2d9fe12dbff32dbffc2dbf",
+	"003fbf093fbf1b3fbf2d3f9f3f3f60513f40633f40753f60873f9f993fbfab3fbfbd3f9fcf3f60e13f40f33f40fc3f40",
+	"0051ff0951ff1b51ff2d51bf3f51405151006351007551408751bf9951ffab51ffbd51bfcf5140e15100f35100fc5100",
+	"0063ff0963ff1b63ff2d63bf3f63405163006363007563408763bf9963ffab63ffbd63bfcf6340e16300f36300fc6300",
+	"0075bf0975bf1b75bf2d759f3f756051754063754075756087759f9975bfab75bfbd759fcf7560e17540f37540fc7540",
+	"0087400987401b87402d87603f879f5187bf6387bf75879f878760998740ab8740bd8760cf879fe187bff387bffc87bf",
+	"0099000999001b99002d99403f99bf5199ff6399ff7599bf879940999900ab9900bd9940cf99bfe199fff399fffc99ff",
+	"00ab0009ab001bab002dab403fabbf51abff63abff75abbf87ab4099ab00abab00bdab40cfabbfe1abfff3abfffcabff",
+	"00bd4009bd401bbd402dbd603fbd9f51bdbf63bdbf75bd9f87bd6099bd40abbd40bdbd60cfbd9fe1bdbff3bdbffcbdbf",
+	"00cfbf09cfbf1bcfbf2dcf9f3fcf6051cf4063cf4075cf6087cf9f99cfbfabcfbfbdcf9fcfcf60e1cf40f3cf40fccf40",
+	"00e1ff09e1ff1be1ff2de1bf3fe14051e10063e10075e14087e1bf99e1ffabe1ffbde1bfcfe140e1e100f3e100fce100",
+	"00f3ff09f3ff1bf3ff2df3bf3ff34051f30063f30075f34087f3bf99f3ffabf3ffbdf3bfcff340e1f300f3f300fcf300",
+	"00fcff09fcff1bfcff2dfcbf3ffc4051fc0063fc0075fc4087fcbf99fcffabfcffbdfcbfcffc40e1fc00f3fc00fcfc00"
+};
+
+static const char* BICUBIC_GOLDEN[] = {
+	"0000000800001b00002d003d3f00c25100ff6300ff7500c287003d990000ab0000bd003dcf00c2e100fff400fffd00ff",
+	"0008000808001b08002d083b3f08c45108ff6308ff7508c487083b990800ab0800bd083bcf08c4e108fff408fffd08ff",
+	"001b00081b001b1b002d1b3a3f1bc5511bff631bff751bc5871b3a991b00ab1b00bd1b3acf1bc5e11bfff41bfffd1bff",
+	"002d3d082d3b1b2d3a2d2d5d3f2da2512dc7632dc7752da2872d5d992d38ab2d38bd2d5dcf2da2e12dc5f42dc4fd2dc2",
+	"003fc2083fc41b3fc52d3fa23f3f5d513f38633f38753f5d873fa2993fc7ab3fc7bd3fa2cf3f5de13f3af43f3bfd3f3d",
+	"0051ff0851ff1b51ff2d51c73f51385151006351007551388751c79951ffab51ffbd51c7cf5138e15100f45100fd5100",
+	"0063ff0863ff1b63ff2d63c73f63385163006363007563388763c79963ffab63ffbd63c7cf6338e16300f46300fd6300",
+	"0075c20875c41b75c52d75a23f755d51753863753875755d8775a29975c7ab75c7bd75a2cf755de1753af4753bfd753d",
+	"00873d08873b1b873a2d875d3f87a25187c76387c77587a287875d998738ab8738bd875dcf87a2e187c5f487c4fd87c2",
+	"0099000899001b99002d99383f99c75199ff6399ff7599c7879938999900ab9900bd9938cf99c7e199fff499fffd99ff",
+	"00ab0008ab001bab002dab383fabc751abff63abff75abc787ab3899ab00abab00bdab38cfabc7e1abfff4abfffdabff",
+	"00bd3d08bd3b1bbd3a2dbd5d3fbda251bdc763bdc775bda287bd5d99bd38abbd38bdbd5dcfbda2e1bdc5f4bdc4fdbdc2",
+	"00cfc208cfc41bcfc52dcfa23fcf5d51cf3863cf3875cf5d87cfa299cfc7abcfc7bdcfa2cfcf5de1cf3af4cf3bfdcf3d",
+	"00e1ff08e1ff1be1ff2de1c53fe13a51e10063e10075e13a87e1c599e1ffabe1ffbde1c5cfe13ae1e100f4e100fde100",
+	"00f4ff08f4ff1bf4ff2df4c43ff43b51f40063f40075f43b87f4c499f4ffabf4ffbdf4c4cff43be1f400f4f400fdf400",
+	"00fdff08fdff1bfdff2dfdc23ffd3d51fd0063fd0075fd3d87fdc299fdffabfdffbdfdc2cffd3de1fd00f4fd00fdfd00"
+};
+
+static const char* LANCZOS_GOLDEN[] = {
+	"0000070600001a00002d00384000be5000ff6400ff7400bf880040980000ac0000bc0041cf00c7e200fff600fffd00f8",
+	"0006000606001a06002d062b4006ca5006ff6406ff7406cc880633980600ac0600bc0635cf06d4e206fff606fffd06ff",
+	"001a00061a001a1a002d1a24401acf501aff641aff741ad2881a2d981a00ac1a00bc1a30cf1adbe21afff61afffd1aff",
+	"002d38062d2b1a2d242d2d53402da7502de4642de4742da8882d57982d1bac2d1bbc2d58cf2dace22ddbf62dd4fd2dc7",
+	"0040be0640ca1a40cf2d40a740405d50402864402874405c8840a39840d7ac40d7bc40a2cf4058e24030f64035fd4041",
+	"0050ff0650ff1a50ff2d50e44050285050006450007450258850da9850ffac50ffbc50d7cf501be25000f65000fd5000",
+	"0064ff0664ff1a64ff2d64e44064285064006464007464258864da9864ffac64ffbc64d7cf641be26400f66400fd6400",
+	"0074bf0674cc1a74d22d74a840745c50742564742574745b8874a49874daac74dabc74a3cf7457e2742df67433fd7440",
+	"0088400688331a882d2d88574088a35088da6488da7488a488885b988825ac8825bc885ccf88a8e288d2f688ccfd88bf",
+	"0098000698001a98002d981b4098d75098ff6498ff7498da889825989800ac9800bc9828cf98e4e298fff698fffd98ff",
+	"00ac0006ac001aac002dac1b40acd750acff64acff74acda88ac2598ac00acac00bcac28cface4e2acfff6acfffdacff",
+	"00bc4106bc351abc302dbc5840bca250bcd764bcd774bca388bc5c98bc28acbc28bcbc5dcfbca7e2bccff6bccafdbcbe",
+	"00cfc706cfd41acfdb2dcfac40cf5850cf1b64cf1b74cf5788cfa898cfe4accfe4bccfa7cfcf53e2cf24f6cf2bfdcf38",
+	"00e2ff06e2ff1ae2ff2de2db40e23050e20064e20074e22d88e2d298e2fface2ffbce2cfcfe224e2e200f6e200fde200",
+	"00f6ff06f6ff1af6ff2df6d440f63550f60064f60074f63388f6cc98f6ffacf6ffbcf6cacff62be2f600f6f600fdf600",
+	"00fdf806fdff1afdff2dfdc740fd4150fd0064fd0074fd4088fdbf98fdffacfdffbcfdbecffd38e2fd00f6fd00fdfd07"
+};
+
+static const char* JINC_GOLDEN[] = {
+	"0000000f00002c002c4000cc5900ff7400d3880033a10000bc002cd000ccec00fffd00ff",
+	"000f000e10002a0f2e400fe25910ff720fd1880f1da11000ba0f2ed00fe2eb10fffd0fff",
+	"002b290f2b242b2b53412baf5a2be1732bac892b50a22b1ebb2b53d12bafec2bdbfd2bd6",
+	"0041d60f41db2c41ac40415a59411e7441538841a5a141e1bc41acd0415aec4124fd4129",
+	"005aff0e5aff2a5ad7405a17595a00725a28885ae8a15affba5ad7d05a17eb5a00fd5a00",
+	"0073d60f73db2b73ac4173505a731e7373538973afa273e1bb73acd17350ec7324fd7329",
+	"0089290f89242c89534089a55989e17489ac88895aa1891ebc8953d089a5ec89dbfd89d6",
+	"00a2000ea2002aa22840a2e859a2ff72a2d788a217a1a200baa228d0a2e8eba2fffda2ff",
+	"00bb290fbb242bbb5341bbaf5abbe173bbac89bb50a2bb1ebbbb53d1bbafecbbdbfdbbd6",
+	"00d1d60fd1db2cd1ac40d15a59d11e74d15388d1a5a1d1e1bcd1acd0d15aecd124fdd129",
+	"00edff0eecff2aede540ed2b59ec0072ed1a88edd4a1ecffbaede5d0ed2bebec00fded00",
+	"00fdff0ffdff2bfdda41fd295afd0073fd2589fdd6a2fdffbbfddad1fd29ecfd00fdfd00"
+};
+
+// 8x8 的输入，R 和 G 随坐标线性变化，B 为 2x2 的棋盘格，既有渐变也有锐利的边缘
+static CpuTexture CreateInput() noexcept {
+	static constexpr uint32_t INPUT_SIZE = 8;
+
+	std::vector<uint8_t> pixels(INPUT_SIZE * INPUT_SIZE * 4);
+	for (uint32_t y = 0; y < INPUT_SIZE; ++y) {
+		for (uint32_t x = 0; x < INPUT_SIZE; ++x) {
+			// BGRA
+			uint8_t* pixel = &pixels[(y * INPUT_SIZE + x) * 4];
+			pixel[0] = (x / 2 + y / 2) % 2 ? (uint8_t)255 : (uint8_t)0;
+			pixel[1] = uint8_t(y * 36);
+			pixel[2] = uint8_t(x * 36);
+			pixel[3] = 255;
+		}
+	}
+
+	return CpuTexture::FromBGRA8(pixels.data(), INPUT_SIZE, INPUT_SIZE, INPUT_SIZE * 4);
+}
+
+static uint8_t ParseHexByte(const char* str) noexcept {
+	return (uint8_t)std::stoul(std::string(str, 2), nullptr, 16);
+}
+
+static bool LoadMetadata(std::string_view effectName, EffectMetadata& metadata) noexcept {
+	std::ifstream file(std::string(MP_EFFECTS_DIR) + std::string(effectName) + ".hlsl", std::ios::binary);
+	std::string source(std::istreambuf_iterator<char>(file), {});
+	return CHECK(!source.empty()) && CHECK(EffectParser::ParseMetadata(source, metadata) == 0);
+}
+
+static bool Render(
+	std::string_view effectName,
+	const CpuEffectParams& params,
+	uint32_t outputSize,
+	std::vector<uint8_t>& result
+) noexcept {
+	EffectMetadata metadata;
+	if (!LoadMetadata(effectName, metadata)) {
+		return false;
+	}
+
+	CpuEffectDrawer drawer;
+	if (!CHECK(drawer.Initialize(effectName, metadata, params, { 8, 8 }, { outputSize, outputSize }))) {
+		return false;
+	}
+
+	const CpuSize size = drawer.OutputSize();
+	if (!CHECK(size.width == outputSize && size.height == outputSize)) {
+		return false;
+	}
+
+	drawer.Draw(CreateInput()).ToRGBA8(result);
+	return true;
+}
+
+// 比较输出和基准图像，GPU 和 CPU 的浮点运算存在差异，允许每个通道有 1 的误差
+static void CheckGolden(std::string_view effectName, uint32_t outputSize, std::span<const char* const> golden) noexcept {
+	std::vector<uint8_t> result;
+	if (!CHECK(golden.size() == outputSize) || !Render(effectName, {}, outputSize, result)) {
+		return;
+	}
+
+	uint32_t mismatchCount = 0;
+	for (uint32_t y = 0; y < outputSize; ++y) {
+		const char* row = golden[y];
+		CHECK(std::strlen(row) == outputSize * 6);
+
+		for (uint32_t x = 0; x < outputSize; ++x) {
+			const uint8_t* pixel = &result[(y * outputSize + x) * 4];
+
+			bool matched = pixel[3] == 255;
+			for (uint32_t c = 0; c < 3; ++c) {
+				matched &= std::abs(pixel[c] - ParseHexByte(row + (x * 3 + c) * 2)) <= 1;
+			}
+
+			if (!matched && mismatchCount++ < 8) {
+				std::fprintf(stderr, "  %.*s: (%u, %u) 处为 %02x%02x%02x%02x，基准为 %.6s\n",
+					(int)effectName.size(), effectName.data(), x, y,
+					pixel[0], pixel[1], pixel[2], pixel[3], row + x * 6);
+			}
+		}
+	}
+
+	CHECK(mismatchCount == 0);
+}
+
+TEST_CASE(CpuEffectDrawer_NearestGolden) {
+	// 非整数倍缩放，检查采样坐标
+	CheckGolden("Nearest", 12, NEAREST_GOLDEN);
+}
+
+TEST_CASE(CpuEffectDrawer_BilinearGolden) {
+	CheckGolden("Bilinear", 16, BILINEAR_GOLDEN);
+}
+
+TEST_CASE(CpuEffectDrawer_BicubicGolden) {
+	// 使用默认参数 B = C = 0.33
+	CheckGolden("Bicubic", 16, BICUBIC_GOLDEN);
+}
+
+TEST_CASE(CpuEffectDrawer_LanczosGolden) {
+	// 使用默认参数 ARStrength = 0.5，棋盘格的边缘处会触发抗振铃
+	CheckGolden("Lanczos", 16, LANCZOS_GOLDEN);
+}
+
+TEST_CASE(CpuEffectDrawer_JincGolden) {
+	// 非整数倍缩放，使用默认参数
+	CheckGolden("Jinc", 12, JINC_GOLDEN);
+}
+
+TEST_CASE(CpuEffectDrawer_Params) {
+	std::vector<uint8_t> defaultResult;
+	std::vector<uint8_t> result;
+	if (!Render("Bicubic", {}, 16, defaultResult)) {
+		return;
+	}
+
+	// 显式指定默认值和不指定的结果相同
+	if (Render("Bicubic", { { "paramB", 0.33f }, { "paramC", 0.33f } }, 16, result)) {
+		CHECK(result == defaultResult);
+	}
+
+	// B = 0, C = 0.5 为 Catmull-Rom，比默认参数锐利，结果必然不同
+	if (Render("Bicubic", { { "paramB", 0.0f }, { "paramC", 0.5f } }, 16, result)) {
+		CHECK(result != defaultResult);
+	}
+}
+
+TEST_CASE(CpuEffectDrawer_RejectsInvalid) {
+	EffectMetadata bicubicMetadata;
+	EffectMetadata lanczosMetadata;
+	if (!LoadMetadata("Bicubic", bicubicMetadata) || !LoadMetadata("Lanczos", lanczosMetadata)) {
+		return;
+	}
+
+	CpuEffectDrawer drawer;
+
+	// 没有内置 CPU 实现的效果
+	CHECK(!CpuEffectDrawer::IsSupported("Deband"));
+	CHECK(!CpuEffectDrawer::IsSupported("ImageAdjustment"));
+	CHECK(!drawer.Initialize("Deband", bicubicMetadata, {}, { 8, 8 }, { 16, 16 }));
+
+	// 元数据和 CPU 实现的参数不一致
+	CHECK(!drawer.Initialize("Bicubic", lanczosMetadata, {}, { 8, 8 }, { 16, 16 }));
+	CHECK(!drawer.Initialize("Lanczos", bicubicMetadata, {}, { 8, 8 }, { 16, 16 }));
+
+	// 未声明的参数和超出范围的值
+	CHECK(!drawer.Initialize("Bicubic", bicubicMetadata, { { "paramD", 0.5f } }, { 8, 8 }, { 16, 16 }));
+	CHECK(!drawer.Initialize("Bicubic", bicubicMetadata, { { "paramB", 1.5f } }, { 8, 8 }, { 16, 16 }));
+	CHECK(!drawer.Initialize("Bicubic", bicubicMetadata, { { "paramC", -0.1f } }, { 8, 8 }, { 16, 16 }));
+
+	// 非法的尺寸
+	CHECK(!drawer.Initialize("Bicubic", bicubicMetadata, {}, { 8, 8 }, { 0, 16 }));
+	CHECK(!drawer.Initialize("Bicubic", bicubicMetadata, {}, { 0, 0 }, { 16, 16 }));
+
+	CHECK(drawer.Initialize("Bicubic", bicubicMetadata, { { "paramB", 1.0f } }, { 8, 8 }, { 16, 16 }));
+}
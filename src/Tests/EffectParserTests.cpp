@@ -0,0 +1,112 @@
+#include "TestFramework.h"
+#include "EffectParser.h"
+
+using namespace Magpie::Core;
+
+static constexpr std::string_view VALID_EFFECT = R"(//!MAGPIE EFFECT
+//!VERSION 4
+//!SORT_NAME Test
+
+//!PARAMETER
+//!LABEL Strength
+//!DEFAULT 0.5
+//!MIN 0
+//!MAX 1
+//!STEP 0.01
+float strength;
+
+//!TEXTURE
+Texture2D INPUT;
+
+//!TEXTURE
+//!WIDTH INPUT_WIDTH
+//!HEIGHT INPUT_HEIGHT
+//!FORMAT R16G16B16A16_FLOAT
+Texture2D tex1;
+
+//!SAMPLER
+//!FILTER POINT
+SamplerState sam;
+
+//!PASS 2
+//!IN tex1
+//!OUT OUTPUT
+//!BLOCK_SIZE 16
+//!NUM_THREADS 64
+
+void Pass2(uint2 blockStart, uint3 threadId) {}
+
+//!PASS 1
+//!DESC First
+//!IN INPUT
+//!OUT tex1
+//!STYLE PS
+
+float4 Pass1(float2 pos) { return 0; }
+)";
+
+static uint32_t ParseMetadata(std::string_view source) noexcept {
+	std::string copy(source);
+	EffectMetadata metadata;
+	return EffectParser::ParseMetadata(copy, metadata);
+}
+
+// 将 VALID_EFFECT 中的 from 替换为 to
+static std::string ReplaceInEffect(std::string_view from, std::string_view to) noexcept {
+	std::string result(VALID_EFFECT);
+	const size_t pos = result.find(from);
+	CHECK(pos != std::string::npos);
+	if (pos != std::string::npos) {
+		result.replace(pos, from.size(), to);
+	}
+	return result;
+}
+
+TEST_CASE(EffectParser_ParseMetadata) {
+	std::string source(VALID_EFFECT);
+	EffectMetadata metadata;
+	CHECK(EffectParser::ParseMetadata(source, metadata) == 0);
+
+	CHECK(metadata.sortName == "Test");
+	CHECK(metadata.params.size() == 1);
+	if (metadata.params.size() == 1) {
+		CHECK(metadata.params[0].name == "strength");
+		CHECK(metadata.params[0].label == "Strength");
+	}
+	CHECK(metadata.outputSizeExpr.first.empty());
+}
+
+TEST_CASE(EffectParser_RejectsBrokenPasses) {
+	// 没有 PASS 块
+	CHECK(ParseMetadata(VALID_EFFECT.substr(0, VALID_EFFECT.find("//!PASS 2"))) != 0);
+	// 序号不连续
+	CHECK(ParseMetadata(ReplaceInEffect("//!PASS 2", "//!PASS 3")) != 0);
+	// 序号重复
+	CHECK(ParseMetadata(ReplaceInEffect("//!PASS 2", "//!PASS 1")) != 0);
+	// 未声明的纹理
+	CHECK(ParseMetadata(ReplaceInEffect("//!IN INPUT", "//!IN INPUT, tex2")) != 0);
+	// OUTPUT 不能作为输入
+	CHECK(ParseMetadata(ReplaceInEffect("//!IN tex1", "//!IN OUTPUT")) != 0);
+	// 最后一个通道只能输出到 OUTPUT
+	CHECK(ParseMetadata(ReplaceInEffect("//!OUT OUTPUT", "//!OUT tex1")) != 0);
+	// 缺少 OUT
+	CHECK(ParseMetadata(ReplaceInEffect("//!OUT tex1\n", "")) != 0);
+	// 未知的选项
+	CHECK(ParseMetadata(ReplaceInEffect("//!DESC First", "//!DESCRIPTION First")) != 0);
+	// 重复的选项
+	CHECK(ParseMetadata(ReplaceInEffect("//!DESC First", "//!IN INPUT")) != 0);
+	// CS 样式必须指定 BLOCK_SIZE 和 NUM_THREADS
+	CHECK(ParseMetadata(ReplaceInEffect("//!BLOCK_SIZE 16\n", "")) != 0);
+	// PS 样式不能指定 BLOCK_SIZE
+	CHECK(ParseMetadata(ReplaceInEffect("//!STYLE PS", "//!STYLE PS\n//!BLOCK_SIZE 16")) != 0);
+	CHECK(ParseMetadata(ReplaceInEffect("//!STYLE PS", "//!STYLE VS")) != 0);
+}
+
+TEST_CASE(EffectParser_RejectsBrokenTextures) {
+	// 未知的选项
+	CHECK(ParseMetadata(ReplaceInEffect("//!FORMAT", "//!FMT")) != 0);
+	// 重复的选项
+	CHECK(ParseMetadata(ReplaceInEffect("//!HEIGHT", "//!WIDTH")) != 0);
+	// 重复的纹理名
+	CHECK(ParseMetadata(ReplaceInEffect("Texture2D INPUT;", "Texture2D tex1;")) != 0);
+}
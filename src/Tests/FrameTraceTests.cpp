@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "FrameTrace.h"
+#include <rapidjson/document.h>
+
+using namespace Magpie::Core;
+
+static const FrameTrace::Summary* FindSummary(
+	const std::vector<FrameTrace::Summary>& summaries,
+	std::string_view name
+) noexcept {
+	auto it = std::find_if(summaries.begin(), summaries.end(),
+		[&](const FrameTrace::Summary& summary) { return summary.name == name; });
+	return it == summaries.end() ? nullptr : &*it;
+}
+
+TEST_CASE(FrameTrace_SummarizeEmpty) {
+	FrameTrace trace;
+	trace.RegisterName("Effect");
+
+	CHECK(trace.Summarize().empty());
+}
+
+TEST_CASE(FrameTrace_SummarizePercentiles) {
+	FrameTrace trace;
+	const uint32_t effectId = trace.RegisterName("Effect");
+	const uint32_t singleId = trace.RegisterName("Single");
+
+	// 乱序记录 1ms~100ms
+	for (uint32_t i = 0; i < 100; ++i) {
+		const uint32_t ms = (i * 37) % 100 + 1;
+		trace.Record(FrameTrace::Category::GPU, effectId, i, i * 1000, ms * 1000);
+	}
+	trace.Record(FrameTrace::Category::Present, singleId, 0, 0, 2500);
+
+	const std::vector<FrameTrace::Summary> summaries = trace.Summarize();
+	CHECK(summaries.size() == 2);
+
+	const FrameTrace::Summary* effect = FindSummary(summaries, "Effect");
+	if (CHECK(effect)) {
+		CHECK(effect->category == FrameTrace::Category::GPU);
+		CHECK(effect->count == 100);
+		CHECK_NEAR(effect->average, 50.5f, 1e-4f);
+		// 最近秩法: p50 为第 50 个，p99 为第 99 个
+		CHECK_NEAR(effect->p50, 50.0f, 1e-4f);
+		CHECK_NEAR(effect->p99, 99.0f, 1e-4f);
+		CHECK_NEAR(effect->max, 100.0f, 1e-4f);
+	}
+
+	// 只有一个值时所有统计量都等于它
+	const FrameTrace::Summary* single = FindSummary(summaries, "Single");
+	if (CHECK(single)) {
+		CHECK(single->count == 1);
+		CHECK_NEAR(single->average, 2.5f, 1e-4f);
+		CHECK_NEAR(single->p50, 2.5f, 1e-4f);
+		CHECK_NEAR(single->p99, 2.5f, 1e-4f);
+		CHECK_NEAR(single->max, 2.5f, 1e-4f);
+	}
+}
+
+TEST_CASE(FrameTrace_SummarizeSplitsCategories) {
+	FrameTrace trace;
+	const uint32_t nameId = trace.RegisterName("Total");
+	CHECK(trace.RegisterName("Total") == nameId);
+
+	trace.Record(FrameTrace::Category::GPU, nameId, 0, 0, 1000);
+	trace.Record(FrameTrace::Category::CPU, nameId, 0, 0, 3000);
+
+	// 同名但类别不同的事件分开统计，按类别排列
+	const std::vector<FrameTrace::Summary> summaries = trace.Summarize();
+	if (CHECK(summaries.size() == 2)) {
+		CHECK(summaries[0].category == FrameTrace::Category::GPU);
+		CHECK_NEAR(summaries[0].max, 1.0f, 1e-4f);
+		CHECK(summaries[1].category == FrameTrace::Category::CPU);
+		CHECK_NEAR(summaries[1].max, 3.0f, 1e-4f);
+	}
+}
+
+TEST_CASE(FrameTrace_SummarizeAfterWrap) {
+	FrameTrace trace(4);
+	const uint32_t nameId = trace.RegisterName("Effect");
+
+	// 缓冲区只保留最后 4 个事件: 3ms~6ms
+	for (uint32_t i = 1; i <= 6; ++i) {
+		trace.Record(FrameTrace::Category::GPU, nameId, i, i * 1000, i * 1000);
+	}
+
+	const std::vector<FrameTrace::Summary> summaries = trace.Summarize();
+	if (CHECK(summaries.size() == 1)) {
+		CHECK(summaries[0].count == 4);
+		CHECK_NEAR(summaries[0].average, 4.5f, 1e-4f);
+		CHECK_NEAR(summaries[0].p50, 4.0f, 1e-4f);
+		CHECK_NEAR(summaries[0].max, 6.0f, 1e-4f);
+	}
+}
+
+TEST_CASE(FrameTrace_ExportEmpty) {
+	FrameTrace trace;
+	const std::string json = trace.ExportChromeTrace();
+
+	rapidjson::Document doc;
+	doc.Parse(json.c_str(), json.size());
+	if (!CHECK(!doc.HasParseError() && doc.IsObject())) {
+		return;
+	}
+
+	CHECK(doc.HasMember("displayTimeUnit") && doc["displayTimeUnit"] == "ms");
+	if (!CHECK(doc.HasMember("traceEvents") && doc["traceEvents"].IsArray())) {
+		return;
+	}
+
+	// 没有事件时只有每个轨道的元数据
+	const auto& events = doc["traceEvents"].GetArray();
+	CHECK(events.Size() == (uint32_t)FrameTrace::Category::COUNT);
+	for (uint32_t i = 0; i < events.Size(); ++i) {
+		const auto& event = events[i];
+		CHECK(event["name"] == "thread_name");
+		CHECK(event["ph"] == "M");
+		CHECK(event["tid"].GetUint() == i + 1);
+		CHECK(event["args"]["name"] == FrameTrace::CategoryName((FrameTrace::Category)i));
+	}
+}
+
+TEST_CASE(FrameTrace_ExportEvents) {
+	FrameTrace trace;
+	const uint32_t effectId = trace.RegisterName("Effect");
+	// 名字中的特殊字符必须转义
+	const uint32_t escapedId = trace.RegisterName("a\"b\\c\n");
+
+	trace.Record(FrameTrace::Category::GPU, effectId, 7, 1500, 250);
+	trace.Record(FrameTrace::Category::Present, escapedId, 8, 3000, 40);
+
+	const std::string json = trace.ExportChromeTrace();
+
+	rapidjson::Document doc;
+	doc.Parse(json.c_str(), json.size());
+	if (!CHECK(!doc.HasParseError() && doc.IsObject() && doc["traceEvents"].IsArray())) {
+		return;
+	}
+
+	const auto& events = doc["traceEvents"].GetArray();
+	const uint32_t metadataCount = (uint32_t)FrameTrace::Category::COUNT;
+	if (!CHECK(events.Size() == metadataCount + 2)) {
+		return;
+	}
+
+	const auto& first = events[metadataCount];
+	CHECK(first["name"] == "Effect");
+	CHECK(first["cat"] == "GPU");
+	CHECK(first["ph"] == "X");
+	CHECK(first["ts"].GetUint64() == 1500);
+	CHECK(first["dur"].GetUint() == 250);
+	CHECK(first["pid"].GetUint() == 1);
+	CHECK(first["tid"].GetUint() == (uint32_t)FrameTrace::Category::GPU + 1);
+	CHECK(first["args"]["frame"].GetUint64() == 7);
+
+	const auto& second = events[metadataCount + 1];
+	CHECK(second["name"] == "a\"b\\c\n");
+	CHECK(second["cat"] == "Present");
+	CHECK(second["tid"].GetUint() == (uint32_t)FrameTrace::Category::Present + 1);
+	CHECK(second["args"]["frame"].GetUint64() == 8);
+}
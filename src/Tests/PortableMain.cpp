@@ -0,0 +1,6 @@
+#include "TestFramework.h"
+
+// 用于 CMake 构建的入口，只包含不依赖 Win32 的测试用例。用法和 main.cpp 相同
+int main(int argc, char* argv[]) {
+	return Magpie::Tests::RunTests(argc > 1 ? argv[1] : "");
+}
@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "ProfileMatcher.h"
+
+using namespace winrt::Magpie::App;
+
+static Profile MakeProfile(
+	std::wstring_view classNameRule,
+	std::wstring_view pathRule,
+	bool isAutoScale = false,
+	bool isPackaged = false
+) noexcept {
+	Profile profile;
+	profile.classNameRule = classNameRule;
+	profile.pathRule = pathRule;
+	profile.isAutoScale = isAutoScale;
+	profile.isPackaged = isPackaged;
+	return profile;
+}
+
+static Profile MakeWildcardProfile(std::wstring_view classNameRule, std::wstring_view pathRule, bool isAutoScale = false) noexcept {
+	Profile profile = MakeProfile(classNameRule, pathRule, isAutoScale);
+	profile.isWildcardRule = true;
+	return profile;
+}
+
+// 模拟获取窗口所属的应用，同时记录调用次数
+struct FakeApp {
+	bool operator()(bool& isPackaged_, std::wstring_view& pathOrAumid_) noexcept {
+		++callCount;
+		isPackaged_ = isPackaged;
+		pathOrAumid_ = pathOrAumid;
+		return succeeded;
+	}
+
+	std::wstring_view pathOrAumid;
+	bool isPackaged = false;
+	bool succeeded = true;
+	uint32_t callCount = 0;
+};
+
+TEST_CASE(ProfileMatcher_ParseWPFClassName) {
+	CHECK(ProfileMatcher::ParseClassName(
+		L"HwndWrapper[Game.exe;;0a1b2c3d-1234-5678-9abc-def012345678]") == L"Game.exe");
+	// 名称中可以包含分号
+	CHECK(ProfileMatcher::ParseClassName(
+		L"HwndWrapper[a;b;;0a1b2c3d-1234-5678-9abc-def012345678]") == L"a;b");
+	// GUID 格式不对时保持不变
+	CHECK(ProfileMatcher::ParseClassName(
+		L"HwndWrapper[Game.exe;;0a1b2c3d-1234-5678-9abc]") == L"HwndWrapper[Game.exe;;0a1b2c3d-1234-5678-9abc]");
+	CHECK(ProfileMatcher::ParseClassName(
+		L"HwndWrapper[Game.exe;;0a1b2c3d-1234-5678-9abc-def012345678") == L"HwndWrapper[Game.exe;;0a1b2c3d-1234-5678-9abc-def012345678");
+}
+
+TEST_CASE(ProfileMatcher_ParseRPGMakerClassName) {
+	CHECK(ProfileMatcher::ParseClassName(L"Chrome_WidgetWin_1") == L"Chrome_WidgetWin_1");
+	CHECK(ProfileMatcher::ParseClassName(L"Chrome_WidgetWin_42") == L"Chrome_WidgetWin_1");
+	CHECK(ProfileMatcher::ParseClassName(L"Chrome_WidgetWin_4a") == L"Chrome_WidgetWin_4a");
+}
+
+TEST_CASE(ProfileMatcher_ParseTeknoParrotClassName) {
+	CHECK(ProfileMatcher::ParseClassName(L"XWindow_1234567") == L"XWindow_0");
+	CHECK(ProfileMatcher::ParseClassName(L"XWindow_12x") == L"XWindow_12x");
+	CHECK(ProfileMatcher::ParseClassName(L"Notepad") == L"Notepad");
+}
+
+TEST_CASE(ProfileMatcher_ExactMatch) {
+	const Profile profiles[] = {
+		MakeProfile(L"Notepad", L"C:\\Windows\\notepad.exe"),
+		MakeProfile(L"UnityWndClass", L"C:\\Games\\a.exe"),
+		MakeProfile(L"UnityWndClass", L"C:\\Games\\b.exe"),
+		MakeProfile(L"UnityWndClass", L"C:\\Games\\a.exe")
+	};
+
+	ProfileMatcher matcher;
+	matcher.Build(profiles);
+
+	FakeApp app{ L"C:\\Games\\b.exe" };
+	CHECK(matcher.Match(false, L"UnityWndClass", app) == 2);
+
+	// 规则相同时返回第一个
+	app.pathOrAumid = L"C:\\Games\\a.exe";
+	CHECK(matcher.Match(false, L"UnityWndClass", app) == 1);
+
+	// 打包应用和路径相同的非打包应用不匹配
+	app.isPackaged = true;
+	CHECK(matcher.Match(false, L"UnityWndClass", app) == ProfileMatcher::NO_MATCH);
+}
+
+TEST_CASE(ProfileMatcher_WildcardPrecedence) {
+	// 更靠前的通配符规则优先于精确匹配
+	{
+		const Profile profiles[] = {
+			MakeWildcardProfile(L"Unreal*", L"C:\\Games\\*.exe"),
+			MakeProfile(L"UnrealWindow", L"C:\\Games\\a.exe")
+		};
+
+		ProfileMatcher matcher;
+		matcher.Build(profiles);
+
+		FakeApp app{ L"C:\\Games\\a.exe" };
+		CHECK(matcher.Match(false, L"UnrealWindow", app) == 0);
+
+		// 只匹配通配符规则
+		app.pathOrAumid = L"C:\\Games\\c.exe";
+		CHECK(matcher.Match(false, L"UnrealWindow", app) == 0);
+
+		// 类名匹配但路径不匹配
+		app.pathOrAumid = L"D:\\a.exe";
+		CHECK(matcher.Match(false, L"UnrealWindow", app) == ProfileMatcher::NO_MATCH);
+	}
+
+	// 更靠后的通配符规则不能取代精确匹配
+	{
+		const Profile profiles[] = {
+			MakeProfile(L"UnrealWindow", L"C:\\Games\\a.exe"),
+			MakeWildcardProfile(L"Unreal?indow", L"*")
+		};
+
+		ProfileMatcher matcher;
+		matcher.Build(profiles);
+
+		FakeApp app{ L"C:\\Games\\a.exe" };
+		CHECK(matcher.Match(false, L"UnrealWindow", app) == 0);
+
+		app.pathOrAumid = L"C:\\Games\\b.exe";
+		CHECK(matcher.Match(false, L"UnrealWindow", app) == 1);
+
+		// ? 只匹配一个字符，区分大小写
+		CHECK(matcher.Match(false, L"Unrealwindow", app) == 1);
+		CHECK(matcher.Match(false, L"UnrealXXindow", app) == ProfileMatcher::NO_MATCH);
+		CHECK(matcher.Match(false, L"unrealWindow", app) == ProfileMatcher::NO_MATCH);
+	}
+}
+
+TEST_CASE(ProfileMatcher_AutoScaleFilter) {
+	const Profile profiles[] = {
+		MakeWildcardProfile(L"Game*", L"*"),
+		MakeProfile(L"GameWindow", L"C:\\game.exe"),
+		MakeProfile(L"GameWindow", L"C:\\game.exe", true)
+	};
+
+	ProfileMatcher matcher;
+	matcher.Build(profiles);
+	CHECK(matcher.HasAutoScaleRules());
+
+	FakeApp app{ L"C:\\game.exe" };
+	CHECK(matcher.Match(false, L"GameWindow", app) == 0);
+	// 自动缩放时跳过未启用自动缩放的配置文件
+	CHECK(matcher.Match(true, L"GameWindow", app) == 2);
+
+	// 没有启用自动缩放的配置文件时不获取窗口所属的应用
+	const Profile manualProfiles[] = {
+		MakeWildcardProfile(L"Game*", L"*"),
+		MakeProfile(L"GameWindow", L"C:\\game.exe")
+	};
+	matcher.Build(manualProfiles);
+	CHECK(!matcher.HasAutoScaleRules());
+
+	app.callCount = 0;
+	CHECK(matcher.Match(true, L"GameWindow", app) == ProfileMatcher::NO_MATCH);
+	CHECK(app.callCount == 0);
+}
+
+TEST_CASE(ProfileMatcher_ResolveApp) {
+	const Profile profiles[] = {
+		MakeProfile(L"Notepad", L"C:\\Windows\\notepad.exe"),
+		MakeWildcardProfile(L"Console*", L"*")
+	};
+
+	ProfileMatcher matcher;
+	matcher.Build(profiles);
+
+	// 类名不匹配时不获取窗口所属的应用
+	FakeApp app{ L"C:\\Windows\\notepad.exe" };
+	CHECK(matcher.Match(false, L"Calculator", app) == ProfileMatcher::NO_MATCH);
+	CHECK(app.callCount == 0);
+
+	CHECK(matcher.Match(false, L"Notepad", app) == 0);
+	CHECK(app.callCount == 1);
+
+	// 获取失败视为没有匹配，即使存在匹配任意路径的通配符规则
+	app.succeeded = false;
+	CHECK(matcher.Match(false, L"Notepad", app) == ProfileMatcher::NO_MATCH);
+	CHECK(matcher.Match(false, L"ConsoleWindowClass", app) == ProfileMatcher::NO_MATCH);
+	CHECK(app.callCount == 3);
+}
+
+TEST_CASE(ProfileMatcher_LiteralWildcardChars) {
+	// 未启用通配符时 * 和 ? 是类名和路径的一部分
+	const Profile profiles[] = {
+		MakeProfile(L"Game*Window", L"C:\\Games\\a?.exe"),
+		MakeProfile(L"GameWindow", L"C:\\Games\\a?.exe")
+	};
+
+	ProfileMatcher matcher;
+	matcher.Build(profiles);
+
+	FakeApp app{ L"C:\\Games\\a?.exe" };
+	CHECK(matcher.Match(false, L"Game*Window", app) == 0);
+	CHECK(matcher.Match(false, L"GameWindow", app) == 1);
+	CHECK(matcher.Match(false, L"GameXWindow", app) == ProfileMatcher::NO_MATCH);
+
+	app.pathOrAumid = L"C:\\Games\\ab.exe";
+	CHECK(matcher.Match(false, L"Game*Window", app) == ProfileMatcher::NO_MATCH);
+
+	// 同样的规则启用通配符后匹配任意字符
+	const Profile wildcardProfiles[] = {
+		MakeWildcardProfile(L"Game*Window", L"C:\\Games\\a?.exe")
+	};
+	matcher.Build(wildcardProfiles);
+	CHECK(matcher.Match(false, L"GameXWindow", app) == 0);
+	CHECK(matcher.Match(false, L"Game*Window", app) == 0);
+}
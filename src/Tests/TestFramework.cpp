@@ -0,0 +1,40 @@
+#include "TestFramework.h"
+
+namespace Magpie::Tests {
+
+std::vector<TestCase>& RegisteredTests() noexcept {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+bool& CurrentTestFailed() noexcept {
+	static bool failed = false;
+	return failed;
+}
+
+int RunTests(std::string_view filter) noexcept {
+	uint32_t runCount = 0;
+	uint32_t failedCount = 0;
+	for (const TestCase& test : RegisteredTests()) {
+		if (!filter.empty() && std::string_view(test.name).find(filter) == std::string_view::npos) {
+			continue;
+		}
+
+		std::fprintf(stderr, "[ 运行 ] %s\n", test.name);
+		CurrentTestFailed() = false;
+		test.func();
+		++runCount;
+
+		if (CurrentTestFailed()) {
+			++failedCount;
+			std::fprintf(stderr, "[ 失败 ] %s\n", test.name);
+		} else {
+			std::fprintf(stderr, "[ 通过 ] %s\n", test.name);
+		}
+	}
+
+	std::fprintf(stderr, "共 %u 个测试，%u 个失败\n", runCount, failedCount);
+	return failedCount == 0 ? 0 : 1;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+namespace Magpie::Tests {
+
+// 极简的测试框架，只依赖标准库。TEST_CASE 在静态初始化时注册，由 RunTests 依次执行。
+// 检查失败时只记录并继续执行，一个测试用例中的所有失败都会被报告。
+using TestFunc = void (*)();
+
+struct TestCase {
+	const char* name;
+	TestFunc func;
+};
+
+std::vector<TestCase>& RegisteredTests() noexcept;
+
+// 当前测试用例是否有检查失败
+bool& CurrentTestFailed() noexcept;
+
+// 只执行名字包含 filter 的测试用例，全部通过时返回 0
+int RunTests(std::string_view filter) noexcept;
+
+struct TestRegistrar {
+	TestRegistrar(const char* name, TestFunc func) noexcept {
+		RegisteredTests().push_back({ name, func });
+	}
+};
+
+inline bool Check(bool condition, const char* expr, const char* file, int line) noexcept {
+	if (!condition) {
+		std::fprintf(stderr, "  %s(%d): 检查失败: %s\n", file, line, expr);
+		CurrentTestFailed() = true;
+	}
+	return condition;
+}
+
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static const ::Magpie::Tests::TestRegistrar name##_registrar(#name, name); \
+	static void name()
+
+#define CHECK(expr) ::Magpie::Tests::Check(bool(expr), #expr, __FILE__, __LINE__)
+
+// 浮点数比较，允许 eps 的误差
+#define CHECK_NEAR(actual, expected, eps) CHECK(std::abs(double(actual) - double(expected)) <= double(eps))
@@ -0,0 +1,34 @@
+#include "pch.h"
+#include "Logger.h"
+#include "Win32Utils.h"
+#include "CommonSharedConstants.h"
+
+using namespace Magpie::Tests;
+
+// 将当前目录设为程序所在目录，以便找到 effects 文件夹
+static void SetWorkingDir() noexcept {
+	std::wstring path = Win32Utils::GetExePath();
+
+	FAIL_FAST_IF_FAILED(PathCchRemoveFileSpec(
+		path.data(),
+		path.size() + 1
+	));
+
+	FAIL_FAST_IF_WIN32_BOOL_FALSE(SetCurrentDirectory(path.c_str()));
+}
+
+// 用法: Tests [过滤]
+// 只执行名字包含过滤字符串的测试用例
+int main(int argc, char* argv[]) {
+	SetWorkingDir();
+
+	Logger::Get().Initialize(
+		spdlog::level::info,
+		CommonSharedConstants::TESTS_LOG_PATH,
+		100000,
+		2,
+		false
+	);
+
+	return RunTests(argc > 1 ? argv[1] : "");
+}
@@ -0,0 +1,3 @@
+#include "pch.h"
+
+// 当使用预编译的头时，需要使用此源文件，编译才能成功。